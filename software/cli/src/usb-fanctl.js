@@ -18,6 +18,79 @@ program.configureOutput(
     }
 );
 
+function calc_crc32(buf)
+{
+    // Same as the firmware: CRC-32 polynomial fed MSB first with little endian words, no final XOR
+    let crc = 0xFFFFFFFF;
+
+    for(let i = 0; i < buf.length; i += 4)
+    {
+        let data = 0;
+
+        for(let j = 0; j < 4 && i + j < buf.length; j++)
+            data |= buf[i + j] << (8 * j);
+
+        crc = (crc ^ data) >>> 0;
+
+        for(let k = 0; k < 32; k++)
+            crc = (crc & 0x80000000 ? (crc << 1) ^ 0x04C11DB7 : crc << 1) >>> 0;
+    }
+
+    return crc;
+}
+function decode_history_block(buf, period)
+{
+    // Key frame followed by records of a LEB128 bitmap of the changed fields and a zigzag LEB128 delta for each of them
+    let time = buf.readUInt32LE(0);
+    let count = buf.readUInt16LE(4);
+    let size = buf.readUInt16LE(6);
+    let fields = [];
+    let samples = [];
+    let pos = 44;
+
+    function read_varint()
+    {
+        let value = 0;
+
+        for(let shift = 0; pos < 44 + size; shift += 7)
+        {
+            let byte = buf.readUInt8(pos++);
+
+            value += (byte & 0x7F) * Math.pow(2, shift);
+
+            if(!(byte & 0x80))
+                break;
+        }
+
+        return value;
+    }
+
+    for(let i = 0; i < 18; i++)
+        fields.push(buf.readInt16LE(8 + i * 2));
+
+    for(let n = 0; n < count; n++)
+    {
+        if(n)
+        {
+            let changed = read_varint();
+
+            for(let i = 0; i < 18; i++)
+            {
+                if(!(changed & (1 << i)))
+                    continue;
+
+                let zigzag = read_varint();
+                let delta = zigzag & 1 ? -((zigzag + 1) / 2) : zigzag / 2;
+
+                fields[i] = ((fields[i] + delta + 0x18000) & 0xFFFF) - 0x8000;
+            }
+        }
+
+        samples.push({ time: time + n * period, fields: fields.slice() });
+    }
+
+    return samples;
+}
 async function sleep(ms)
 {
     return new Promise(resolve => setTimeout(resolve, ms));
@@ -126,6 +199,17 @@ async function serial_port_cmd(port, cmd)
                             return;
                     }
 
+                    if(cmd >= 0xE1 && cmd <= 0xEF) // Unsolicited event, not the response
+                    {
+                        resp = resp.subarray(expectedLength);
+                        expectedLength = 4;
+
+                        if(resp.length < expectedLength)
+                            return;
+
+                        return port.emit("data", Buffer.alloc(0));
+                    }
+
                     port.removeAllListeners("data");
 
                     return resolve(resp);
@@ -168,6 +252,29 @@ async function cmd_set_dc(port, channel, dc)
     if(cmdID === 0x01)
         return true;
 }
+async function cmd_set_dc_all(port, dcs)
+{
+    let cmd = Buffer.alloc(4 + 7 * 4);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x0A, 2);
+    cmd.writeUInt8(7 * 4, 3);
+
+    for(let i = 0; i < 7; i++)
+        cmd.writeFloatLE(dcs[i], 4 + i * 4);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error setting DC");
+
+    if(cmdID === 0x0A)
+        return true;
+}
 async function cmd_get_dc(port, channel)
 {
     let cmd = Buffer.from([0xC7, 0xFA, 0x02, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00]);
@@ -237,8 +344,14 @@ async function cmd_set_freq(port, freq)
     if(cmdID === 0xE0)
         throw new Error("Error setting frequency");
 
-    if(cmdID === 0x05)
-        return true;
+    if(cmdID === 0x05 && payloadLen === 8)
+    {
+        return {
+            freq: resp.readFloatLE(4),
+            prescaler: resp.readUInt16LE(8),
+            steps: resp.readUInt16LE(10)
+        };
+    }
 }
 async function cmd_get_freq(port)
 {
@@ -256,9 +369,9 @@ async function cmd_get_freq(port)
     if(cmdID === 0x06 && payloadLen === cmd.length - 4)
         return resp.readFloatLE(4);
 }
-async function cmd_get_uid(port)
+async function cmd_get_pwm_info(port)
 {
-    let cmd = Buffer.from([0xC7, 0xFA, 0xF0, 0x00]);
+    let cmd = Buffer.from([0xC7, 0xFA, 0x07, 0x00]);
 
     let resp = await serial_port_cmd(port, cmd);
 
@@ -267,199 +380,1505 @@ async function cmd_get_uid(port)
     let payloadLen = resp.readUInt8(3);
 
     if(cmdID === 0xE0)
-        throw new Error("Error getting UID");
+        throw new Error("Error getting PWM info");
 
-    if(cmdID === 0xF0 && payloadLen === 8)
+    if(cmdID === 0x07 && payloadLen === 8)
     {
-        let str = "";
-
-        for(let i = 7; i >= 0; i--)
-            str += resp.readUInt8(i + 4).toString(16).padStart(2, "0").toUpperCase() + (i === 4 ? "-" : "");
-
-        return str;
+        return {
+            freq: resp.readFloatLE(4),
+            prescaler: resp.readUInt16LE(8),
+            steps: resp.readUInt16LE(10)
+        };
     }
 }
-
-async function run()
+async function cmd_set_burst(port, channel, on, off)
 {
-    let opts = program.opts();
+    let cmd = Buffer.from([0xC7, 0xFA, 0x08, 0x03, 0x00, 0x00, 0x00]);
 
-    if(!opts.port)
-    {
-        console.log("Invalid options provided");
-        console.log("Invalid serial port");
+    cmd.writeUInt8(channel, 4);
+    cmd.writeUInt8(on, 5);
+    cmd.writeUInt8(off, 6);
 
-        return process.exit(1);
-    }
+    let resp = await serial_port_cmd(port, cmd);
 
-    let port_details
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
 
-    try
-    {
-        port_details = await validate_serial_port(opts.port);
-    }
-    catch(e)
-    {
-        console.log("Invalid options provided");
-        console.log("Serial port does not match criteria");
-        console.log(e);
+    if(cmdID === 0xE0)
+        throw new Error("Error setting burst");
 
-        return process.exit(1);
-    }
+    if(cmdID === 0x08)
+        return true;
+}
+async function cmd_get_burst(port, channel)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0x09, 0x03, 0x00, 0x00, 0x00]);
 
-    if(!port_details)
-    {
-        console.log("Invalid options provided");
-        console.log("Serial port does not exist");
+    cmd.writeUInt8(channel, 4);
 
-        return process.exit(1);
-    }
+    let resp = await serial_port_cmd(port, cmd);
 
-    let port;
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
 
-    try
-    {
-        port = await open_serial_port(opts.port);
-    }
-    catch(e)
-    {
-        console.log("Error opening serial port");
-        console.log(e);
+    if(cmdID === 0xE0)
+        throw new Error("Error getting burst");
 
-        return process.exit(1);
-    }
+    if(cmdID === 0x09 && payloadLen === cmd.length - 4)
+        return {on: resp.readUInt8(5), off: resp.readUInt8(6)};
+}
+async function cmd_set_eff_voltage(port, channel, voltage)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0x0D, 0x03, 0x00, 0x00, 0x00]);
 
-    if(typeof opts.voltage === "number")
-    {
-        if(opts.voltage < 0 || opts.voltage > 5)
-        {
-            console.log("Invalid options provided");
-            console.log("Invalid voltage channel (0 < chan < 6)");
+    cmd.writeUInt8(channel, 4);
+    cmd.writeUInt16LE(voltage, 5);
 
-            return process.exit(1);
-        }
+    let resp = await serial_port_cmd(port, cmd);
 
-        console.log((await cmd_get_voltage(port, opts.voltage)) + " mV");
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
 
-        port.close();
-        return process.exit(0);
-    }
+    if(cmdID === 0xE0)
+        throw new Error("Error setting effective voltage");
 
-    if(typeof opts.temp === "number")
-    {
-        if(opts.temp < 0 || opts.temp > 1)
-        {
-            console.log("Invalid options provided");
-            console.log("Invalid temperature channel (0 < chan < 2)");
+    if(cmdID === 0x0D)
+        return true;
+}
+async function cmd_get_eff_voltage(port, channel)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0x0E, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00]);
 
-            return process.exit(1);
-        }
+    cmd.writeUInt8(channel, 4);
 
-        console.log((await cmd_get_temperature(port, opts.temp)) + " C");
+    let resp = await serial_port_cmd(port, cmd);
 
-        port.close();
-        return process.exit(0);
-    }
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
 
-    if(typeof opts.freq === "number")
-    {
-        if(opts.freq < 0)
-        {
-            console.log("Invalid options provided");
-            console.log("Invalid frequency");
+    if(cmdID === 0xE0)
+        throw new Error("Error getting effective voltage");
 
-            return process.exit(1);
-        }
+    if(cmdID === 0x0E && payloadLen === cmd.length - 4)
+        return {voltage: resp.readUInt16LE(5), vext: resp.readUInt16LE(7)};
+}
+async function cmd_set_fan_curve(port, channel, source, points, hysteresis, min, max)
+{
+    let cmd = Buffer.alloc(4 + 9 + 8 * 4);
 
-        await cmd_set_freq(port, opts.freq);
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x0F, 2);
+    cmd.writeUInt8(9 + 8 * 4, 3);
+    cmd.writeUInt8(channel, 4);
+    cmd.writeUInt8(source, 5);
+    cmd.writeUInt8(points.length, 6);
+    cmd.writeUInt16LE(Math.round(hysteresis * 256), 7);
+    cmd.writeUInt16LE(Math.round(min * 65535), 9);
+    cmd.writeUInt16LE(Math.round(max * 65535), 11);
 
-        port.close();
-        return process.exit(0);
+    for(let i = 0; i < points.length; i++)
+    {
+        cmd.writeInt16LE(Math.round(points[i].temp * 256), 13 + i * 4);
+        cmd.writeUInt16LE(Math.round(points[i].dc * 65535), 15 + i * 4);
     }
 
-    if(typeof opts.channel === "number")
-    {
-        if(opts.channel < 0 || opts.channel > 6)
-        {
-            console.log("Invalid options provided");
-            console.log("Invalid channel (0 < chan < 7)");
+    let resp = await serial_port_cmd(port, cmd);
 
-            return process.exit(1);
-        }
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
 
-        if(typeof opts.dutyCycle === "number")
-        {
-            if(opts.dutyCycle < 0 || opts.dutyCycle > 100)
-            {
-                console.log("Invalid options provided");
-                console.log("Invalid duty cycle (0 < dc < 100)");
+    if(cmdID === 0xE0)
+        throw new Error("Error setting fan curve");
 
-                return process.exit(1);
-            }
+    if(cmdID === 0x0F)
+        return true;
+}
+async function cmd_set_pid(port, channel, enable, source, setpoint, kp, ki, kd, filter, min, max, period)
+{
+    let cmd = Buffer.alloc(4 + 24);
 
-            await cmd_set_dc(port, opts.channel, opts.dutyCycle / 100);
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x11, 2);
+    cmd.writeUInt8(24, 3);
+    cmd.writeUInt8(channel, 4);
+    cmd.writeUInt8(enable ? 1 : 0, 5);
+    cmd.writeUInt8(source, 6);
+    cmd.writeInt16LE(Math.round(setpoint * 256), 7);
+    cmd.writeInt32LE(kp, 9);
+    cmd.writeInt32LE(ki, 13);
+    cmd.writeInt32LE(kd, 17);
+    cmd.writeUInt8(filter, 21);
+    cmd.writeUInt16LE(Math.round(min * 65535), 22);
+    cmd.writeUInt16LE(Math.round(max * 65535), 24);
+    cmd.writeUInt16LE(period, 26);
 
-            port.close();
-            return process.exit(0);
-        }
+    let resp = await serial_port_cmd(port, cmd);
 
-        console.log((await cmd_get_dc(port, opts.channel)) * 100 + " %");
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
 
-        port.close();
-        return process.exit(0);
-    }
+    if(cmdID === 0xE0)
+        throw new Error("Error setting PID loop");
 
-    console.log("USB Serial number: " + port_details.serialNumber.toUpperCase());
-    console.log("Unique ID: " + await cmd_get_uid(port));
+    if(cmdID === 0x11)
+        return true;
+}
+async function cmd_get_pid(port, channel)
+{
+    let cmd = Buffer.alloc(4 + 28);
 
-    console.log("Frequency: " + (await cmd_get_freq(port)) + " Hz");
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x12, 2);
+    cmd.writeUInt8(28, 3);
+    cmd.writeUInt8(channel, 4);
 
-    let str;
+    let resp = await serial_port_cmd(port, cmd);
 
-    str = "Duty cycle: ";
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
 
-    for(let i = 0; i < 7; i++)
-        str += ((await cmd_get_dc(port, i)) * 100).toFixed(2) + "%" + (i === 6 ? "" : ", ");
+    if(cmdID === 0xE0)
+        throw new Error("Error getting PID loop");
 
-    console.log(str);
+    if(cmdID === 0x12 && payloadLen === cmd.length - 4)
+    {
+        return {
+            enabled: !!resp.readUInt8(5),
+            source: resp.readUInt8(6),
+            setpoint: resp.readInt16LE(7) / 256,
+            kp: resp.readInt32LE(9),
+            ki: resp.readInt32LE(13),
+            kd: resp.readInt32LE(17),
+            filter: resp.readUInt8(21),
+            min: resp.readUInt16LE(22) / 65535,
+            max: resp.readUInt16LE(24) / 65535,
+            period: resp.readUInt16LE(26),
+            temperature: resp.readInt16LE(28) / 256,
+            dc: resp.readUInt16LE(30) / 65535
+        };
+    }
+}
+async function cmd_get_sensors(port)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0x13, 0x00]);
 
-    str = "Voltage: ";
+    let resp = await serial_port_cmd(port, cmd);
 
-    for(let i = 0; i < 6; i++)
-        str += (await cmd_get_voltage(port, i)).toFixed(2) + " mV" + (i === 5 ? "" : ", ");
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
 
-    console.log(str);
+    if(cmdID === 0xE0)
+        throw new Error("Error getting sensors");
 
-    str = "Temperature: ";
+    if(cmdID !== 0x13 || payloadLen !== 1 + 8 * 8)
+        return;
 
-    for(let i = 0; i < 2; i++)
-        str += (await cmd_get_temperature(port, i)).toFixed(2) + " C" + (i === 1 ? "" : ", ");
+    let sensors = [];
 
-    console.log(str);
+    for(let i = 0; i < resp.readUInt8(4); i++)
+        sensors.push(Buffer.from(resp.subarray(5 + i * 8, 13 + i * 8)).reverse().toString("hex").toUpperCase());
 
-    port.close();
-    process.exit(0);
+    return sensors;
 }
-
-async function main()
+async function cmd_set_sensor_config(port, sensor, resolution, overdrive)
 {
-    let defaultPort;
+    let cmd = Buffer.from([0xC7, 0xFA, 0x14, 0x03, 0x00, 0x00, 0x00]);
 
-    if(OS.platform() === "win32")
-        defaultPort = "COM1";
-    else if(OS.platform() === "linux")
-        defaultPort = "/dev/ttyUSB0";
+    cmd.writeUInt8(sensor, 4);
+    cmd.writeUInt8(resolution, 5);
+    cmd.writeUInt8(overdrive ? 1 : 0, 6);
 
-    program
-        .option("-p, --port <port>", "Serial port to use", defaultPort)
-        .option("-d, --duty-cycle <dc>", "Set the duty cycle, requires -c", parseFloat)
-        .option("-c, --channel <chan>", "Set the channel, if -d is not set, reads back the current value", parseInt)
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error setting sensor configuration");
+
+    if(cmdID === 0x14)
+        return true;
+}
+async function cmd_get_sensor_config(port, sensor)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0x15, 0x04, 0x00, 0x00, 0x00, 0x00]);
+
+    cmd.writeUInt8(sensor, 4);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error getting sensor configuration");
+
+    if(cmdID === 0x15 && payloadLen === cmd.length - 4)
+        return {resolution: resp.readUInt8(5), overdrive: !!resp.readUInt8(6), parasite: !!resp.readUInt8(7)};
+}
+async function cmd_set_filter(port, input, type, param)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0x16, 0x03, 0x00, 0x00, 0x00]);
+
+    cmd.writeUInt8(input, 4);
+    cmd.writeUInt8(type, 5);
+    cmd.writeUInt8(param, 6);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error setting filter");
+
+    if(cmdID === 0x16)
+        return true;
+}
+async function cmd_get_stats(port, input, clear)
+{
+    let cmd = Buffer.alloc(4 + 24);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x17, 2);
+    cmd.writeUInt8(24, 3);
+    cmd.writeUInt8(input, 4);
+    cmd.writeUInt8(clear, 5);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error getting statistics");
+
+    if(cmdID === 0x17 && payloadLen === cmd.length - 4)
+    {
+        return {
+            filter: resp.readUInt8(6),
+            param: resp.readUInt8(7),
+            min: resp.readFloatLE(8),
+            max: resp.readFloatLE(12),
+            mean: resp.readFloatLE(16),
+            peak: resp.readFloatLE(20),
+            count: resp.readUInt32LE(24)
+        };
+    }
+}
+async function cmd_set_rail_alarm(port, input, enable, low, high, force, safeDuty)
+{
+    let cmd = Buffer.alloc(4 + 15);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x18, 2);
+    cmd.writeUInt8(15, 3);
+    cmd.writeUInt8(input, 4);
+    cmd.writeUInt8(enable ? 1 : 0, 5);
+    cmd.writeFloatLE(low, 6);
+    cmd.writeFloatLE(high, 10);
+    cmd.writeUInt8(force ? 1 : 0, 14);
+    cmd.writeFloatLE(safeDuty, 15);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error setting rail alarm");
+
+    if(cmdID === 0x18)
+        return true;
+}
+async function cmd_get_rail_alarm(port, input, clear)
+{
+    let cmd = Buffer.alloc(4 + 18);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x19, 2);
+    cmd.writeUInt8(18, 3);
+    cmd.writeUInt8(input, 4);
+    cmd.writeUInt8(clear ? 1 : 0, 5);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error getting rail alarm");
+
+    if(cmdID === 0x19 && payloadLen === cmd.length - 4)
+    {
+        return {
+            enabled: !!resp.readUInt8(6),
+            armed: !!resp.readUInt8(7),
+            latched: resp.readUInt8(8),
+            low: resp.readFloatLE(9),
+            high: resp.readFloatLE(13),
+            force: !!resp.readUInt8(17),
+            safeDuty: resp.readFloatLE(18)
+        };
+    }
+}
+async function cmd_set_sample_period(port, period)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0x1A, 0x02, 0x00, 0x00]);
+
+    cmd.writeUInt16LE(period, 4);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error setting sample period");
+
+    if(cmdID === 0x1A)
+        return true;
+}
+async function cmd_get_sample_period(port)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0x1B, 0x00]);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error getting sample period");
+
+    if(cmdID === 0x1B && payloadLen === 6)
+        return {period: resp.readUInt16LE(4), sequences: resp.readUInt32LE(6)};
+}
+async function cmd_set_rpm_config(port, channel, enable, pulsesPerRev)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0x1C, 0x03, 0x00, 0x00, 0x00]);
+
+    cmd.writeUInt8(channel, 4);
+    cmd.writeUInt8(enable ? 1 : 0, 5);
+    cmd.writeUInt8(pulsesPerRev, 6);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error setting RPM configuration");
+
+    if(cmdID === 0x1C)
+        return true;
+}
+async function cmd_get_rpm(port, channel)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0x1D, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00]);
+
+    cmd.writeUInt8(channel, 4);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error getting RPM");
+
+    if(cmdID === 0x1D && payloadLen === cmd.length - 4)
+        return {enabled: !!resp.readUInt8(5), pulsesPerRev: resp.readUInt8(6), rpm: resp.readUInt16LE(7)};
+}
+async function cmd_set_tach_config(port, tach, channel, pulsesPerRev, average, stallTimeout)
+{
+    let cmd = Buffer.alloc(4 + 6);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x1E, 2);
+    cmd.writeUInt8(6, 3);
+    cmd.writeUInt8(tach, 4);
+    cmd.writeUInt8(channel, 5);
+    cmd.writeUInt8(pulsesPerRev, 6);
+    cmd.writeUInt8(average, 7);
+    cmd.writeUInt16LE(stallTimeout, 8);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error setting tach configuration");
+
+    if(cmdID === 0x1E)
+        return true;
+}
+async function cmd_get_tach(port, tach, clear)
+{
+    let cmd = Buffer.alloc(4 + 15);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x1F, 2);
+    cmd.writeUInt8(15, 3);
+    cmd.writeUInt8(tach, 4);
+    cmd.writeUInt8(clear ? 1 : 0, 5);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error getting tach");
+
+    if(cmdID === 0x1F && payloadLen === cmd.length - 4)
+    {
+        return {
+            channel: resp.readUInt8(6),
+            pulsesPerRev: resp.readUInt8(7),
+            average: resp.readUInt8(8),
+            stallTimeout: resp.readUInt16LE(9),
+            rpm: resp.readUInt16LE(11),
+            pulses: resp.readUInt32LE(13),
+            fault: !!resp.readUInt8(17),
+            kicks: resp.readUInt8(18)
+        };
+    }
+}
+async function cmd_self_test(port, run)
+{
+    let cmd = Buffer.alloc(4 + 17);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x20, 2);
+    cmd.writeUInt8(17, 3);
+    cmd.writeUInt8(run ? 1 : 0, 4);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error running self-test");
+
+    if(cmdID === 0x20 && payloadLen === cmd.length - 4)
+    {
+        let result = resp.readUInt16LE(5);
+        let channels = [];
+
+        for(let i = 0; i < 7; i++)
+        {
+            channels.push({
+                state: ["no load", "normal", "SHORT", "untested"][(result >> (i * 2)) & 3],
+                droop: resp.readInt16LE(7 + i * 2)
+            });
+        }
+
+        return channels;
+    }
+}
+async function cmd_get_accounting(port, channel, reset)
+{
+    let cmd = Buffer.alloc(4 + 26);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x21, 2);
+    cmd.writeUInt8(26, 3);
+    cmd.writeUInt8(channel, 4);
+    cmd.writeUInt8(reset ? 1 : 0, 5);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error getting accounting");
+
+    if(cmdID === 0x21 && payloadLen === cmd.length - 4)
+    {
+        return {
+            onTime: Number(resp.readBigUInt64LE(6)) / 1000, // s
+            dutyTime: Number(resp.readBigUInt64LE(14)) / 65536 / 1000, // s at full duty
+            energy: Number(resp.readBigUInt64LE(22)) / 1e6 // V^2 s
+        };
+    }
+}
+async function cmd_update_begin(port, size, crc)
+{
+    let cmd = Buffer.alloc(4 + 8);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x22, 2);
+    cmd.writeUInt8(8, 3);
+    cmd.writeUInt32LE(size, 4);
+    cmd.writeUInt32LE(crc, 8);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error starting update");
+
+    if(cmdID === 0x22)
+        return true;
+}
+async function cmd_update_data(port, offset, chunk)
+{
+    let cmd = Buffer.alloc(4 + 4 + chunk.length);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x23, 2);
+    cmd.writeUInt8(4 + chunk.length, 3);
+    cmd.writeUInt32LE(offset, 4);
+    chunk.copy(cmd, 8);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error writing update chunk at " + offset);
+
+    if(cmdID === 0x23)
+        return true;
+}
+async function cmd_update_finish(port, apply)
+{
+    let cmd = Buffer.alloc(4 + 5);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x24, 2);
+    cmd.writeUInt8(5, 3);
+    cmd.writeUInt8(apply ? 1 : 0, 4);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Image verification failed");
+
+    if(cmdID === 0x24 && payloadLen === cmd.length - 4)
+        return resp.readUInt32LE(5);
+}
+async function cmd_get_history(port, tier, block)
+{
+    let cmd = Buffer.alloc(4 + 249);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x26, 2);
+    cmd.writeUInt8(249, 3);
+    cmd.writeUInt8(tier, 4);
+    cmd.writeUInt8(block, 5);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error getting history");
+
+    if(cmdID === 0x26 && payloadLen === cmd.length - 4)
+    {
+        let period = resp.readUInt16LE(7);
+
+        return {
+            blockCount: resp.readUInt8(6),
+            period: period, // s
+            now: resp.readUInt32LE(9), // s
+            samples: decode_history_block(resp.subarray(13, 13 + 240), period)
+        };
+    }
+}
+async function cmd_get_perf(port, reset)
+{
+    let cmd = Buffer.alloc(4 + 29);
+
+    cmd.writeUInt16LE(0xFAC7, 0);
+    cmd.writeUInt8(0x25, 2);
+    cmd.writeUInt8(29, 3);
+    cmd.writeUInt8(reset ? 1 : 0, 4);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error getting performance counters");
+
+    if(cmdID === 0x25 && payloadLen === cmd.length - 4)
+    {
+        return {
+            loopAvg: resp.readUInt32LE(5), // Cycles
+            loopMax: resp.readUInt32LE(9), // Cycles
+            cmdMax: resp.readUInt32LE(13), // Cycles
+            cacheHits: Number(resp.readBigUInt64LE(17)),
+            cacheMisses: Number(resp.readBigUInt64LE(25))
+        };
+    }
+}
+async function cmd_get_uid(port)
+{
+    let cmd = Buffer.from([0xC7, 0xFA, 0xF0, 0x00]);
+
+    let resp = await serial_port_cmd(port, cmd);
+
+    let magic = resp.readUInt16LE(0);
+    let cmdID = resp.readUInt8(2);
+    let payloadLen = resp.readUInt8(3);
+
+    if(cmdID === 0xE0)
+        throw new Error("Error getting UID");
+
+    if(cmdID === 0xF0 && payloadLen === 8)
+    {
+        let str = "";
+
+        for(let i = 7; i >= 0; i--)
+            str += resp.readUInt8(i + 4).toString(16).padStart(2, "0").toUpperCase() + (i === 4 ? "-" : "");
+
+        return str;
+    }
+}
+
+async function connect(opts)
+{
+    if(!opts.port)
+    {
+        console.log("Invalid options provided");
+        console.log("Invalid serial port");
+
+        return process.exit(1);
+    }
+
+    let port_details
+
+    try
+    {
+        port_details = await validate_serial_port(opts.port);
+    }
+    catch(e)
+    {
+        console.log("Invalid options provided");
+        console.log("Serial port does not match criteria");
+        console.log(e);
+
+        return process.exit(1);
+    }
+
+    if(!port_details)
+    {
+        console.log("Invalid options provided");
+        console.log("Serial port does not exist");
+
+        return process.exit(1);
+    }
+
+    let port;
+
+    try
+    {
+        port = await open_serial_port(opts.port);
+    }
+    catch(e)
+    {
+        console.log("Error opening serial port");
+        console.log(e);
+
+        return process.exit(1);
+    }
+
+    return port;
+}
+async function update(image, cmdOpts)
+{
+    let opts = program.opts();
+    let data;
+
+    try
+    {
+        data = FileSystem.readFileSync(image);
+    }
+    catch(e)
+    {
+        console.log("Error reading image");
+        console.log(e);
+
+        return process.exit(1);
+    }
+
+    // The firmware programs whole words, pad with erased flash
+    if(data.length & 3)
+        data = Buffer.concat([data, Buffer.alloc(4 - (data.length & 3), 0xFF)]);
+
+    if(data.length < 8 || (data.readUInt32LE(0) & 0xFFF80000) !== 0x20000000)
+    {
+        console.log("Invalid options provided");
+        console.log("Image is not a raw application binary (initial stack pointer outside of RAM)");
+
+        return process.exit(1);
+    }
+
+    let port = await connect(opts);
+    let crc = calc_crc32(data);
+    let start = Date.now();
+
+    console.log("Sending " + data.length + " bytes...");
+
+    await cmd_update_begin(port, data.length, crc);
+
+    for(let offset = 0; offset < data.length; offset += 128)
+    {
+        let chunk = Buffer.alloc(128, 0xFF);
+
+        data.copy(chunk, 0, offset, Math.min(offset + 128, data.length));
+
+        await cmd_update_data(port, offset, chunk);
+
+        if(!(offset % 8192))
+            process.stdout.write("\rWriting... " + Math.floor(offset * 100 / data.length) + "%");
+    }
+
+    process.stdout.write("\rWriting... 100%\n");
+
+    let deviceCRC = await cmd_update_finish(port, cmdOpts.apply !== false);
+
+    console.log("Verified image CRC 0x" + deviceCRC.toString(16).toUpperCase().padStart(8, "0") + " in " + ((Date.now() - start) / 1000).toFixed(1) + " s");
+
+    if(cmdOpts.apply !== false)
+    {
+        // The boot stub starts the copy over if it is interrupted, it only takes longer
+        console.log("Controller is restarting and copying the image into place, this takes about " + Math.ceil(Math.ceil(data.length / 2048) * 0.04 + 0.5) + " s");
+    }
+
+    port.close();
+    return process.exit(0);
+}
+async function run()
+{
+    let opts = program.opts();
+    let port = await connect(opts);
+
+    if(opts.accounting)
+    {
+        let resistance = typeof opts.loadResistance === "number" ? opts.loadResistance : 0;
+
+        if(isNaN(resistance) || resistance < 0)
+        {
+            console.log("Invalid options provided");
+            console.log("Invalid load resistance (> 0 ohm)");
+
+            return process.exit(1);
+        }
+
+        for(let i = 0; i < 7; i++)
+        {
+            let acc = await cmd_get_accounting(port, i, opts.accounting === "reset");
+            let line = "Channel " + i + ": on " + (acc.onTime / 3600).toFixed(2) + " h, " + (acc.dutyTime / 3600).toFixed(2) + " h at full duty";
+
+            if(acc.onTime)
+                line += " (" + (acc.dutyTime / acc.onTime * 100).toFixed(1) + "% average)";
+
+            if(resistance)
+                line += ", " + (acc.energy / resistance / 3600).toFixed(3) + " Wh";
+            else
+                line += ", " + (acc.energy / 3600).toFixed(1) + " V^2 h";
+
+            console.log(line);
+        }
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(opts.history)
+    {
+        let lines = ["tier,time_s,duty0,duty1,duty2,duty3,duty4,duty5,duty6,vext_mv,5v0_mv,temp_adc,temp_ext0,temp_ext1,temp_ext2,temp_ext3,temp_ext4,temp_ext5,temp_ext6,temp_ext7"];
+
+        for(let tier = 0; tier < 2; tier++)
+        {
+            let samples = [];
+            let now = 0;
+
+            for(let block = 0, count = 1; block < count; block++)
+            {
+                let hist = await cmd_get_history(port, tier, block);
+
+                count = hist.blockCount;
+                now = hist.now;
+
+                // Blocks shift when the oldest one is dropped mid-read, skip what was already seen
+                for(let sample of hist.samples)
+                    if(!samples.length || sample.time > samples[samples.length - 1].time)
+                        samples.push(sample);
+            }
+
+            for(let sample of samples)
+            {
+                let f = sample.fields.map(v => v === -0x8000 ? "" : v);
+                let row = [tier, sample.time - now];
+
+                for(let i = 0; i < 7; i++)
+                    row.push((f[i] / 32767 * 100).toFixed(2));
+
+                row.push(f[7], f[8]);
+
+                for(let i = 9; i < 18; i++)
+                    row.push(f[i] === "" ? "" : (f[i] / 256).toFixed(2));
+
+                lines.push(row.join(","));
+            }
+        }
+
+        if(typeof opts.history === "string")
+            FileSystem.writeFileSync(opts.history, lines.join(OS.EOL) + OS.EOL);
+        else
+            console.log(lines.join(OS.EOL));
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(opts.perf)
+    {
+        let perf = await cmd_get_perf(port, opts.perf === "reset");
+        let fetches = perf.cacheHits + perf.cacheMisses;
+
+        console.log("Main loop: " + perf.loopAvg + " cycles average, " + perf.loopMax + " cycles max");
+        console.log("Command dispatch: " + perf.cmdMax + " cycles max");
+        console.log("Flash cache: " + perf.cacheHits + " hits, " + perf.cacheMisses + " misses" + (fetches ? " (" + (perf.cacheMisses / fetches * 100).toFixed(2) + "% miss rate)" : ""));
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(opts.selfTest)
+    {
+        let channels = await cmd_self_test(port, opts.selfTest === "run");
+
+        for(let i = 0; i < channels.length; i++)
+            console.log("Channel " + i + ": " + channels[i].state + (channels[i].state !== "untested" ? " (" + channels[i].droop + " mV droop)" : ""));
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(typeof opts.tach === "number")
+    {
+        if(isNaN(opts.tach) || opts.tach < 0 || opts.tach > 2)
+        {
+            console.log("Invalid options provided");
+            console.log("Invalid tach input (0 - PB11, 1 - PB13, 2 - PB14)");
+
+            return process.exit(1);
+        }
+
+        let tach = await cmd_get_tach(port, opts.tach, opts.clearFault);
+
+        if(typeof opts.tachChannel === "string")
+        {
+            let channel = opts.tachChannel === "none" ? 0xFF : parseInt(opts.tachChannel);
+            let pulsesPerRev = typeof opts.tachPulses === "number" ? opts.tachPulses : tach.pulsesPerRev;
+            let average = typeof opts.tachAverage === "number" ? opts.tachAverage : tach.average;
+            let stallTimeout = typeof opts.stallTimeout === "number" ? opts.stallTimeout : tach.stallTimeout;
+
+            if(channel !== 0xFF && (isNaN(channel) || channel < 0 || channel > 6))
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid tach channel (0 < chan < 6, none unassigns it)");
+
+                return process.exit(1);
+            }
+
+            if(isNaN(pulsesPerRev) || pulsesPerRev < 1 || pulsesPerRev > 255 || isNaN(average) || average < 1 || average > 16 || isNaN(stallTimeout) || stallTimeout < 1 || stallTimeout > 65535)
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid tach settings (0 < pulses < 256, 0 < average < 17, 0 < stall timeout < 65536 ms)");
+
+                return process.exit(1);
+            }
+
+            await cmd_set_tach_config(port, opts.tach, channel, pulsesPerRev, average, stallTimeout);
+
+            port.close();
+            return process.exit(0);
+        }
+
+        console.log("Channel: " + (tach.channel === 0xFF ? "none" : tach.channel) + ", " + tach.pulsesPerRev + " pulses per revolution, averaged over " + tach.average + ", stall after " + tach.stallTimeout + " ms");
+        console.log(tach.rpm + " RPM (" + tach.pulses + " pulses)");
+
+        if(tach.fault)
+            console.log("STALLED" + (tach.kicks ? " (" + tach.kicks + " kick(s))" : ""));
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(typeof opts.samplePeriod === "number")
+    {
+        if(isNaN(opts.samplePeriod) || opts.samplePeriod < 0 || opts.samplePeriod > 32768 || (opts.samplePeriod & (opts.samplePeriod - 1)))
+        {
+            console.log("Invalid options provided");
+            console.log("Invalid sample period (power of two up to 32768 ms, 0 - free running)");
+
+            return process.exit(1);
+        }
+
+        await cmd_set_sample_period(port, opts.samplePeriod);
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(typeof opts.input === "number")
+    {
+        if(opts.input < 0 || opts.input > 6)
+        {
+            console.log("Invalid options provided");
+            console.log("Invalid analog input (0 - AVDD, 1 - DVDD, 2 - IOVDD, 3 - Core, 4 - 5V0, 5 - VEXT, 6 - Temperature)");
+
+            return process.exit(1);
+        }
+
+        if(typeof opts.filter === "string")
+        {
+            let types = {off: 0, iir: 1, avg: 2};
+            let type = types[opts.filter.split(":")[0]];
+            let param = parseInt(opts.filter.split(":")[1] || "0");
+
+            if(type === undefined || isNaN(param) || (type === 1 && (param < 1 || param > 8)) || (type === 2 && (param < 2 || param > 16)))
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid filter (off, iir:<1 - 8>, avg:<2 - 16>)");
+
+                return process.exit(1);
+            }
+
+            await cmd_set_filter(port, opts.input, type, param);
+
+            port.close();
+            return process.exit(0);
+        }
+
+        if((typeof opts.alarm === "string" || opts.clearAlarm) && opts.input !== 4 && opts.input !== 5)
+        {
+            console.log("Invalid options provided");
+            console.log("Rail alarms are only available on 4 - 5V0 and 5 - VEXT");
+
+            return process.exit(1);
+        }
+
+        if(typeof opts.alarm === "string")
+        {
+            let limits = opts.alarm.split(":").map(x => parseFloat(x));
+            let enable = opts.alarm !== "off";
+
+            if(enable && (limits.length !== 2 || isNaN(limits[0]) || isNaN(limits[1]) || limits[0] < 0 || limits[1] <= limits[0]))
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid alarm window (<low mV>:<high mV> or off)");
+
+                return process.exit(1);
+            }
+
+            if(typeof opts.safeDuty === "number" && (opts.safeDuty < 0 || opts.safeDuty > 100))
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid safe duty cycle (0 < dc < 100)");
+
+                return process.exit(1);
+            }
+
+            await cmd_set_rail_alarm(port, opts.input, enable, enable ? limits[0] : 0, enable ? limits[1] : 0, typeof opts.safeDuty === "number", (opts.safeDuty || 0) / 100);
+
+            port.close();
+            return process.exit(0);
+        }
+
+        let stats = await cmd_get_stats(port, opts.input, (opts.resetStats ? 1 : 0) | (opts.resetPeak ? 2 : 0));
+        let unit = opts.input === 6 ? " C" : " mV";
+
+        console.log("Filter: " + ["off", "iir", "avg"][stats.filter] + (stats.filter ? ":" + stats.param : ""));
+        console.log("Min: " + stats.min.toFixed(2) + unit + ", Max: " + stats.max.toFixed(2) + unit + ", Mean: " + stats.mean.toFixed(2) + unit + " (" + stats.count + " samples)");
+        console.log("Peak: " + stats.peak.toFixed(2) + unit);
+
+        let sampling = await cmd_get_sample_period(port);
+
+        console.log("Sampling: " + (sampling.period ? "every " + sampling.period + " ms" : "free running") + " (" + sampling.sequences + " sequences)");
+
+        if(opts.input === 4 || opts.input === 5)
+        {
+            let alarm = await cmd_get_rail_alarm(port, opts.input, opts.clearAlarm);
+
+            if(alarm.enabled)
+                console.log("Alarm: " + alarm.low.toFixed(2) + " - " + alarm.high.toFixed(2) + unit + (alarm.force ? ", safe duty cycle " + (alarm.safeDuty * 100).toFixed(2) + "%" : "") + ((alarm.latched & (1 << opts.input)) ? ", TRIPPED" : (alarm.armed ? ", armed" : "")));
+            else
+                console.log("Alarm: off");
+        }
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(typeof opts.voltage === "number")
+    {
+        if(opts.voltage < 0 || opts.voltage > 5)
+        {
+            console.log("Invalid options provided");
+            console.log("Invalid voltage channel (0 < chan < 6)");
+
+            return process.exit(1);
+        }
+
+        console.log((await cmd_get_voltage(port, opts.voltage)) + " mV");
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(typeof opts.temp === "number")
+    {
+        if(opts.temp < 0 || opts.temp > 9)
+        {
+            console.log("Invalid options provided");
+            console.log("Invalid temperature channel (0 < chan < 10)");
+
+            return process.exit(1);
+        }
+
+        console.log((await cmd_get_temperature(port, opts.temp)) + " C");
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(typeof opts.freq === "number")
+    {
+        if(opts.freq < 0)
+        {
+            console.log("Invalid options provided");
+            console.log("Invalid frequency");
+
+            return process.exit(1);
+        }
+
+        let info = await cmd_set_freq(port, opts.freq);
+
+        console.log("Frequency: " + info.freq.toFixed(3) + " Hz (" + info.steps + " steps, prescaler " + info.prescaler + ")");
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(typeof opts.dutyCycleAll === "string")
+    {
+        let dcs = opts.dutyCycleAll.split(",").map(x => parseFloat(x));
+
+        if(dcs.length !== 7 || dcs.some(x => isNaN(x) || x < 0 || x > 100))
+        {
+            console.log("Invalid options provided");
+            console.log("Invalid duty cycles (7 comma separated values, 0 < dc < 100)");
+
+            return process.exit(1);
+        }
+
+        await cmd_set_dc_all(port, dcs.map(x => x / 100));
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(typeof opts.sensor === "number")
+    {
+        if(opts.sensor < 0 || opts.sensor > 7)
+        {
+            console.log("Invalid options provided");
+            console.log("Invalid sensor (0 < sensor < 8)");
+
+            return process.exit(1);
+        }
+
+        if(typeof opts.resolution === "number" || opts.overdrive)
+        {
+            let resolution = opts.resolution;
+
+            if(typeof resolution !== "number")
+                resolution = (await cmd_get_sensor_config(port, opts.sensor)).resolution;
+
+            if(isNaN(resolution) || resolution < 9 || resolution > 12)
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid resolution (9 < bits < 12)");
+
+                return process.exit(1);
+            }
+
+            await cmd_set_sensor_config(port, opts.sensor, resolution, !!opts.overdrive);
+
+            port.close();
+            return process.exit(0);
+        }
+
+        let config = await cmd_get_sensor_config(port, opts.sensor);
+
+        console.log(config.resolution + " bit" + (config.overdrive ? ", overdrive" : "") + (config.parasite ? ", parasite powered bus" : ""));
+
+        port.close();
+        return process.exit(0);
+    }
+
+    if(typeof opts.channel === "number")
+    {
+        if(opts.channel < 0 || opts.channel > 6)
+        {
+            console.log("Invalid options provided");
+            console.log("Invalid channel (0 < chan < 7)");
+
+            return process.exit(1);
+        }
+
+        if(typeof opts.dutyCycle === "number")
+        {
+            if(opts.dutyCycle < 0 || opts.dutyCycle > 100)
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid duty cycle (0 < dc < 100)");
+
+                return process.exit(1);
+            }
+
+            await cmd_set_dc(port, opts.channel, opts.dutyCycle / 100);
+
+            port.close();
+            return process.exit(0);
+        }
+
+        if(typeof opts.curve === "string")
+        {
+            let points = [];
+
+            if(opts.curve !== "off")
+                points = opts.curve.split(",").map(x => ({temp: parseFloat(x.split(":")[0]), dc: parseFloat(x.split(":")[1]) / 100}));
+
+            if(points.length > 8 || points.some(x => isNaN(x.temp) || isNaN(x.dc) || x.dc < 0 || x.dc > 1) || points.some((x, i) => i > 0 && x.temp <= points[i - 1].temp))
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid fan curve (up to 8 <temp>:<dc> points, sorted by temperature, or \"off\")");
+
+                return process.exit(1);
+            }
+
+            if(opts.curveSource < 0 || opts.curveSource > 9 || opts.curveMin < 0 || opts.curveMax > 100 || opts.curveMin > opts.curveMax || opts.curveHysteresis < 0)
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid fan curve settings");
+
+                return process.exit(1);
+            }
+
+            await cmd_set_fan_curve(port, opts.channel, opts.curveSource, points, opts.curveHysteresis, opts.curveMin / 100, opts.curveMax / 100);
+
+            port.close();
+            return process.exit(0);
+        }
+
+        if(typeof opts.pid === "string")
+        {
+            let pid = await cmd_get_pid(port, opts.channel);
+
+            if(opts.pid === "off")
+            {
+                await cmd_set_pid(port, opts.channel, false, pid.source, pid.setpoint, pid.kp, pid.ki, pid.kd, pid.filter, pid.min, pid.max, pid.period);
+
+                port.close();
+                return process.exit(0);
+            }
+
+            let setpoint = parseFloat(opts.pid);
+            let gains = opts.pidGains.split(",").map(x => parseFloat(x));
+
+            if(isNaN(setpoint) || setpoint < -128 || setpoint > 127 || gains.length !== 3 || gains.some(x => isNaN(x) || x < 0))
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid PID loop (-128 < setpoint < 127 C, 3 comma separated gains >= 0)");
+
+                return process.exit(1);
+            }
+
+            if(isNaN(opts.pidSource) || opts.pidSource < 0 || opts.pidSource > 9 || isNaN(opts.pidPeriod) || opts.pidPeriod < 8 || opts.pidPeriod > 60000 || isNaN(opts.pidFilter) || opts.pidFilter < 0 || opts.pidFilter > 15 || opts.pidMin < 0 || opts.pidMax > 100 || opts.pidMin > opts.pidMax)
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid PID loop settings");
+
+                return process.exit(1);
+            }
+
+            // The firmware gains are duty cycle per C and per sample, samples are whole 1/128 s ticks
+            let period = Math.round(opts.pidPeriod * 128 / 1000) / 128;
+            let kp = Math.round(gains[0] / 100 * 65536);
+            let ki = Math.round(gains[1] / 100 * period * 65536);
+            let kd = Math.round(gains[2] / 100 / period * 65536);
+
+            if([kp, ki, kd].some(x => x > 0x7FFFFFFF))
+            {
+                console.log("Invalid options provided");
+                console.log("PID gains too large");
+
+                return process.exit(1);
+            }
+
+            await cmd_set_pid(port, opts.channel, true, opts.pidSource, setpoint, kp, ki, kd, opts.pidFilter, opts.pidMin / 100, opts.pidMax / 100, opts.pidPeriod);
+
+            port.close();
+            return process.exit(0);
+        }
+
+        if(typeof opts.effVoltage === "number")
+        {
+            if(isNaN(opts.effVoltage) || opts.effVoltage < 0 || opts.effVoltage > 27500)
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid effective voltage (0 < mv < 27500, 0 returns to duty cycle mode)");
+
+                return process.exit(1);
+            }
+
+            await cmd_set_eff_voltage(port, opts.channel, opts.effVoltage);
+
+            port.close();
+            return process.exit(0);
+        }
+
+        if(typeof opts.burst === "string")
+        {
+            let pattern = opts.burst.split(",").map(x => parseInt(x));
+
+            if(pattern.length !== 2 || pattern.some(x => isNaN(x) || x < 0 || x > 64) || (pattern[1] > 0 && pattern[0] < 1))
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid burst pattern (<on>,<off> periods, 0 < on + off < 65, off = 0 disables)");
+
+                return process.exit(1);
+            }
+
+            await cmd_set_burst(port, opts.channel, pattern[0], pattern[1]);
+
+            port.close();
+            return process.exit(0);
+        }
+
+        if(typeof opts.rpmEstimate === "string")
+        {
+            let pulsesPerRev = opts.rpmEstimate === "off" ? 4 : parseInt(opts.rpmEstimate);
+
+            if(isNaN(pulsesPerRev) || pulsesPerRev < 1 || pulsesPerRev > 255)
+            {
+                console.log("Invalid options provided");
+                console.log("Invalid commutations per revolution (0 < n < 256, off disables)");
+
+                return process.exit(1);
+            }
+
+            await cmd_set_rpm_config(port, opts.channel, opts.rpmEstimate !== "off", pulsesPerRev);
+
+            port.close();
+            return process.exit(0);
+        }
+
+        console.log((await cmd_get_dc(port, opts.channel)) * 100 + " %");
+
+        let pid = await cmd_get_pid(port, opts.channel);
+
+        if(pid.enabled)
+        {
+            let period = pid.period / 1000;
+
+            console.log("PID: " + pid.setpoint.toFixed(2) + " C setpoint on temperature channel " + pid.source + ", measured " + pid.temperature.toFixed(2) + " C, output " + (pid.dc * 100).toFixed(2) + "%");
+            console.log("PID gains: Kp " + (pid.kp / 65536 * 100).toFixed(3) + " %/C, Ki " + (pid.ki / 65536 * 100 / period).toFixed(3) + " %/(C s), Kd " + (pid.kd / 65536 * 100 * period).toFixed(3) + " % s/C, every " + pid.period + " ms, limits " + (pid.min * 100).toFixed(1) + " - " + (pid.max * 100).toFixed(1) + "%");
+        }
+
+        let rpm = await cmd_get_rpm(port, opts.channel);
+
+        if(rpm.enabled)
+            console.log((rpm.rpm ? rpm.rpm : "--") + " RPM (estimated)");
+
+        port.close();
+        return process.exit(0);
+    }
+
+    console.log("USB Serial number: " + port_details.serialNumber.toUpperCase());
+    console.log("Unique ID: " + await cmd_get_uid(port));
+
+    let info = await cmd_get_pwm_info(port);
+
+    console.log("Frequency: " + info.freq.toFixed(3) + " Hz (" + info.steps + " steps, prescaler " + info.prescaler + ")");
+
+    let str;
+
+    str = "Duty cycle: ";
+
+    for(let i = 0; i < 7; i++)
+        str += ((await cmd_get_dc(port, i)) * 100).toFixed(2) + "%" + (i === 6 ? "" : ", ");
+
+    console.log(str);
+
+    str = "Burst (on/off): ";
+
+    for(let i = 0; i < 7; i++)
+    {
+        let burst = await cmd_get_burst(port, i);
+
+        str += (burst.off ? burst.on + "/" + burst.off : "off") + (i === 6 ? "" : ", ");
+    }
+
+    console.log(str);
+
+    str = "Effective voltage: ";
+
+    for(let i = 0; i < 7; i++)
+    {
+        let eff = await cmd_get_eff_voltage(port, i);
+
+        str += (eff.voltage ? eff.voltage + " mV" : "off") + (i === 6 ? "" : ", ");
+    }
+
+    console.log(str);
+
+    str = "Voltage: ";
+
+    for(let i = 0; i < 6; i++)
+        str += (await cmd_get_voltage(port, i)).toFixed(2) + " mV" + (i === 5 ? "" : ", ");
+
+    console.log(str);
+
+    let sensors = await cmd_get_sensors(port);
+
+    str = "Temperature: ";
+
+    for(let i = 0; i < 2 + sensors.length; i++)
+    {
+        let temp;
+
+        try
+        {
+            temp = (await cmd_get_temperature(port, i)).toFixed(2) + " C";
+        }
+        catch(e)
+        {
+            temp = "N/A";
+        }
+
+        if(i >= 2)
+            temp += " (" + sensors[i - 2] + ", " + (await cmd_get_sensor_config(port, i - 2)).resolution + " bit)";
+
+        str += temp + (i === 1 + sensors.length ? "" : ", ");
+    }
+
+    console.log(str);
+
+    port.close();
+    process.exit(0);
+}
+
+async function main()
+{
+    let defaultPort;
+
+    if(OS.platform() === "win32")
+        defaultPort = "COM1";
+    else if(OS.platform() === "linux")
+        defaultPort = "/dev/ttyUSB0";
+
+    program
+        .option("-p, --port <port>", "Serial port to use", defaultPort)
+        .option("-d, --duty-cycle <dc>", "Set the duty cycle, requires -c", parseFloat)
+        .option("-a, --duty-cycle-all <dc,...>", "Set the duty cycle of all channels, fans are spun up one after the other")
+        .option("-c, --channel <chan>", "Set the channel, if -d is not set, reads back the current value", parseInt)
+        .option("-b, --burst <on,off>", "Set the burst pattern in PWM periods, requires -c")
+        .option("-e, --eff-voltage <mv>", "Hold the average fan voltage constant against VEXT changes, requires -c", parseInt)
+        .option("--rpm-estimate <n>", "Estimate the speed of a 2-pin fan from its commutation ripple, <n> commutations per revolution, \"off\" disables it, requires -c (ripple below about 36 Hz, 540 RPM at 4 commutations, may read as --)")
+        .option("--curve <temp:dc,...>", "Set a temperature to duty cycle curve, \"off\" disables it, requires -c")
+        .option("--curve-source <chan>", "Temperature channel used by the curve (0 - EMU, 1 - ADC, 2+ - 1-Wire sensors)", parseInt, 0)
+        .option("--curve-hysteresis <temp>", "Temperature drop needed before the curve lowers the duty cycle", parseFloat, 2)
+        .option("--curve-min <dc>", "Minimum duty cycle of the curve", parseFloat, 0)
+        .option("--curve-max <dc>", "Maximum duty cycle of the curve", parseFloat, 100)
+        .option("--pid <temp>", "Regulate a temperature to this setpoint in C with a PID loop, \"off\" disables it, requires -c")
+        .option("--pid-source <chan>", "Temperature channel used by the PID loop (0 - EMU, 1 - ADC, 2+ - 1-Wire sensors)", parseInt, 0)
+        .option("--pid-gains <kp,ki,kd>", "PID gains in % duty cycle per C, per C and second, and per C/s", "5,0.5,0")
+        .option("--pid-period <ms>", "PID loop sample period", parseInt, 1000)
+        .option("--pid-filter <n>", "Derivative low pass filter, alpha = 2^-n (0 - 15)", parseInt, 2)
+        .option("--pid-min <dc>", "Minimum duty cycle of the PID loop", parseFloat, 0)
+        .option("--pid-max <dc>", "Maximum duty cycle of the PID loop", parseFloat, 100)
+        .option("-s, --sensor <n>", "Select a 1-Wire sensor, reads back its configuration unless --resolution or --overdrive is set", parseInt)
+        .option("--resolution <bits>", "Set the sensor resolution (9 - 94 ms to 12 - 750 ms per conversion), stored in its EEPROM, requires -s", parseInt)
+        .option("--overdrive", "Address the sensor at 1-Wire overdrive speed, only for devices that support it, requires -s")
+        .option("-i, --input <n>", "Select an analog input and print its statistics (0 - AVDD, 1 - DVDD, 2 - IOVDD, 3 - Core, 4 - 5V0, 5 - VEXT, 6 - Temperature)", parseInt)
+        .option("--filter <type[:param]>", "Set the input filter (off, iir:<shift>, avg:<window>), requires -i")
+        .option("--reset-stats", "Start a new statistics window after reading, requires -i")
+        .option("--reset-peak", "Clear the peak hold after reading, requires -i")
+        .option("--alarm <low:high>", "Set the rail alarm window in mV, \"off\" disables it, requires -i 4 or 5")
+        .option("--safe-duty <dc>", "Force all channels to this duty cycle when the rail alarm trips, requires --alarm", parseFloat)
+        .option("--clear-alarm", "Clear a tripped rail alarm after reading and re-arm it, requires -i 4 or 5")
+        .option("-T, --tach <n>", "Select a tach input and print its speed and stall state (0 - PB11, 1 - PB13, 2 - PB14)", parseInt)
+        .option("--tach-channel <chan>", "Assign the PWM channel driving the fan on this tach input, \"none\" disables stall handling, requires -T")
+        .option("--tach-pulses <n>", "Tach pulses per revolution, requires --tach-channel", parseInt)
+        .option("--tach-average <n>", "Pulses the speed is averaged over (1 - 16), requires --tach-channel", parseInt)
+        .option("--stall-timeout <ms>", "Time without pulses before a driven fan counts as stalled and is kicked, requires --tach-channel", parseInt)
+        .option("--clear-fault", "Clear the stall flag after reading, requires -T")
+        .option("--accounting [reset]", "Print the on-time, duty-time and energy counters of all channels, \"reset\" clears them after reading")
+        .option("--load-resistance <ohm>", "Fan resistance the energy is estimated with (duty * VEXT^2 / R), requires --accounting", parseFloat)
+        .option("--self-test [run]", "Print the channel load self-test result from boot, \"run\" pulses the idle channels again first")
+        .option("--history [file]", "Dump the on-device history as CSV (tier 0 every second, tier 1 every minute, times relative to now), to <file> if given")
+        .option("--perf [reset]", "Print the main loop and command dispatch cycle counts and the flash cache counters, \"reset\" restarts them after reading")
+        .option("--sample-period <ms>", "Convert the analog inputs every <ms> milliseconds (power of two), 0 converts them back to back", parseInt)
         .option("-m, --voltage <chan>", "Read this voltage channel", parseInt)
         .option("-t, --temp <chan>", "Read this temperature channel", parseInt)
         .option("-f, --freq <freq>", "Set the PWM frequency", parseFloat)
         .option("-V, --verbose", "Print debugging information")
         .action(run);
 
+    program
+        .command("update <image>")
+        .description("Stream a raw firmware binary to the controller, verify it and restart into it. Applying restarts into the boot stub, which copies the image over the firmware (about 40 ms per 2 KiB of image) and starts over after a power loss")
+        .option("--no-apply", "Only stage and verify the image, keep running the current firmware")
+        .action(update);
+
     await program.parseAsync();
 }
 
@@ -1,5 +1,331 @@
 #include "adc.h"
 
+// Register image of each input, written by the LDMA right before its conversion
+typedef struct
+{
+    uint32_t ulSingleCtrl;
+    uint32_t ulSingleCtrlX;
+    uint32_t ulCmpThr; // CMPTHR, BIASPROG and CAL are consecutive registers
+    uint32_t ulBiasProg;
+    uint32_t ulCal;
+} adc_input_config_t;
+
+static adc_input_config_t pxADCInputConfig[ADC_INPUT_COUNT];
+static uint32_t ulADCStartCmd = ADC_CMD_SINGLESTART;
+static volatile uint32_t pulADCSample[ADC_INPUT_COUNT]; // Latest raw result of each input, word writes from the LDMA are never torn
+static volatile uint32_t pulADCSequence[ADC_SEQUENCE_BUFFER][ADC_INPUT_COUNT]; // Copies of pulADCSample at the end of each sequence, for adc_task()
+static volatile uint32_t pulADCSequenceFull[ADC_SEQUENCE_BUFFER]; // Set by the LDMA after the copy, cleared by adc_task()
+static uint32_t pulADCSequenceLink[ADC_SEQUENCE_BUFFER]; // Points the end of the sequence at the copy into each slot
+static uint32_t ulADCSequenceMark = 1;
+static uint8_t ubADCSequenceTail = 0; // Next slot adc_task() reads
+static volatile uint32_t pulADCValue[ADC_INPUT_COUNT]; // Filtered result of each input, what the readers get
+static filter_t pxADCFilter[ADC_INPUT_COUNT];
+static filter_stats_t pxADCStats[ADC_INPUT_COUNT];
+static volatile uint32_t ulADCSequenceCount = 0;
+static adc_sequence_callback_t pfSequenceCallback = NULL;
+static adc_window_isr_t pfWindowISR = NULL;
+static volatile uint8_t ubADCWindowArmed = 0x00; // Bitmap of the inputs with the window comparator enabled
+static uint32_t ulADCTrigger = 0; // PRS source gating the sequence, 0 when free running
+static ldma_descriptor_t __attribute__ ((aligned (4))) pADCDMADescriptor[1 + ADC_INPUT_COUNT * 4]; // Sequence gate followed by 4 descriptors per input
+static ldma_descriptor_t __attribute__ ((aligned (4))) pADCSequenceDescriptor[ADC_SEQUENCE_BUFFER * 3]; // Copy, relink and mark of each slot
+static volatile uint8_t ubADCCaptureState = ADC_CAPTURE_STATE_IDLE;
+static uint8_t ubADCCaptureInput;
+static uint32_t ulADCCapturePRSSource;
+static uint32_t ulADCCapturePRSEdge;
+static uint8_t ubADCCaptureDecimation;
+static uint8_t ubADCCaptureBlock;
+static uint16_t *pusADCCaptureBuffer;
+static uint16_t usADCCaptureCount;
+static volatile uint16_t usADCCaptureIndex;
+static uint32_t ulADCCaptureSum; // Of the stored samples, fed to the input filter as one sample when the capture ends
+static uint32_t ulADCCaptureCtrl; // ADC0->CTRL of the sequence, restored after the capture
+static volatile uint16_t pusADCCaptureBlock[2][ADC_CAPTURE_MAX_DECIMATION];
+static ldma_descriptor_t __attribute__ ((aligned (4))) pADCCaptureDescriptor[2];
+
+static uint8_t adc_window_outside(uint8_t ubInput, uint32_t ulSample)
+{
+    uint16_t usLow = (pxADCInputConfig[ubInput].ulCmpThr & _ADC_CMPTHR_ADLT_MASK) >> _ADC_CMPTHR_ADLT_SHIFT;
+    uint16_t usHigh = (pxADCInputConfig[ubInput].ulCmpThr & _ADC_CMPTHR_ADGT_MASK) >> _ADC_CMPTHR_ADGT_SHIFT;
+
+    return ulSample < usLow || ulSample > usHigh;
+}
+static uint8_t adc_window_check(volatile uint32_t *pulSample)
+{
+    uint8_t ubTripped = 0x00;
+
+    for(uint8_t i = 0; i < ADC_INPUT_COUNT; i++)
+        if((ubADCWindowArmed & BIT(i)) && adc_window_outside(i, pulSample[i]))
+            ubTripped |= BIT(i);
+
+    return ubTripped;
+}
+static void adc_window_trip(uint8_t ubTripped)
+{
+    if(!ubTripped)
+        return;
+
+    // Alarms are latched, the window stays disarmed until it is set again
+    for(uint8_t i = 0; i < ADC_INPUT_COUNT; i++)
+        if(ubTripped & BIT(i))
+            pxADCInputConfig[i].ulSingleCtrl &= ~ADC_SINGLECTRL_CMPEN;
+
+    ubADCWindowArmed &= ~ubTripped;
+
+    if(pfWindowISR)
+        pfWindowISR(ubTripped);
+}
+
+void _adc0_isr()
+{
+    uint32_t ulFlags = ADC0->IFC;
+
+    if(!(ulFlags & ADC_IFC_SINGLECMP))
+        return;
+
+    if(ubADCCaptureState == ADC_CAPTURE_STATE_RUNNING)
+    {
+        // Only the captured input is being converted, stop comparing until the window is set again
+        ADC0->SINGLECTRL &= ~ADC_SINGLECTRL_CMPEN;
+
+        adc_window_trip(ubADCWindowArmed & BIT(ubADCCaptureInput));
+
+        return;
+    }
+
+    // The flag does not tell which input tripped, the selected input does
+    // The LDMA only loads the next input after popping the result, a result still in the FIFO after reading both belongs to this input
+    uint32_t ulPosSel = ADC0->SINGLECTRL & _ADC_SINGLECTRL_POSSEL_MASK;
+    uint32_t ulSample = ADC0->SINGLEDATAP;
+
+    if(!(ADC0->SINGLEFIFOCOUNT & _ADC_SINGLEFIFOCOUNT_SINGLEDC_MASK))
+    {
+        adc_window_trip(adc_window_check(pulADCSample)); // Already stored by the LDMA
+
+        return;
+    }
+
+    for(uint8_t i = 0; i < ADC_INPUT_COUNT; i++)
+    {
+        if(!(ubADCWindowArmed & BIT(i)) || (pxADCInputConfig[i].ulSingleCtrl & _ADC_SINGLECTRL_POSSEL_MASK) != ulPosSel)
+            continue;
+
+        if(adc_window_outside(i, ulSample))
+            adc_window_trip(BIT(i));
+
+        return;
+    }
+}
+
+static void adc_sequence_wake(uint8_t ubEnable)
+{
+    // The end of each pass only raises the interrupt while a capture waits for it, the main loop may be asleep
+    for(uint8_t i = 0; i < ADC_SEQUENCE_BUFFER; i++)
+    {
+        if(ubEnable)
+            pADCSequenceDescriptor[i * 3 + 2].CTRL |= LDMA_CH_CTRL_DONEIFSEN;
+        else
+            pADCSequenceDescriptor[i * 3 + 2].CTRL &= ~LDMA_CH_CTRL_DONEIFSEN;
+    }
+}
+static void adc_capture_arm()
+{
+    adc_input_config_t *pConfig = &pxADCInputConfig[ubADCCaptureInput];
+
+    adc_sequence_wake(0);
+
+    ldma_ch_disable(ADC0_DMA_CHANNEL);
+    ldma_ch_req_clear(ADC0_DMA_CHANNEL);
+
+    ADC0->CMD = ADC_CMD_SINGLESTOP;
+    ADC0->SINGLEFIFOCLEAR = ADC_SINGLEFIFOCLEAR_SINGLEFIFOCLEAR;
+
+    // An armed window stays armed on the captured input, with the 16 bit thresholds scaled down to the 12 bit results
+    uint32_t ulLow = ((pConfig->ulCmpThr & _ADC_CMPTHR_ADLT_MASK) >> _ADC_CMPTHR_ADLT_SHIFT) >> 4;
+    uint32_t ulHigh = ((pConfig->ulCmpThr & _ADC_CMPTHR_ADGT_MASK) >> _ADC_CMPTHR_ADGT_SHIFT) >> 4;
+
+    ADC0->CMPTHR = ((ulHigh << _ADC_CMPTHR_ADGT_SHIFT) & _ADC_CMPTHR_ADGT_MASK) | ((ulLow << _ADC_CMPTHR_ADLT_SHIFT) & _ADC_CMPTHR_ADLT_MASK);
+
+    // 12 bit without oversampling at a 1 MHz SAR clock, each trigger edge starts one conversion
+    ulADCCaptureCtrl = ADC0->CTRL;
+    ADC0->CTRL = (ulADCCaptureCtrl & ~_ADC_CTRL_PRESC_MASK) | (7 << _ADC_CTRL_PRESC_SHIFT);
+    ADC0->SINGLECTRL = (pConfig->ulSingleCtrl & ~(_ADC_SINGLECTRL_AT_MASK | _ADC_SINGLECTRL_RES_MASK | _ADC_SINGLECTRL_PRSSEL_MASK)) | ADC_SINGLECTRL_AT_4CYCLES | ADC_SINGLECTRL_RES_12BIT | ((ADC0_CAPTURE_PRS_CHANNEL << _ADC_SINGLECTRL_PRSSEL_SHIFT) & _ADC_SINGLECTRL_PRSSEL_MASK) | ADC_SINGLECTRL_PRSEN;
+    ADC0->SINGLECTRLX = pConfig->ulSingleCtrlX;
+    ADC0->BIASPROG = pConfig->ulBiasProg;
+    ADC0->CAL = pConfig->ulCal;
+
+    // Two blocks of one decimation window each, the ISR reduces one while the LDMA fills the other
+    for(uint8_t i = 0; i < 2; i++)
+    {
+        pADCCaptureDescriptor[i].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_DSTINC_ONE | LDMA_CH_CTRL_SIZE_HALFWORD | LDMA_CH_CTRL_SRCINC_NONE | LDMA_CH_CTRL_REQMODE_BLOCK | LDMA_CH_CTRL_BLOCKSIZE_UNIT1 | ((((uint32_t)ubADCCaptureDecimation - 1) << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_DONEIFSEN | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+        pADCCaptureDescriptor[i].SRC = &ADC0->SINGLEDATA;
+        pADCCaptureDescriptor[i].DST = pusADCCaptureBlock[i];
+        pADCCaptureDescriptor[i].LINK = (uint32_t)&pADCCaptureDescriptor[i ^ 1] | LDMA_CH_LINK_LINK;
+    }
+
+    ubADCCaptureBlock = 0;
+    usADCCaptureIndex = 0;
+    ulADCCaptureSum = 0;
+    ubADCCaptureState = ADC_CAPTURE_STATE_RUNNING;
+
+    ldma_ch_load(ADC0_DMA_CHANNEL, pADCCaptureDescriptor);
+    ldma_ch_enable(ADC0_DMA_CHANNEL);
+
+    prs_ch_config(ADC0_CAPTURE_PRS_CHANNEL, ulADCCapturePRSSource, ulADCCapturePRSEdge, 0);
+}
+static void adc_capture_stop()
+{
+    prs_ch_disable(ADC0_CAPTURE_PRS_CHANNEL);
+
+    ldma_ch_disable(ADC0_DMA_CHANNEL);
+    ldma_ch_req_clear(ADC0_DMA_CHANNEL);
+
+    ADC0->CMD = ADC_CMD_SINGLESTOP;
+    ADC0->SINGLEFIFOCLEAR = ADC_SINGLEFIFOCLEAR_SINGLEFIFOCLEAR;
+    ADC0->CTRL = ulADCCaptureCtrl;
+
+    // The captured input counts as converted once, its readers and statistics see the capture average instead of going stale
+    if(usADCCaptureIndex)
+    {
+        uint16_t usValue = filter_update(&pxADCFilter[ubADCCaptureInput], ulADCCaptureSum / usADCCaptureIndex);
+
+        pulADCValue[ubADCCaptureInput] = usValue;
+
+        filter_stats_update(&pxADCStats[ubADCCaptureInput], usValue);
+    }
+
+    // Back to the sequence, the gate is reopened with whatever trigger was set before
+    adc_set_trigger(ulADCTrigger);
+
+    ubADCCaptureState = ADC_CAPTURE_STATE_IDLE;
+
+    ldma_ch_load(ADC0_DMA_CHANNEL, pADCDMADescriptor);
+    ldma_ch_enable(ADC0_DMA_CHANNEL);
+}
+static void adc_capture_isr(uint8_t ubError)
+{
+    if(ubError)
+    {
+        usADCCaptureCount = 0; // Nothing valid was captured
+
+        adc_capture_stop();
+
+        return;
+    }
+
+    volatile uint16_t *pusBlock = pusADCCaptureBlock[ubADCCaptureBlock];
+    uint32_t ulSum = 0;
+
+    ubADCCaptureBlock ^= 1;
+
+    for(uint8_t i = 0; i < ubADCCaptureDecimation; i++)
+        ulSum += pusBlock[i];
+
+    uint16_t usSample = (ulSum << 4) / ubADCCaptureDecimation; // 12 bit codes scaled to 16 bits
+
+    pusADCCaptureBuffer[usADCCaptureIndex++] = usSample;
+    pulADCSample[ubADCCaptureInput] = usSample; // Raw readers stay current
+    ulADCCaptureSum += usSample;
+
+    if(usADCCaptureIndex >= usADCCaptureCount)
+        adc_capture_stop();
+}
+static void adc_dma_isr(uint8_t ubError)
+{
+    // The sequence runs without the CPU, it only interrupts to hand the ADC to a pending capture
+    if(ubADCCaptureState == ADC_CAPTURE_STATE_RUNNING)
+        adc_capture_isr(ubError);
+    else if(ubADCCaptureState == ADC_CAPTURE_STATE_PENDING)
+        adc_capture_arm(); // The sequence is parked at its gate by now
+}
+static float adc_get_scale(uint8_t ubInput) // mV per code of the linear inputs
+{
+    switch(ubInput)
+    {
+        case ADC_INPUT_AVDD:
+        case ADC_INPUT_DVDD:
+        case ADC_INPUT_IOVDD:
+            return 5000.f / 65535.f;
+        case ADC_INPUT_DECOUPLE:
+            return 2500.f / 65535.f;
+        case ADC_INPUT_5V0:
+            return 2500.f / 65535.f * ADC_5V0_DIV;
+        case ADC_INPUT_VEXT:
+            return 2500.f / 65535.f * ADC_VEXT_DIV;
+        default:
+            return 0.f;
+    }
+}
+static float adc_convert(uint8_t ubInput, float fCode)
+{
+    if(ubInput == ADC_INPUT_TEMP)
+    {
+        float fCalibrationTemp = (DEVINFO->CAL & _DEVINFO_CAL_TEMP_MASK) >> _DEVINFO_CAL_TEMP_SHIFT;
+        float fADCCalibrationTemp = (DEVINFO->ADC0CAL3 & _DEVINFO_ADC0CAL3_TEMPREAD1V25_MASK) >> _DEVINFO_ADC0CAL3_TEMPREAD1V25_SHIFT;
+
+        return fCalibrationTemp - (fADCCalibrationTemp - fCode) * 1250.f / (4096.f * -1.84f);
+    }
+
+    return fCode * adc_get_scale(ubInput);
+}
+static void adc_config_input(uint8_t ubInput, uint32_t ulSingleCtrl, uint32_t ulCal, uint32_t ulBias)
+{
+    adc_input_config_t *pConfig = &pxADCInputConfig[ubInput];
+
+    pConfig->ulSingleCtrl = ulSingleCtrl;
+    pConfig->ulSingleCtrlX = ADC_SINGLECTRLX_FIFOOFACT_OVERWRITE | (0 << _ADC_SINGLECTRLX_DVL_SHIFT);
+    pConfig->ulCmpThr = 0;
+    pConfig->ulBiasProg = (ADC0->BIASPROG & ~_ADC_BIASPROG_ADCBIASPROG_MASK) | ulBias;
+    pConfig->ulCal = (ADC0->CAL & ~(_ADC_CAL_SINGLEGAIN_MASK | _ADC_CAL_SINGLEOFFSET_MASK | _ADC_CAL_SINGLEOFFSETINV_MASK)) | ulCal;
+
+    ldma_descriptor_t *pDescriptor = &pADCDMADescriptor[1 + ubInput * 4];
+
+    // SINGLECTRL and SINGLECTRLX
+    pDescriptor[0].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_DSTINC_ONE | LDMA_CH_CTRL_SIZE_WORD | LDMA_CH_CTRL_SRCINC_ONE | LDMA_CH_CTRL_REQMODE_ALL | LDMA_CH_CTRL_BLOCKSIZE_UNIT2 | (((2 - 1) << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_STRUCTREQ | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+    pDescriptor[0].SRC = &pConfig->ulSingleCtrl;
+    pDescriptor[0].DST = &ADC0->SINGLECTRL;
+    pDescriptor[0].LINK = (uint32_t)&pDescriptor[1] | LDMA_CH_LINK_LINK;
+
+    // CMPTHR, BIASPROG and CAL
+    pDescriptor[1].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_DSTINC_ONE | LDMA_CH_CTRL_SIZE_WORD | LDMA_CH_CTRL_SRCINC_ONE | LDMA_CH_CTRL_REQMODE_ALL | LDMA_CH_CTRL_BLOCKSIZE_UNIT3 | (((3 - 1) << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_STRUCTREQ | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+    pDescriptor[1].SRC = &pConfig->ulCmpThr;
+    pDescriptor[1].DST = &ADC0->CMPTHR;
+    pDescriptor[1].LINK = (uint32_t)&pDescriptor[2] | LDMA_CH_LINK_LINK;
+
+    // Start the conversion
+    pDescriptor[2].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_DSTINC_NONE | LDMA_CH_CTRL_SIZE_WORD | LDMA_CH_CTRL_SRCINC_NONE | LDMA_CH_CTRL_REQMODE_BLOCK | LDMA_CH_CTRL_BLOCKSIZE_UNIT1 | ((0 << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_STRUCTREQ | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+    pDescriptor[2].SRC = &ulADCStartCmd;
+    pDescriptor[2].DST = &ADC0->CMD;
+    pDescriptor[2].LINK = (uint32_t)&pDescriptor[3] | LDMA_CH_LINK_LINK;
+
+    // Wait for the SINGLE request and store the result, the last input goes on to the copy into the next free slot
+    pDescriptor[3].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_DSTINC_NONE | LDMA_CH_CTRL_SIZE_WORD | LDMA_CH_CTRL_SRCINC_NONE | LDMA_CH_CTRL_REQMODE_BLOCK | LDMA_CH_CTRL_BLOCKSIZE_UNIT1 | ((0 << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+    pDescriptor[3].SRC = &ADC0->SINGLEDATA;
+    pDescriptor[3].DST = &pulADCSample[ubInput];
+    pDescriptor[3].LINK = ubInput == ADC_INPUT_COUNT - 1 ? pulADCSequenceLink[0] : (uint32_t)&pADCDMADescriptor[1 + (ubInput + 1) * 4] | LDMA_CH_LINK_LINK;
+}
+static void adc_config_sequence_slot(uint8_t ubSlot)
+{
+    ldma_descriptor_t *pDescriptor = &pADCSequenceDescriptor[ubSlot * 3];
+
+    // Copy every sample of the sequence into the slot
+    pDescriptor[0].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_DSTINC_ONE | LDMA_CH_CTRL_SIZE_WORD | LDMA_CH_CTRL_SRCINC_ONE | LDMA_CH_CTRL_REQMODE_ALL | LDMA_CH_CTRL_BLOCKSIZE_ALL | (((ADC_INPUT_COUNT - 1) << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_STRUCTREQ | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+    pDescriptor[0].SRC = pulADCSample;
+    pDescriptor[0].DST = pulADCSequence[ubSlot];
+    pDescriptor[0].LINK = (uint32_t)&pDescriptor[1] | LDMA_CH_LINK_LINK;
+
+    // Point the last input at the next slot, the LDMA only reads that descriptor again on the next pass
+    pDescriptor[1].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_DSTINC_NONE | LDMA_CH_CTRL_SIZE_WORD | LDMA_CH_CTRL_SRCINC_NONE | LDMA_CH_CTRL_REQMODE_BLOCK | LDMA_CH_CTRL_BLOCKSIZE_UNIT1 | ((0 << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_STRUCTREQ | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+    pDescriptor[1].SRC = &pulADCSequenceLink[(ubSlot + 1) % ADC_SEQUENCE_BUFFER];
+    pDescriptor[1].DST = &pADCDMADescriptor[ADC_INPUT_COUNT * 4].LINK;
+    pDescriptor[1].LINK = (uint32_t)&pDescriptor[2] | LDMA_CH_LINK_LINK;
+
+    // Mark the slot full last, adc_task() never sees a partial copy
+    pDescriptor[2].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_DSTINC_NONE | LDMA_CH_CTRL_SIZE_WORD | LDMA_CH_CTRL_SRCINC_NONE | LDMA_CH_CTRL_REQMODE_BLOCK | LDMA_CH_CTRL_BLOCKSIZE_UNIT1 | ((0 << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_STRUCTREQ | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+    pDescriptor[2].SRC = &ulADCSequenceMark;
+    pDescriptor[2].DST = &pulADCSequenceFull[ubSlot];
+    pDescriptor[2].LINK = (uint32_t)&pADCDMADescriptor[0] | LDMA_CH_LINK_LINK;
+}
+
 void adc_init()
 {
     cmu_hfper0_clock_gate(CMU_HFPERCLKEN0_ADC0, 1);
@@ -12,135 +338,390 @@ void adc_init()
     // adc_sar_clk is 100 kHz (ADC_CLK / (PRESC + 1)) PRESC = 79
     // TIMEBASE period is 1 us (1 MHz) (ADC_CLK / (TIMEBASE + 1)) TIMEBASE = 7
     ADC0->CTRL = ADC_CTRL_CHCONMODE_MAXSETTLE | ADC_CTRL_OVSRSEL_X16 | (7 << _ADC_CTRL_TIMEBASE_SHIFT) | (79 << _ADC_CTRL_PRESC_SHIFT) | ADC_CTRL_ASYNCCLKEN_ALWAYSON | ADC_CTRL_ADCCLKMODE_ASYNC | ADC_CTRL_WARMUPMODE_NORMAL;
-}
 
-float adc_get_avdd()
+    for(uint8_t i = 0; i < ADC_SEQUENCE_BUFFER; i++)
+    {
+        pulADCSequenceLink[i] = (uint32_t)&pADCSequenceDescriptor[i * 3] | LDMA_CH_LINK_LINK;
+        pulADCSequenceFull[i] = 0;
+
+        adc_config_sequence_slot(i);
+    }
+
+    adc_config_input(ADC_INPUT_AVDD, ADC_SINGLECTRL_AT_64CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_POSSEL_AVDD | ADC_SINGLECTRL_REF_5V | ADC_SINGLECTRL_RES_OVS, (DEVINFO->ADC0CAL1 & 0x7FFF0000) >> 16, ADC_BIASPROG_GPBIASACC_HIGHACC); // Calibration for 5V reference
+    adc_config_input(ADC_INPUT_DVDD, ADC_SINGLECTRL_AT_64CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_POSSEL_DVDD | ADC_SINGLECTRL_REF_5V | ADC_SINGLECTRL_RES_OVS, (DEVINFO->ADC0CAL1 & 0x7FFF0000) >> 16, ADC_BIASPROG_GPBIASACC_HIGHACC); // Calibration for 5V reference
+    adc_config_input(ADC_INPUT_IOVDD, ADC_SINGLECTRL_AT_64CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_POSSEL_IOVDD | ADC_SINGLECTRL_REF_5V | ADC_SINGLECTRL_RES_OVS, (DEVINFO->ADC0CAL1 & 0x7FFF0000) >> 16, ADC_BIASPROG_GPBIASACC_HIGHACC); // Calibration for 5V reference
+    adc_config_input(ADC_INPUT_DECOUPLE, ADC_SINGLECTRL_AT_64CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_POSSEL_DECOUPLE | ADC_SINGLECTRL_REF_2V5 | ADC_SINGLECTRL_RES_OVS, (DEVINFO->ADC0CAL0 & 0x7FFF0000) >> 16, ADC_BIASPROG_GPBIASACC_HIGHACC); // Calibration for 2V5 reference
+    adc_config_input(ADC_INPUT_5V0, ADC_SINGLECTRL_AT_256CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_5V0_CHAN | ADC_SINGLECTRL_REF_2V5 | ADC_SINGLECTRL_RES_OVS, (DEVINFO->ADC0CAL0 & 0x7FFF0000) >> 16, ADC_BIASPROG_GPBIASACC_HIGHACC); // Calibration for 2V5 reference
+    adc_config_input(ADC_INPUT_VEXT, ADC_SINGLECTRL_AT_256CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_VEXT_CHAN | ADC_SINGLECTRL_REF_2V5 | ADC_SINGLECTRL_RES_OVS, (DEVINFO->ADC0CAL0 & 0x7FFF0000) >> 16, ADC_BIASPROG_GPBIASACC_HIGHACC); // Calibration for 2V5 reference
+    adc_config_input(ADC_INPUT_TEMP, ADC_SINGLECTRL_AT_256CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_POSSEL_TEMP | ADC_SINGLECTRL_REF_1V25 | ADC_SINGLECTRL_RES_12BIT, (DEVINFO->ADC0CAL0 & 0x00007FFF) >> 0, ADC_BIASPROG_GPBIASACC_LOWACC); // Calibration for 1V25 reference
+
+    // Sequence gate, matches anything until a trigger is set
+    pADCDMADescriptor[0].CTRL = LDMA_CH_CTRL_STRUCTREQ | LDMA_CH_CTRL_STRUCTTYPE_SYNC;
+    pADCDMADescriptor[0].SYNC = 0x0000;
+    pADCDMADescriptor[0].MATCH = 0x0000;
+    pADCDMADescriptor[0].LINK = (uint32_t)&pADCDMADescriptor[1] | LDMA_CH_LINK_LINK;
+
+    for(uint8_t i = 0; i < ADC_INPUT_COUNT; i++)
+    {
+        filter_config(&pxADCFilter[i], FILTER_TYPE_NONE, 0);
+        filter_stats_reset(&pxADCStats[i], 1);
+    }
+
+    ADC0->IFC = _ADC_IFC_MASK; // Clear all flags
+    IRQ_CLEAR(ADC0_IRQn); // Clear pending vector
+    IRQ_SET_PRIO(ADC0_IRQn, 1, 0); // Set priority 1,0
+    IRQ_ENABLE(ADC0_IRQn); // Enable vector
+    ADC0->IEN = ADC_IEN_SINGLECMP;
+
+    ldma_ch_disable(ADC0_DMA_CHANNEL);
+    ldma_ch_peri_req_disable(ADC0_DMA_CHANNEL);
+    ldma_ch_req_clear(ADC0_DMA_CHANNEL);
+
+    ldma_ch_config(ADC0_DMA_CHANNEL, LDMA_CH_REQSEL_SOURCESEL_ADC0 | LDMA_CH_REQSEL_SIGSEL_ADC0SINGLE, LDMA_CH_CFG_SRCINCSIGN_DEFAULT, LDMA_CH_CFG_DSTINCSIGN_DEFAULT, LDMA_CH_CFG_ARBSLOTS_DEFAULT, 0);
+    ldma_ch_set_isr(ADC0_DMA_CHANNEL, adc_dma_isr);
+
+    // The sequence loops forever, every input is reconverted as soon as the previous one is stored unless a trigger gates it
+    ldma_ch_load(ADC0_DMA_CHANNEL, pADCDMADescriptor);
+    ldma_ch_peri_req_enable(ADC0_DMA_CHANNEL);
+    ldma_ch_enable(ADC0_DMA_CHANNEL);
+
+    while(!ulADCSequenceCount) // Every reader gets a real sample from now on
+        adc_task();
+}
+void adc_task()
 {
-    while(ADC0->STATUS & (ADC_STATUS_WARM | ADC_STATUS_SCANREFWARM | ADC_STATUS_SINGLEREFWARM)); // Wait for ADC to cool down
+    uint8_t ubCompleted = 0;
+
+    // An immediate capture can stop the LDMA after it moved on to the next slot but before it marked this one, that one never fills
+    for(uint8_t i = 1; i < ADC_SEQUENCE_BUFFER && !pulADCSequenceFull[ubADCSequenceTail]; i++)
+    {
+        if(pulADCSequenceFull[(ubADCSequenceTail + i) % ADC_SEQUENCE_BUFFER])
+            ubADCSequenceTail = (ubADCSequenceTail + i) % ADC_SEQUENCE_BUFFER;
+    }
+
+    // Filters run on every buffered sequence in order, the LDMA laps the oldest slot only if this falls ADC_SEQUENCE_BUFFER sequences behind
+    while(pulADCSequenceFull[ubADCSequenceTail])
+    {
+        volatile uint32_t *pulSample = pulADCSequence[ubADCSequenceTail];
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // The end of a capture feeds the filters from its interrupt
+        {
+            for(uint8_t i = 0; i < ADC_INPUT_COUNT; i++)
+            {
+                uint16_t usValue = filter_update(&pxADCFilter[i], pulSample[i]);
+
+                pulADCValue[i] = usValue;
+
+                filter_stats_update(&pxADCStats[i], usValue);
+            }
+
+            // Backs up the comparator interrupt, which only gets to look at the newest result
+            adc_window_trip(adc_window_check(pulSample));
+        }
+
+        pulADCSequenceFull[ubADCSequenceTail] = 0;
+        ubADCSequenceTail = (ubADCSequenceTail + 1) % ADC_SEQUENCE_BUFFER;
+
+        ulADCSequenceCount++;
+        ubCompleted = 1;
+
+        if(pfSequenceCallback)
+            pfSequenceCallback();
+    }
+
+    if(!ubCompleted)
+        return;
+
+    // Normally armed from the interrupt already, this covers a pass whose last descriptor was loaded before the interrupt was enabled
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(ubADCCaptureState == ADC_CAPTURE_STATE_PENDING)
+            adc_capture_arm();
+    }
+}
+void adc_set_sequence_callback(adc_sequence_callback_t pfCallback)
+{
+    pfSequenceCallback = pfCallback;
+}
+uint32_t adc_get_sequence_count()
+{
+    return ulADCSequenceCount;
+}
+void adc_set_trigger(uint32_t ulPRSSource)
+{
+    ulADCTrigger = ulPRSSource;
 
-    ADC0->SINGLECTRL = ADC_SINGLECTRL_AT_64CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_POSSEL_AVDD | ADC_SINGLECTRL_REF_5V | ADC_SINGLECTRL_RES_OVS;
-    ADC0->SINGLECTRLX = ADC_SINGLECTRLX_FIFOOFACT_OVERWRITE | (0 << _ADC_SINGLECTRLX_DVL_SHIFT);
-    ADC0->CAL &= ~(_ADC_CAL_SINGLEGAIN_MASK | _ADC_CAL_SINGLEOFFSET_MASK | _ADC_CAL_SINGLEOFFSETINV_MASK);
-    ADC0->CAL |= (DEVINFO->ADC0CAL1 & 0x7FFF0000) >> 16; // Calibration for 5V reference
-    ADC0->BIASPROG = (ADC0->BIASPROG & ~_ADC_BIASPROG_ADCBIASPROG_MASK) | ADC_BIASPROG_GPBIASACC_HIGHACC;
+    if(!ulPRSSource)
+    {
+        // Matching nothing lets the gate through, the LDMA may be waiting on it right now so release it too
+        pADCDMADescriptor[0].MATCH = 0x0000;
+        pADCDMADescriptor[0].SYNC = 0x0000;
 
-    ADC0->CMD |= ADC_CMD_SINGLESTART;
+        ldma_sync_prs_enable(BIT(ADC0_PRS_CHANNEL), 0);
+        prs_ch_disable(ADC0_PRS_CHANNEL);
+        ldma_sync_set(BIT(ADC0_PRS_CHANNEL));
 
-    while(!(ADC0->IF & ADC_IF_SINGLE));
+        return;
+    }
 
-    float fAVDD = ADC0->SINGLEDATA * 5000.f / 65535.f;
+    // Each trigger edge sets the SYNC bit, the gate clears it and waits for the next one
+    // A trigger arriving while a sequence is still converting is dropped, SYNCCLR wipes it when the chain gets back to the gate
+    prs_ch_config(ADC0_PRS_CHANNEL, ulPRSSource, PRS_CH_CTRL_EDSEL_POSEDGE, 0);
+    ldma_sync_prs_enable(BIT(ADC0_PRS_CHANNEL), 1);
 
-    return fAVDD;
+    pADCDMADescriptor[0].SYNC = BIT(ADC0_PRS_CHANNEL) << 8; // SYNCCLR
+    pADCDMADescriptor[0].MATCH = (BIT(ADC0_PRS_CHANNEL) << 8) | BIT(ADC0_PRS_CHANNEL); // MATCHEN, MATCHVAL
 }
-float adc_get_dvdd()
+uint32_t adc_get_trigger()
+{
+    return ulADCTrigger;
+}
+uint8_t adc_capture_start(uint8_t ubInput, uint32_t ulPRSSource, uint32_t ulPRSEdge, uint8_t ubDecimation, uint16_t *pusBuffer, uint16_t usCount, uint8_t ubImmediate)
 {
-    while(ADC0->STATUS & (ADC_STATUS_WARM | ADC_STATUS_SCANREFWARM | ADC_STATUS_SINGLEREFWARM)); // Wait for ADC to cool down
+    if(ubInput >= ADC_INPUT_COUNT || ubInput == ADC_INPUT_TEMP)
+        return 0;
 
-    ADC0->SINGLECTRL = ADC_SINGLECTRL_AT_64CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_POSSEL_DVDD | ADC_SINGLECTRL_REF_5V | ADC_SINGLECTRL_RES_OVS;
-    ADC0->SINGLECTRLX = ADC_SINGLECTRLX_FIFOOFACT_OVERWRITE | (0 << _ADC_SINGLECTRLX_DVL_SHIFT);
-    ADC0->CAL &= ~(_ADC_CAL_SINGLEGAIN_MASK | _ADC_CAL_SINGLEOFFSET_MASK | _ADC_CAL_SINGLEOFFSETINV_MASK);
-    ADC0->CAL |= (DEVINFO->ADC0CAL1 & 0x7FFF0000) >> 16; // Calibration for 5V reference
-    ADC0->BIASPROG = (ADC0->BIASPROG & ~_ADC_BIASPROG_ADCBIASPROG_MASK) | ADC_BIASPROG_GPBIASACC_HIGHACC;
+    if(!ubDecimation || ubDecimation > ADC_CAPTURE_MAX_DECIMATION)
+        return 0;
 
-    ADC0->CMD |= ADC_CMD_SINGLESTART;
+    if(!pusBuffer || !usCount)
+        return 0;
 
-    while(!(ADC0->IF & ADC_IF_SINGLE));
+    if(ubADCCaptureState != ADC_CAPTURE_STATE_IDLE)
+        return 0;
 
-    float fDVDD = ADC0->SINGLEDATA * 5000.f / 65535.f;
+    ubADCCaptureInput = ubInput;
+    ulADCCapturePRSSource = ulPRSSource;
+    ulADCCapturePRSEdge = ulPRSEdge;
+    ubADCCaptureDecimation = ubDecimation;
+    pusADCCaptureBuffer = pusBuffer;
+    usADCCaptureCount = usCount;
 
-    return fDVDD;
-}
-float adc_get_iovdd()
-{
-    while(ADC0->STATUS & (ADC_STATUS_WARM | ADC_STATUS_SCANREFWARM | ADC_STATUS_SINGLEREFWARM)); // Wait for ADC to cool down
+    if(ubImmediate)
+    {
+        // Cut the running pass short, the inputs it did not reach keep their previous samples
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            adc_capture_arm();
+        }
 
-    ADC0->SINGLECTRL = ADC_SINGLECTRL_AT_64CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_POSSEL_IOVDD | ADC_SINGLECTRL_REF_5V | ADC_SINGLECTRL_RES_OVS;
-    ADC0->SINGLECTRLX = ADC_SINGLECTRLX_FIFOOFACT_OVERWRITE | (0 << _ADC_SINGLECTRLX_DVL_SHIFT);
-    ADC0->CAL &= ~(_ADC_CAL_SINGLEGAIN_MASK | _ADC_CAL_SINGLEOFFSET_MASK | _ADC_CAL_SINGLEOFFSETINV_MASK);
-    ADC0->CAL |= (DEVINFO->ADC0CAL1 & 0x7FFF0000) >> 16; // Calibration for 5V reference
-    ADC0->BIASPROG = (ADC0->BIASPROG & ~_ADC_BIASPROG_ADCBIASPROG_MASK) | ADC_BIASPROG_GPBIASACC_HIGHACC;
+        return 1;
+    }
 
-    ADC0->CMD |= ADC_CMD_SINGLESTART;
+    // Hold the sequence at its gate once the current pass ends, the capture takes over the ADC from there
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pADCDMADescriptor[0].SYNC = BIT(ADC0_PARK_SYNC_BIT) << 8; // SYNCCLR
+        pADCDMADescriptor[0].MATCH = (BIT(ADC0_PARK_SYNC_BIT) << 8) | BIT(ADC0_PARK_SYNC_BIT); // MATCHEN, MATCHVAL
 
-    while(!(ADC0->IF & ADC_IF_SINGLE));
+        adc_sequence_wake(1);
 
-    float fIOVDD = ADC0->SINGLEDATA * 5000.f / 65535.f;
+        ubADCCaptureState = ADC_CAPTURE_STATE_PENDING;
+    }
 
-    return fIOVDD;
+    return 1;
 }
-float adc_get_corevdd()
+void adc_capture_abort()
 {
-    while(ADC0->STATUS & (ADC_STATUS_WARM | ADC_STATUS_SCANREFWARM | ADC_STATUS_SINGLEREFWARM)); // Wait for ADC to cool down
-
-    ADC0->SINGLECTRL = ADC_SINGLECTRL_AT_64CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_POSSEL_DECOUPLE | ADC_SINGLECTRL_REF_2V5 | ADC_SINGLECTRL_RES_OVS;
-    ADC0->SINGLECTRLX = ADC_SINGLECTRLX_FIFOOFACT_OVERWRITE | (0 << _ADC_SINGLECTRLX_DVL_SHIFT);
-    ADC0->CAL &= ~(_ADC_CAL_SINGLEGAIN_MASK | _ADC_CAL_SINGLEOFFSET_MASK | _ADC_CAL_SINGLEOFFSETINV_MASK);
-    ADC0->CAL |= (DEVINFO->ADC0CAL0 & 0x7FFF0000) >> 16; // Calibration for 2V5 reference
-    ADC0->BIASPROG = (ADC0->BIASPROG & ~_ADC_BIASPROG_ADCBIASPROG_MASK) | ADC_BIASPROG_GPBIASACC_HIGHACC;
-    ADC0->CMD |= ADC_CMD_SINGLESTART;
-
-    while(!(ADC0->IF & ADC_IF_SINGLE));
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(ubADCCaptureState == ADC_CAPTURE_STATE_RUNNING)
+        {
+            usADCCaptureCount = 0;
+
+            adc_capture_stop();
+        }
+        else if(ubADCCaptureState == ADC_CAPTURE_STATE_PENDING)
+        {
+            adc_set_trigger(ulADCTrigger);
+            ldma_sync_set(BIT(ADC0_PARK_SYNC_BIT)); // Release the gate in case the sequence is already parked on it
+
+            adc_sequence_wake(0);
+
+            ubADCCaptureState = ADC_CAPTURE_STATE_IDLE;
+        }
+    }
+}
+uint8_t adc_capture_busy()
+{
+    return ubADCCaptureState != ADC_CAPTURE_STATE_IDLE;
+}
+float adc_code_to_value(uint8_t ubInput, uint16_t usCode)
+{
+    if(ubInput >= ADC_INPUT_COUNT)
+        return 0.f;
 
-    float fDECOUPLE = ADC0->SINGLEDATA * 2500.f / 65535.f;
+    return adc_convert(ubInput, usCode);
+}
+uint32_t adc_get_raw(uint8_t ubInput)
+{
+    if(ubInput >= ADC_INPUT_COUNT)
+        return 0;
 
-    return fDECOUPLE;
+    return pulADCSample[ubInput];
 }
-float adc_get_5v0()
+void adc_set_window_isr(adc_window_isr_t pfISR)
+{
+    pfWindowISR = pfISR;
+}
+uint8_t adc_set_window(uint8_t ubInput, float fLow, float fHigh)
 {
-    while(ADC0->STATUS & (ADC_STATUS_WARM | ADC_STATUS_SCANREFWARM | ADC_STATUS_SINGLEREFWARM)); // Wait for ADC to cool down
+    if(ubInput >= ADC_INPUT_COUNT || ubInput == ADC_INPUT_TEMP)
+        return 0;
+
+    if(fLow < 0.f || fHigh <= fLow)
+        return 0;
 
-    ADC0->SINGLECTRL = ADC_SINGLECTRL_AT_256CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_5V0_CHAN | ADC_SINGLECTRL_REF_2V5 | ADC_SINGLECTRL_RES_OVS;
-    ADC0->SINGLECTRLX = ADC_SINGLECTRLX_FIFOOFACT_OVERWRITE | (0 << _ADC_SINGLECTRLX_DVL_SHIFT);
-    ADC0->CAL &= ~(_ADC_CAL_SINGLEGAIN_MASK | _ADC_CAL_SINGLEOFFSET_MASK | _ADC_CAL_SINGLEOFFSETINV_MASK);
-    ADC0->CAL |= (DEVINFO->ADC0CAL0 & 0x7FFF0000) >> 16; // Calibration for 2V5 reference
-    ADC0->BIASPROG = (ADC0->BIASPROG & ~_ADC_BIASPROG_ADCBIASPROG_MASK) | ADC_BIASPROG_GPBIASACC_HIGHACC;
+    float fLowCode = fLow / adc_get_scale(ubInput);
+    float fHighCode = fHigh / adc_get_scale(ubInput);
 
-    ADC0->CMD |= ADC_CMD_SINGLESTART;
+    if(fHighCode > 65535.f)
+        fHighCode = 65535.f;
 
-    while(!(ADC0->IF & ADC_IF_SINGLE));
+    if(fLowCode > fHighCode)
+        return 0;
 
-    float f5V0 = ADC0->SINGLEDATA * 2500.f / 65535.f;
+    adc_input_config_t *pConfig = &pxADCInputConfig[ubInput];
 
-    return f5V0 * ADC_5V0_DIV;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // With ADGT >= ADLT the comparator fires on results outside of [ADLT, ADGT]
+        pConfig->ulSingleCtrl &= ~ADC_SINGLECTRL_CMPEN; // The LDMA picks up each word on its own, never arm stale thresholds
+        pConfig->ulCmpThr = (((uint32_t)fHighCode << _ADC_CMPTHR_ADGT_SHIFT) & _ADC_CMPTHR_ADGT_MASK) | (((uint32_t)fLowCode << _ADC_CMPTHR_ADLT_SHIFT) & _ADC_CMPTHR_ADLT_MASK);
+        pConfig->ulSingleCtrl |= ADC_SINGLECTRL_CMPEN;
+
+        ubADCWindowArmed |= BIT(ubInput);
+    }
+
+    return 1;
 }
-float adc_get_vext()
+uint8_t adc_clear_window(uint8_t ubInput)
 {
-    while(ADC0->STATUS & (ADC_STATUS_WARM | ADC_STATUS_SCANREFWARM | ADC_STATUS_SINGLEREFWARM)); // Wait for ADC to cool down
+    if(ubInput >= ADC_INPUT_COUNT)
+        return 0;
 
-    ADC0->SINGLECTRL = ADC_SINGLECTRL_AT_256CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_VEXT_CHAN | ADC_SINGLECTRL_REF_2V5 | ADC_SINGLECTRL_RES_OVS;
-    ADC0->SINGLECTRLX = ADC_SINGLECTRLX_FIFOOFACT_OVERWRITE | (0 << _ADC_SINGLECTRLX_DVL_SHIFT);
-    ADC0->CAL &= ~(_ADC_CAL_SINGLEGAIN_MASK | _ADC_CAL_SINGLEOFFSET_MASK | _ADC_CAL_SINGLEOFFSETINV_MASK);
-    ADC0->CAL |= (DEVINFO->ADC0CAL0 & 0x7FFF0000) >> 16; // Calibration for 2V5 reference
-    ADC0->BIASPROG = (ADC0->BIASPROG & ~_ADC_BIASPROG_ADCBIASPROG_MASK) | ADC_BIASPROG_GPBIASACC_HIGHACC;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ubADCWindowArmed &= ~BIT(ubInput);
+        pxADCInputConfig[ubInput].ulSingleCtrl &= ~ADC_SINGLECTRL_CMPEN;
+    }
 
-    ADC0->CMD |= ADC_CMD_SINGLESTART;
+    return 1;
+}
+uint8_t adc_get_window(uint8_t ubInput, float *pfLow, float *pfHigh)
+{
+    if(ubInput >= ADC_INPUT_COUNT)
+        return 0;
 
-    while(!(ADC0->IF & ADC_IF_SINGLE));
+    if(pfLow)
+        *pfLow = adc_convert(ubInput, (pxADCInputConfig[ubInput].ulCmpThr & _ADC_CMPTHR_ADLT_MASK) >> _ADC_CMPTHR_ADLT_SHIFT);
 
-    float fVIEXT = ADC0->SINGLEDATA * 2500.f / 65535.f;
+    if(pfHigh)
+        *pfHigh = adc_convert(ubInput, (pxADCInputConfig[ubInput].ulCmpThr & _ADC_CMPTHR_ADGT_MASK) >> _ADC_CMPTHR_ADGT_SHIFT);
 
-    return fVIEXT * ADC_VEXT_DIV;
+    return !!(ubADCWindowArmed & BIT(ubInput));
 }
-
-float adc_get_temperature()
+uint8_t adc_set_filter(uint8_t ubInput, uint8_t ubType, uint8_t ubParam)
 {
-    while(ADC0->STATUS & (ADC_STATUS_WARM | ADC_STATUS_SCANREFWARM | ADC_STATUS_SINGLEREFWARM)); // Wait for ADC to cool down
+    if(ubInput >= ADC_INPUT_COUNT)
+        return 0;
 
-    ADC0->SINGLECTRL = ADC_SINGLECTRL_AT_256CYCLES | ADC_SINGLECTRL_NEGSEL_VSS | ADC_SINGLECTRL_POSSEL_TEMP | ADC_SINGLECTRL_REF_1V25 | ADC_SINGLECTRL_RES_12BIT;
-    ADC0->SINGLECTRLX = ADC_SINGLECTRLX_FIFOOFACT_OVERWRITE | (0 << _ADC_SINGLECTRLX_DVL_SHIFT);
-    ADC0->CAL &= ~(_ADC_CAL_SINGLEGAIN_MASK | _ADC_CAL_SINGLEOFFSET_MASK | _ADC_CAL_SINGLEOFFSETINV_MASK);
-    ADC0->CAL |= (DEVINFO->ADC0CAL0 & 0x00007FFF) >> 0; // Calibration for 1V25 reference
-    ADC0->BIASPROG = (ADC0->BIASPROG & ~_ADC_BIASPROG_ADCBIASPROG_MASK) | ADC_BIASPROG_GPBIASACC_LOWACC;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(!filter_config(&pxADCFilter[ubInput], ubType, ubParam))
+            return 0;
 
-    ADC0->CMD |= ADC_CMD_SINGLESTART;
+        filter_stats_reset(&pxADCStats[ubInput], 1); // Old statistics describe a different signal
+    }
 
-    while(!(ADC0->IF & ADC_IF_SINGLE));
+    return 1;
+}
+uint8_t adc_get_filter(uint8_t ubInput, uint8_t *pubType, uint8_t *pubParam)
+{
+    if(ubInput >= ADC_INPUT_COUNT)
+        return 0;
 
-    float fADCCode = ADC0->SINGLEDATA;
-    float fCalibrationTemp = (DEVINFO->CAL & _DEVINFO_CAL_TEMP_MASK) >> _DEVINFO_CAL_TEMP_SHIFT;
-    float fADCCalibrationTemp = (DEVINFO->ADC0CAL3 & _DEVINFO_ADC0CAL3_TEMPREAD1V25_MASK) >> _DEVINFO_ADC0CAL3_TEMPREAD1V25_SHIFT;
-    float fADCTemp = fCalibrationTemp - (fADCCalibrationTemp - fADCCode) * 1250.f / (4096.f * -1.84f);
+    if(pubType)
+        *pubType = pxADCFilter[ubInput].ubType;
 
-    return fADCTemp;
+    if(pubParam)
+        *pubParam = pxADCFilter[ubInput].ubParam;
+
+    return 1;
+}
+uint8_t adc_get_stats(uint8_t ubInput, adc_stats_t *pStats, uint8_t ubClear)
+{
+    if(ubInput >= ADC_INPUT_COUNT)
+        return 0;
+
+    if(!pStats)
+        return 0;
+
+    filter_stats_t xStats;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        xStats = pxADCStats[ubInput];
+
+        if(ubClear & ADC_STATS_CLEAR_WINDOW)
+            filter_stats_reset(&pxADCStats[ubInput], 0);
+
+        if(ubClear & ADC_STATS_CLEAR_PEAK)
+        {
+            pxADCStats[ubInput].usPeak = 0;
+            pxADCStats[ubInput].usPeakMin = 0xFFFF;
+        }
+    }
+
+    if(!xStats.ulCount)
+        return 0;
+
+    pStats->fMean = adc_convert(ubInput, (float)xStats.ullSum / xStats.ulCount);
+
+    // The temperature falls as the code rises, its extremes and peak come from the opposite codes
+    if(ubInput == ADC_INPUT_TEMP)
+    {
+        pStats->fMin = adc_convert(ubInput, xStats.usMax);
+        pStats->fMax = adc_convert(ubInput, xStats.usMin);
+        pStats->fPeak = adc_convert(ubInput, xStats.usPeakMin);
+    }
+    else
+    {
+        pStats->fMin = adc_convert(ubInput, xStats.usMin);
+        pStats->fMax = adc_convert(ubInput, xStats.usMax);
+        pStats->fPeak = adc_convert(ubInput, xStats.usPeak);
+    }
+    pStats->ulCount = xStats.ulCount;
+
+    return 1;
+}
+
+float adc_get_avdd()
+{
+    return adc_convert(ADC_INPUT_AVDD, pulADCValue[ADC_INPUT_AVDD]);
+}
+float adc_get_dvdd()
+{
+    return adc_convert(ADC_INPUT_DVDD, pulADCValue[ADC_INPUT_DVDD]);
+}
+float adc_get_iovdd()
+{
+    return adc_convert(ADC_INPUT_IOVDD, pulADCValue[ADC_INPUT_IOVDD]);
+}
+float adc_get_corevdd()
+{
+    return adc_convert(ADC_INPUT_DECOUPLE, pulADCValue[ADC_INPUT_DECOUPLE]);
+}
+float adc_get_5v0()
+{
+    return adc_convert(ADC_INPUT_5V0, pulADCValue[ADC_INPUT_5V0]);
+}
+float adc_get_vext()
+{
+    return adc_convert(ADC_INPUT_VEXT, pulADCValue[ADC_INPUT_VEXT]);
 }
 
+float adc_get_temperature()
+{
+    return adc_convert(ADC_INPUT_TEMP, pulADCValue[ADC_INPUT_TEMP]);
+}
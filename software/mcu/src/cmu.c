@@ -42,8 +42,11 @@ void cmu_init()
     // Calibrate AUXHFRCO for 8 MHz
     cmu_auxhfrco_config(1, AUXHFRCO_CALIB_8M, 8000000);
 
+    // Start LFRCO, the RTCC system time base needs its 2^15 Hz
+    cmu_lfrco_config(1, CMU_LFRCOCTRL_TIMEOUT_32CYCLES | CMU_LFRCOCTRL_ENCHOP | CMU_LFRCOCTRL_ENDEM);
+
     // Configure LFE clock
-    cmu_lfe_clock_config(CMU_LFECLKSEL_LFE_ULFRCO);
+    cmu_lfe_clock_config(CMU_LFECLKSEL_LFE_LFRCO);
 
     // Disable unused oscillators
     cmu_hfxo_config(0, 0, 0);
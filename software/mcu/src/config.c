@@ -0,0 +1,253 @@
+#include "config.h"
+
+#define CONFIG_MAGIC                0x47464E43 // Bumped when the layout changes
+#define CONFIG_RECORDS_PER_PAGE     ((FLASH_PAGE_SIZE - sizeof(config_page_header_t)) / sizeof(config_record_t))
+#define CONFIG_RECORD_CLEARED       0x80000000 // In ulKey, the key has no value from this record on
+
+typedef struct
+{
+    uint32_t ulMagic;
+    uint32_t ulGeneration; // Bumped on every compaction, the valid page with the highest one is the active one
+} config_page_header_t;
+typedef struct
+{
+    uint32_t ulKey;
+    uint32_t ulValue;
+    uint32_t ulCRC; // Over the key and the value, written last so a torn record never validates
+} config_record_t;
+
+static uint32_t pulConfigValue[CONFIG_MAX_KEYS];
+static uint32_t ulConfigValid = 0; // Bitmap of the keys holding a value
+static uint32_t ulConfigDirty = 0; // Bitmap of the keys not yet in flash
+static uint32_t ulConfigPage = CONFIG_FLASH_ADDR; // Active page
+static uint32_t ulConfigGeneration = 0;
+static uint16_t usConfigNextRecord = 0; // Next free record slot in the active page
+static uint64_t ullConfigFirstChangeTick = 0;
+static uint64_t ullConfigLastChangeTick = 0;
+
+static config_record_t *config_record_addr(uint32_t ulPage, uint16_t usRecord)
+{
+    return (config_record_t *)(ulPage + sizeof(config_page_header_t)) + usRecord;
+}
+static uint8_t config_write_record(uint16_t usKey)
+{
+    if(usConfigNextRecord >= CONFIG_RECORDS_PER_PAGE)
+        return 0;
+
+    config_record_t xRecord;
+
+    xRecord.ulKey = usKey | ((ulConfigValid & BIT(usKey)) ? 0 : CONFIG_RECORD_CLEARED);
+    xRecord.ulValue = pulConfigValue[usKey];
+    xRecord.ulCRC = calc_crc32((uint8_t *)&xRecord, sizeof(config_record_t) - sizeof(uint32_t));
+
+    msc_flash_page_write((uint32_t)config_record_addr(ulConfigPage, usConfigNextRecord++), (uint8_t *)&xRecord, sizeof(config_record_t));
+
+    return 1;
+}
+static void config_compact()
+{
+    uint32_t ulPage = ulConfigPage + FLASH_PAGE_SIZE;
+
+    if(ulPage >= CONFIG_FLASH_ADDR + CONFIG_FLASH_PAGES * FLASH_PAGE_SIZE)
+        ulPage = CONFIG_FLASH_ADDR;
+
+    msc_flash_page_erase(ulPage);
+
+    ulConfigPage = ulPage;
+    usConfigNextRecord = 0;
+
+    // Only the newest value of each key is carried over, pending changes included
+    for(uint16_t i = 0; i < CONFIG_MAX_KEYS; i++)
+        if(ulConfigValid & BIT(i))
+            config_write_record(i);
+
+    ulConfigDirty = 0;
+
+    // The header goes last, a reset before this keeps the old page active
+    msc_flash_word_write(ulPage + 4, ++ulConfigGeneration);
+    msc_flash_word_write(ulPage, CONFIG_MAGIC);
+}
+
+void config_init()
+{
+    const config_page_header_t *pActive = NULL;
+
+    for(uint8_t i = 0; i < CONFIG_FLASH_PAGES; i++)
+    {
+        const config_page_header_t *pHeader = (const config_page_header_t *)(CONFIG_FLASH_ADDR + i * FLASH_PAGE_SIZE);
+
+        if(pHeader->ulMagic != CONFIG_MAGIC)
+            continue;
+
+        if(pActive && pHeader->ulGeneration < pActive->ulGeneration)
+            continue;
+
+        pActive = pHeader;
+    }
+
+    ulConfigValid = 0;
+    ulConfigDirty = 0;
+    usConfigNextRecord = 0;
+
+    if(!pActive) // Blank or foreign contents, start an empty log
+    {
+        ulConfigPage = CONFIG_FLASH_ADDR + (CONFIG_FLASH_PAGES - 1) * FLASH_PAGE_SIZE;
+        ulConfigGeneration = 0;
+
+        config_compact();
+
+        return;
+    }
+
+    ulConfigPage = (uint32_t)pActive;
+    ulConfigGeneration = pActive->ulGeneration;
+
+    // Replay the log, later records of a key override earlier ones
+    for(uint16_t i = 0; i < CONFIG_RECORDS_PER_PAGE; i++)
+    {
+        config_record_t *pRecord = config_record_addr(ulConfigPage, i);
+
+        if(pRecord->ulKey == 0xFFFFFFFF && pRecord->ulValue == 0xFFFFFFFF && pRecord->ulCRC == 0xFFFFFFFF)
+            continue;
+
+        usConfigNextRecord = i + 1; // Partially written slots are skipped too, they can't be programmed again
+
+        uint32_t ulKey = pRecord->ulKey & ~CONFIG_RECORD_CLEARED;
+
+        if(ulKey >= CONFIG_MAX_KEYS)
+            continue;
+
+        if(pRecord->ulCRC != calc_crc32((uint8_t *)pRecord, sizeof(config_record_t) - sizeof(uint32_t)))
+            continue;
+
+        if(pRecord->ulKey & CONFIG_RECORD_CLEARED)
+        {
+            ulConfigValid &= ~BIT(ulKey);
+
+            continue;
+        }
+
+        pulConfigValue[ulKey] = pRecord->ulValue;
+        ulConfigValid |= BIT(ulKey);
+    }
+}
+uint8_t config_set(uint16_t usKey, uint32_t ulValue)
+{
+    if(usKey >= CONFIG_MAX_KEYS)
+        return 0;
+
+    if((ulConfigValid & BIT(usKey)) && pulConfigValue[usKey] == ulValue)
+        return 1;
+
+    pulConfigValue[usKey] = ulValue;
+    ulConfigValid |= BIT(usKey);
+
+    if(!ulConfigDirty)
+        ullConfigFirstChangeTick = now_ms();
+
+    ulConfigDirty |= BIT(usKey);
+    ullConfigLastChangeTick = now_ms();
+
+    return 1;
+}
+uint8_t config_clear(uint16_t usKey)
+{
+    if(usKey >= CONFIG_MAX_KEYS)
+        return 0;
+
+    if(!(ulConfigValid & BIT(usKey)))
+        return 1;
+
+    ulConfigValid &= ~BIT(usKey); // Compaction drops it, an append writes a cleared record
+
+    if(!ulConfigDirty)
+        ullConfigFirstChangeTick = now_ms();
+
+    ulConfigDirty |= BIT(usKey);
+    ullConfigLastChangeTick = now_ms();
+
+    return 1;
+}
+uint8_t config_get(uint16_t usKey, uint32_t *pulValue)
+{
+    if(usKey >= CONFIG_MAX_KEYS)
+        return 0;
+
+    if(!(ulConfigValid & BIT(usKey)))
+        return 0;
+
+    if(pulValue)
+        *pulValue = pulConfigValue[usKey];
+
+    return 1;
+}
+uint8_t config_set_float(uint16_t usKey, float fValue)
+{
+    union
+    {
+        float f;
+        uint32_t ul;
+    } xValue = {.f = fValue};
+
+    return config_set(usKey, xValue.ul);
+}
+uint8_t config_get_float(uint16_t usKey, float *pfValue)
+{
+    union
+    {
+        float f;
+        uint32_t ul;
+    } xValue;
+
+    if(!config_get(usKey, &xValue.ul))
+        return 0;
+
+    if(pfValue)
+        *pfValue = xValue.f;
+
+    return 1;
+}
+uint8_t config_is_dirty()
+{
+    return !!ulConfigDirty;
+}
+void config_flush()
+{
+    if(!ulConfigDirty)
+        return;
+
+    uint8_t ubPending = 0;
+
+    for(uint16_t i = 0; i < CONFIG_MAX_KEYS; i++)
+        if(ulConfigDirty & BIT(i))
+            ubPending++;
+
+    // Compaction writes every key anyway, so it is done instead of filling the page up
+    if(usConfigNextRecord + ubPending > CONFIG_RECORDS_PER_PAGE)
+    {
+        config_compact();
+
+        return;
+    }
+
+    for(uint16_t i = 0; i < CONFIG_MAX_KEYS; i++)
+        if(ulConfigDirty & BIT(i))
+            config_write_record(i);
+
+    ulConfigDirty = 0;
+}
+void config_task()
+{
+    if(!ulConfigDirty)
+        return;
+
+    if(now_ms() - ullConfigLastChangeTick < CONFIG_FLUSH_DELAY_MS && now_ms() - ullConfigFirstChangeTick < CONFIG_FLUSH_MAX_DELAY_MS)
+    {
+        sleep_deadline(ullConfigLastChangeTick + CONFIG_FLUSH_DELAY_MS);
+        sleep_deadline(ullConfigFirstChangeTick + CONFIG_FLUSH_MAX_DELAY_MS);
+
+        return;
+    }
+
+    config_flush();
+}
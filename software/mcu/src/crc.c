@@ -92,3 +92,23 @@ uint32_t calc_crc32(uint8_t *pData, uint32_t ulSize)
 }
 
 #endif
+
+uint8_t calc_crc8_maxim(uint8_t *pData, uint32_t ulSize)
+{
+    uint8_t crc = 0x00;
+
+    while(ulSize--)
+    {
+        crc ^= *pData++;
+
+        for(uint8_t i = 0; i < 8; i++)
+        {
+            if(crc & 0x01)
+                crc = (crc >> 1) ^ 0x8C;
+            else
+                crc = (crc >> 1);
+        }
+    }
+
+    return crc;
+}
@@ -0,0 +1,32 @@
+#include "cryotimer.h"
+
+void cryotimer_init(uint32_t ulOscillator, uint32_t ulPrescaler, uint8_t ubPeriodSel)
+{
+    cmu_hfbus_clock_gate(CMU_HFBUSCLKEN0_LE, 1);
+
+    CRYOTIMER->CTRL = 0; // Stop before reconfiguring, this also clears the counter
+    CRYOTIMER->PERIODSEL = (ubPeriodSel << _CRYOTIMER_PERIODSEL_PERIODSEL_SHIFT) & _CRYOTIMER_PERIODSEL_PERIODSEL_MASK;
+    CRYOTIMER->IFC = _CRYOTIMER_IFC_MASK;
+    CRYOTIMER->CTRL = (ulOscillator & _CRYOTIMER_CTRL_OSCSEL_MASK) | (ulPrescaler & _CRYOTIMER_CTRL_PRESC_MASK) | CRYOTIMER_CTRL_DEBUGRUN | CRYOTIMER_CTRL_EN;
+}
+void cryotimer_disable()
+{
+    CRYOTIMER->CTRL = 0;
+}
+uint32_t cryotimer_get_count()
+{
+    return CRYOTIMER->CNT;
+}
+uint32_t cryotimer_get_period()
+{
+    if(!(CRYOTIMER->CTRL & CRYOTIMER_CTRL_EN))
+        return 0;
+
+    uint8_t ubPrescaler = (CRYOTIMER->CTRL & _CRYOTIMER_CTRL_PRESC_MASK) >> _CRYOTIMER_CTRL_PRESC_SHIFT;
+    uint8_t ubPeriodSel = (CRYOTIMER->PERIODSEL & _CRYOTIMER_PERIODSEL_PERIODSEL_MASK) >> _CRYOTIMER_PERIODSEL_PERIODSEL_SHIFT;
+
+    if(ubPrescaler + ubPeriodSel > 31)
+        return 0xFFFFFFFF;
+
+    return (uint32_t)1 << (ubPrescaler + ubPeriodSel);
+}
@@ -0,0 +1,154 @@
+#include "ds18b20.h"
+
+uint8_t ds18b20_seq_convert(ds2484_seq_t *pSeq, const uint8_t *pubROM, uint8_t ubOverdrive, uint8_t ubStrongPullup)
+{
+    ds2484_seq_init(pSeq);
+
+    // With a NULL ROM every sensor on the bus is addressed (Skip ROM) and all of them convert in the same window
+    if(!ds2484_seq_add_select(pSeq, pubROM, ubOverdrive))
+        return 0;
+
+    if(ubStrongPullup && !ds2484_seq_add(pSeq, DS2484_STEP_STRONG_PULLUP, 0)) // Parasite powered sensors draw their conversion current from the bus
+        return 0;
+
+    return ds2484_seq_add(pSeq, DS2484_STEP_WRITE_BYTE, DS18B20_CMD_CONVERT_T);
+}
+uint8_t ds18b20_seq_read_scratchpad(ds2484_seq_t *pSeq, const uint8_t *pubROM, uint8_t ubOverdrive)
+{
+    ds2484_seq_init(pSeq);
+
+    if(!ds2484_seq_add_select(pSeq, pubROM, ubOverdrive))
+        return 0;
+
+    if(!ds2484_seq_add(pSeq, DS2484_STEP_WRITE_BYTE, DS18B20_CMD_READ_SCRATCHPAD))
+        return 0;
+
+    return ds2484_seq_add_read(pSeq, 9);
+}
+uint8_t ds18b20_seq_get_scratchpad(const ds2484_seq_t *pSeq, uint8_t *pubScratchpad)
+{
+    if(pSeq->ubStatus != DS2484_SEQ_STATUS_DONE || pSeq->ubCount < 9)
+        return 0;
+
+    for(uint8_t i = 0; i < 9; i++)
+        pubScratchpad[i] = pSeq->pxStep[pSeq->ubCount - 9 + i].ubData; // The read steps come last
+
+    return calc_crc8_maxim(pubScratchpad, 8) == pubScratchpad[DS18B20_SP_CRC];
+}
+uint8_t ds18b20_seq_get_temperature(const ds2484_seq_t *pSeq, float *pfTemperature)
+{
+    uint8_t ubScratchpad[9];
+
+    if(!ds18b20_seq_get_scratchpad(pSeq, ubScratchpad))
+        return 0;
+
+    int16_t sRaw = ((uint16_t)ubScratchpad[DS18B20_SP_TEMP_MSB] << 8) | ubScratchpad[DS18B20_SP_TEMP_LSB];
+    uint8_t ubResolution = DS18B20_MIN_RESOLUTION + ((ubScratchpad[DS18B20_SP_CONFIG] & DS18B20_CONFIG_RES_MASK) >> DS18B20_CONFIG_RES_SHIFT);
+
+    sRaw &= ~((1 << (DS18B20_MAX_RESOLUTION - ubResolution)) - 1); // Below 12 bit the low bits are undefined, not 0
+
+    *pfTemperature = sRaw / 16.f;
+
+    return 1;
+}
+
+uint8_t ds18b20_convert(const uint8_t *pubROM, uint8_t ubOverdrive, uint8_t ubStrongPullup)
+{
+    ds2484_seq_t xSeq;
+
+    if(!ds18b20_seq_convert(&xSeq, pubROM, ubOverdrive, ubStrongPullup))
+        return 0;
+
+    return ds2484_seq_run(&xSeq);
+}
+uint8_t ds18b20_read_scratchpad(const uint8_t *pubROM, uint8_t ubOverdrive, uint8_t *pubScratchpad)
+{
+    ds2484_seq_t xSeq;
+
+    if(!ds18b20_seq_read_scratchpad(&xSeq, pubROM, ubOverdrive))
+        return 0;
+
+    if(!ds2484_seq_run(&xSeq))
+        return 0;
+
+    return ds18b20_seq_get_scratchpad(&xSeq, pubScratchpad);
+}
+uint8_t ds18b20_read_temperature(const uint8_t *pubROM, uint8_t ubOverdrive, float *pfTemperature)
+{
+    ds2484_seq_t xSeq;
+
+    if(!ds18b20_seq_read_scratchpad(&xSeq, pubROM, ubOverdrive))
+        return 0;
+
+    if(!ds2484_seq_run(&xSeq))
+        return 0;
+
+    return ds18b20_seq_get_temperature(&xSeq, pfTemperature);
+}
+uint8_t ds18b20_read_resolution(const uint8_t *pubROM, uint8_t ubOverdrive, uint8_t *pubResolution)
+{
+    uint8_t ubScratchpad[9];
+
+    if(!ds18b20_read_scratchpad(pubROM, ubOverdrive, ubScratchpad))
+        return 0;
+
+    *pubResolution = DS18B20_MIN_RESOLUTION + ((ubScratchpad[DS18B20_SP_CONFIG] & DS18B20_CONFIG_RES_MASK) >> DS18B20_CONFIG_RES_SHIFT);
+
+    return 1;
+}
+uint8_t ds18b20_set_resolution(const uint8_t *pubROM, uint8_t ubOverdrive, uint8_t ubResolution)
+{
+    if(ubResolution < DS18B20_MIN_RESOLUTION || ubResolution > DS18B20_MAX_RESOLUTION)
+        return 0;
+
+    uint8_t ubScratchpad[9];
+
+    if(!ds18b20_read_scratchpad(pubROM, ubOverdrive, ubScratchpad)) // Keep the alarm thresholds, they share the write
+        return 0;
+
+    uint8_t ubConfig = (ubScratchpad[DS18B20_SP_CONFIG] & ~DS18B20_CONFIG_RES_MASK) | ((ubResolution - DS18B20_MIN_RESOLUTION) << DS18B20_CONFIG_RES_SHIFT);
+    uint8_t ubBuf[4] = {DS18B20_CMD_WRITE_SCRATCHPAD, ubScratchpad[DS18B20_SP_TH], ubScratchpad[DS18B20_SP_TL], ubConfig};
+
+    if(!ds2484_one_wire_select_speed(pubROM, ubOverdrive))
+        return 0;
+
+    if(!ds2484_one_wire_write(ubBuf, 4))
+        return 0;
+
+    if(!ds18b20_read_scratchpad(pubROM, ubOverdrive, ubScratchpad))
+        return 0;
+
+    if(ubScratchpad[DS18B20_SP_CONFIG] != ubConfig)
+        return 0;
+
+    // Persist to EEPROM so the sensor comes back at this resolution after a power cycle
+    if(!ds2484_one_wire_select_speed(pubROM, ubOverdrive))
+        return 0;
+
+    if(!ds2484_strong_pullup())
+        return 0;
+
+    if(!ds2484_one_wire_write_byte(DS18B20_CMD_COPY_SCRATCHPAD))
+        return 0;
+
+    delay_ms(DS18B20_COPY_TIME_MS);
+
+    return ds2484_one_wire_reset(); // Ends the strong pullup
+}
+uint8_t ds18b20_read_power_supply(const uint8_t *pubROM, uint8_t *pubParasite)
+{
+    if(!ds2484_one_wire_select(pubROM))
+        return 0;
+
+    if(!ds2484_one_wire_write_byte(DS18B20_CMD_READ_POWER_SUPPLY))
+        return 0;
+
+    uint8_t ubBit;
+
+    if(!ds2484_one_wire_read_bit(&ubBit))
+        return 0;
+
+    *pubParasite = !ubBit; // Parasite powered sensors pull the bus low
+
+    return 1;
+}
@@ -0,0 +1,587 @@
+#include "ds2484.h"
+
+static uint8_t ubDS2484Config = 0; // Last configuration written, without the self clearing strong pullup
+static ds2484_seq_t * volatile pDS2484Seq = NULL; // Sequence being run
+static uint8_t ubDS2484Step;
+static uint8_t ubDS2484Phase;
+static uint8_t ubDS2484NewConfig;
+static uint8_t pubDS2484Write[2];
+static uint8_t ubDS2484Read;
+static uint64_t ullDS2484Deadline;
+static i2c_transfer_t xDS2484Transfer;
+
+static void ds2484_seq_isr(i2c_transfer_t *pTransfer);
+
+static uint8_t ds2484_wait_idle(uint8_t *pubStatus)
+{
+    uint8_t ubStatus;
+    uint64_t ullStartTick = now_ms();
+
+    // Every command except Set Read Pointer leaves the read pointer at the status register
+    do
+    {
+        if(!i2c0_read(DS2484_I2C_ADDR, &ubStatus, 1, I2C_STOP))
+            return 0;
+
+        if(!(ubStatus & DS2484_STATUS_1WB))
+        {
+            if(pubStatus)
+                *pubStatus = ubStatus;
+
+            return 1;
+        }
+    } while(now_ms() - ullStartTick <= DS2484_TIMEOUT_MS);
+
+    return 0;
+}
+static uint8_t ds2484_seq_submit(uint8_t ubWriteCount, uint8_t ubReadCount)
+{
+    i2c_transfer_t *pTransfer = &xDS2484Transfer;
+
+    pTransfer->ubAddress = DS2484_I2C_ADDR;
+    pTransfer->ubFlags = 0;
+    pTransfer->pubWrite = ubWriteCount ? pubDS2484Write : NULL;
+    pTransfer->ulWriteCount = ubWriteCount;
+    pTransfer->pubRead = ubReadCount ? &ubDS2484Read : NULL;
+    pTransfer->ulReadCount = ubReadCount;
+    pTransfer->ulTimeout = 0;
+    pTransfer->pfCallback = ds2484_seq_isr;
+    pTransfer->pContext = NULL;
+
+    return i2c0_transfer_submit(pTransfer);
+}
+static void ds2484_seq_end(uint8_t ubStatus)
+{
+    ds2484_seq_t *pSeq = pDS2484Seq;
+
+    pDS2484Seq = NULL;
+    pSeq->ubStatus = ubStatus;
+}
+static void ds2484_seq_next()
+{
+    while(ubDS2484Step < pDS2484Seq->ubCount)
+    {
+        ds2484_step_t *pStep = &pDS2484Seq->pxStep[ubDS2484Step];
+        uint8_t ubWriteCount = 2;
+        uint8_t ubReadCount = 0;
+
+        ubDS2484Phase = DS2484_SEQ_PHASE_COMMAND;
+
+        switch(pStep->ubType)
+        {
+            case DS2484_STEP_RESET:
+            {
+                pubDS2484Write[0] = DS2484_CMD_1W_RESET;
+                ubWriteCount = 1;
+            }
+            break;
+            case DS2484_STEP_WRITE_BYTE:
+            {
+                pubDS2484Write[0] = DS2484_CMD_1W_WRITE_BYTE;
+                pubDS2484Write[1] = pStep->ubData;
+            }
+            break;
+            case DS2484_STEP_READ_BYTE:
+            {
+                pubDS2484Write[0] = DS2484_CMD_1W_READ_BYTE;
+                ubWriteCount = 1;
+            }
+            break;
+            case DS2484_STEP_SINGLE_BIT:
+            {
+                pubDS2484Write[0] = DS2484_CMD_1W_SINGLE_BIT;
+                pubDS2484Write[1] = pStep->ubData ? 0x80 : 0x00; // A read slot is a write 1 slot sampled by the master
+            }
+            break;
+            case DS2484_STEP_TRIPLET:
+            {
+                pubDS2484Write[0] = DS2484_CMD_1W_TRIPLET;
+                pubDS2484Write[1] = pStep->ubData ? 0x80 : 0x00;
+            }
+            break;
+            case DS2484_STEP_SPEED:
+            {
+                if(!!(ubDS2484Config & DS2484_CONFIG_1WS) == !!pStep->ubData)
+                {
+                    ubDS2484Step++;
+
+                    continue;
+                }
+
+                ubDS2484NewConfig = pStep->ubData ? (ubDS2484Config | DS2484_CONFIG_1WS) : (ubDS2484Config & ~DS2484_CONFIG_1WS);
+                ubDS2484Phase = DS2484_SEQ_PHASE_CONFIG;
+            }
+            break;
+            case DS2484_STEP_STRONG_PULLUP:
+            {
+                ubDS2484NewConfig = ubDS2484Config | DS2484_CONFIG_SPU;
+                ubDS2484Phase = DS2484_SEQ_PHASE_CONFIG;
+            }
+            break;
+            default:
+            {
+                ds2484_seq_end(DS2484_SEQ_STATUS_FAIL);
+            }
+            return;
+        }
+
+        if(ubDS2484Phase == DS2484_SEQ_PHASE_CONFIG)
+        {
+            pubDS2484Write[0] = DS2484_CMD_WRITE_CONFIG;
+            pubDS2484Write[1] = (~ubDS2484NewConfig << 4) | ubDS2484NewConfig; // Upper nibble must be the complement of the lower one
+            ubReadCount = 1; // The read pointer is left at the configuration register
+        }
+
+        ullDS2484Deadline = now_ms() + DS2484_TIMEOUT_MS;
+
+        if(!ds2484_seq_submit(ubWriteCount, ubReadCount))
+            ds2484_seq_end(DS2484_SEQ_STATUS_FAIL);
+
+        return;
+    }
+
+    ds2484_seq_end(DS2484_SEQ_STATUS_DONE);
+}
+static void ds2484_seq_isr(i2c_transfer_t *pTransfer)
+{
+    if(!pDS2484Seq)
+        return;
+
+    if(pTransfer->ubStatus != I2C_TRANSFER_STATUS_DONE)
+    {
+        ds2484_seq_end(DS2484_SEQ_STATUS_FAIL);
+
+        return;
+    }
+
+    ds2484_step_t *pStep = &pDS2484Seq->pxStep[ubDS2484Step];
+
+    switch(ubDS2484Phase)
+    {
+        case DS2484_SEQ_PHASE_COMMAND:
+        {
+            ubDS2484Phase = DS2484_SEQ_PHASE_POLL;
+
+            // Every command except Set Read Pointer leaves the read pointer at the status register
+            if(!ds2484_seq_submit(0, 1))
+                ds2484_seq_end(DS2484_SEQ_STATUS_FAIL);
+        }
+        return;
+        case DS2484_SEQ_PHASE_POLL:
+        {
+            if(ubDS2484Read & DS2484_STATUS_1WB)
+            {
+                if(now_ms() > ullDS2484Deadline || !ds2484_seq_submit(0, 1))
+                    ds2484_seq_end(DS2484_SEQ_STATUS_FAIL);
+
+                return;
+            }
+
+            switch(pStep->ubType)
+            {
+                case DS2484_STEP_RESET:
+                {
+                    if((ubDS2484Read & DS2484_STATUS_SD) || !(ubDS2484Read & DS2484_STATUS_PPD))
+                    {
+                        ds2484_seq_end(DS2484_SEQ_STATUS_FAIL);
+
+                        return;
+                    }
+                }
+                break;
+                case DS2484_STEP_READ_BYTE:
+                {
+                    ubDS2484Phase = DS2484_SEQ_PHASE_DATA;
+                    pubDS2484Write[0] = DS2484_CMD_SET_READ_PTR;
+                    pubDS2484Write[1] = DS2484_REG_DATA;
+
+                    if(!ds2484_seq_submit(2, 1))
+                        ds2484_seq_end(DS2484_SEQ_STATUS_FAIL);
+                }
+                return;
+                case DS2484_STEP_SINGLE_BIT:
+                {
+                    pStep->ubData = !!(ubDS2484Read & DS2484_STATUS_SBR);
+                }
+                break;
+                case DS2484_STEP_TRIPLET:
+                {
+                    pStep->ubData = ubDS2484Read;
+                }
+                break;
+            }
+        }
+        break;
+        case DS2484_SEQ_PHASE_DATA:
+        {
+            pStep->ubData = ubDS2484Read;
+        }
+        break;
+        case DS2484_SEQ_PHASE_CONFIG:
+        {
+            if(ubDS2484Read != ubDS2484NewConfig)
+            {
+                ds2484_seq_end(DS2484_SEQ_STATUS_FAIL);
+
+                return;
+            }
+
+            ubDS2484Config = ubDS2484NewConfig & ~DS2484_CONFIG_SPU;
+        }
+        break;
+    }
+
+    ubDS2484Step++;
+
+    ds2484_seq_next();
+}
+static uint8_t ds2484_run_step(uint8_t ubType, uint8_t *pubData)
+{
+    ds2484_seq_t xSeq;
+
+    ds2484_seq_init(&xSeq);
+    ds2484_seq_add(&xSeq, ubType, pubData ? *pubData : 0);
+
+    if(!ds2484_seq_run(&xSeq))
+        return 0;
+
+    if(pubData)
+        *pubData = xSeq.pxStep[0].ubData;
+
+    return 1;
+}
+
+uint8_t ds2484_init()
+{
+    if(!ds2484_device_reset())
+        return 0;
+
+    ubDS2484Config = 0;
+
+    return ds2484_write_config(DS2484_CONFIG_APU);
+}
+uint8_t ds2484_device_reset()
+{
+    if(!i2c0_write_byte(DS2484_I2C_ADDR, DS2484_CMD_DEVICE_RESET, I2C_STOP))
+        return 0;
+
+    uint8_t ubStatus;
+
+    if(!ds2484_wait_idle(&ubStatus))
+        return 0;
+
+    return !!(ubStatus & DS2484_STATUS_RST);
+}
+uint8_t ds2484_read_register(uint8_t ubRegister, uint8_t *pubValue)
+{
+    uint8_t ubBuf[2] = {DS2484_CMD_SET_READ_PTR, ubRegister};
+
+    return i2c0_write_read(DS2484_I2C_ADDR, ubBuf, 2, pubValue, 1);
+}
+uint8_t ds2484_write_config(uint8_t ubNewConfig)
+{
+    ubNewConfig &= 0x0F;
+
+    uint8_t ubBuf[2] = {DS2484_CMD_WRITE_CONFIG, (~ubNewConfig << 4) | ubNewConfig}; // Upper nibble must be the complement of the lower one
+
+    uint8_t ubReadback;
+
+    if(!i2c0_write_read(DS2484_I2C_ADDR, ubBuf, 2, &ubReadback, 1)) // The read pointer is left at the configuration register
+        return 0;
+
+    if(ubReadback != ubNewConfig)
+        return 0;
+
+    ubDS2484Config = ubNewConfig & ~DS2484_CONFIG_SPU;
+
+    return 1;
+}
+uint8_t ds2484_strong_pullup()
+{
+    return ds2484_run_step(DS2484_STEP_STRONG_PULLUP, NULL);
+}
+uint8_t ds2484_set_speed(uint8_t ubOverdrive)
+{
+    return ds2484_run_step(DS2484_STEP_SPEED, &ubOverdrive);
+}
+
+void ds2484_seq_init(ds2484_seq_t *pSeq)
+{
+    pSeq->ubCount = 0;
+    pSeq->ubStatus = DS2484_SEQ_STATUS_IDLE;
+}
+uint8_t ds2484_seq_add(ds2484_seq_t *pSeq, uint8_t ubType, uint8_t ubData)
+{
+    if(pSeq->ubStatus != DS2484_SEQ_STATUS_IDLE)
+        return 0;
+
+    if(pSeq->ubCount >= DS2484_SEQ_MAX_STEPS)
+    {
+        pSeq->ubStatus = DS2484_SEQ_STATUS_FAIL; // A truncated sequence must never run
+
+        return 0;
+    }
+
+    pSeq->pxStep[pSeq->ubCount].ubType = ubType;
+    pSeq->pxStep[pSeq->ubCount].ubData = ubData;
+    pSeq->ubCount++;
+
+    return 1;
+}
+uint8_t ds2484_seq_add_write(ds2484_seq_t *pSeq, const uint8_t *pubSrc, uint8_t ubCount)
+{
+    while(ubCount--)
+        if(!ds2484_seq_add(pSeq, DS2484_STEP_WRITE_BYTE, *pubSrc++))
+            return 0;
+
+    return 1;
+}
+uint8_t ds2484_seq_add_read(ds2484_seq_t *pSeq, uint8_t ubCount)
+{
+    while(ubCount--)
+        if(!ds2484_seq_add(pSeq, DS2484_STEP_READ_BYTE, 0))
+            return 0;
+
+    return 1;
+}
+uint8_t ds2484_seq_add_select(ds2484_seq_t *pSeq, const uint8_t *pubROM, uint8_t ubOverdrive)
+{
+    // A standard speed reset drops every device on the bus back to standard speed
+    if(!ds2484_seq_add(pSeq, DS2484_STEP_SPEED, 0))
+        return 0;
+
+    if(!ds2484_seq_add(pSeq, DS2484_STEP_RESET, 0))
+        return 0;
+
+    if(ubOverdrive)
+    {
+        if(!ds2484_seq_add(pSeq, DS2484_STEP_WRITE_BYTE, pubROM ? ONE_WIRE_CMD_OD_MATCH_ROM : ONE_WIRE_CMD_OD_SKIP_ROM))
+            return 0;
+
+        if(!ds2484_seq_add(pSeq, DS2484_STEP_SPEED, 1)) // The ROM and everything after it go at overdrive speed
+            return 0;
+    }
+    else if(!ds2484_seq_add(pSeq, DS2484_STEP_WRITE_BYTE, pubROM ? ONE_WIRE_CMD_MATCH_ROM : ONE_WIRE_CMD_SKIP_ROM))
+    {
+        return 0;
+    }
+
+    if(!pubROM)
+        return 1;
+
+    return ds2484_seq_add_write(pSeq, pubROM, 8);
+}
+uint8_t ds2484_seq_add_search(ds2484_seq_t *pSeq, const uint8_t *pubROM, int8_t bLastDiscrepancy)
+{
+    if(!ds2484_seq_add(pSeq, DS2484_STEP_SPEED, 0)) // Search always runs at standard speed
+        return 0;
+
+    if(!ds2484_seq_add(pSeq, DS2484_STEP_RESET, 0))
+        return 0;
+
+    if(!ds2484_seq_add(pSeq, DS2484_STEP_WRITE_BYTE, ONE_WIRE_CMD_SEARCH_ROM))
+        return 0;
+
+    // The DS2484 only takes the direction where the devices disagree, so the whole path is known up front
+    for(uint8_t i = 0; i < 64; i++)
+    {
+        uint8_t ubDirection;
+
+        if(i < bLastDiscrepancy)
+            ubDirection = !!(pubROM[i >> 3] & BIT(i & 7)); // Follow the previous path
+        else
+            ubDirection = (i == bLastDiscrepancy); // Take the 1 branch at the last discrepancy, 0 on new ones
+
+        if(!ds2484_seq_add(pSeq, DS2484_STEP_TRIPLET, ubDirection))
+            return 0;
+    }
+
+    return 1;
+}
+uint8_t ds2484_seq_get_search(const ds2484_seq_t *pSeq, uint8_t *pubROM, int8_t *pbDiscrepancy)
+{
+    if(pSeq->ubStatus != DS2484_SEQ_STATUS_DONE || pSeq->ubCount < 64)
+        return 0;
+
+    const ds2484_step_t *pTriplet = &pSeq->pxStep[pSeq->ubCount - 64];
+    int8_t bDiscrepancy = -1;
+
+    for(uint8_t i = 0; i < 64; i++)
+    {
+        uint8_t ubStatus = pTriplet[i].ubData;
+        uint8_t ubIdBit = !!(ubStatus & DS2484_STATUS_SBR);
+        uint8_t ubCmpBit = !!(ubStatus & DS2484_STATUS_TSB);
+
+        if(ubIdBit && ubCmpBit)
+            return 0; // No device answered
+
+        if(!ubIdBit && !ubCmpBit && !(ubStatus & DS2484_STATUS_DIR))
+            bDiscrepancy = i;
+
+        if(ubStatus & DS2484_STATUS_DIR)
+            pubROM[i >> 3] |= BIT(i & 7);
+        else
+            pubROM[i >> 3] &= ~BIT(i & 7);
+    }
+
+    *pbDiscrepancy = bDiscrepancy;
+
+    return 1;
+}
+uint8_t ds2484_seq_start(ds2484_seq_t *pSeq)
+{
+    if(!pSeq || !pSeq->ubCount || pSeq->ubStatus != DS2484_SEQ_STATUS_IDLE)
+        return 0;
+
+    if(pDS2484Seq) // Only cleared from the ISR, and only started from the main loop
+        return 0;
+
+    pSeq->ubStatus = DS2484_SEQ_STATUS_BUSY;
+    ubDS2484Step = 0;
+    pDS2484Seq = pSeq;
+
+    ds2484_seq_next();
+
+    return 1;
+}
+uint8_t ds2484_seq_busy()
+{
+    return !!pDS2484Seq;
+}
+uint8_t ds2484_seq_run(ds2484_seq_t *pSeq)
+{
+    while(pDS2484Seq)
+        i2c0_check_timeout();
+
+    if(!ds2484_seq_start(pSeq))
+        return 0;
+
+    while(pSeq->ubStatus == DS2484_SEQ_STATUS_BUSY)
+        i2c0_check_timeout();
+
+    return pSeq->ubStatus == DS2484_SEQ_STATUS_DONE;
+}
+
+uint8_t ds2484_one_wire_reset()
+{
+    return ds2484_run_step(DS2484_STEP_RESET, NULL);
+}
+uint8_t ds2484_one_wire_write_bit(uint8_t ubBit)
+{
+    return ds2484_run_step(DS2484_STEP_SINGLE_BIT, &ubBit);
+}
+uint8_t ds2484_one_wire_read_bit(uint8_t *pubBit)
+{
+    *pubBit = 1;
+
+    return ds2484_run_step(DS2484_STEP_SINGLE_BIT, pubBit);
+}
+uint8_t ds2484_one_wire_write_byte(uint8_t ubData)
+{
+    return ds2484_run_step(DS2484_STEP_WRITE_BYTE, &ubData);
+}
+uint8_t ds2484_one_wire_read_byte(uint8_t *pubData)
+{
+    return ds2484_run_step(DS2484_STEP_READ_BYTE, pubData);
+}
+uint8_t ds2484_one_wire_write(const uint8_t *pubSrc, uint32_t ulCount)
+{
+    ds2484_seq_t xSeq;
+
+    while(ulCount)
+    {
+        uint8_t ubChunk = ulCount > DS2484_SEQ_MAX_STEPS ? DS2484_SEQ_MAX_STEPS : ulCount;
+
+        ds2484_seq_init(&xSeq);
+        ds2484_seq_add_write(&xSeq, pubSrc, ubChunk);
+
+        if(!ds2484_seq_run(&xSeq))
+            return 0;
+
+        pubSrc += ubChunk;
+        ulCount -= ubChunk;
+    }
+
+    return 1;
+}
+uint8_t ds2484_one_wire_read(uint8_t *pubDst, uint32_t ulCount)
+{
+    ds2484_seq_t xSeq;
+
+    while(ulCount)
+    {
+        uint8_t ubChunk = ulCount > DS2484_SEQ_MAX_STEPS ? DS2484_SEQ_MAX_STEPS : ulCount;
+
+        ds2484_seq_init(&xSeq);
+        ds2484_seq_add_read(&xSeq, ubChunk);
+
+        if(!ds2484_seq_run(&xSeq))
+            return 0;
+
+        for(uint8_t i = 0; i < ubChunk; i++)
+            *pubDst++ = xSeq.pxStep[i].ubData;
+
+        ulCount -= ubChunk;
+    }
+
+    return 1;
+}
+uint8_t ds2484_one_wire_triplet(uint8_t ubDirection, uint8_t *pubStatus)
+{
+    if(!ds2484_run_step(DS2484_STEP_TRIPLET, &ubDirection))
+        return 0;
+
+    if(pubStatus)
+        *pubStatus = ubDirection;
+
+    return 1;
+}
+uint8_t ds2484_one_wire_select(const uint8_t *pubROM)
+{
+    return ds2484_one_wire_select_speed(pubROM, 0);
+}
+uint8_t ds2484_one_wire_select_speed(const uint8_t *pubROM, uint8_t ubOverdrive)
+{
+    ds2484_seq_t xSeq;
+
+    ds2484_seq_init(&xSeq);
+    ds2484_seq_add_select(&xSeq, pubROM, ubOverdrive);
+
+    return ds2484_seq_run(&xSeq);
+}
+uint8_t ds2484_one_wire_search(uint8_t (*pubROM)[8], uint8_t ubMaxDevices)
+{
+    ds2484_seq_t xSeq;
+    uint8_t ubROM[8] = {0};
+    uint8_t ubCount = 0;
+    int8_t bLastDiscrepancy = -1;
+
+    while(ubCount < ubMaxDevices)
+    {
+        ds2484_seq_init(&xSeq);
+        ds2484_seq_add_search(&xSeq, ubROM, bLastDiscrepancy);
+
+        if(!ds2484_seq_run(&xSeq))
+            break;
+
+        int8_t bDiscrepancy;
+
+        if(!ds2484_seq_get_search(&xSeq, ubROM, &bDiscrepancy))
+            break;
+
+        if(calc_crc8_maxim(ubROM, 7) == ubROM[7])
+        {
+            for(uint8_t i = 0; i < 8; i++)
+                pubROM[ubCount][i] = ubROM[i];
+
+            ubCount++;
+        }
+
+        if(bDiscrepancy < 0)
+            break; // Last device found
+
+        bLastDiscrepancy = bDiscrepancy;
+    }
+
+    return ubCount;
+}
@@ -0,0 +1,79 @@
+#include "fan_curve.h"
+
+uint8_t fan_curve_set(fan_curve_t *pCurve, const fan_curve_point_t *pPoints, uint8_t ubPointCount, uint16_t usHysteresis, uint16_t usMinDuty, uint16_t usMaxDuty)
+{
+    if(!pCurve)
+        return 0;
+
+    if(ubPointCount > FAN_CURVE_MAX_POINTS)
+        return 0;
+
+    if(ubPointCount && !pPoints)
+        return 0;
+
+    if(usMinDuty > usMaxDuty)
+        return 0;
+
+    for(uint8_t i = 1; i < ubPointCount; i++)
+        if(pPoints[i].sTemperature <= pPoints[i - 1].sTemperature)
+            return 0; // Points must be sorted by strictly increasing temperature
+
+    pCurve->ubPointCount = 0; // Disable while the points are being replaced
+
+    for(uint8_t i = 0; i < ubPointCount; i++)
+        pCurve->xPoint[i] = pPoints[i];
+
+    pCurve->usHysteresis = usHysteresis;
+    pCurve->usMinDuty = usMinDuty;
+    pCurve->usMaxDuty = usMaxDuty;
+    pCurve->ubPrimed = 0;
+    pCurve->ubPointCount = ubPointCount;
+
+    return 1;
+}
+uint16_t fan_curve_eval(fan_curve_t *pCurve, int16_t sTemperature)
+{
+    if(!pCurve || !pCurve->ubPointCount)
+        return 0;
+
+    // Rising temperatures are followed immediately, falling ones only once they drop past the hysteresis band
+    if(pCurve->ubPrimed && sTemperature < pCurve->sHeldTemperature && (int32_t)pCurve->sHeldTemperature - sTemperature < pCurve->usHysteresis)
+        sTemperature = pCurve->sHeldTemperature;
+
+    pCurve->sHeldTemperature = sTemperature;
+    pCurve->ubPrimed = 1;
+
+    const fan_curve_point_t *pPoint = pCurve->xPoint;
+    uint8_t ubLast = pCurve->ubPointCount - 1;
+    int32_t lDuty;
+
+    if(sTemperature <= pPoint[0].sTemperature)
+    {
+        lDuty = pPoint[0].usDuty;
+    }
+    else if(sTemperature >= pPoint[ubLast].sTemperature)
+    {
+        lDuty = pPoint[ubLast].usDuty;
+    }
+    else
+    {
+        uint8_t i = 0;
+
+        while(sTemperature >= pPoint[i + 1].sTemperature)
+            i++;
+
+        int32_t lSpan = (int32_t)pPoint[i + 1].sTemperature - pPoint[i].sTemperature;
+        int32_t lOffset = (int32_t)sTemperature - pPoint[i].sTemperature;
+        int32_t lRise = (int32_t)pPoint[i + 1].usDuty - pPoint[i].usDuty;
+
+        lDuty = pPoint[i].usDuty + (int32_t)((int64_t)lRise * lOffset / lSpan);
+    }
+
+    if(lDuty < pCurve->usMinDuty)
+        lDuty = pCurve->usMinDuty;
+
+    if(lDuty > pCurve->usMaxDuty)
+        lDuty = pCurve->usMaxDuty;
+
+    return lDuty;
+}
@@ -0,0 +1,95 @@
+#include "filter.h"
+
+uint8_t filter_config(filter_t *pFilter, uint8_t ubType, uint8_t ubParam)
+{
+    if(!pFilter)
+        return 0;
+
+    if(ubType == FILTER_TYPE_IIR && (ubParam < 1 || ubParam > FILTER_IIR_MAX_SHIFT))
+        return 0;
+
+    if(ubType == FILTER_TYPE_MOVING_AVERAGE && (ubParam < 2 || ubParam > FILTER_MA_MAX_WINDOW))
+        return 0;
+
+    if(ubType > FILTER_TYPE_MOVING_AVERAGE)
+        return 0;
+
+    pFilter->ubType = FILTER_TYPE_NONE; // Pass samples through while the state is rebuilt
+    pFilter->ubParam = ubParam;
+    pFilter->ubPrimed = 0;
+    pFilter->ubIndex = 0;
+    pFilter->ubFill = 0;
+    pFilter->ulState = 0;
+    pFilter->ubType = ubType;
+
+    return 1;
+}
+uint16_t filter_update(filter_t *pFilter, uint16_t usSample)
+{
+    switch(pFilter->ubType)
+    {
+        case FILTER_TYPE_IIR:
+        {
+            if(!pFilter->ubPrimed) // Start from the first sample instead of ramping up from 0
+            {
+                pFilter->ulState = (uint32_t)usSample << 8;
+                pFilter->ubPrimed = 1;
+            }
+
+            int32_t lError = ((int32_t)usSample << 8) - (int32_t)pFilter->ulState;
+
+            pFilter->ulState += lError >> pFilter->ubParam; // Arithmetic shift, rounds towards -inf
+
+            return (pFilter->ulState + 0x80) >> 8;
+        }
+        case FILTER_TYPE_MOVING_AVERAGE:
+        {
+            // Running sum, O(1) per sample whatever the window length
+            if(pFilter->ubFill < pFilter->ubParam)
+                pFilter->ubFill++;
+            else
+                pFilter->ulState -= pFilter->pusWindow[pFilter->ubIndex];
+
+            pFilter->pusWindow[pFilter->ubIndex] = usSample;
+            pFilter->ulState += usSample;
+
+            if(++pFilter->ubIndex >= pFilter->ubParam)
+                pFilter->ubIndex = 0;
+
+            return (pFilter->ulState + (pFilter->ubFill >> 1)) / pFilter->ubFill;
+        }
+        default:
+            return usSample;
+    }
+}
+
+void filter_stats_reset(filter_stats_t *pStats, uint8_t ubClearPeak)
+{
+    pStats->usMin = 0xFFFF;
+    pStats->usMax = 0;
+    pStats->ulCount = 0;
+    pStats->ullSum = 0;
+
+    if(ubClearPeak)
+    {
+        pStats->usPeak = 0;
+        pStats->usPeakMin = 0xFFFF;
+    }
+}
+void filter_stats_update(filter_stats_t *pStats, uint16_t usSample)
+{
+    if(usSample < pStats->usMin)
+        pStats->usMin = usSample;
+
+    if(usSample > pStats->usMax)
+        pStats->usMax = usSample;
+
+    if(usSample > pStats->usPeak)
+        pStats->usPeak = usSample;
+
+    if(usSample < pStats->usPeakMin)
+        pStats->usPeakMin = usSample;
+
+    pStats->ulCount++;
+    pStats->ullSum += usSample;
+}
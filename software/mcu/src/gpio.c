@@ -1,10 +1,14 @@
 #include "gpio.h"
 
-static void gpio_isr(uint32_t ulFlags)
-{
+static gpio_exti_isr_t ppfEXTIISR[16];
 
+static void RAM_CODE gpio_isr(uint32_t ulFlags)
+{
+    for(uint8_t i = 0; i < 16; i++)
+        if((ulFlags & BIT(i)) && ppfEXTIISR[i])
+            ppfEXTIISR[i](i);
 }
-void _gpio_even_isr()
+void RAM_CODE _gpio_even_isr()
 {
     uint32_t ulFlags = GPIO->IF;
 
@@ -12,7 +16,7 @@ void _gpio_even_isr()
 
     GPIO->IFC = 0x55555555; // Clear all even flags
 }
-void _gpio_odd_isr()
+void RAM_CODE _gpio_odd_isr()
 {
     uint32_t ulFlags = GPIO->IF;
 
@@ -65,12 +69,12 @@ void gpio_init()
     GPIO->P[1].MODEH  = GPIO_P_MODEH_MODE8_DISABLED         // NC
                       | GPIO_P_MODEH_MODE9_DISABLED         // NC
                       | GPIO_P_MODEH_MODE10_DISABLED        // NC
-                      | GPIO_P_MODEH_MODE11_DISABLED        // NU
+                      | GPIO_P_MODEH_MODE11_INPUTPULLFILTER // TACH0
                       | GPIO_P_MODEH_MODE12_DISABLED        // VEXT_VSENSE
-                      | GPIO_P_MODEH_MODE13_DISABLED        // NU
-                      | GPIO_P_MODEH_MODE14_DISABLED        // NU
+                      | GPIO_P_MODEH_MODE13_INPUTPULLFILTER // TACH1
+                      | GPIO_P_MODEH_MODE14_INPUTPULLFILTER // TACH2
                       | GPIO_P_MODEH_MODE15_PUSHPULL;       // PWM6 - TIM1_CC3 Location 7
-    GPIO->P[1].DOUT   = 0;
+    GPIO->P[1].DOUT   = BIT(11) | BIT(13) | BIT(14);
     GPIO->P[1].OVTDIS = BIT(12);
 
     // Port C
@@ -156,10 +160,10 @@ void gpio_init()
     GPIO->EXTIPSELH = GPIO_EXTIPSELH_EXTIPSEL8_PORTA            // NU
                     | GPIO_EXTIPSELH_EXTIPSEL9_PORTA            // NU
                     | GPIO_EXTIPSELH_EXTIPSEL10_PORTA           // NU
-                    | GPIO_EXTIPSELH_EXTIPSEL11_PORTA           // NU
+                    | GPIO_EXTIPSELH_EXTIPSEL11_PORTB           // TACH0
                     | GPIO_EXTIPSELH_EXTIPSEL12_PORTA           // NU
-                    | GPIO_EXTIPSELH_EXTIPSEL13_PORTA           // NU
-                    | GPIO_EXTIPSELH_EXTIPSEL14_PORTA           // NU
+                    | GPIO_EXTIPSELH_EXTIPSEL13_PORTB           // TACH1
+                    | GPIO_EXTIPSELH_EXTIPSEL14_PORTB           // TACH2
                     | GPIO_EXTIPSELH_EXTIPSEL15_PORTA;          // NU
 
     GPIO->EXTIPINSELL = GPIO_EXTIPINSELL_EXTIPINSEL0_PIN0       // NU
@@ -173,14 +177,14 @@ void gpio_init()
     GPIO->EXTIPINSELH = GPIO_EXTIPINSELH_EXTIPINSEL8_PIN8       // NU
                       | GPIO_EXTIPINSELH_EXTIPINSEL9_PIN8       // NU
                       | GPIO_EXTIPINSELH_EXTIPINSEL10_PIN8      // NU
-                      | GPIO_EXTIPINSELH_EXTIPINSEL11_PIN8      // NU
+                      | GPIO_EXTIPINSELH_EXTIPINSEL11_PIN11     // TACH0
                       | GPIO_EXTIPINSELH_EXTIPINSEL12_PIN12     // NU
-                      | GPIO_EXTIPINSELH_EXTIPINSEL13_PIN12     // NU
-                      | GPIO_EXTIPINSELH_EXTIPINSEL14_PIN12     // NU
+                      | GPIO_EXTIPINSELH_EXTIPINSEL13_PIN13     // TACH1
+                      | GPIO_EXTIPINSELH_EXTIPINSEL14_PIN14     // TACH2
                       | GPIO_EXTIPINSELH_EXTIPINSEL15_PIN12;    // NU
 
     GPIO->EXTIRISE = 0; // 
-    GPIO->EXTIFALL = 0; // 
+    GPIO->EXTIFALL = BIT(11) | BIT(13) | BIT(14); // Open drain tach outputs pull low once per pulse
 
     GPIO->IFC = _GPIO_IFC_MASK; // Clear pending IRQs
     IRQ_CLEAR(GPIO_EVEN_IRQn); // Clear pending vector
@@ -189,5 +193,22 @@ void gpio_init()
     IRQ_SET_PRIO(GPIO_ODD_IRQn, 0, 0); // Set priority 0,0 (max)
     IRQ_ENABLE(GPIO_EVEN_IRQn); // Enable vector
     IRQ_ENABLE(GPIO_ODD_IRQn); // Enable vector
-    GPIO->IEN = 0; // Enable interrupts
+    GPIO->IEN = 0; // Enabled per line by gpio_set_exti_isr
+}
+void gpio_set_exti_isr(uint8_t ubLine, gpio_exti_isr_t pfISR)
+{
+    if(ubLine > 15)
+        return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ppfEXTIISR[ubLine] = pfISR;
+
+        GPIO->IFC = BIT(ubLine);
+
+        if(pfISR)
+            GPIO->IEN |= BIT(ubLine);
+        else
+            GPIO->IEN &= ~BIT(ubLine);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include "history.h"
+
+typedef struct
+{
+    history_block_t *pBlocks;
+    uint8_t ubBlocks;
+    uint8_t ubFirst; // Oldest block
+    uint8_t ubUsed;
+    uint8_t ubDecimation; // Samples of the tier below averaged into one of this tier
+    uint16_t usPeriod; // s
+    uint8_t ubPending; // Samples of the tier below accumulated so far
+    uint32_t ulPendingTime; // s, of the first of them
+    int32_t plSum[HISTORY_FIELDS];
+    uint8_t pubValid[HISTORY_FIELDS]; // Accumulated samples that had a value in this field
+    int16_t psLast[HISTORY_FIELDS]; // Last stored sample, deltas are taken against it
+} history_tier_t;
+
+#define HISTORY_RECORD_MAX_SIZE     (5 + 3 * HISTORY_FIELDS) // A full bitmap and 16 bit deltas everywhere
+
+static const uint8_t pubHistoryTierBlocks[HISTORY_TIERS] = {0, HISTORY_TIER1_BLOCKS}; // Tier 0 is kept in slots instead
+static const uint8_t pubHistoryTierDecimation[HISTORY_TIERS] = {1, HISTORY_TIER1_DECIMATION};
+
+static history_block_t pxHistoryBlock[HISTORY_TIER1_BLOCKS];
+static history_tier_t pxHistoryTier[HISTORY_TIERS];
+
+static int16_t psHistorySlot[HISTORY_TIER0_SAMPLES][HISTORY_FIELDS];
+static uint8_t pubHistorySlotBlock[(HISTORY_TIER0_SAMPLES + 7) / 8]; // Slots that start a readout block, at least 4 samples per block even when every field changes
+static uint16_t usHistorySlotFirst = 0; // Oldest slot
+static uint16_t usHistorySlotUsed = 0;
+static uint16_t usHistorySlotBlockSize = 0; // Bytes of deltas the newest readout block holds so far
+static uint32_t ulHistorySlotTime = 0; // s, of the newest slot
+
+static void history_tier_push(uint8_t ubTier, uint32_t ulTime, const int16_t *psSample);
+
+static uint8_t history_put_varint(uint8_t *pubDst, uint32_t ulValue)
+{
+    uint8_t ubSize = 0;
+
+    do
+    {
+        pubDst[ubSize++] = (ulValue & 0x7F) | (ulValue > 0x7F ? 0x80 : 0x00);
+
+        ulValue >>= 7;
+    } while(ulValue);
+
+    return ubSize;
+}
+static uint8_t history_encode(uint8_t *pubRecord, const int16_t *psLast, const int16_t *psSample)
+{
+    uint32_t ulChanged = 0;
+
+    for(uint8_t i = 0; i < HISTORY_FIELDS; i++)
+        if(psSample[i] != psLast[i])
+            ulChanged |= 1UL << i;
+
+    uint8_t ubSize = history_put_varint(pubRecord, ulChanged);
+
+    for(uint8_t i = 0; i < HISTORY_FIELDS; i++)
+    {
+        if(!(ulChanged & (1UL << i)))
+            continue;
+
+        int16_t sDelta = (uint16_t)psSample[i] - (uint16_t)psLast[i]; // Wraps, the host adds it back modulo 2^16
+
+        ubSize += history_put_varint(&pubRecord[ubSize], (uint16_t)(((uint16_t)sDelta << 1) ^ (uint16_t)(sDelta >> 15))); // Zigzag, small deltas of either sign fit in one byte
+    }
+
+    return ubSize;
+}
+static uint8_t history_append(history_block_t *pBlock, const int16_t *psLast, const int16_t *psSample)
+{
+    uint8_t pubRecord[HISTORY_RECORD_MAX_SIZE];
+    uint8_t ubSize = history_encode(pubRecord, psLast, psSample);
+
+    if(pBlock->usSize + ubSize > sizeof(pBlock->ubData))
+        return 0;
+
+    memcpy(&pBlock->ubData[pBlock->usSize], pubRecord, ubSize);
+
+    pBlock->usSize += ubSize;
+    pBlock->usCount++;
+
+    return 1;
+}
+static void history_start_block(history_block_t *pBlock, uint32_t ulTime, const int16_t *psSample)
+{
+    pBlock->ulTime = ulTime;
+    pBlock->usCount = 1;
+    pBlock->usSize = 0;
+
+    memcpy(pBlock->psKey, psSample, sizeof(pBlock->psKey));
+}
+static void history_new_block(history_tier_t *pTier, uint32_t ulTime, const int16_t *psSample)
+{
+    if(pTier->ubUsed < pTier->ubBlocks)
+        pTier->ubUsed++;
+    else if(++pTier->ubFirst >= pTier->ubBlocks) // Full, the oldest block is dropped
+        pTier->ubFirst = 0;
+
+    history_start_block(&pTier->pBlocks[(pTier->ubFirst + pTier->ubUsed - 1) % pTier->ubBlocks], ulTime, psSample);
+}
+static void history_slot_store(const int16_t *psSample)
+{
+    uint16_t usSlot = (usHistorySlotFirst + usHistorySlotUsed) % HISTORY_TIER0_SAMPLES;
+
+    if(usHistorySlotUsed < HISTORY_TIER0_SAMPLES)
+        usHistorySlotUsed++;
+    else if(++usHistorySlotFirst >= HISTORY_TIER0_SAMPLES) // Full, the oldest slot is overwritten
+        usHistorySlotFirst = 0;
+
+    // Readout blocks are cut as the samples come in, so they stay put while the ring moves
+    uint8_t pubRecord[HISTORY_RECORD_MAX_SIZE];
+    uint8_t ubSize = usHistorySlotUsed > 1 ? history_encode(pubRecord, psHistorySlot[(usSlot + HISTORY_TIER0_SAMPLES - 1) % HISTORY_TIER0_SAMPLES], psSample) : 0;
+
+    if(usHistorySlotUsed == 1 || usHistorySlotBlockSize + ubSize > sizeof(((history_block_t *)0)->ubData))
+    {
+        pubHistorySlotBlock[usSlot >> 3] |= (1 << (usSlot & 7));
+        usHistorySlotBlockSize = 0;
+    }
+    else
+    {
+        pubHistorySlotBlock[usSlot >> 3] &= ~(1 << (usSlot & 7));
+        usHistorySlotBlockSize += ubSize;
+    }
+
+    memcpy(psHistorySlot[usSlot], psSample, sizeof(psHistorySlot[usSlot]));
+}
+static void history_slot_push(uint32_t ulTime, const int16_t *psSample)
+{
+    if(usHistorySlotUsed && ulTime <= ulHistorySlotTime) // Time went back, what is there can't be placed anymore
+        usHistorySlotUsed = 0;
+
+    if(usHistorySlotUsed)
+    {
+        // Slots have no time of their own, skipped periods are filled with samples without values
+        uint32_t ulSkipped = (ulTime - ulHistorySlotTime) / HISTORY_TIER0_PERIOD - 1;
+        int16_t psInvalid[HISTORY_FIELDS];
+
+        if(ulSkipped > HISTORY_TIER0_SAMPLES)
+            ulSkipped = HISTORY_TIER0_SAMPLES;
+
+        for(uint8_t i = 0; i < HISTORY_FIELDS; i++)
+            psInvalid[i] = HISTORY_INVALID;
+
+        for(uint32_t i = 0; i < ulSkipped; i++)
+            history_slot_store(psInvalid);
+    }
+
+    history_slot_store(psSample);
+
+    ulHistorySlotTime = ulTime;
+}
+static uint8_t history_slot_starts_block(uint16_t usIndex)
+{
+    uint16_t usSlot = (usHistorySlotFirst + usIndex) % HISTORY_TIER0_SAMPLES;
+
+    return !usIndex || (pubHistorySlotBlock[usSlot >> 3] & (1 << (usSlot & 7))); // The oldest slot always does, even when the rest of its block was overwritten
+}
+static uint8_t history_slot_get_block_count()
+{
+    uint8_t ubCount = 0;
+
+    for(uint16_t i = 0; i < usHistorySlotUsed; i++)
+        if(history_slot_starts_block(i))
+            ubCount++;
+
+    return ubCount;
+}
+static uint8_t history_slot_get_block(uint8_t ubBlock, history_block_t *pBlock)
+{
+    if(!usHistorySlotUsed)
+        return 0;
+
+    uint16_t usStart = 0;
+    uint16_t usEnd;
+
+    for(usEnd = 1; usEnd < usHistorySlotUsed; usEnd++)
+    {
+        if(!history_slot_starts_block(usEnd))
+            continue;
+
+        if(!ubBlock)
+            break;
+
+        ubBlock--;
+        usStart = usEnd;
+    }
+
+    if(ubBlock)
+        return 0;
+
+    history_start_block(pBlock, ulHistorySlotTime - (uint32_t)(usHistorySlotUsed - 1 - usStart) * HISTORY_TIER0_PERIOD, psHistorySlot[(usHistorySlotFirst + usStart) % HISTORY_TIER0_SAMPLES]);
+
+    for(uint16_t i = usStart + 1; i < usEnd; i++)
+        if(!history_append(pBlock, psHistorySlot[(usHistorySlotFirst + i - 1) % HISTORY_TIER0_SAMPLES], psHistorySlot[(usHistorySlotFirst + i) % HISTORY_TIER0_SAMPLES]))
+            break; // Can't happen, the block was sized when the samples came in
+
+    return 1;
+}
+static void history_flush_window(uint8_t ubTier)
+{
+    history_tier_t *pTier = &pxHistoryTier[ubTier];
+
+    if(!pTier->ubPending)
+        return;
+
+    int16_t psAverage[HISTORY_FIELDS];
+
+    for(uint8_t i = 0; i < HISTORY_FIELDS; i++)
+        psAverage[i] = pTier->pubValid[i] ? pTier->plSum[i] / pTier->pubValid[i] : HISTORY_INVALID;
+
+    pTier->ubPending = 0;
+
+    memset(pTier->plSum, 0, sizeof(pTier->plSum));
+    memset(pTier->pubValid, 0, sizeof(pTier->pubValid));
+
+    history_tier_push(ubTier, pTier->ulPendingTime, psAverage);
+}
+static void history_tier_push(uint8_t ubTier, uint32_t ulTime, const int16_t *psSample)
+{
+    history_tier_t *pTier = &pxHistoryTier[ubTier];
+
+    if(!ubTier)
+    {
+        history_slot_push(ulTime, psSample);
+    }
+    else
+    {
+        history_block_t *pBlock = pTier->ubUsed ? &pTier->pBlocks[(pTier->ubFirst + pTier->ubUsed - 1) % pTier->ubBlocks] : NULL;
+
+        // Gaps have no encoding, the sample after one starts a new key frame
+        if(!pBlock || ulTime != pBlock->ulTime + (uint32_t)pBlock->usCount * pTier->usPeriod || !history_append(pBlock, pTier->psLast, psSample))
+            history_new_block(pTier, ulTime, psSample);
+
+        memcpy(pTier->psLast, psSample, sizeof(pTier->psLast));
+    }
+
+    if(ubTier + 1 >= HISTORY_TIERS)
+        return;
+
+    history_tier_t *pNext = &pxHistoryTier[ubTier + 1];
+
+    if(pNext->ubPending && ulTime != pNext->ulPendingTime + (uint32_t)pNext->ubPending * pTier->usPeriod) // A gap here cuts the window of the next tier short
+        history_flush_window(ubTier + 1);
+
+    if(!pNext->ubPending)
+        pNext->ulPendingTime = ulTime;
+
+    for(uint8_t i = 0; i < HISTORY_FIELDS; i++)
+    {
+        if(psSample[i] == HISTORY_INVALID)
+            continue;
+
+        pNext->plSum[i] += psSample[i];
+        pNext->pubValid[i]++;
+    }
+
+    if(++pNext->ubPending >= pNext->ubDecimation)
+        history_flush_window(ubTier + 1);
+}
+
+void history_init()
+{
+    history_block_t *pBlocks = pxHistoryBlock;
+
+    memset(pxHistoryTier, 0, sizeof(pxHistoryTier));
+
+    usHistorySlotFirst = 0;
+    usHistorySlotUsed = 0;
+
+    for(uint8_t i = 0; i < HISTORY_TIERS; i++)
+    {
+        pxHistoryTier[i].pBlocks = pBlocks;
+        pxHistoryTier[i].ubBlocks = pubHistoryTierBlocks[i];
+        pxHistoryTier[i].ubDecimation = pubHistoryTierDecimation[i];
+        pxHistoryTier[i].usPeriod = i ? pxHistoryTier[i - 1].usPeriod * pubHistoryTierDecimation[i] : HISTORY_TIER0_PERIOD;
+
+        pBlocks += pubHistoryTierBlocks[i];
+    }
+}
+void history_push(uint32_t ulTime, const int16_t *psSample)
+{
+    if(!psSample)
+        return;
+
+    history_tier_push(0, ulTime, psSample);
+}
+uint8_t history_get_block_count(uint8_t ubTier)
+{
+    if(ubTier >= HISTORY_TIERS)
+        return 0;
+
+    if(!ubTier)
+        return history_slot_get_block_count();
+
+    return pxHistoryTier[ubTier].ubUsed;
+}
+uint8_t history_get_block(uint8_t ubTier, uint8_t ubBlock, history_block_t *pBlock)
+{
+    if(ubTier >= HISTORY_TIERS || !pBlock)
+        return 0;
+
+    if(!ubTier)
+        return history_slot_get_block(ubBlock, pBlock);
+
+    history_tier_t *pTier = &pxHistoryTier[ubTier];
+
+    if(ubBlock >= pTier->ubUsed)
+        return 0;
+
+    memcpy(pBlock, &pTier->pBlocks[(pTier->ubFirst + ubBlock) % pTier->ubBlocks], sizeof(history_block_t));
+
+    return 1;
+}
+uint16_t history_get_period(uint8_t ubTier)
+{
+    if(ubTier >= HISTORY_TIERS)
+        return 0;
+
+    return pxHistoryTier[ubTier].usPeriod;
+}
@@ -1,128 +1,498 @@
 #include "i2c.h"
 
-void i2c0_init(uint8_t ubMode, uint8_t ubSCLLocation, uint8_t ubSDALocation)
+#define I2C_STATE_IDLE  0
+#define I2C_STATE_ADDR  1 // Waiting for the address ACK
+#define I2C_STATE_WRITE 2 // Waiting for a data byte ACK
+#define I2C_STATE_READ  3 // Waiting for a data byte
+#define I2C_STATE_STOP  4 // Waiting for the STOP condition to be sent
+#define I2C_STATE_WRITE_DMA 5 // LDMA feeding TXDATA, waiting for the last byte to be shifted out
+#define I2C_STATE_READ_DMA  6 // LDMA draining RXDATA with auto ACK, the last two bytes are read by the CPU
+#define I2C_STATE_RECOVER   7 // Failed, the bus is recovered by i2c0_check_timeout from thread context
+
+#define I2C_IEN_DEFAULT (I2C_IEN_ACK | I2C_IEN_NACK | I2C_IEN_RXDATAV | I2C_IEN_MSTOP | I2C_IEN_ARBLOST | I2C_IEN_BUSERR | I2C_IEN_CLTO)
+
+// Pin of each I2C0 location (port << 4 | pin), SDA uses the location directly, SCL is offset by one
+static const uint8_t pubLocationPin[32] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x26, 0x27, 0x28, 0x29, 0x2A,
+    0x2B, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57
+};
+
+static uint8_t ubSCLPin;
+static uint8_t ubSDAPin;
+
+static i2c_transfer_t * volatile pI2C0Head = NULL;
+static i2c_transfer_t * volatile pI2C0Tail = NULL;
+static volatile uint8_t ubI2C0State = I2C_STATE_IDLE;
+static volatile uint8_t ubI2C0ReadPhase = 0;
+static volatile uint32_t ulI2C0Index = 0;
+static volatile uint8_t ubI2C0Result = I2C_TRANSFER_STATUS_DONE;
+static volatile uint8_t ubI2C0DMAError = 0;
+static ldma_descriptor_t __attribute__ ((aligned (4))) pxI2C0DMADescriptor[2];
+static const uint32_t ulI2C0AutoAck = I2C_CTRL_AUTOACK; // Written to the CTRL clear alias by the LDMA at the end of a read
+
+static void i2c0_recovery_delay()
 {
-    if(ubSCLLocation > AFCHANLOC_MAX)
+    for(uint32_t i = 0; i < HFCORE_CLOCK_FREQ / 400000; i++) // At least 2.5 us, SCL runs well below 100 kHz
+        __NOP();
+}
+static void i2c0_dma_start(uint8_t ubChannel, volatile void *pSrc, volatile void *pDst, uint32_t ulCount)
+{
+    pxI2C0DMADescriptor[0].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_SIZE_BYTE | LDMA_CH_CTRL_REQMODE_BLOCK | LDMA_CH_CTRL_BLOCKSIZE_UNIT1 | (((ulCount - 1) << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+    pxI2C0DMADescriptor[0].SRC = pSrc;
+    pxI2C0DMADescriptor[0].DST = pDst;
+
+    if(ubChannel == I2C0_DMA_TX_CHANNEL)
+    {
+        pxI2C0DMADescriptor[0].CTRL |= LDMA_CH_CTRL_SRCINC_ONE | LDMA_CH_CTRL_DSTINC_NONE | LDMA_CH_CTRL_DONEIFSEN;
+        pxI2C0DMADescriptor[0].LINK = 0;
+    }
+    else
+    {
+        pxI2C0DMADescriptor[0].CTRL |= LDMA_CH_CTRL_SRCINC_NONE | LDMA_CH_CTRL_DSTINC_ONE;
+        pxI2C0DMADescriptor[0].LINK = (uint32_t)&pxI2C0DMADescriptor[1] | LDMA_CH_LINK_LINK;
+
+        // Runs as soon as it is loaded, right after the last DMA byte, so the next byte already waits for a manual ACK whatever the interrupt latency
+        pxI2C0DMADescriptor[1].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_SIZE_WORD | LDMA_CH_CTRL_SRCINC_NONE | LDMA_CH_CTRL_DSTINC_NONE | LDMA_CH_CTRL_REQMODE_BLOCK | LDMA_CH_CTRL_DONEIFSEN | LDMA_CH_CTRL_STRUCTREQ | LDMA_CH_CTRL_BLOCKSIZE_UNIT1 | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+        pxI2C0DMADescriptor[1].SRC = (void *)&ulI2C0AutoAck;
+        pxI2C0DMADescriptor[1].DST = (void *)PERI_REG_BIT_CLEAR_ADDR(&I2C0->CTRL);
+        pxI2C0DMADescriptor[1].LINK = 0;
+    }
+
+    ldma_ch_load(ubChannel, pxI2C0DMADescriptor);
+    ldma_ch_peri_req_enable(ubChannel);
+    ldma_ch_enable(ubChannel);
+}
+static void i2c0_dma_stop()
+{
+    ldma_ch_disable(I2C0_DMA_TX_CHANNEL);
+    ldma_ch_peri_req_disable(I2C0_DMA_TX_CHANNEL);
+    ldma_ch_disable(I2C0_DMA_RX_CHANNEL);
+    ldma_ch_peri_req_disable(I2C0_DMA_RX_CHANNEL);
+
+    I2C0->CTRL &= ~I2C_CTRL_AUTOACK;
+    I2C0->IEN = I2C_IEN_DEFAULT;
+
+    ubI2C0DMAError = 0;
+}
+static void i2c0_dma_tx_isr(uint8_t ubError)
+{
+    if(ubI2C0State != I2C_STATE_WRITE_DMA)
         return;
 
-    if(ubSDALocation > AFCHANLOC_MAX)
+    if(ubError)
+    {
+        ubI2C0DMAError = 1;
+
+        IRQ_SET(I2C0_IRQn); // Let the I2C ISR recover the bus
+
         return;
+    }
 
-    CMU->HFPERCLKEN0 |= CMU_HFPERCLKEN0_I2C0;
+    // The last byte is still waiting in TXDATA, catch the end of its ACK cycle
+    I2C0->IFC = I2C_IFC_TXC;
+    I2C0->IEN |= I2C_IEN_TXC;
+}
+static void i2c0_dma_rx_isr(uint8_t ubError)
+{
+    if(ubI2C0State != I2C_STATE_READ_DMA)
+        return;
 
-    I2C0->CTRL = I2C_CTRL_CLHR_STANDARD | I2C_CTRL_TXBIL_EMPTY;
-    I2C0->ROUTEPEN = I2C_ROUTEPEN_SCLPEN | I2C_ROUTEPEN_SDAPEN;
-    I2C0->ROUTELOC0 = ((uint32_t)ubSCLLocation << _I2C_ROUTELOC0_SCLLOC_SHIFT) | ((uint32_t)ubSDALocation << _I2C_ROUTELOC0_SDALOC_SHIFT);
+    I2C0->CTRL &= ~I2C_CTRL_AUTOACK; // Already cleared by the second descriptor unless the LDMA failed
 
-    if(ubMode == I2C_NORMAL)
-        I2C0->CLKDIV = (((HFPER_CLOCK_FREQ / 100000) - 8) / 8) - 1;
-    else if(ubMode == I2C_FAST)
-        I2C0->CLKDIV = (((HFPER_CLOCK_FREQ / 400000) - 8) / 8) - 1;
+    if(ubError)
+    {
+        ubI2C0DMAError = 1;
+
+        IRQ_SET(I2C0_IRQn);
+
+        return;
+    }
+
+    // The bus is held on the second to last byte until it is ACKed, the last one gets the NACK
+    ulI2C0Index = pI2C0Head->ulReadCount - 2;
+    ubI2C0State = I2C_STATE_READ;
+
+    I2C0->IEN = I2C_IEN_DEFAULT;
+}
+static void i2c0_bus_recover()
+{
+    volatile uint32_t *pulSCLDOUT = &GPIO->P[ubSCLPin >> 4].DOUT;
+    volatile uint32_t *pulSDADOUT = &GPIO->P[ubSDAPin >> 4].DOUT;
 
-    I2C0->CTRL |= I2C_CTRL_EN;
     I2C0->CMD = I2C_CMD_ABORT;
+    I2C0->ROUTEPEN = 0; // Hand the pins back to the GPIO, they are open drain
 
-    while(I2C0->STATE & I2C_STATE_BUSY);
+    PERI_REG_BIT_SET(pulSDADOUT) = BIT(ubSDAPin & 0xF);
+    PERI_REG_BIT_SET(pulSCLDOUT) = BIT(ubSCLPin & 0xF);
+
+    i2c0_recovery_delay();
+
+    // Clock out whatever byte a slave is stuck in the middle of, until it releases SDA
+    for(uint8_t i = 0; i < I2C_RECOVERY_CLOCKS; i++)
+    {
+        if(GPIO->P[ubSDAPin >> 4].DIN & BIT(ubSDAPin & 0xF))
+            break;
+
+        PERI_REG_BIT_CLEAR(pulSCLDOUT) = BIT(ubSCLPin & 0xF);
+        i2c0_recovery_delay();
+        PERI_REG_BIT_SET(pulSCLDOUT) = BIT(ubSCLPin & 0xF);
+        i2c0_recovery_delay();
+    }
+
+    // Manual STOP condition
+    PERI_REG_BIT_CLEAR(pulSCLDOUT) = BIT(ubSCLPin & 0xF);
+    i2c0_recovery_delay();
+    PERI_REG_BIT_CLEAR(pulSDADOUT) = BIT(ubSDAPin & 0xF);
+    i2c0_recovery_delay();
+    PERI_REG_BIT_SET(pulSCLDOUT) = BIT(ubSCLPin & 0xF);
+    i2c0_recovery_delay();
+    PERI_REG_BIT_SET(pulSDADOUT) = BIT(ubSDAPin & 0xF);
+    i2c0_recovery_delay();
+
+    I2C0->ROUTEPEN = I2C_ROUTEPEN_SCLPEN | I2C_ROUTEPEN_SDAPEN;
+    I2C0->CMD = I2C_CMD_ABORT;
 }
-uint8_t i2c0_transmit(uint8_t ubAddress, uint8_t *pubSrc, uint32_t ulCount, uint8_t ubStop)
+static void i2c0_fail(uint8_t ubStatus)
+{
+    i2c0_dma_stop();
+
+    I2C0->CMD = I2C_CMD_ABORT;
+    I2C0->IEN = 0;
+
+    // Bit-banging the bus free takes a few hundred us, the transfer is finished once that is done
+    ubI2C0Result = ubStatus;
+    ubI2C0State = I2C_STATE_RECOVER;
+}
+static void i2c0_start(i2c_transfer_t *pTransfer)
 {
+    pTransfer->ubStatus = I2C_TRANSFER_STATUS_BUSY;
+    pTransfer->ullDeadline = now_ms() + (pTransfer->ulTimeout ? pTransfer->ulTimeout : I2C_DEFAULT_TIMEOUT_MS);
+
+    ubI2C0ReadPhase = !pTransfer->ulWriteCount && pTransfer->ulReadCount; // Pure reads skip the write phase
+    ulI2C0Index = 0;
+    ubI2C0Result = I2C_TRANSFER_STATUS_DONE;
+    ubI2C0State = I2C_STATE_ADDR;
+
+    I2C0->CMD = I2C_CMD_CLEARPC | I2C_CMD_CLEARTX;
+
+    if(I2C0->IF & I2C_IF_RXDATAV)
+        REG_DISCARD(&I2C0->RXDATA);
+
     I2C0->IFC = _I2C_IFC_MASK;
+    I2C0->CMD = I2C_CMD_START; // Repeated start if the bus is still held by a NO_STOP transfer
+    I2C0->TXDATA = (pTransfer->ubAddress << 1) | ubI2C0ReadPhase;
+}
+static void i2c0_finish(uint8_t ubStatus)
+{
+    i2c_transfer_t *pTransfer = pI2C0Head;
+
+    i2c0_dma_stop();
+
+    ubI2C0State = I2C_STATE_IDLE;
+
+    if(!pTransfer)
+        return;
 
-    I2C0->CMD = I2C_CMD_START;
+    pI2C0Head = pTransfer->pNext;
 
-    while(!(I2C0->IF & (I2C_IF_START | I2C_IF_RSTART | I2C_IF_ARBLOST | I2C_IF_BUSERR)));
+    if(!pI2C0Head)
+        pI2C0Tail = NULL;
 
-    if(I2C0->IF & (I2C_IF_ARBLOST | I2C_IF_BUSERR))
+    pTransfer->pNext = NULL;
+    pTransfer->ubStatus = ubStatus;
+
+    if(pTransfer->pfCallback)
+        pTransfer->pfCallback(pTransfer);
+
+    if(pI2C0Head && ubI2C0State == I2C_STATE_IDLE) // The callback may have already started the next one
+        i2c0_start(pI2C0Head);
+}
+static void i2c0_end(uint8_t ubStatus)
+{
+    if(ubStatus == I2C_TRANSFER_STATUS_DONE && (pI2C0Head->ubFlags & I2C_TRANSFER_FLAG_NO_STOP))
     {
-        I2C0->CMD = I2C_CMD_ABORT;
+        i2c0_finish(ubStatus);
 
-        return 0;
+        return;
     }
 
-    I2C0->TXDATA = ubAddress;
+    ubI2C0Result = ubStatus;
+    ubI2C0State = I2C_STATE_STOP;
 
-    while(!(I2C0->IF & (I2C_IF_ACK | I2C_IF_NACK | I2C_IF_ARBLOST | I2C_IF_BUSERR)));
+    I2C0->CMD = I2C_CMD_STOP;
+}
+static void i2c0_next_byte()
+{
+    i2c_transfer_t *pTransfer = pI2C0Head;
 
-    if(I2C0->IF & (I2C_IF_ARBLOST | I2C_IF_BUSERR))
+    if(!ulI2C0Index && pTransfer->ulWriteCount >= I2C_DMA_THRESHOLD && pTransfer->ulWriteCount <= I2C_DMA_MAX_XFERS)
     {
-        I2C0->CMD = I2C_CMD_ABORT;
+        ubI2C0State = I2C_STATE_WRITE_DMA;
+        ulI2C0Index = pTransfer->ulWriteCount;
 
-        return 0;
+        I2C0->IEN &= ~I2C_IEN_ACK; // Only NACKs matter until the LDMA is done
+
+        i2c0_dma_start(I2C0_DMA_TX_CHANNEL, pTransfer->pubWrite, &I2C0->TXDATA, pTransfer->ulWriteCount);
+    }
+    else if(ulI2C0Index < pTransfer->ulWriteCount)
+    {
+        ubI2C0State = I2C_STATE_WRITE;
+
+        I2C0->TXDATA = pTransfer->pubWrite[ulI2C0Index++];
     }
-    else if(I2C0->IF & I2C_IF_NACK)
+    else if(pTransfer->ulReadCount)
     {
-        I2C0->CMD = I2C_CMD_STOP;
+        ubI2C0ReadPhase = 1;
+        ulI2C0Index = 0;
+        ubI2C0State = I2C_STATE_ADDR;
 
-        while(I2C0->IFC & (I2C_IFC_MSTOP | I2C_IFC_ARBLOST | I2C_IF_BUSERR));
+        I2C0->CMD = I2C_CMD_START;
+        I2C0->TXDATA = (pTransfer->ubAddress << 1) | 1;
+    }
+    else
+    {
+        i2c0_end(I2C_TRANSFER_STATUS_DONE);
+    }
+}
 
-        if(I2C0->IF & (I2C_IF_ARBLOST | I2C_IF_BUSERR))
-            I2C0->CMD = I2C_CMD_ABORT;
+void _i2c0_isr()
+{
+    uint32_t ulFlags = I2C0->IF & I2C0->IEN;
 
-        return 0;
+    I2C0->IFC = ulFlags & _I2C_IFC_MASK;
+
+    if(!pI2C0Head || ubI2C0State == I2C_STATE_IDLE || ubI2C0State == I2C_STATE_RECOVER)
+        return;
+
+    if((ulFlags & (I2C_IF_ARBLOST | I2C_IF_BUSERR | I2C_IF_CLTO)) || ubI2C0DMAError)
+    {
+        i2c0_fail(I2C_TRANSFER_STATUS_ERROR);
+
+        return;
     }
 
-    if(ulCount)
-        do
+    switch(ubI2C0State)
+    {
+        case I2C_STATE_ADDR:
         {
-            if(ubAddress & 1) // Read
+            if(ulFlags & I2C_IF_NACK)
+                i2c0_end(I2C_TRANSFER_STATUS_NACK);
+            else if((ulFlags & I2C_IF_ACK) && ubI2C0ReadPhase && pI2C0Head->ulReadCount >= I2C_DMA_THRESHOLD && pI2C0Head->ulReadCount <= I2C_DMA_MAX_XFERS)
             {
-                while(!(I2C0->IF & (I2C_IF_RXDATAV | I2C_IF_ARBLOST | I2C_IF_BUSERR)));
+                ubI2C0State = I2C_STATE_READ_DMA;
+
+                I2C0->IEN &= ~(I2C_IEN_ACK | I2C_IEN_RXDATAV);
+                I2C0->CTRL |= I2C_CTRL_AUTOACK;
 
-                if(I2C0->IF & (I2C_IF_ARBLOST | I2C_IF_BUSERR))
-                {
-                    I2C0->CMD = I2C_CMD_ABORT;
+                i2c0_dma_start(I2C0_DMA_RX_CHANNEL, &I2C0->RXDATA, pI2C0Head->pubRead, pI2C0Head->ulReadCount - 2);
+            }
+            else if((ulFlags & I2C_IF_ACK) && ubI2C0ReadPhase)
+                ubI2C0State = I2C_STATE_READ;
+            else if(ulFlags & I2C_IF_ACK)
+                i2c0_next_byte();
+        }
+        break;
+        case I2C_STATE_WRITE:
+        {
+            if(ulFlags & I2C_IF_NACK)
+                i2c0_end(I2C_TRANSFER_STATUS_NACK);
+            else if(ulFlags & I2C_IF_ACK)
+                i2c0_next_byte();
+        }
+        break;
+        case I2C_STATE_READ:
+        {
+            if(!(ulFlags & I2C_IF_RXDATAV))
+                break;
 
-                    return 0;
-                }
+            i2c_transfer_t *pTransfer = pI2C0Head;
 
-                *pubSrc++ = I2C0->RXDATA;
+            pTransfer->pubRead[ulI2C0Index++] = I2C0->RXDATA;
 
-                if(ulCount > 1)
-                    I2C0->CMD = I2C_CMD_ACK;
-                else
-                    I2C0->CMD = I2C_CMD_NACK;
+            if(ulI2C0Index < pTransfer->ulReadCount)
+            {
+                I2C0->CMD = I2C_CMD_ACK;
             }
-            else // Write
+            else
             {
+                I2C0->CMD = I2C_CMD_NACK;
+
+                i2c0_end(I2C_TRANSFER_STATUS_DONE);
+            }
+        }
+        break;
+        case I2C_STATE_WRITE_DMA:
+        {
+            if(ulFlags & I2C_IF_NACK)
+            {
+                i2c0_dma_stop();
+                i2c0_end(I2C_TRANSFER_STATUS_NACK);
+            }
+            else if(ulFlags & I2C_IF_TXC)
+            {
+                i2c0_dma_stop();
+
                 I2C0->IFC = I2C_IFC_ACK;
 
-                I2C0->TXDATA = *pubSrc++;
+                i2c0_next_byte();
+            }
+        }
+        break;
+        case I2C_STATE_READ_DMA:
+        break;
+        case I2C_STATE_STOP:
+        {
+            if(ulFlags & I2C_IF_MSTOP)
+                i2c0_finish(ubI2C0Result);
+        }
+        break;
+        case I2C_STATE_RECOVER:
+        break;
+    }
+}
 
-                while(!(I2C0->IF & (I2C_IF_ACK | I2C_IF_NACK | I2C_IF_ARBLOST | I2C_IF_BUSERR)));
+void i2c0_init(uint8_t ubMode, uint8_t ubSCLLocation, uint8_t ubSDALocation)
+{
+    if(ubSCLLocation > AFCHANLOC_MAX)
+        return;
 
-                if(I2C0->IF & (I2C_IF_ARBLOST | I2C_IF_BUSERR))
-                {
-                    I2C0->CMD = I2C_CMD_ABORT;
+    if(ubSDALocation > AFCHANLOC_MAX)
+        return;
+
+    ubSCLPin = pubLocationPin[(ubSCLLocation + 1) % 32];
+    ubSDAPin = pubLocationPin[ubSDALocation];
+
+    CMU->HFPERCLKEN0 |= CMU_HFPERCLKEN0_I2C0;
 
-                    return 0;
-                }
-                else if(I2C0->IF & I2C_IF_NACK)
-                {
-                    I2C0->CMD = I2C_CMD_STOP;
+    I2C0->CTRL = I2C_CTRL_CLTO_1024PCC | I2C_CTRL_CLHR_STANDARD | I2C_CTRL_TXBIL_EMPTY;
+    I2C0->ROUTEPEN = I2C_ROUTEPEN_SCLPEN | I2C_ROUTEPEN_SDAPEN;
+    I2C0->ROUTELOC0 = ((uint32_t)ubSCLLocation << _I2C_ROUTELOC0_SCLLOC_SHIFT) | ((uint32_t)ubSDALocation << _I2C_ROUTELOC0_SDALOC_SHIFT);
 
-                    while(I2C0->IFC & (I2C_IFC_MSTOP | I2C_IFC_ARBLOST | I2C_IF_BUSERR));
+    if(ubMode == I2C_NORMAL)
+        I2C0->CLKDIV = (((HFPER_CLOCK_FREQ / 100000) - 8) / 8) - 1;
+    else if(ubMode == I2C_FAST)
+        I2C0->CLKDIV = (((HFPER_CLOCK_FREQ / 400000) - 8) / 8) - 1;
 
-                    if(I2C0->IF & (I2C_IF_ARBLOST | I2C_IF_BUSERR))
-                        I2C0->CMD = I2C_CMD_ABORT;
+    I2C0->CTRL |= I2C_CTRL_EN;
+    I2C0->CMD = I2C_CMD_ABORT;
 
-                    return 0;
-                }
-            }
-        } while(--ulCount);
+    while(I2C0->STATE & I2C_STATE_BUSY);
 
-    if(ubStop)
+    I2C0->IFC = _I2C_IFC_MASK; // Clear all flags
+    IRQ_CLEAR(I2C0_IRQn); // Clear pending vector
+    IRQ_SET_PRIO(I2C0_IRQn, 2, 1); // Set priority 2,1
+    IRQ_ENABLE(I2C0_IRQn); // Enable vector
+    I2C0->IEN = I2C_IEN_DEFAULT;
+
+    ldma_ch_disable(I2C0_DMA_TX_CHANNEL);
+    ldma_ch_peri_req_disable(I2C0_DMA_TX_CHANNEL);
+    ldma_ch_req_clear(I2C0_DMA_TX_CHANNEL);
+    ldma_ch_config(I2C0_DMA_TX_CHANNEL, LDMA_CH_REQSEL_SOURCESEL_I2C0 | LDMA_CH_REQSEL_SIGSEL_I2C0TXBL, LDMA_CH_CFG_SRCINCSIGN_POSITIVE, LDMA_CH_CFG_DSTINCSIGN_DEFAULT, LDMA_CH_CFG_ARBSLOTS_DEFAULT, 0);
+    ldma_ch_set_isr(I2C0_DMA_TX_CHANNEL, i2c0_dma_tx_isr);
+
+    ldma_ch_disable(I2C0_DMA_RX_CHANNEL);
+    ldma_ch_peri_req_disable(I2C0_DMA_RX_CHANNEL);
+    ldma_ch_req_clear(I2C0_DMA_RX_CHANNEL);
+    ldma_ch_config(I2C0_DMA_RX_CHANNEL, LDMA_CH_REQSEL_SOURCESEL_I2C0 | LDMA_CH_REQSEL_SIGSEL_I2C0RXDATAV, LDMA_CH_CFG_SRCINCSIGN_DEFAULT, LDMA_CH_CFG_DSTINCSIGN_POSITIVE, LDMA_CH_CFG_ARBSLOTS_DEFAULT, 0);
+    ldma_ch_set_isr(I2C0_DMA_RX_CHANNEL, i2c0_dma_rx_isr);
+}
+uint8_t i2c0_transfer_submit(i2c_transfer_t *pTransfer)
+{
+    if(!pTransfer)
+        return 0;
+
+    if(pTransfer->ulReadCount && !pTransfer->pubRead)
+        return 0;
+
+    if(pTransfer->ulWriteCount && !pTransfer->pubWrite)
+        return 0;
+
+    pTransfer->ubStatus = I2C_TRANSFER_STATUS_QUEUED;
+    pTransfer->pNext = NULL;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        I2C0->CMD = I2C_CMD_STOP;
+        if(pI2C0Tail)
+            pI2C0Tail->pNext = pTransfer;
+        else
+            pI2C0Head = pTransfer;
+
+        pI2C0Tail = pTransfer;
+
+        if(pI2C0Head == pTransfer)
+            i2c0_start(pTransfer);
+    }
 
-        while(I2C0->IFC & (I2C_IFC_MSTOP | I2C_IFC_ARBLOST | I2C_IF_BUSERR));
+    return 1;
+}
+uint8_t i2c0_transfer_wait(i2c_transfer_t *pTransfer)
+{
+    while(pTransfer->ubStatus == I2C_TRANSFER_STATUS_QUEUED || pTransfer->ubStatus == I2C_TRANSFER_STATUS_BUSY)
+        i2c0_check_timeout();
 
-        if(I2C0->IF & (I2C_IF_ARBLOST | I2C_IF_BUSERR))
+    return pTransfer->ubStatus;
+}
+void i2c0_check_timeout()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(pI2C0Head && ubI2C0State != I2C_STATE_IDLE && ubI2C0State != I2C_STATE_RECOVER)
         {
-            I2C0->CMD = I2C_CMD_ABORT;
+            if(now_ms() >= pI2C0Head->ullDeadline)
+                i2c0_fail(I2C_TRANSFER_STATUS_TIMEOUT);
+            else
+                sleep_deadline(pI2C0Head->ullDeadline);
+        }
+    }
+
+    if(ubI2C0State != I2C_STATE_RECOVER)
+        return;
+
+    i2c0_bus_recover(); // With interrupts enabled, the I2C ISR ignores the bus until the transfer is finished
 
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        i2c0_finish(ubI2C0Result);
+    }
+}
+uint8_t i2c0_write_read(uint8_t ubAddress, uint8_t *pubSrc, uint32_t ulSrcCount, uint8_t *pubDst, uint32_t ulDstCount)
+{
+    i2c_transfer_t xTransfer = {0};
+
+    xTransfer.ubAddress = ubAddress;
+    xTransfer.pubWrite = pubSrc;
+    xTransfer.ulWriteCount = ulSrcCount;
+    xTransfer.pubRead = pubDst;
+    xTransfer.ulReadCount = ulDstCount;
+
+    if(!i2c0_transfer_submit(&xTransfer))
+        return 0;
+
+    return i2c0_transfer_wait(&xTransfer) == I2C_TRANSFER_STATUS_DONE;
+}
+uint8_t i2c0_transmit(uint8_t ubAddress, uint8_t *pubSrc, uint32_t ulCount, uint8_t ubStop)
+{
+    i2c_transfer_t xTransfer = {0};
+
+    xTransfer.ubAddress = ubAddress >> 1;
+    xTransfer.ubFlags = ubStop ? 0 : I2C_TRANSFER_FLAG_NO_STOP;
+
+    if(ubAddress & 1)
+    {
+        if(!ulCount)
             return 0;
-        }
+
+        xTransfer.pubRead = pubSrc;
+        xTransfer.ulReadCount = ulCount;
+    }
+    else
+    {
+        xTransfer.pubWrite = pubSrc;
+        xTransfer.ulWriteCount = ulCount;
     }
 
-    return 1;
-}
\ No newline at end of file
+    if(!i2c0_transfer_submit(&xTransfer))
+        return 0;
+
+    return i2c0_transfer_wait(&xTransfer) == I2C_TRANSFER_STATUS_DONE;
+}
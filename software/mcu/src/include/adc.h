@@ -2,7 +2,14 @@
 #define __ADC_H__
 
 #include <em_device.h>
+#include <stddef.h>
 #include "cmu.h"
+#include "ldma.h"
+#include "prs.h"
+#include "nvic.h"
+#include "atomic.h"
+#include "utils.h"
+#include "filter.h"
 
 #define ADC_5V0_DIV             2.219512195121951f // Voltage divider ratio
 #define ADC_VEXT_DIV            11.f // Voltage divider ratio
@@ -10,7 +17,63 @@
 #define ADC_5V0_CHAN            ADC_SINGLECTRL_POSSEL_APORT4XCH5
 #define ADC_VEXT_CHAN           ADC_SINGLECTRL_POSSEL_APORT3XCH28
 
+#define ADC0_DMA_CHANNEL        6
+#define ADC0_PRS_CHANNEL        0 // Also the LDMA SYNC bit it sets, only PRS channels 0 to 7 can do that
+#define ADC0_CAPTURE_PRS_CHANNEL    1
+#define ADC0_PARK_SYNC_BIT      7 // Never set, holds the sequence at its gate
+
+#define ADC_SEQUENCE_BUFFER     4 // Completed sequences the LDMA keeps for adc_task(), about half a second free running
+
+#define ADC_CAPTURE_STATE_IDLE      0
+#define ADC_CAPTURE_STATE_PENDING   1 // Waiting for the running sequence to end
+#define ADC_CAPTURE_STATE_RUNNING   2
+
+#define ADC_CAPTURE_MAX_DECIMATION  64
+#define ADC_CAPTURE_MAX_TRIGGER_HZ  50000 // One 12 bit conversion takes 17 us at the 1 MHz capture clock
+
+// Sequence inputs, converted in this order
+#define ADC_INPUT_AVDD          0
+#define ADC_INPUT_DVDD          1
+#define ADC_INPUT_IOVDD         2
+#define ADC_INPUT_DECOUPLE      3
+#define ADC_INPUT_5V0           4
+#define ADC_INPUT_VEXT          5
+#define ADC_INPUT_TEMP          6
+#define ADC_INPUT_COUNT         7
+
+#define ADC_STATS_CLEAR_WINDOW  BIT(0) // Start a new min/max/mean window after reading
+#define ADC_STATS_CLEAR_PEAK    BIT(1)
+
+typedef struct
+{
+    float fMin;
+    float fMax;
+    float fMean;
+    float fPeak;
+    uint32_t ulCount; // Samples in the window
+} adc_stats_t;
+
+typedef void (* adc_sequence_callback_t)(); // Called from adc_task() once per sequence
+typedef void (* adc_window_isr_t)(uint8_t); // Bitmap of the inputs found outside of their window
+
 void adc_init();
+void adc_task(); // Filters the sequences the LDMA buffered since the last call
+void adc_set_sequence_callback(adc_sequence_callback_t pfCallback);
+uint32_t adc_get_sequence_count();
+void adc_set_trigger(uint32_t ulPRSSource);
+uint32_t adc_get_trigger();
+uint32_t adc_get_raw(uint8_t ubInput);
+float adc_code_to_value(uint8_t ubInput, uint16_t usCode); // mV or degrees Celsius, for the 16 bit codes of the sequence and of captures
+uint8_t adc_capture_start(uint8_t ubInput, uint32_t ulPRSSource, uint32_t ulPRSEdge, uint8_t ubDecimation, uint16_t *pusBuffer, uint16_t usCount, uint8_t ubImmediate);
+void adc_capture_abort();
+uint8_t adc_capture_busy();
+void adc_set_window_isr(adc_window_isr_t pfISR);
+uint8_t adc_set_window(uint8_t ubInput, float fLow, float fHigh);
+uint8_t adc_clear_window(uint8_t ubInput);
+uint8_t adc_get_window(uint8_t ubInput, float *pfLow, float *pfHigh);
+uint8_t adc_set_filter(uint8_t ubInput, uint8_t ubType, uint8_t ubParam);
+uint8_t adc_get_filter(uint8_t ubInput, uint8_t *pubType, uint8_t *pubParam);
+uint8_t adc_get_stats(uint8_t ubInput, adc_stats_t *pStats, uint8_t ubClear);
 
 float adc_get_avdd();
 float adc_get_dvdd();
@@ -0,0 +1,27 @@
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+#include <em_device.h>
+#include <stddef.h>
+#include "msc.h"
+#include "crc.h"
+#include "systime.h"
+#include "utils.h"
+
+#define CONFIG_FLASH_ADDR           (FLASH_BASE + FLASH_SIZE - 4 * FLASH_PAGE_SIZE) // Two pages below the accounting checkpoints, kept out of irom0 by the linker script
+#define CONFIG_FLASH_PAGES          2
+#define CONFIG_MAX_KEYS             32 // Keys are indexes into the RAM copy
+#define CONFIG_FLUSH_DELAY_MS       2000 // Changes are written once the values have been left alone this long
+#define CONFIG_FLUSH_MAX_DELAY_MS   10000 // ...or at the latest this long after the first unwritten change
+
+void config_init();
+uint8_t config_set(uint16_t usKey, uint32_t ulValue);
+uint8_t config_get(uint16_t usKey, uint32_t *pulValue);
+uint8_t config_clear(uint16_t usKey); // Back to no value, config_get fails until the next config_set
+uint8_t config_set_float(uint16_t usKey, float fValue);
+uint8_t config_get_float(uint16_t usKey, float *pfValue);
+uint8_t config_is_dirty();
+void config_flush();
+void config_task();
+
+#endif  // __CONFIG_H__
@@ -8,5 +8,6 @@
 
 void crc_init();
 uint32_t calc_crc32(uint8_t *pData, uint32_t ulSize);
+uint8_t calc_crc8_maxim(uint8_t *pData, uint32_t ulSize);
 
 #endif  // __CRC_H__
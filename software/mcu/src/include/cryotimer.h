@@ -0,0 +1,13 @@
+#ifndef __CRYOTIMER_H__
+#define __CRYOTIMER_H__
+
+#include <em_device.h>
+#include "cmu.h"
+#include "utils.h"
+
+void cryotimer_init(uint32_t ulOscillator, uint32_t ulPrescaler, uint8_t ubPeriodSel);
+void cryotimer_disable();
+uint32_t cryotimer_get_count();
+uint32_t cryotimer_get_period(); // In clock ticks, 0 when stopped
+
+#endif  // __CRYOTIMER_H__
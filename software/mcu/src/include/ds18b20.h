@@ -0,0 +1,49 @@
+#ifndef __DS18B20_H__
+#define __DS18B20_H__
+
+#include <em_device.h>
+#include "ds2484.h"
+#include "systime.h"
+#include "crc.h"
+
+#define DS18B20_FAMILY_CODE             0x28
+
+#define DS18B20_CONVERSION_TIME_MS      750 // At 12 bit resolution, halves with each bit less
+#define DS18B20_CONVERSION_TIME(r)      ((DS18B20_CONVERSION_TIME_MS >> (12 - (r))) + 1)
+#define DS18B20_COPY_TIME_MS            10
+
+#define DS18B20_MIN_RESOLUTION          9
+#define DS18B20_MAX_RESOLUTION          12
+
+// Scratchpad
+#define DS18B20_SP_TEMP_LSB             0
+#define DS18B20_SP_TEMP_MSB             1
+#define DS18B20_SP_TH                   2
+#define DS18B20_SP_TL                   3
+#define DS18B20_SP_CONFIG               4
+#define DS18B20_SP_CRC                  8
+
+#define DS18B20_CONFIG_RES_SHIFT        5
+#define DS18B20_CONFIG_RES_MASK         (3 << DS18B20_CONFIG_RES_SHIFT)
+
+// Commands
+#define DS18B20_CMD_CONVERT_T           0x44
+#define DS18B20_CMD_WRITE_SCRATCHPAD    0x4E
+#define DS18B20_CMD_READ_SCRATCHPAD     0xBE
+#define DS18B20_CMD_COPY_SCRATCHPAD     0x48
+#define DS18B20_CMD_RECALL_EEPROM       0xB8
+#define DS18B20_CMD_READ_POWER_SUPPLY   0xB4
+
+uint8_t ds18b20_seq_convert(ds2484_seq_t *pSeq, const uint8_t *pubROM, uint8_t ubOverdrive, uint8_t ubStrongPullup);
+uint8_t ds18b20_seq_read_scratchpad(ds2484_seq_t *pSeq, const uint8_t *pubROM, uint8_t ubOverdrive);
+uint8_t ds18b20_seq_get_scratchpad(const ds2484_seq_t *pSeq, uint8_t *pubScratchpad); // From a finished read, 0 on a failed sequence or CRC
+uint8_t ds18b20_seq_get_temperature(const ds2484_seq_t *pSeq, float *pfTemperature);
+
+uint8_t ds18b20_convert(const uint8_t *pubROM, uint8_t ubOverdrive, uint8_t ubStrongPullup);
+uint8_t ds18b20_read_scratchpad(const uint8_t *pubROM, uint8_t ubOverdrive, uint8_t *pubScratchpad);
+uint8_t ds18b20_read_temperature(const uint8_t *pubROM, uint8_t ubOverdrive, float *pfTemperature);
+uint8_t ds18b20_read_resolution(const uint8_t *pubROM, uint8_t ubOverdrive, uint8_t *pubResolution);
+uint8_t ds18b20_set_resolution(const uint8_t *pubROM, uint8_t ubOverdrive, uint8_t ubResolution);
+uint8_t ds18b20_read_power_supply(const uint8_t *pubROM, uint8_t *pubParasite);
+
+#endif  // __DS18B20_H__
@@ -0,0 +1,119 @@
+#ifndef __DS2484_H__
+#define __DS2484_H__
+
+#include <em_device.h>
+#include <stddef.h>
+#include "systime.h"
+#include "i2c.h"
+#include "crc.h"
+
+#define DS2484_I2C_ADDR             0x18
+
+#define DS2484_TIMEOUT_MS           10 // Longest 1-Wire operation (reset in standard speed) is ~1.2 ms
+
+// Commands
+#define DS2484_CMD_DEVICE_RESET     0xF0
+#define DS2484_CMD_SET_READ_PTR     0xE1
+#define DS2484_CMD_WRITE_CONFIG     0xD2
+#define DS2484_CMD_ADJUST_PORT      0xC3
+#define DS2484_CMD_1W_RESET         0xB4
+#define DS2484_CMD_1W_SINGLE_BIT    0x87
+#define DS2484_CMD_1W_WRITE_BYTE    0xA5
+#define DS2484_CMD_1W_READ_BYTE     0x96
+#define DS2484_CMD_1W_TRIPLET       0x78
+
+// Read pointer codes
+#define DS2484_REG_STATUS           0xF0
+#define DS2484_REG_DATA             0xE1
+#define DS2484_REG_PORT_CONFIG      0xB4
+#define DS2484_REG_DEVICE_CONFIG    0xC3
+
+// Status register
+#define DS2484_STATUS_1WB           BIT(0) // 1-Wire busy
+#define DS2484_STATUS_PPD           BIT(1) // Presence pulse detected
+#define DS2484_STATUS_SD            BIT(2) // Short detected
+#define DS2484_STATUS_LL            BIT(3) // Logic level
+#define DS2484_STATUS_RST           BIT(4) // Device reset
+#define DS2484_STATUS_SBR           BIT(5) // Single bit result
+#define DS2484_STATUS_TSB           BIT(6) // Triplet second bit
+#define DS2484_STATUS_DIR           BIT(7) // Branch direction taken
+
+// Device configuration register
+#define DS2484_CONFIG_APU           BIT(0) // Active pullup
+#define DS2484_CONFIG_PDN           BIT(1) // 1-Wire power down
+#define DS2484_CONFIG_SPU           BIT(2) // Strong pullup
+#define DS2484_CONFIG_1WS           BIT(3) // 1-Wire overdrive speed
+
+// 1-Wire ROM commands
+#define ONE_WIRE_CMD_READ_ROM       0x33
+#define ONE_WIRE_CMD_MATCH_ROM      0x55
+#define ONE_WIRE_CMD_SEARCH_ROM     0xF0
+#define ONE_WIRE_CMD_SKIP_ROM       0xCC
+#define ONE_WIRE_CMD_OD_SKIP_ROM    0x3C // Overdrive Skip ROM
+#define ONE_WIRE_CMD_OD_MATCH_ROM   0x69 // Overdrive Match ROM
+
+// Sequences, 1-Wire steps run back to back from the I2C completion interrupt
+#define DS2484_SEQ_MAX_STEPS        68 // A search pass, speed, reset, Search ROM and the 64 triplets
+
+#define DS2484_STEP_RESET           0 // Fails on a short or without a presence pulse
+#define DS2484_STEP_WRITE_BYTE      1
+#define DS2484_STEP_READ_BYTE       2 // ubData receives the byte
+#define DS2484_STEP_SINGLE_BIT      3 // ubData is the bit written, then the bit read
+#define DS2484_STEP_TRIPLET         4 // ubData is the direction, then the status register
+#define DS2484_STEP_SPEED           5 // ubData selects overdrive, skipped when the DS2484 is already there
+#define DS2484_STEP_STRONG_PULLUP   6 // Cleared by the device when the pullup ends after the next byte or bit
+
+#define DS2484_SEQ_STATUS_IDLE      0 // Being built
+#define DS2484_SEQ_STATUS_BUSY      1
+#define DS2484_SEQ_STATUS_DONE      2
+#define DS2484_SEQ_STATUS_FAIL      3 // Also set when it did not fit in DS2484_SEQ_MAX_STEPS
+
+#define DS2484_SEQ_PHASE_COMMAND    0
+#define DS2484_SEQ_PHASE_POLL       1 // Status reads until 1WB clears
+#define DS2484_SEQ_PHASE_DATA       2 // Read data register
+#define DS2484_SEQ_PHASE_CONFIG     3 // Write config with its readback
+
+typedef struct
+{
+    uint8_t ubType;
+    uint8_t ubData;
+} ds2484_step_t;
+
+typedef struct
+{
+    ds2484_step_t pxStep[DS2484_SEQ_MAX_STEPS];
+    uint8_t ubCount;
+    volatile uint8_t ubStatus;
+} ds2484_seq_t;
+
+uint8_t ds2484_init();
+uint8_t ds2484_device_reset();
+uint8_t ds2484_read_register(uint8_t ubRegister, uint8_t *pubValue);
+uint8_t ds2484_write_config(uint8_t ubConfig);
+uint8_t ds2484_strong_pullup();
+uint8_t ds2484_set_speed(uint8_t ubOverdrive);
+
+void ds2484_seq_init(ds2484_seq_t *pSeq);
+uint8_t ds2484_seq_add(ds2484_seq_t *pSeq, uint8_t ubType, uint8_t ubData);
+uint8_t ds2484_seq_add_write(ds2484_seq_t *pSeq, const uint8_t *pubSrc, uint8_t ubCount);
+uint8_t ds2484_seq_add_read(ds2484_seq_t *pSeq, uint8_t ubCount);
+uint8_t ds2484_seq_add_select(ds2484_seq_t *pSeq, const uint8_t *pubROM, uint8_t ubOverdrive);
+uint8_t ds2484_seq_add_search(ds2484_seq_t *pSeq, const uint8_t *pubROM, int8_t bLastDiscrepancy); // One Search ROM pass, following pubROM up to the last discrepancy
+uint8_t ds2484_seq_get_search(const ds2484_seq_t *pSeq, uint8_t *pubROM, int8_t *pbDiscrepancy); // ROM found by a finished search pass, CRC not checked
+uint8_t ds2484_seq_start(ds2484_seq_t *pSeq); // Returns right away, pSeq->ubStatus leaves BUSY when it ends
+uint8_t ds2484_seq_busy();
+uint8_t ds2484_seq_run(ds2484_seq_t *pSeq); // Blocking, waits for a running sequence first
+
+uint8_t ds2484_one_wire_reset();
+uint8_t ds2484_one_wire_write_bit(uint8_t ubBit);
+uint8_t ds2484_one_wire_read_bit(uint8_t *pubBit);
+uint8_t ds2484_one_wire_write_byte(uint8_t ubData);
+uint8_t ds2484_one_wire_read_byte(uint8_t *pubData);
+uint8_t ds2484_one_wire_write(const uint8_t *pubSrc, uint32_t ulCount);
+uint8_t ds2484_one_wire_read(uint8_t *pubDst, uint32_t ulCount);
+uint8_t ds2484_one_wire_triplet(uint8_t ubDirection, uint8_t *pubStatus);
+uint8_t ds2484_one_wire_select(const uint8_t *pubROM);
+uint8_t ds2484_one_wire_select_speed(const uint8_t *pubROM, uint8_t ubOverdrive);
+uint8_t ds2484_one_wire_search(uint8_t (*pubROM)[8], uint8_t ubMaxDevices);
+
+#endif  // __DS2484_H__
@@ -0,0 +1,29 @@
+#ifndef __FAN_CURVE_H__
+#define __FAN_CURVE_H__
+
+#include <stdint.h>
+
+#define FAN_CURVE_MAX_POINTS    8
+
+// Temperatures are Q8.8 degrees Celsius, duty cycles are Q0.16 (65535 = 100 %)
+typedef struct __attribute__((__packed__))
+{
+    int16_t sTemperature;
+    uint16_t usDuty;
+} fan_curve_point_t;
+
+typedef struct
+{
+    uint8_t ubPointCount; // 0 disables the curve
+    uint16_t usHysteresis;
+    uint16_t usMinDuty;
+    uint16_t usMaxDuty;
+    fan_curve_point_t xPoint[FAN_CURVE_MAX_POINTS];
+    int16_t sHeldTemperature; // Temperature the output was last computed from
+    uint8_t ubPrimed;
+} fan_curve_t;
+
+uint8_t fan_curve_set(fan_curve_t *pCurve, const fan_curve_point_t *pPoints, uint8_t ubPointCount, uint16_t usHysteresis, uint16_t usMinDuty, uint16_t usMaxDuty);
+uint16_t fan_curve_eval(fan_curve_t *pCurve, int16_t sTemperature);
+
+#endif  // __FAN_CURVE_H__
@@ -0,0 +1,41 @@
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <stdint.h>
+
+#define FILTER_TYPE_NONE            0
+#define FILTER_TYPE_IIR             1 // First order low pass, y += (x - y) / 2^k
+#define FILTER_TYPE_MOVING_AVERAGE  2
+
+#define FILTER_IIR_MAX_SHIFT        8
+#define FILTER_MA_MAX_WINDOW        16
+
+// Samples are unsigned 16 bit codes
+typedef struct
+{
+    uint8_t ubType;
+    uint8_t ubParam; // Shift for the IIR, window length for the moving average
+    uint8_t ubPrimed;
+    uint8_t ubIndex;
+    uint8_t ubFill;
+    uint32_t ulState; // IIR output in Q16.8, moving average running sum
+    uint16_t pusWindow[FILTER_MA_MAX_WINDOW];
+} filter_t;
+
+typedef struct
+{
+    uint16_t usMin;
+    uint16_t usMax;
+    uint16_t usPeak; // Held across windows until cleared explicitly
+    uint16_t usPeakMin; // Same for the lowest code, the peak of inputs that fall as the code rises
+    uint32_t ulCount;
+    uint64_t ullSum;
+} filter_stats_t;
+
+uint8_t filter_config(filter_t *pFilter, uint8_t ubType, uint8_t ubParam);
+uint16_t filter_update(filter_t *pFilter, uint16_t usSample);
+
+void filter_stats_reset(filter_stats_t *pStats, uint8_t ubClearPeak);
+void filter_stats_update(filter_stats_t *pStats, uint16_t usSample);
+
+#endif  // __FILTER_H__
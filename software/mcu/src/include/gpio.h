@@ -3,10 +3,18 @@
 
 #include <em_device.h>
 #include "cmu.h"
-#include "systick.h"
+#include "systime.h"
 #include "utils.h"
 #include "nvic.h"
+#include "atomic.h"
+
+#define GPIO_EXTI_TACH0         11 // PB11
+#define GPIO_EXTI_TACH1         13 // PB13
+#define GPIO_EXTI_TACH2         14 // PB14
+
+typedef void (* gpio_exti_isr_t)(uint8_t);
 
 void gpio_init();
+void gpio_set_exti_isr(uint8_t ubLine, gpio_exti_isr_t pfISR);
 
 #endif  // __GPIO_H__
@@ -0,0 +1,32 @@
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HISTORY_FIELDS              18 // 7 duty cycles, VEXT, 5V0, ADC temperature and 8 1-Wire sensors, filled in by main.c
+#define HISTORY_INVALID             INT16_MIN // Field had no value, e.g. a missing sensor
+#define HISTORY_BLOCK_SIZE          240 // Bytes, one block per USART frame
+#define HISTORY_TIERS               2
+#define HISTORY_TIER0_PERIOD        1 // s
+#define HISTORY_TIER0_SAMPLES       300 // 5 minutes, stored as is so the span does not depend on how much the inputs move, delta encoded at readout
+#define HISTORY_TIER1_DECIMATION    60 // Tier 0 samples averaged into each tier 1 sample
+#define HISTORY_TIER1_BLOCKS        20 // About 10 hours
+
+typedef struct
+{
+    uint32_t ulTime; // s, of the key frame, samples follow every tier period
+    uint16_t usCount; // Samples in the block, key frame included
+    uint16_t usSize; // Bytes used in ubData
+    int16_t psKey[HISTORY_FIELDS]; // Key frame, stored as is
+    uint8_t ubData[HISTORY_BLOCK_SIZE - 8 - 2 * HISTORY_FIELDS]; // Deltas to the previous sample, a LEB128 bitmap of the changed fields followed by a zigzag LEB128 delta for each of them
+} history_block_t;
+
+void history_init();
+void history_push(uint32_t ulTime, const int16_t *psSample); // ulTime in s, periods skipped since the last sample are kept in tier 0 as samples without values
+uint8_t history_get_block_count(uint8_t ubTier);
+uint8_t history_get_block(uint8_t ubTier, uint8_t ubBlock, history_block_t *pBlock); // Oldest first
+uint16_t history_get_period(uint8_t ubTier);
+
+#endif  // __HISTORY_H__
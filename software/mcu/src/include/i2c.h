@@ -2,8 +2,13 @@
 #define __I2C_H__
 
 #include <em_device.h>
+#include <stddef.h>
 #include "utils.h"
+#include "atomic.h"
 #include "cmu.h"
+#include "nvic.h"
+#include "systime.h"
+#include "ldma.h"
 
 #define I2C_NORMAL 0
 #define I2C_FAST 1
@@ -11,7 +16,47 @@
 #define I2C_RESTART 0
 #define I2C_STOP 1
 
+#define I2C0_DMA_TX_CHANNEL             4
+#define I2C0_DMA_RX_CHANNEL             5
+#define I2C_DMA_THRESHOLD               4 // Phases at least this long are moved by the LDMA, reads need at least 3 as the CPU takes the last two bytes
+#define I2C_DMA_MAX_XFERS               2048
+
+#define I2C_DEFAULT_TIMEOUT_MS          20
+#define I2C_RECOVERY_CLOCKS             9
+
+#define I2C_TRANSFER_STATUS_QUEUED      0
+#define I2C_TRANSFER_STATUS_BUSY        1
+#define I2C_TRANSFER_STATUS_DONE        2
+#define I2C_TRANSFER_STATUS_NACK        3
+#define I2C_TRANSFER_STATUS_ERROR       4 // Arbitration lost, bus error or SCL held low, the bus was recovered
+#define I2C_TRANSFER_STATUS_TIMEOUT     5
+
+#define I2C_TRANSFER_FLAG_NO_STOP       BIT(0) // Keep the bus after the transfer, the next one starts with a repeated start
+
+typedef struct i2c_transfer_t i2c_transfer_t;
+typedef void (* i2c_transfer_cb_t)(i2c_transfer_t *pTransfer);
+
+struct i2c_transfer_t
+{
+    uint8_t ubAddress; // 7 bit
+    uint8_t ubFlags;
+    uint8_t *pubWrite; // Written first, then the read phase follows after a repeated start
+    uint32_t ulWriteCount;
+    uint8_t *pubRead;
+    uint32_t ulReadCount;
+    uint32_t ulTimeout; // ms, 0 for the default
+    i2c_transfer_cb_t pfCallback; // Called from the ISR on completion, may submit new transfers
+    void *pContext;
+    volatile uint8_t ubStatus;
+    uint64_t ullDeadline;
+    i2c_transfer_t *pNext;
+};
+
 void i2c0_init(uint8_t ubMode, uint8_t ubSCLLocation, uint8_t ubSDALocation);
+uint8_t i2c0_transfer_submit(i2c_transfer_t *pTransfer);
+uint8_t i2c0_transfer_wait(i2c_transfer_t *pTransfer);
+void i2c0_check_timeout(); // Also recovers the bus after a failed transfer, thread context only
+uint8_t i2c0_write_read(uint8_t ubAddress, uint8_t *pubSrc, uint32_t ulSrcCount, uint8_t *pubDst, uint32_t ulDstCount);
 uint8_t i2c0_transmit(uint8_t ubAddress, uint8_t *pubSrc, uint32_t ulCount, uint8_t ubStop);
 static inline uint8_t i2c0_write(uint8_t ubAddress, uint8_t *pubSrc, uint32_t ulCount, uint8_t ubStop)
 {
@@ -36,19 +36,21 @@ void ldma_init();
 
 void ldma_sync_set(uint8_t ubMask);
 void ldma_sync_clear(uint8_t ubMask);
+void ldma_sync_prs_enable(uint8_t ubMask, uint8_t ubEnable); // PRS channel n sets SYNC bit n
 
 void ldma_ch_config(uint8_t ubChannel, uint32_t ulSource, uint32_t ulSrcIncSign, uint32_t ulDstIncSign, uint32_t ulArbitrationSlots, uint8_t ubLoopCount);
 void ldma_ch_set_isr(uint8_t ubChannel, ldma_ch_isr_t pfISR);
-void ldma_ch_load(uint8_t ubChannel, ldma_descriptor_t *pDescriptor);
+void ldma_ch_load(uint8_t ubChannel, ldma_descriptor_t *pDescriptor) RAM_CODE; // RAM_CODE ones are on the USART RX ISR path
 void ldma_ch_sw_req(uint8_t ubChannel);
 void ldma_ch_enable(uint8_t ubChannel);
 void ldma_ch_disable(uint8_t ubChannel);
-void ldma_ch_peri_req_enable(uint8_t ubChannel);
-void ldma_ch_peri_req_disable(uint8_t ubChannel);
+void ldma_ch_peri_req_enable(uint8_t ubChannel) RAM_CODE;
+void ldma_ch_peri_req_disable(uint8_t ubChannel) RAM_CODE;
 void ldma_ch_req_clear(uint8_t ubChannel);
-uint8_t ldma_ch_get_busy(uint8_t ubChannel);
-uint16_t ldma_ch_get_remaining_xfers(uint8_t ubChannel);
+uint8_t ldma_ch_get_busy(uint8_t ubChannel) RAM_CODE;
+uint8_t ldma_ch_get_done(uint8_t ubChannel);
+uint16_t ldma_ch_get_remaining_xfers(uint8_t ubChannel) RAM_CODE;
 void* ldma_ch_get_next_src_addr(uint8_t ubChannel);
-void* ldma_ch_get_next_dst_addr(uint8_t ubChannel);
+void* ldma_ch_get_next_dst_addr(uint8_t ubChannel) RAM_CODE;
 
 #endif  // __LDMA_H__
\ No newline at end of file
@@ -2,9 +2,15 @@
 #define __MSC_H__
 
 #include <em_device.h>
+#include "ldma.h"
+#include "atomic.h"
+#include "nvic.h"
+#include "utils.h"
 
 #define FLASH_PAGE_COUNT    (FLASH_SIZE / FLASH_PAGE_SIZE)
 
+#define MSC_DMA_CHANNEL     7 // Feeds WDATA during page writes, only used while the LDMA is clocked
+
 typedef struct
 {
     volatile uint32_t   PLW[16]; // Page Lock Word (one page per bit from 0 to 32)
@@ -27,10 +33,12 @@ extern init_calib_t *g_psInitCalibrationTable;
 
 void msc_init();
 void msc_config_waitstates(uint32_t ulFrequency);
+void msc_cache_counters_reset();
+void msc_cache_counters_get(uint64_t *pullHits, uint64_t *pullMisses); // Flash fetches served by the instruction cache and the ones that went to flash
 void msc_flash_lock();
 void msc_flash_unlock();
 void msc_flash_page_erase(uint32_t ulAddress);
-void msc_flash_page_write(uint32_t ulAddress, uint8_t *pubData, uint32_t ulSize);
+void msc_flash_page_write(uint32_t ulAddress, uint8_t *pubData, uint32_t ulSize); // Word aligned, may span several pages
 void msc_flash_word_write(uint32_t ulAddress, uint32_t ulData);
 
 #endif  // __MSC_H__
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef __PID_H__
+#define __PID_H__
+
+#include <stdint.h>
+
+// Measurements and setpoints are Q8.8 degrees Celsius, gains are Q16.16 duty cycle per degree and per sample, outputs are Q0.16 duty cycles
+// The loop is reverse acting (cooling), the output rises while the measurement is above the setpoint
+typedef struct
+{
+    int16_t sSetpoint;
+    int32_t lKp;
+    int32_t lKi;
+    int32_t lKd;
+    uint8_t ubDerivativeFilter; // First order low pass on the derivative term, alpha = 2^-n, 0 disables
+    uint16_t usMinOutput;
+    uint16_t usMaxOutput;
+    int32_t lIntegral; // Q0.24, kept within the output limits
+    int32_t lDerivative;
+    int16_t sLastMeasurement;
+    uint8_t ubPrimed;
+} pid_controller_t;
+
+uint8_t pid_config(pid_controller_t *pPID, int16_t sSetpoint, int32_t lKp, int32_t lKi, int32_t lKd, uint8_t ubDerivativeFilter, uint16_t usMinOutput, uint16_t usMaxOutput);
+void pid_reset(pid_controller_t *pPID);
+uint16_t pid_step(pid_controller_t *pPID, int16_t sMeasurement);
+
+#endif  // __PID_H__
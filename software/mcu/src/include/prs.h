@@ -0,0 +1,17 @@
+#ifndef __PRS_H__
+#define __PRS_H__
+
+#include <em_device.h>
+#include "cmu.h"
+#include "utils.h"
+
+void prs_init();
+
+void prs_ch_config(uint8_t ubChannel, uint32_t ulSource, uint32_t ulEdge, uint8_t ubAsync);
+void prs_ch_disable(uint8_t ubChannel);
+uint8_t prs_ch_get_level(uint8_t ubChannel);
+
+void prs_sw_pulse(uint16_t usMask);
+void prs_sw_level(uint16_t usMask, uint16_t usLevel);
+
+#endif  // __PRS_H__
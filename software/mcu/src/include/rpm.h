@@ -0,0 +1,19 @@
+#ifndef __RPM_H__
+#define __RPM_H__
+
+#include <stdint.h>
+
+#define RPM_MIN_SAMPLES         128
+#define RPM_MIN_CROSSINGS       3 // Rising crossings needed for a result, two full ripple periods
+#define RPM_MIN_RIPPLE          16 // Peak to peak codes below which the capture is treated as flat
+#define RPM_SMOOTHING           4 // Length of the moving average applied before the crossing detector
+#define RPM_BASELINE_SHIFT      5 // Time constant of the baseline tracker, 2^k samples
+#define RPM_SETTLE_SAMPLES      64 // Samples skipped while the baseline settles
+
+// Estimates the speed of a brushless DC fan from its commutation ripple
+// Samples are unsigned 16 bit codes taken at a fixed rate, the result is 0 when no periodic ripple is found
+// RPM_MIN_CROSSINGS ripple periods plus one to arm the trigger must fit after the settle samples, slower ripple may read as 0
+// The lowest ripple frequency always measured is (RPM_MIN_CROSSINGS + 1) * rate / (count - RPM_SETTLE_SAMPLES), about 36 Hz for 512 samples at 4 kHz
+uint16_t rpm_estimate(const uint16_t *pusSamples, uint16_t usCount, uint32_t ulSampleRate, uint8_t ubPulsesPerRev);
+
+#endif  // __RPM_H__
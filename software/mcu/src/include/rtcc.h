@@ -2,12 +2,20 @@
 #define __RTCC_H__
 
 #include <em_device.h>
+#include <stddef.h>
 #include "utils.h"
+#include "atomic.h"
 #include "cmu.h"
+#include "nvic.h"
+
+#define RTCC_TICK_SHIFT         15 // The RTCC runs from the LFRCO undivided, 2^15 ticks per second
+#define RTCC_ALARM_MIN_TICKS    2 // Alarms closer than this can be missed
+
+typedef void (* rtcc_tick_isr_t)();
 
 void rtcc_init();
-uint32_t rtcc_get_time();
-void rtcc_set_time(uint32_t ulTime);
-void rtcc_set_alarm(uint32_t ulAlarm);
+uint64_t rtcc_get_ticks(); // Since rtcc_init, never wraps or tears
+uint8_t rtcc_set_alarm(uint64_t ullTicks); // Wakes the core at this tick count, fails if it is too close or more than 2^32 ticks away
+void rtcc_set_tick(uint32_t ulPeriod, rtcc_tick_isr_t pfISR);
 
 #endif  // __RTCC_H__
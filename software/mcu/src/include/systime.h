@@ -0,0 +1,14 @@
+#ifndef __SYSTIME_H__
+#define __SYSTIME_H__
+
+#include <em_device.h>
+#include "atomic.h"
+#include "rtcc.h"
+
+uint64_t now_ms(); // Since rtcc_init, safe to call from any context
+uint64_t now_us(); // Same, in steps of one RTCC tick (~30.5 us)
+void delay_ms(uint32_t ulMs); // Sleeps in EM1 until an RTCC alarm, interrupts run meanwhile
+void sleep_deadline(uint64_t ullMs); // The next sleep_idle ends by this now_ms() value, 0 skips it
+uint32_t sleep_idle(uint32_t ulMaxMs); // One EM1 sleep until the earliest deadline or an interrupt, returns the cycles added to CYCCNT for it
+
+#endif  // __SYSTIME_H__
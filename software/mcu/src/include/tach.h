@@ -0,0 +1,26 @@
+#ifndef __TACH_H__
+#define __TACH_H__
+
+#include <em_device.h>
+#include "cmu.h"
+#include "gpio.h"
+#include "rtcc.h"
+#include "atomic.h"
+#include "utils.h"
+
+#define TACH_COUNT              3
+#define TACH_MAX_AVERAGE        16 // Pulses the period is averaged over
+#define TACH_DEF_AVERAGE        4
+#define TACH_DEF_PULSES_PER_REV 2
+#define TACH_MIN_PERIOD_US      500 // Shorter intervals are glitches, 30000 RPM at 4 pulses per revolution
+#define TACH_MAX_PERIOD_MS      1000 // Longer intervals restart the measurement, the fan reads 0 RPM meanwhile
+
+void tach_init();
+uint8_t tach_config(uint8_t ubTach, uint8_t ubPulsesPerRev, uint8_t ubAverage);
+void tach_get_config(uint8_t ubTach, uint8_t *pubPulsesPerRev, uint8_t *pubAverage);
+uint16_t tach_get_rpm(uint8_t ubTach); // 0 until enough pulses were seen
+uint32_t tach_get_pulse_count(uint8_t ubTach);
+uint32_t tach_get_idle_time(uint8_t ubTach); // ms since the last pulse
+void tach_reset(uint8_t ubTach);
+
+#endif  // __TACH_H__
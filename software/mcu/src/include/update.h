@@ -0,0 +1,26 @@
+#ifndef __UPDATE_H__
+#define __UPDATE_H__
+
+#include <em_device.h>
+#include <stddef.h>
+#include <string.h>
+#include "msc.h"
+#include "crc.h"
+#include "wdog.h"
+#include "utils.h"
+
+#define UPDATE_APP_ADDR         FLASH_BASE
+#define UPDATE_SLOT_SIZE        ((FLASH_SIZE - 6 * FLASH_PAGE_SIZE) / 2) // Flash below nvm0 is split in two, must match irom0 in the linker script
+#define UPDATE_STAGING_ADDR     (UPDATE_APP_ADDR + UPDATE_SLOT_SIZE)
+#define UPDATE_MARKER_ADDR      (UPDATE_STAGING_ADDR + UPDATE_SLOT_SIZE) // First page of nvm0, read by the boot stub so it can never move
+#define UPDATE_MARKER_MAGIC     0x59504F43 // Copy pending
+#define UPDATE_CHUNK_SIZE       128 // Image bytes per USART frame
+
+uint8_t update_begin(uint32_t ulSize, uint32_t ulCRC);
+uint8_t update_write(uint32_t ulOffset, const uint8_t *pubData, uint32_t ulSize);
+uint8_t update_finish(uint32_t *pulCRC);
+void update_abort();
+uint8_t update_is_active();
+void update_apply(); // Only returns if update_finish() did not succeed, otherwise the device restarts and the boot stub copies the image, about 40 ms per page, starting over after a reset or power loss
+
+#endif  // __UPDATE_H__
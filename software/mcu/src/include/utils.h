@@ -9,8 +9,8 @@
 #define IROM1_TEXT __attribute__ ((section(".irom1.text")))
 #define DROM0_DATA __attribute__ ((section(".drom0.data")))
 
-#define RAM_CODE IRAM0_TEXT
-#define RAMH_CODE IRAM1_TEXT
+#define RAM_CODE IRAM0_TEXT __attribute__ ((long_call, noinline)) // RAM is out of BL range from flash, and inlining would pull the code back into flash
+#define RAMH_CODE IRAM1_TEXT __attribute__ ((long_call, noinline))
 #define BOOT_CODE IROM1_TEXT
 #define USER_DATA DROM0_DATA
 
@@ -2,7 +2,7 @@
 
 static ldma_ch_isr_t ppfChannelISR[DMA_CHAN_COUNT];
 
-void _ldma_isr()
+void RAM_CODE _ldma_isr()
 {
     uint32_t ulFlags = LDMA->IFC;
 
@@ -43,6 +43,13 @@ void ldma_sync_clear(uint8_t ubMask)
 {
     PERI_REG_BIT_CLEAR(&(LDMA->SYNC)) = ubMask;
 }
+void ldma_sync_prs_enable(uint8_t ubMask, uint8_t ubEnable)
+{
+    if(ubEnable)
+        PERI_REG_BIT_SET(&(LDMA->CTRL)) = (uint32_t)ubMask << _LDMA_CTRL_SYNCPRSSETEN_SHIFT;
+    else
+        PERI_REG_BIT_CLEAR(&(LDMA->CTRL)) = (uint32_t)ubMask << _LDMA_CTRL_SYNCPRSSETEN_SHIFT;
+}
 
 void ldma_ch_config(uint8_t ubChannel, uint32_t ulSource, uint32_t ulSrcIncSign, uint32_t ulDstIncSign, uint32_t ulArbitrationSlots, uint8_t ubLoopCount)
 {
@@ -125,6 +132,13 @@ uint8_t ldma_ch_get_busy(uint8_t ubChannel)
 
     return PERI_REG_BIT(&(LDMA->CHBUSY), ubChannel);
 }
+uint8_t ldma_ch_get_done(uint8_t ubChannel)
+{
+    if(ubChannel >= DMA_CHAN_COUNT)
+        return 0;
+
+    return PERI_REG_BIT(&(LDMA->CHDONE), ubChannel);
+}
 uint16_t ldma_ch_get_remaining_xfers(uint8_t ubChannel)
 {
     if(ubChannel >= DMA_CHAN_COUNT)
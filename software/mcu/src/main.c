@@ -5,21 +5,67 @@
 #include "utils.h"
 #include "nvic.h"
 #include "atomic.h"
-#include "systick.h"
+#include "systime.h"
 #include "rmu.h"
 #include "emu.h"
 #include "cmu.h"
 #include "gpio.h"
+#include "ldma.h"
+#include "fan_curve.h"
+#include "rpm.h"
+#include "tach.h"
+#include "pid.h"
 #include "dbg.h"
 #include "msc.h"
 #include "rtcc.h"
+#include "prs.h"
+#include "cryotimer.h"
 #include "adc.h"
 #include "crc.h"
+#include "config.h"
+#include "update.h"
+#include "history.h"
 #include "usart.h"
 #include "i2c.h"
+#include "ds2484.h"
+#include "ds18b20.h"
 #include "wdog.h"
 
 // Structs
+typedef struct
+{
+    TIMER_TypeDef *pTimer;
+    uint32_t ulDMASource;
+    uint32_t ulDMABlockSize;
+    uint8_t ubDMAChannel;
+    uint8_t ubFirstChannel;
+    uint8_t ubChannelCount;
+    uint8_t ubFrameCount;
+    volatile uint32_t *pulFrames; // Two tables, the LDMA reads one while the other is rendered
+    ldma_descriptor_t *pDescriptors;
+    uint8_t ubActiveTable;
+    uint8_t ubDirty;
+    volatile uint8_t ubSwapState;
+} pwm_burst_t;
+typedef struct
+{
+    uint32_t ulMagic;
+    uint8_t ubCount;
+    uint8_t ubReserved[3];
+    uint8_t ubROM[8][8];
+    uint32_t ulCRC; // Over all the previous fields
+} one_wire_rom_cache_t;
+typedef struct
+{
+    uint32_t ulMagic;
+    uint32_t ulSequence; // The valid checkpoint with the highest sequence is the newest
+    uint64_t ullOnTime[7]; // ms
+    uint64_t ullDutyTime[7]; // ms at full duty, Q16
+    uint64_t ullEnergy[7]; // V^2 us, divide by the load resistance for uJ
+    uint32_t ulReserved;
+    uint32_t ulCRC; // Over all the previous fields
+} accounting_checkpoint_t;
+
 typedef struct __attribute__((__packed__))
 {
     uint16_t usMagic;
@@ -46,6 +92,262 @@ typedef struct __attribute__((__packed__))
     float fFreq;
 } usart_cmd_get_freq_t;
 typedef struct __attribute__((__packed__))
+{
+    float fFreq;
+    uint16_t usPrescaler;
+    uint16_t usSteps;
+} usart_cmd_get_pwm_info_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint8_t ubOnPeriods;
+    uint8_t ubOffPeriods;
+} usart_cmd_set_burst_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint8_t ubOnPeriods;
+    uint8_t ubOffPeriods;
+} usart_cmd_get_burst_t;
+typedef struct __attribute__((__packed__))
+{
+    float fDutyCycle[7];
+} usart_cmd_set_dc_all_t;
+typedef struct __attribute__((__packed__))
+{
+    uint16_t usDelay[7];
+    uint16_t usDroopThreshold;
+    uint16_t usDroopTimeout;
+} usart_cmd_set_spinup_t;
+typedef struct __attribute__((__packed__))
+{
+    uint16_t usDelay[7];
+    uint16_t usDroopThreshold;
+    uint16_t usDroopTimeout;
+    uint8_t ubPending;
+} usart_cmd_get_spinup_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint16_t usVoltage;
+} usart_cmd_set_eff_voltage_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint16_t usVoltage;
+    uint16_t usVEXT;
+} usart_cmd_get_eff_voltage_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint8_t ubSource;
+    uint8_t ubPointCount;
+    uint16_t usHysteresis;
+    uint16_t usMinDuty;
+    uint16_t usMaxDuty;
+    fan_curve_point_t xPoint[FAN_CURVE_MAX_POINTS];
+} usart_cmd_set_fan_curve_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint8_t ubSource;
+    uint8_t ubPointCount;
+    uint16_t usHysteresis;
+    uint16_t usMinDuty;
+    uint16_t usMaxDuty;
+    fan_curve_point_t xPoint[FAN_CURVE_MAX_POINTS];
+    int16_t sTemperature;
+    uint16_t usDuty;
+} usart_cmd_get_fan_curve_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint8_t ubEnable;
+    uint8_t ubSource;
+    int16_t sSetpoint;
+    int32_t lKp;
+    int32_t lKi;
+    int32_t lKd;
+    uint8_t ubDerivativeFilter;
+    uint16_t usMinDuty;
+    uint16_t usMaxDuty;
+    uint16_t usPeriod;
+} usart_cmd_set_pid_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint8_t ubEnable;
+    uint8_t ubSource;
+    int16_t sSetpoint;
+    int32_t lKp;
+    int32_t lKi;
+    int32_t lKd;
+    uint8_t ubDerivativeFilter;
+    uint16_t usMinDuty;
+    uint16_t usMaxDuty;
+    uint16_t usPeriod;
+    int16_t sTemperature;
+    uint16_t usDuty;
+} usart_cmd_get_pid_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubCount;
+    uint8_t ubROM[8][8];
+} usart_cmd_get_sensors_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubSensor;
+    uint8_t ubResolution;
+    uint8_t ubOverdrive;
+} usart_cmd_set_sensor_config_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubSensor;
+    uint8_t ubResolution;
+    uint8_t ubOverdrive;
+    uint8_t ubParasite;
+} usart_cmd_get_sensor_config_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubInput;
+    uint8_t ubType;
+    uint8_t ubParam;
+} usart_cmd_set_filter_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubInput;
+    uint8_t ubClear;
+    uint8_t ubFilterType;
+    uint8_t ubFilterParam;
+    float fMin;
+    float fMax;
+    float fMean;
+    float fPeak;
+    uint32_t ulCount;
+} usart_cmd_get_stats_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubInput;
+    uint8_t ubEnable;
+    float fLow;
+    float fHigh;
+    uint8_t ubForceSafeDuty;
+    float fSafeDuty;
+} usart_cmd_set_rail_alarm_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubInput;
+    uint8_t ubClear;
+    uint8_t ubEnabled;
+    uint8_t ubArmed;
+    uint8_t ubLatched;
+    float fLow;
+    float fHigh;
+    uint8_t ubForceSafeDuty;
+    float fSafeDuty;
+} usart_cmd_get_rail_alarm_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubInputs;
+    float f5V0;
+    float fVEXT;
+} usart_cmd_rail_alarm_t;
+typedef struct __attribute__((__packed__))
+{
+    uint16_t usPeriod;
+} usart_cmd_set_sample_period_t;
+typedef struct __attribute__((__packed__))
+{
+    uint16_t usPeriod;
+    uint32_t ulSequenceCount;
+} usart_cmd_get_sample_period_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint8_t ubEnable;
+    uint8_t ubPulsesPerRev;
+} usart_cmd_set_rpm_config_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint8_t ubEnabled;
+    uint8_t ubPulsesPerRev;
+    uint16_t usRPM;
+} usart_cmd_get_rpm_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubTach;
+    uint8_t ubChannel;
+    uint8_t ubPulsesPerRev;
+    uint8_t ubAverage;
+    uint16_t usStallTimeout;
+} usart_cmd_set_tach_config_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubTach;
+    uint8_t ubClear;
+    uint8_t ubChannel;
+    uint8_t ubPulsesPerRev;
+    uint8_t ubAverage;
+    uint16_t usStallTimeout;
+    uint16_t usRPM;
+    uint32_t ulPulseCount;
+    uint8_t ubFault;
+    uint8_t ubKicks;
+} usart_cmd_get_tach_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubTach;
+    uint8_t ubChannel;
+} usart_cmd_tach_fault_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubRun;
+    uint16_t usResult;
+    int16_t sDroop[7];
+} usart_cmd_self_test_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubChannel;
+    uint8_t ubReset;
+    uint64_t ullOnTime;
+    uint64_t ullDutyTime;
+    uint64_t ullEnergy;
+} usart_cmd_get_accounting_t;
+typedef struct __attribute__((__packed__))
+{
+    uint32_t ulSize;
+    uint32_t ulCRC;
+} usart_cmd_update_begin_t;
+typedef struct __attribute__((__packed__))
+{
+    uint32_t ulOffset;
+    uint8_t ubData[UPDATE_CHUNK_SIZE];
+} usart_cmd_update_data_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubApply;
+    uint32_t ulCRC;
+} usart_cmd_update_finish_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubReset;
+    uint32_t ulLoopAvg;
+    uint32_t ulLoopMax;
+    uint32_t ulCmdMax;
+    uint64_t ullCacheHits;
+    uint64_t ullCacheMisses;
+} usart_cmd_get_perf_t;
+typedef struct __attribute__((__packed__))
+{
+    uint8_t ubTier;
+    uint8_t ubBlock;
+    uint8_t ubBlockCount;
+    uint16_t usPeriod; // s
+    uint32_t ulNow; // s, time of the newest tier 0 sample
+    history_block_t xBlock; // Empty past the last block
+} usart_cmd_get_history_t;
+typedef struct __attribute__((__packed__))
 {
     uint8_t ubChannel;
     float fVoltage;
@@ -67,9 +369,98 @@ typedef struct __attribute__((__packed__))
 } usart_cmd_get_sw_info_t;
 
 // Defines
-#define TIMER_PWM_MIN_FREQ_HZ   500
+#define TIMER_PWM_MIN_FREQ_HZ   1
 #define TIMER_PWM_MAX_FREQ_HZ   1600000
 #define TIMER_PWM_DEF_FREQ_HZ   25000
+#define TIMER_PWM_MAX_PRESC     10 // DIV1024
+#define TIMER_PWM_BURST_FRAMES  64 // Maximum length of the combined burst pattern of a timer, in PWM periods
+
+#define TIMER0_DMA_CHANNEL      2
+#define TIMER1_DMA_CHANNEL      3
+
+#define SPINUP_DEF_DELAY_MS         250 // Time given to each fan to spin up before the next one is started
+#define SPINUP_DEF_DROOP_TIMEOUT_MS 2000 // Maximum time to wait for VEXT to recover before starting the next fan anyway
+#define SPINUP_DROOP_POLL_MS        5
+
+#define VEXT_COMP_PERIOD_MS     20 // How often VEXT is sampled for the channels in effective voltage mode
+
+#define FAN_CURVE_PERIOD_MS     500
+
+#define ONE_WIRE_MAX_SENSORS    8
+#define ONE_WIRE_PERIOD_MS      1000 // Time between the starts of two conversion rounds at 12 bit, halves with each bit less
+#define ONE_WIRE_SEARCH_PASS_MS 250 // Between the passes of the search after a boot from the ROM cache, one device per pass
+#define ONE_WIRE_ROM_CACHE_ADDR     USERDATA_BASE
+#define ONE_WIRE_ROM_CACHE_MAGIC    0x31524F4D // Bumped when the layout changes
+
+#define ONE_WIRE_STATE_IDLE     0
+#define ONE_WIRE_STATE_CONVERT  1
+#define ONE_WIRE_STATE_READ     2
+
+#define ONE_WIRE_OP_NONE        0
+#define ONE_WIRE_OP_CONVERT     1 // Addressed, externally powered sensors
+#define ONE_WIRE_OP_CONVERT_ALL 2 // Broadcast with the strong pullup
+#define ONE_WIRE_OP_READ        3
+#define ONE_WIRE_OP_SEARCH      4
+
+#define ACCOUNTING_TICK_MS          1
+#define ACCOUNTING_CHECKPOINT_MS    900000 // 15 min, with 11 checkpoints per page a page is erased every ~3 hours of runtime
+#define ACCOUNTING_FLASH_ADDR       (FLASH_BASE + FLASH_SIZE - 2 * FLASH_PAGE_SIZE) // Last two main flash pages, kept out of irom0 by the linker script
+#define ACCOUNTING_FLASH_PAGES      2
+#define ACCOUNTING_SLOTS_PER_PAGE   (FLASH_PAGE_SIZE / sizeof(accounting_checkpoint_t))
+#define ACCOUNTING_MAGIC            0x54434341 // Bumped when the layout changes
+
+// Config store keys
+#define CONFIG_KEY_PWM_FREQ         0
+#define CONFIG_KEY_DUTY(c)          (1 + (c))
+
+#define ADC_SAMPLE_DEF_PERIOD_MS    0 // CRYOTIMER period gating the ADC sequence, power of two, 0 keeps it free running
+#define ADC_SAMPLE_MAX_PERIOD_MS    32768
+
+#define RPM_SAMPLE_RATE_HZ      4000 // Rate the captured VEXT ripple is decimated to
+#define RPM_CAPTURE_SAMPLES     512 // 128 ms, ripple below about 36 Hz (540 RPM at 4 commutations per revolution) may read as 0
+#define RPM_CAPTURE_TIMEOUT_MS  500
+#define RPM_PERIOD_MS           500 // Time between two captures, channels take turns
+#define RPM_DEF_PULSES_PER_REV  4 // Commutations per revolution of a common 4 pole fan
+
+#define TACH_PERIOD_MS          100
+#define TACH_DEF_STALL_TIMEOUT_MS   2000 // Time without pulses on a driven fan before it counts as stalled
+#define TACH_KICK_MS            1000 // Time a stalled fan is driven at full duty cycle to get it going
+#define TACH_MAX_KICKS          3 // Kicks per stall before giving up, until the channel is switched off or the fan recovers
+#define TACH_NO_CHANNEL         0xFF
+
+#define SELF_TEST_DUTY          0.25f // Duty cycle an idle channel is pulsed with
+#define SELF_TEST_SAMPLES       16 // VEXT samples per measurement, only the second half is used so the load can settle
+#define SELF_TEST_TIMEOUT_MS    5 // On top of the time the samples take at the current PWM frequency
+#define SELF_TEST_MIN_FREQ_HZ   1000 // Slower PWM is switched to the default frequency for the test, the samples come once per period
+#define SELF_TEST_NO_LOAD_MV    30 // Less droop than this and nothing is connected
+#define SELF_TEST_SHORT_MV      2000 // More droop than this and the load is shorted
+
+// 2 bit channel states of the self-test result
+#define SELF_TEST_NO_LOAD       0
+#define SELF_TEST_NORMAL        1
+#define SELF_TEST_SHORT         2
+#define SELF_TEST_UNTESTED      3 // Channel was running, bursting or the PWM is too fast to sample
+
+#define HISTORY_EXT_TEMP_FIELD  10 // Fields of a history sample: duty cycles of the 7 channels (Q1.15), VEXT and 5V0 (mV), ADC temperature and the 1-Wire sensors (Q8.8)
+
+#define PERF_LOOP_WINDOW_SHIFT  10 // Main loop iterations per average, as a power of two
+
+#define SLEEP_MAX_MS            250 // Longest idle, adc_task has to empty the sequence buffer before the LDMA laps it
+
+#define PID_TICK_HZ             128 // RTCC driven base tick of the PID loops, periods are multiples of it
+#define PID_TICK_PERIOD         (BIT(RTCC_TICK_SHIFT) / PID_TICK_HZ) // RTCC ticks
+
+#if BIT(RTCC_TICK_SHIFT) % PID_TICK_HZ
+#error "PID_TICK_HZ must divide the RTCC clock exactly, the gains are per sample and a truncated period skews every time constant"
+#endif
+
+#define BURST_SWAP_IDLE         0 // The inactive table is free to render
+#define BURST_SWAP_PENDING      1 // The inactive table is rendered, the done interrupt switches to it when the pattern wraps
+#define BURST_SWAP_DRAINING     2 // Switched, the LDMA may still hold a descriptor of the old table
+
+#define SPINUP_STATE_IDLE       0
+#define SPINUP_STATE_DELAY      1
+#define SPINUP_STATE_DROOP      2
 
 #define USART_HEADER_MAGIC      0xFAC7
 
@@ -79,7 +470,41 @@ typedef struct __attribute__((__packed__))
 #define USART_CMD_GET_TEMP      0x04
 #define USART_CMD_SET_FREQ      0x05
 #define USART_CMD_GET_FREQ      0x06
+#define USART_CMD_GET_PWM_INFO  0x07
+#define USART_CMD_SET_BURST     0x08
+#define USART_CMD_GET_BURST     0x09
+#define USART_CMD_SET_DC_ALL    0x0A
+#define USART_CMD_SET_SPINUP    0x0B
+#define USART_CMD_GET_SPINUP    0x0C
+#define USART_CMD_SET_EFF_VOLTAGE 0x0D
+#define USART_CMD_GET_EFF_VOLTAGE 0x0E
+#define USART_CMD_SET_FAN_CURVE 0x0F
+#define USART_CMD_GET_FAN_CURVE 0x10
+#define USART_CMD_SET_PID       0x11
+#define USART_CMD_GET_PID       0x12
+#define USART_CMD_GET_SENSORS   0x13
+#define USART_CMD_SET_SENSOR_CONFIG 0x14
+#define USART_CMD_GET_SENSOR_CONFIG 0x15
+#define USART_CMD_SET_FILTER    0x16
+#define USART_CMD_GET_STATS     0x17
+#define USART_CMD_SET_RAIL_ALARM 0x18
+#define USART_CMD_GET_RAIL_ALARM 0x19
+#define USART_CMD_SET_SAMPLE_PERIOD 0x1A
+#define USART_CMD_GET_SAMPLE_PERIOD 0x1B
+#define USART_CMD_SET_RPM_CONFIG 0x1C
+#define USART_CMD_GET_RPM       0x1D
+#define USART_CMD_SET_TACH_CONFIG 0x1E
+#define USART_CMD_GET_TACH      0x1F
+#define USART_CMD_SELF_TEST     0x20
+#define USART_CMD_GET_ACCOUNTING 0x21
+#define USART_CMD_UPDATE_BEGIN  0x22
+#define USART_CMD_UPDATE_DATA   0x23
+#define USART_CMD_UPDATE_FINISH 0x24
+#define USART_CMD_GET_PERF      0x25
+#define USART_CMD_GET_HISTORY   0x26
 #define USART_CMD_ERROR         0xE0
+#define USART_CMD_RAIL_ALARM    0xE1 // Unsolicited, sent when a rail leaves its window
+#define USART_CMD_TACH_FAULT    0xE2 // Unsolicited, sent when a fan stalls
 #define USART_CMD_GET_UID       0xF0
 #define USART_CMD_GET_SW_INFO   0xF1
 #define USART_CMD_RESET_BL      0xFE
@@ -94,10 +519,13 @@ typedef struct __attribute__((__packed__))
 
 #define USART_TEMP_EMU          0
 #define USART_TEMP_ADC          1
+#define USART_TEMP_EXT_BASE     2 // 1-Wire sensors, in the order they were found on the bus
+#define USART_TEMP_COUNT        (USART_TEMP_EXT_BASE + ONE_WIRE_MAX_SENSORS)
 
 // Forward declarations
 static void reset() __attribute__((noreturn));
 static void sleep();
+static uint8_t period_elapsed(uint64_t *pullLastTick, uint32_t ulPeriod);
 
 static uint32_t get_free_ram();
 
@@ -107,12 +535,154 @@ static uint16_t get_device_revision();
 static void wdog_warning_isr();
 
 static void init_timers();
+static void restore_settings();
 static void set_freq(float fFreq);
 static float get_freq();
+static uint16_t get_prescaler();
+static uint16_t get_steps();
 static void set_channel_dc(uint8_t ubChannel, float fDuty);
 static float get_channel_dc(uint8_t ubChannel);
+static uint16_t get_channel_compare(uint8_t ubChannel) RAM_CODE;
+static void update_channel(uint8_t ubChannel, uint8_t ubImmediate) RAM_CODE;
+static void set_channel_eff_voltage(uint8_t ubChannel, uint16_t usVoltage);
+static uint16_t get_channel_eff_voltage(uint8_t ubChannel);
+static void vext_comp_task();
+static uint8_t set_channel_burst(uint8_t ubChannel, uint8_t ubOnPeriods, uint8_t ubOffPeriods);
+static void get_channel_burst(uint8_t ubChannel, uint8_t *pubOnPeriods, uint8_t *pubOffPeriods);
+static void burst_update_channel(pwm_burst_t *pBurst, uint8_t ubChannel, uint16_t usCompare) RAM_CODE;
+static void burst_render(pwm_burst_t *pBurst, uint8_t ubTable) RAM_CODE;
+static void burst_swap(pwm_burst_t *pBurst) RAM_CODE;
+static void burst_dma_isr(pwm_burst_t *pBurst) RAM_CODE;
+static void burst0_dma_isr(uint8_t ubError) RAM_CODE;
+static void burst1_dma_isr(uint8_t ubError) RAM_CODE;
+static void burst_task();
+static uint32_t burst_calc_frames(pwm_burst_t *pBurst);
+static uint8_t burst_rebuild(pwm_burst_t *pBurst);
+static void spinup_set_channel_dc(uint8_t ubChannel, float fDuty);
+static void spinup_set_channel_eff_voltage(uint8_t ubChannel, uint16_t usVoltage);
+static void spinup_task();
+static uint8_t get_temperature(uint8_t ubSource, float *pfTemperature);
+static void fan_curve_task();
+static void stop_channel_control(uint8_t ubChannel);
+static void pid_tick_isr();
+static void pid_task();
+static uint8_t one_wire_cache_load();
+static void one_wire_cache_store();
+static void one_wire_probe();
+static void one_wire_update(uint8_t (*pubROM)[8], uint8_t ubCount);
+static void one_wire_scan();
+static void one_wire_start();
+static void one_wire_task();
+static void rail_alarm_isr(uint8_t ubInputs);
+static uint8_t set_rail_alarm(uint8_t ubInput, uint8_t ubEnable, float fLow, float fHigh, uint8_t ubForceSafeDuty, float fSafeDuty);
+static void rail_alarm_task();
+static uint8_t set_sample_period(uint16_t usPeriod);
+static uint16_t get_sample_period();
+static void rpm_task();
+static void tach_task();
+static uint8_t accounting_load();
+static void accounting_store();
+static void accounting_task();
+static uint8_t self_test_measure(uint32_t ulPRSSource, uint32_t ulPRSEdge, float *pfVoltage);
+static void self_test_run();
+static void perf_reset();
+static void perf_loop_tick();
+static void history_task();
+static void usart_cmd_error(usart_cmd_header_t *pHeader);
+static uint8_t usart_cmd_read_payload(usart_cmd_header_t *pHeader, void *pPayload, uint8_t ubSize);
 
 // Variables
+static float pfChannelDuty[7];
+static uint16_t pusChannelEffVoltage[7]; // mV, 0 when the channel is in plain duty cycle mode
+static uint16_t usVEXTVoltage = 0; // mV, last VEXT sample used for effective voltage compensation
+static uint8_t pubBurstOnPeriods[7];
+static uint8_t pubBurstOffPeriods[7];
+static uint16_t pusBurstCompare[7]; // Compare value of the on periods, the frame tables are rendered from it
+static volatile uint32_t pulBurst0Frames[2 * TIMER_PWM_BURST_FRAMES * 3];
+static volatile uint32_t pulBurst1Frames[2 * TIMER_PWM_BURST_FRAMES * 4];
+static ldma_descriptor_t pxBurst0Descriptors[TIMER_PWM_BURST_FRAMES];
+static ldma_descriptor_t pxBurst1Descriptors[TIMER_PWM_BURST_FRAMES];
+static pwm_burst_t pxBurst[2] = {
+    {TIMER0, LDMA_CH_REQSEL_SOURCESEL_TIMER0 | LDMA_CH_REQSEL_SIGSEL_TIMER0UFOF, LDMA_CH_CTRL_BLOCKSIZE_UNIT3, TIMER0_DMA_CHANNEL, 0, 3, 0, pulBurst0Frames, pxBurst0Descriptors},
+    {TIMER1, LDMA_CH_REQSEL_SOURCESEL_TIMER1 | LDMA_CH_REQSEL_SIGSEL_TIMER1UFOF, LDMA_CH_CTRL_BLOCKSIZE_UNIT4, TIMER1_DMA_CHANNEL, 3, 4, 0, pulBurst1Frames, pxBurst1Descriptors}
+};
+static float pfSpinUpDuty[7];
+static uint16_t pusSpinUpEffVoltage[7]; // mV, queued instead of pfSpinUpDuty when not 0
+static uint8_t ubSpinUpPending = 0x00; // Bitmap of the channels waiting for their turn to speed up
+static uint16_t pusSpinUpDelay[7] = {SPINUP_DEF_DELAY_MS, SPINUP_DEF_DELAY_MS, SPINUP_DEF_DELAY_MS, SPINUP_DEF_DELAY_MS, SPINUP_DEF_DELAY_MS, SPINUP_DEF_DELAY_MS, SPINUP_DEF_DELAY_MS};
+static uint16_t usSpinUpDroopThreshold = 0; // mV, 0 disables the VEXT gate
+static uint16_t usSpinUpDroopTimeout = SPINUP_DEF_DROOP_TIMEOUT_MS;
+static fan_curve_t pxFanCurve[7];
+static uint8_t pubFanCurveSource[7];
+static uint16_t pusFanCurveDuty[7]; // Last output of each curve, Q0.16
+static pid_controller_t pxPID[7];
+static uint8_t pubPIDSource[7];
+static uint16_t pusPIDPeriod[7]; // In PID ticks
+static uint16_t pusPIDCountdown[7];
+static uint16_t pusPIDDuty[7]; // Last output of each loop, Q0.16
+static int16_t psPIDTemperature[7]; // Last measurement of each loop, Q8.8
+static uint8_t ubPIDActive = 0x00; // Bitmap of the channels under PID control
+static volatile uint16_t usPIDTicks = 0; // Ticks elapsed since the last run of pid_task
+static uint8_t pubSensorROM[ONE_WIRE_MAX_SENSORS][8];
+static uint8_t ubSensorCount = 0;
+static float pfSensorTemperature[ONE_WIRE_MAX_SENSORS];
+static uint8_t ubSensorValid = 0x00; // Bitmap of the sensors whose last read succeeded
+static uint8_t ubSensorSearchPending = 0; // Set when the sensors came from the ROM cache, a search follows the first round
+static uint8_t ubSensorSearchActive = 0; // That search is running, one pass at a time from one_wire_task
+static uint8_t pubSearchROM[ONE_WIRE_MAX_SENSORS][8]; // Found so far
+static uint8_t ubSearchCount = 0;
+static uint8_t pubSearchPath[8]; // ROM of the last pass, the next one follows it up to the discrepancy
+static int8_t bSearchDiscrepancy = -1;
+static uint8_t pubSensorResolution[ONE_WIRE_MAX_SENSORS]; // Bits
+static uint8_t ubSensorOverdrive = 0x00; // Bitmap of the sensors addressed at overdrive speed
+static uint8_t ubSensorParasite = 1; // Some sensor is parasite powered, conversions need the strong pullup and a quiet bus
+static uint8_t ubSensorConverting = 0x00; // Bitmap of the sensors with an addressed conversion running
+static uint64_t pullSensorConvertTick[ONE_WIRE_MAX_SENSORS];
+static ds2484_seq_t xOneWireSeq; // Run by one_wire_task from the I2C interrupt
+static uint8_t ubRPMEnabled = 0x00; // Bitmap of the channels with back-EMF speed estimation
+static uint8_t pubRPMPulsesPerRev[7] = {RPM_DEF_PULSES_PER_REV, RPM_DEF_PULSES_PER_REV, RPM_DEF_PULSES_PER_REV, RPM_DEF_PULSES_PER_REV, RPM_DEF_PULSES_PER_REV, RPM_DEF_PULSES_PER_REV, RPM_DEF_PULSES_PER_REV};
+static uint16_t pusChannelRPM[7];
+static uint16_t pusRPMSamples[RPM_CAPTURE_SAMPLES];
+static uint8_t ubRPMCaptureAborted = 0; // The self-test took the ADC in the middle of a capture, its samples are incomplete
+static const uint32_t pulRPMTrigger[7] = { // PRS signal of each PWM output, its falling edge is the compare clear
+    PRS_CH_CTRL_SOURCESEL_TIMER0 | PRS_CH_CTRL_SIGSEL_TIMER0CC0,
+    PRS_CH_CTRL_SOURCESEL_TIMER0 | PRS_CH_CTRL_SIGSEL_TIMER0CC1,
+    PRS_CH_CTRL_SOURCESEL_TIMER0 | PRS_CH_CTRL_SIGSEL_TIMER0CC2,
+    PRS_CH_CTRL_SOURCESEL_TIMER1 | PRS_CH_CTRL_SIGSEL_TIMER1CC0,
+    PRS_CH_CTRL_SOURCESEL_TIMER1 | PRS_CH_CTRL_SIGSEL_TIMER1CC1,
+    PRS_CH_CTRL_SOURCESEL_TIMER1 | PRS_CH_CTRL_SIGSEL_TIMER1CC2,
+    PRS_CH_CTRL_SOURCESEL_TIMER1 | PRS_CH_CTRL_SIGSEL_TIMER1CC3
+};
+static uint8_t pubTachChannel[TACH_COUNT] = {TACH_NO_CHANNEL, TACH_NO_CHANNEL, TACH_NO_CHANNEL}; // PWM channel driving the fan of each tach input
+static uint16_t pusTachStallTimeout[TACH_COUNT] = {TACH_DEF_STALL_TIMEOUT_MS, TACH_DEF_STALL_TIMEOUT_MS, TACH_DEF_STALL_TIMEOUT_MS};
+static uint8_t pubTachKickCount[TACH_COUNT];
+static uint64_t pullTachKickTick[TACH_COUNT];
+static uint64_t pullTachOnTick[TACH_COUNT]; // When the channel last started driving the fan, stalls are only checked after the timeout
+static uint8_t ubTachKick = 0x00; // Bitmap of the channels held at full duty cycle for a re-kick
+static uint8_t ubTachFault = 0x00; // Bitmap of the tach inputs that saw a stall, cleared by the host
+static uint64_t pullAccountingOnTime[7]; // ms
+static uint64_t pullAccountingDutyTime[7]; // ms at full duty, Q16
+static uint64_t pullAccountingEnergy[7]; // V^2 us
+static uint32_t ulAccountingSequence = 0;
+static uint16_t usAccountingSlot = 0; // Next checkpoint slot, counting across both pages
+static uint8_t ubAccountingDirty = 0;
+static uint64_t ullAccountingTick = 0; // Last accounting tick, set when the main loop starts so boot time is not counted
+static uint16_t usSelfTestResult = 0xFFFF; // SELF_TEST_* state of each channel, 2 bits each starting at channel 0
+static int16_t psSelfTestDroop[7]; // mV
+static uint16_t pusSelfTestSamples[SELF_TEST_SAMPLES];
+static uint32_t ulPerfLoopLast = 0; // CYCCNT at the start of the previous main loop iteration
+static uint64_t ullPerfLoopSum = 0;
+static uint16_t usPerfLoopCount = 0;
+static uint32_t ulPerfLoopAvg = 0; // Cycles, over the last complete window
+static uint32_t ulPerfLoopMax = 0; // Cycles
+static uint32_t ulPerfCmdMax = 0; // Cycles, from the header read to the end of the command
+static uint32_t ulPerfIdleCycles = 0; // Cycles asleep since the last loop tick, left out of the loop figures
+static uint32_t ulHistoryTime = 0; // s since boot, of the newest history sample
+static uint8_t ubRailAlarmEnabled = 0x00; // Bitmap of the inputs with a configured window
+static uint8_t ubRailAlarmForce = 0x00; // Bitmap of the inputs whose alarm forces the safe duty cycle
+static volatile uint16_t usRailAlarmSafeDuty = 0; // Q0.16
+static volatile uint8_t ubRailAlarmLatched = 0x00; // Bitmap of the tripped inputs, cleared by the host
+static volatile uint8_t ubRailAlarmPending = 0x00; // Bitmap of the trips not yet handled by rail_alarm_task
 
 // ISRs
 
@@ -125,25 +695,23 @@ void reset()
 }
 void sleep()
 {
-    rtcc_set_alarm(rtcc_get_time() + 5);
+    if(usart0_available() >= sizeof(usart_cmd_header_t)) // The next command is already waiting
+        sleep_deadline(0);
 
-    SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk; // Configure Deep Sleep (EM2/3)
+    // EM1 until the earliest deadline the tasks handed in, interrupts wake the core earlier
+    ulPerfIdleCycles += sleep_idle(SLEEP_MAX_MS);
+}
+uint8_t period_elapsed(uint64_t *pullLastTick, uint32_t ulPeriod)
+{
+    uint64_t ullNow = now_ms();
+    uint8_t ubElapsed = ullNow - *pullLastTick >= ulPeriod;
 
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-    {
-        IRQ_CLEAR(RTCC_IRQn);
-
-        __DMB(); // Wait for all memory transactions to finish before memory access
-        __DSB(); // Wait for all memory transactions to finish before executing instructions
-        __ISB(); // Wait for all memory transactions to finish before fetching instructions
-        __SEV(); // Set the event flag to ensure the next WFE will be a NOP
-        __WFE(); // NOP and clear the event flag
-        __WFE(); // Wait for event
-        __NOP(); // Prevent debugger crashes
-
-        cmu_init();
-        cmu_update_clocks();
-    }
+    if(ubElapsed)
+        *pullLastTick = ullNow;
+
+    sleep_deadline(*pullLastTick + ulPeriod);
+
+    return ubElapsed;
 }
 
 uint32_t get_free_ram()
@@ -282,8 +850,9 @@ void init_timers()
     // Timer 0
     cmu_hfper0_clock_gate(CMU_HFPERCLKEN0_TIMER0, 1);
 
-    TIMER0->CTRL = TIMER_CTRL_RSSCOIST | TIMER_CTRL_PRESC_DIV1 | TIMER_CTRL_CLKSEL_PRESCHFPERCLK | TIMER_CTRL_FALLA_NONE | TIMER_CTRL_RISEA_NONE | TIMER_CTRL_MODE_UP;
+    TIMER0->CTRL = TIMER_CTRL_RSSCOIST | TIMER_CTRL_DMACLRACT | TIMER_CTRL_PRESC_DIV1 | TIMER_CTRL_CLKSEL_PRESCHFPERCLK | TIMER_CTRL_FALLA_NONE | TIMER_CTRL_RISEA_NONE | TIMER_CTRL_MODE_UP;
     TIMER0->TOP = HFPER_CLOCK_FREQ / TIMER_PWM_DEF_FREQ_HZ - 1;
+    TIMER0->TOPB = TIMER0->TOP; // get_steps() reads the buffer, which holds the pending period after set_freq
     TIMER0->CNT = 0x0000;
 
     TIMER0->CC[0].CTRL = TIMER_CC_CTRL_PRSCONF_LEVEL | TIMER_CC_CTRL_CUFOA_NONE | TIMER_CC_CTRL_COFOA_SET | TIMER_CC_CTRL_CMOA_CLEAR | TIMER_CC_CTRL_MODE_PWM;
@@ -301,8 +870,9 @@ void init_timers()
     // Timer 1
     cmu_hfper0_clock_gate(CMU_HFPERCLKEN0_TIMER1, 1);
 
-    TIMER1->CTRL = TIMER_CTRL_RSSCOIST | TIMER_CTRL_PRESC_DIV1 | TIMER_CTRL_CLKSEL_PRESCHFPERCLK | TIMER_CTRL_FALLA_NONE | TIMER_CTRL_RISEA_NONE | TIMER_CTRL_MODE_UP;
+    TIMER1->CTRL = TIMER_CTRL_RSSCOIST | TIMER_CTRL_DMACLRACT | TIMER_CTRL_PRESC_DIV1 | TIMER_CTRL_CLKSEL_PRESCHFPERCLK | TIMER_CTRL_FALLA_NONE | TIMER_CTRL_RISEA_NONE | TIMER_CTRL_MODE_UP;
     TIMER1->TOP = HFPER_CLOCK_FREQ / TIMER_PWM_DEF_FREQ_HZ - 1;
+    TIMER1->TOPB = TIMER1->TOP;
     TIMER1->CNT = 0x0000;
 
     TIMER1->CC[0].CTRL = TIMER_CC_CTRL_PRSCONF_LEVEL | TIMER_CC_CTRL_CUFOA_NONE | TIMER_CC_CTRL_COFOA_SET | TIMER_CC_CTRL_CMOA_CLEAR | TIMER_CC_CTRL_MODE_PWM;
@@ -324,6 +894,22 @@ void init_timers()
     TIMER0->CMD = TIMER_CMD_START;
     TIMER1->CMD = TIMER_CMD_START;
 }
+void restore_settings()
+{
+    float fValue;
+
+    if(config_get_float(CONFIG_KEY_PWM_FREQ, &fValue))
+    {
+        set_freq(fValue);
+
+        DBGPRINTLN_CTX("Restored PWM frequency %.3f Hz", get_freq());
+    }
+
+    // Through the spin-up sequencer so a full set of fans doesn't start at once
+    for(uint8_t i = 0; i < 7; i++)
+        if(config_get_float(CONFIG_KEY_DUTY(i), &fValue))
+            spinup_set_channel_dc(i, fValue);
+}
 void set_freq(float fFreq)
 {
     if(fFreq < TIMER_PWM_MIN_FREQ_HZ)
@@ -332,24 +918,68 @@ void set_freq(float fFreq)
     if(fFreq > TIMER_PWM_MAX_FREQ_HZ)
         return;
 
-    float fDutyBackup[7];
+    // Use the smallest prescaler that keeps TOP within 16 bits to get the best duty cycle resolution
+    uint8_t ubPrescaler = 0;
+    float fTicks = (float)HFPER_CLOCK_FREQ / fFreq;
 
-    for(uint8_t i = 0; i < 7; i++)
+    // TOP + 1 steps have to fit the 16 bit compare registers, a compare past TOP is what holds the output at 100%
+    while(fTicks > 65535.f && ubPrescaler < TIMER_PWM_MAX_PRESC)
+    {
+        fTicks /= 2.f;
+        ubPrescaler++;
+    }
+
+    uint32_t ulTicks = (uint32_t)(fTicks + 0.5f);
+
+    if(ulTicks > 65535)
+        ulTicks = 65535;
+
+    if(ubPrescaler == (TIMER0->CTRL & _TIMER_CTRL_PRESC_MASK) >> _TIMER_CTRL_PRESC_SHIFT)
     {
-        fDutyBackup[i] = get_channel_dc(i);
+        // Same prescaler, the period and the compare values are buffered and taken over together at the next overflow
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            TIMER0->TOPB = ulTicks - 1;
+            TIMER1->TOPB = ulTicks - 1;
+
+            for(uint8_t i = 0; i < 7; i++)
+                update_channel(i, 0);
+        }
 
-        set_channel_dc(i, 0.f);
+        return;
     }
 
-    TIMER0->TOPB = HFPER_CLOCK_FREQ / fFreq - 1;
-    TIMER1->TOPB = HFPER_CLOCK_FREQ / fFreq - 1;
+    // The prescaler is not buffered, stop both timers while it is changed
+    TIMER0->CMD = TIMER_CMD_STOP;
+    TIMER1->CMD = TIMER_CMD_STOP;
+
+    TIMER0->CTRL = (TIMER0->CTRL & ~_TIMER_CTRL_PRESC_MASK) | ((uint32_t)ubPrescaler << _TIMER_CTRL_PRESC_SHIFT);
+    TIMER0->TOP = ulTicks - 1;
+    TIMER0->TOPB = ulTicks - 1;
+    TIMER0->CNT = 0x0000;
+
+    TIMER1->CTRL = (TIMER1->CTRL & ~_TIMER_CTRL_PRESC_MASK) | ((uint32_t)ubPrescaler << _TIMER_CTRL_PRESC_SHIFT);
+    TIMER1->TOP = ulTicks - 1;
+    TIMER1->TOPB = ulTicks - 1;
+    TIMER1->CNT = 0x0000;
 
     for(uint8_t i = 0; i < 7; i++)
-        set_channel_dc(i, fDutyBackup[i]);
+        update_channel(i, 1); // Timers are stopped, load the compare values now instead of after the first period
+
+    TIMER0->CMD = TIMER_CMD_START;
+    TIMER1->CMD = TIMER_CMD_START;
 }
 float get_freq()
 {
-    return (float)HFPER_CLOCK_FREQ / (TIMER0->TOP + 1);
+    return (float)HFPER_CLOCK_FREQ / get_prescaler() / get_steps();
+}
+uint16_t get_prescaler()
+{
+    return 1 << ((TIMER0->CTRL & _TIMER_CTRL_PRESC_MASK) >> _TIMER_CTRL_PRESC_SHIFT);
+}
+uint16_t get_steps()
+{
+    return TIMER0->TOPB + 1; // Both timers share the period, the counter runs from 0 to TOP
 }
 void set_channel_dc(uint8_t ubChannel, float fDuty)
 {
@@ -359,581 +989,3044 @@ void set_channel_dc(uint8_t ubChannel, float fDuty)
     if(fDuty < 0 || fDuty > 1)
         return;
 
-    if(ubChannel > 2)
-        TIMER1->CC[ubChannel - 3].CCVB = (uint16_t)(fDuty * TIMER1->TOP);
-    else
-        TIMER0->CC[ubChannel].CCVB = (uint16_t)(fDuty * TIMER0->TOP);
+    pfChannelDuty[ubChannel] = fDuty;
+    pusChannelEffVoltage[ubChannel] = 0;
+
+    update_channel(ubChannel, 0);
 }
 float get_channel_dc(uint8_t ubChannel)
 {
     if(ubChannel > 6)
         return 0.f;
 
-    if(ubChannel > 2)
-        return (float)TIMER1->CC[ubChannel - 3].CCV / TIMER1->TOP;
-    else
-        return (float)TIMER0->CC[ubChannel].CCV / TIMER0->TOP;
-}
+    if(pusChannelEffVoltage[ubChannel])
+        return (float)get_channel_compare(ubChannel) / get_steps();
 
-int init()
+    return pfChannelDuty[ubChannel];
+}
+uint16_t get_channel_compare(uint8_t ubChannel)
 {
-    rmu_init(RMU_CTRL_PINRMODE_FULL, RMU_CTRL_SYSRMODE_EXTENDED, RMU_CTRL_LOCKUPRMODE_EXTENDED, RMU_CTRL_WDOGRMODE_EXTENDED); // Init RMU and set reset modes
+    uint32_t ulSteps = get_steps();
 
-    emu_init(1); // Init EMU, ignore DCDC and switch digital power immediatly to DVDD
+    if(ubTachKick & BIT(ubChannel))
+        return ulSteps;
 
-    cmu_init(); // Init Clocks
+    if(!pusChannelEffVoltage[ubChannel])
+        return (uint16_t)(pfChannelDuty[ubChannel] * ulSteps);
 
-    dbg_init(); // Init Debug module
-    dbg_swo_config(BIT(0) | BIT(1), 200000); // Init SWO channels 0 and 1 at 200 kHz
+    if(!usVEXTVoltage)
+        return 0;
 
-    msc_init(); // Init Flash, RAM and caches
+    // Duty = Veff / VEXT, both operands are 16 bit so the product fits in 32 bits
+    uint32_t ulCompare = ((uint32_t)pusChannelEffVoltage[ubChannel] * ulSteps + (usVEXTVoltage >> 1)) / usVEXTVoltage;
 
-    systick_init(); // Init system tick
+    if(ulCompare > ulSteps)
+        ulCompare = ulSteps;
 
-    wdog_init((8 <<_WDOG_CTRL_PERSEL_SHIFT) | (3 << _WDOG_CTRL_WARNSEL_SHIFT)); // Init the watchdog timer, 2049 ms timeout, 75% warning
-    wdog_set_warning_isr(wdog_warning_isr);
+    return ulCompare;
+}
+void update_channel(uint8_t ubChannel, uint8_t ubImmediate)
+{
+    if(ubChannel > 6)
+        return;
 
-    gpio_init(); // Init GPIOs
-    ldma_init(); // Init LDMA
-    rtcc_init(); // Init RTCC
-    crc_init(); // Init CRC calculation unit
-    adc_init(); // Init ADCs
+    pwm_burst_t *pBurst = &pxBurst[ubChannel > 2 ? 1 : 0];
+    uint8_t ubCC = ubChannel - pBurst->ubFirstChannel;
+    uint16_t usCompare = get_channel_compare(ubChannel);
 
-    float fAVDDHighThresh, fAVDDLowThresh;
-    float fDVDDHighThresh, fDVDDLowThresh;
-    float fIOVDDHighThresh, fIOVDDLowThresh;
+    if(ubImmediate)
+        pBurst->pTimer->CC[ubCC].CCV = usCompare;
 
-    emu_vmon_avdd_config(1, 3.1f, &fAVDDLowThresh, 3.22f, &fAVDDHighThresh); // Enable AVDD monitor
-    emu_vmon_dvdd_config(1, 3.1f, &fDVDDLowThresh); // Enable DVDD monitor
-    emu_vmon_iovdd_config(1, 3.15f, &fIOVDDLowThresh); // Enable IOVDD monitor
+    if(pBurst->ubFrameCount)
+        burst_update_channel(pBurst, ubChannel, usCompare); // The LDMA owns CCVB while a burst pattern is running
+    else
+        pBurst->pTimer->CC[ubCC].CCVB = usCompare;
+}
+void set_channel_eff_voltage(uint8_t ubChannel, uint16_t usVoltage)
+{
+    if(ubChannel > 6)
+        return;
 
-    fDVDDHighThresh = fDVDDLowThresh + 0.026f; // Hysteresis from datasheet
-    fIOVDDHighThresh = fIOVDDLowThresh + 0.026f; // Hysteresis from datasheet
+    if(!usVoltage)
+    {
+        set_channel_dc(ubChannel, get_channel_dc(ubChannel)); // Hold the current duty cycle
 
-    usart0_init(115200, USART_FRAME_STOPBITS_ONE | USART_FRAME_PARITY_NONE | USART_FRAME_DATABITS_EIGHT, 17, 19, -1, -1);
-    i2c0_init(I2C_NORMAL, 31, 1);
+        return;
+    }
 
-    char szDeviceName[32];
+    if(!usVEXTVoltage)
+        usVEXTVoltage = adc_get_vext();
 
-    get_device_name(szDeviceName, 32);
+    pusChannelEffVoltage[ubChannel] = usVoltage;
 
-    DBGPRINTLN_CTX("USB Fan Controller v%lu (%s %s)!", BUILD_VERSION, __DATE__, __TIME__);
-    DBGPRINTLN_CTX("Device: %s", szDeviceName);
-    DBGPRINTLN_CTX("Device Revision: 0x%04X", get_device_revision());
-    DBGPRINTLN_CTX("Calibration temperature: %hhu C", (DEVINFO->CAL & _DEVINFO_CAL_TEMP_MASK) >> _DEVINFO_CAL_TEMP_SHIFT);
-    DBGPRINTLN_CTX("Flash Size: %hu kB", FLASH_SIZE >> 10);
-    DBGPRINTLN_CTX("RAM Size: %hu kB", SRAM_SIZE >> 10);
-    DBGPRINTLN_CTX("Free RAM: %lu B", get_free_ram());
-    DBGPRINTLN_CTX("Unique ID: %08X-%08X", DEVINFO->UNIQUEH, DEVINFO->UNIQUEL);
+    update_channel(ubChannel, 0);
+}
+uint16_t get_channel_eff_voltage(uint8_t ubChannel)
+{
+    if(ubChannel > 6)
+        return 0;
 
-    DBGPRINTLN_CTX("RMU - Reset cause: %hhu", rmu_get_reset_reason());
-    DBGPRINTLN_CTX("RMU - Reset state: %hhu", rmu_get_reset_state());
+    return pusChannelEffVoltage[ubChannel];
+}
+void vext_comp_task()
+{
+    static uint64_t ullLastTick = 0;
 
-    rmu_clear_reset_reason();
-    rmu_set_reset_state(0x00);
+    uint8_t ubActive = 0;
 
-    DBGPRINTLN_CTX("CMU - HFXO Oscillator: %.3f MHz", (float)HFXO_OSC_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - HFRCO Oscillator: %.3f MHz", (float)HFRCO_OSC_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - AUXHFRCO Oscillator: %.3f MHz", (float)AUXHFRCO_OSC_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - LFXO Oscillator: %.3f kHz", (float)LFXO_OSC_FREQ / 1000);
-    DBGPRINTLN_CTX("CMU - LFRCO Oscillator: %.3f kHz", (float)LFRCO_OSC_FREQ / 1000);
-    DBGPRINTLN_CTX("CMU - ULFRCO Oscillator: %.3f kHz", (float)ULFRCO_OSC_FREQ / 1000);
-    DBGPRINTLN_CTX("CMU - HFSRC Clock: %.3f MHz", (float)HFSRC_CLOCK_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - HF Clock: %.3f MHz", (float)HF_CLOCK_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - HFCORE Clock: %.3f MHz", (float)HFCORE_CLOCK_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - HFEXP Clock: %.3f MHz", (float)HFEXP_CLOCK_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - HFPER Clock: %.3f MHz", (float)HFPER_CLOCK_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - HFLE Clock: %.3f MHz", (float)HFLE_CLOCK_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - ADC0 Clock: %.3f MHz", (float)ADC0_CLOCK_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - DBG Clock: %.3f MHz", (float)DBG_CLOCK_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - AUX Clock: %.3f MHz", (float)AUX_CLOCK_FREQ / 1000000);
-    DBGPRINTLN_CTX("CMU - LFA Clock: %.3f kHz", (float)LFA_CLOCK_FREQ / 1000);
-    DBGPRINTLN_CTX("CMU - LETIMER0 Clock: %.3f kHz", (float)LETIMER0_CLOCK_FREQ / 1000);
-    DBGPRINTLN_CTX("CMU - LFB Clock: %.3f kHz", (float)LFB_CLOCK_FREQ / 1000);
-    DBGPRINTLN_CTX("CMU - LEUART0 Clock: %.3f kHz", (float)LEUART0_CLOCK_FREQ / 1000);
-    DBGPRINTLN_CTX("CMU - LFE Clock: %.3f kHz", (float)LFE_CLOCK_FREQ / 1000);
-    DBGPRINTLN_CTX("CMU - RTCC Clock: %.3f kHz", (float)RTCC_CLOCK_FREQ / 1000);
+    for(uint8_t i = 0; i < 7; i++)
+        if(pusChannelEffVoltage[i])
+            ubActive = 1;
 
-    DBGPRINTLN_CTX("EMU - AVDD Fall Threshold: %.2f mV!", fAVDDLowThresh * 1000);
-    DBGPRINTLN_CTX("EMU - AVDD Rise Threshold: %.2f mV!", fAVDDHighThresh * 1000);
-    DBGPRINTLN_CTX("EMU - AVDD Voltage: %.2f mV", adc_get_avdd());
-    DBGPRINTLN_CTX("EMU - AVDD Status: %s", g_ubAVDDLow ? "LOW" : "OK");
-    DBGPRINTLN_CTX("EMU - DVDD Fall Threshold: %.2f mV!", fDVDDLowThresh * 1000);
-    DBGPRINTLN_CTX("EMU - DVDD Rise Threshold: %.2f mV!", fDVDDHighThresh * 1000);
-    DBGPRINTLN_CTX("EMU - DVDD Voltage: %.2f mV", adc_get_dvdd());
-    DBGPRINTLN_CTX("EMU - DVDD Status: %s", g_ubDVDDLow ? "LOW" : "OK");
-    DBGPRINTLN_CTX("EMU - IOVDD Fall Threshold: %.2f mV!", fIOVDDLowThresh * 1000);
-    DBGPRINTLN_CTX("EMU - IOVDD Rise Threshold: %.2f mV!", fIOVDDHighThresh * 1000);
-    DBGPRINTLN_CTX("EMU - IOVDD Voltage: %.2f mV", adc_get_iovdd());
-    DBGPRINTLN_CTX("EMU - IOVDD Status: %s", g_ubIOVDDLow ? "LOW" : "OK");
-    DBGPRINTLN_CTX("EMU - Core Voltage: %.2f mV", adc_get_corevdd());
-    DBGPRINTLN_CTX("EMU - 5V0 Voltage: %.2f mV", adc_get_5v0());
-    DBGPRINTLN_CTX("EMU - VEXT Voltage: %.2f mV", adc_get_vext());
+    if(!ubActive)
+        return;
 
-    DBGPRINTLN_CTX("Scanning I2C bus 0...");
+    if(!period_elapsed(&ullLastTick, VEXT_COMP_PERIOD_MS))
+        return;
 
-    for(uint8_t a = 0x08; a < 0x78; a++)
-    {
-        if(i2c0_write(a, 0, 0, I2C_STOP))
-            DBGPRINTLN_CTX("  Address 0x%02X ACKed!", a);
-    }
+    usVEXTVoltage = adc_get_vext();
 
-    return 0;
+    for(uint8_t i = 0; i < 7; i++)
+        if(pusChannelEffVoltage[i])
+            update_channel(i, 0);
 }
-int main()
+uint8_t set_channel_burst(uint8_t ubChannel, uint8_t ubOnPeriods, uint8_t ubOffPeriods)
 {
-    init_timers();
+    if(ubChannel > 6)
+        return 0;
 
-    while(1)
-    {
-        wdog_feed();
+    if(ubOffPeriods && !ubOnPeriods)
+        return 0;
 
-        static uint64_t ullLastUSARTChange = 0;
-        static uint32_t ulLastUSARTAvailable = 0;
+    if(!ubOffPeriods)
+        ubOnPeriods = 0;
 
-        if(usart0_available() != ulLastUSARTAvailable)
+    if((uint32_t)ubOnPeriods + ubOffPeriods > TIMER_PWM_BURST_FRAMES)
+        return 0;
+
+    pwm_burst_t *pBurst = &pxBurst[ubChannel > 2 ? 1 : 0];
+
+    uint8_t ubOldOnPeriods = pubBurstOnPeriods[ubChannel];
+    uint8_t ubOldOffPeriods = pubBurstOffPeriods[ubChannel];
+
+    pubBurstOnPeriods[ubChannel] = ubOnPeriods;
+    pubBurstOffPeriods[ubChannel] = ubOffPeriods;
+
+    if(burst_calc_frames(pBurst) > TIMER_PWM_BURST_FRAMES)
+    {
+        pubBurstOnPeriods[ubChannel] = ubOldOnPeriods;
+        pubBurstOffPeriods[ubChannel] = ubOldOffPeriods;
+
+        return 0;
+    }
+
+    return burst_rebuild(pBurst);
+}
+void get_channel_burst(uint8_t ubChannel, uint8_t *pubOnPeriods, uint8_t *pubOffPeriods)
+{
+    if(ubChannel > 6)
+        return;
+
+    if(pubOnPeriods)
+        *pubOnPeriods = pubBurstOnPeriods[ubChannel];
+
+    if(pubOffPeriods)
+        *pubOffPeriods = pubBurstOffPeriods[ubChannel];
+}
+void burst_update_channel(pwm_burst_t *pBurst, uint8_t ubChannel, uint16_t usCompare)
+{
+    pusBurstCompare[ubChannel] = usCompare;
+    pBurst->ubDirty = 1;
+
+    burst_swap(pBurst);
+}
+void burst_render(pwm_burst_t *pBurst, uint8_t ubTable)
+{
+    volatile uint32_t *pulFrames = &pBurst->pulFrames[ubTable * TIMER_PWM_BURST_FRAMES * pBurst->ubChannelCount];
+
+    for(uint8_t i = 0; i < pBurst->ubFrameCount; i++)
+    {
+        for(uint8_t j = 0; j < pBurst->ubChannelCount; j++)
         {
-            ulLastUSARTAvailable = usart0_available();
-            ullLastUSARTChange = g_ullSystemTick;
+            uint8_t ubChannel = pBurst->ubFirstChannel + j;
+            uint8_t ubOnPeriods = pubBurstOnPeriods[ubChannel];
+            uint8_t ubPeriods = ubOnPeriods + pubBurstOffPeriods[ubChannel];
+            uint8_t ubOn = !ubPeriods || (i % ubPeriods) < ubOnPeriods;
+
+            pulFrames[i * pBurst->ubChannelCount + j] = ubOn ? pusBurstCompare[ubChannel] : 0;
         }
+    }
+}
+void burst_swap(pwm_burst_t *pBurst)
+{
+    if(!pBurst->ubFrameCount)
+        return;
+
+    if(pBurst->ubSwapState == BURST_SWAP_DRAINING)
+    {
+        // Descriptors are loaded one ahead, the old table is free once the LDMA source is past it
+        uint32_t ulOld = (uint32_t)&pBurst->pulFrames[(pBurst->ubActiveTable ^ 1) * TIMER_PWM_BURST_FRAMES * pBurst->ubChannelCount];
+        uint32_t ulSource = (uint32_t)ldma_ch_get_next_src_addr(pBurst->ubDMAChannel);
 
-        if(ulLastUSARTAvailable != 0 && g_ullSystemTick - ullLastUSARTChange > 2000)
+        if(ulSource >= ulOld && ulSource <= ulOld + (uint32_t)pBurst->ubFrameCount * pBurst->ubChannelCount * sizeof(uint32_t))
         {
-            DBGPRINTLN_CTX("Clearing USART buffer...");
+            if(pBurst->ubDirty) // Only an update waits on the LDMA leaving the old table, nothing wakes the core for it
+                sleep_deadline(0);
 
-            usart0_flush();
+            return;
         }
 
-        if(usart0_available() >= sizeof(usart_cmd_header_t))
+        pBurst->ubSwapState = BURST_SWAP_IDLE;
+    }
+
+    if(!pBurst->ubDirty)
+        return;
+
+    uint8_t ubSwitched = 0;
+
+    // A swap still pending is called off while its table is rendered again, the interrupt ignores the wrap until it is armed
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(pBurst->ubSwapState == BURST_SWAP_DRAINING)
+            ubSwitched = 1; // It went through since the check above, burst_task tries again
+        else
+            pBurst->ubSwapState = BURST_SWAP_IDLE;
+    }
+
+    if(ubSwitched)
+    {
+        sleep_deadline(0);
+
+        return;
+    }
+
+    pBurst->ubDirty = 0;
+
+    burst_render(pBurst, pBurst->ubActiveTable ^ 1);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pBurst->ubSwapState = BURST_SWAP_PENDING;
+        pBurst->pDescriptors[pBurst->ubFrameCount - 1].CTRL |= LDMA_CH_CTRL_DONEIFSEN;
+    }
+}
+void burst_dma_isr(pwm_burst_t *pBurst)
+{
+    pBurst->pDescriptors[pBurst->ubFrameCount - 1].CTRL &= ~LDMA_CH_CTRL_DONEIFSEN;
+
+    if(pBurst->ubSwapState != BURST_SWAP_PENDING)
+        return;
+
+    // Only the source pointers change here, a descriptor the LDMA already fetched still reads the intact old table
+    pBurst->ubActiveTable ^= 1;
+
+    volatile uint32_t *pulFrames = &pBurst->pulFrames[pBurst->ubActiveTable * TIMER_PWM_BURST_FRAMES * pBurst->ubChannelCount];
+
+    for(uint8_t i = 0; i < pBurst->ubFrameCount; i++)
+        pBurst->pDescriptors[i].SRC = &pulFrames[i * pBurst->ubChannelCount];
+
+    pBurst->ubSwapState = BURST_SWAP_DRAINING;
+}
+void burst0_dma_isr(uint8_t ubError)
+{
+    if(ubError || !pxBurst[0].ubFrameCount)
+        return;
+
+    burst_dma_isr(&pxBurst[0]);
+}
+void burst1_dma_isr(uint8_t ubError)
+{
+    if(ubError || !pxBurst[1].ubFrameCount)
+        return;
+
+    burst_dma_isr(&pxBurst[1]);
+}
+void burst_task()
+{
+    // Picks up the updates that came in while the old table was still draining
+    burst_swap(&pxBurst[0]);
+    burst_swap(&pxBurst[1]);
+}
+uint32_t burst_calc_frames(pwm_burst_t *pBurst)
+{
+    uint32_t ulFrames = 1;
+
+    // The pattern table must hold a whole number of cycles of every bursting channel
+    for(uint8_t i = pBurst->ubFirstChannel; i < pBurst->ubFirstChannel + pBurst->ubChannelCount; i++)
+    {
+        if(!pubBurstOffPeriods[i])
+            continue;
+
+        uint32_t ulPeriods = pubBurstOnPeriods[i] + pubBurstOffPeriods[i];
+        uint32_t a = ulFrames;
+        uint32_t b = ulPeriods;
+
+        while(b)
         {
-            usart_cmd_header_t xHeader;
+            uint32_t t = a % b;
 
-            DBGPRINTLN_CTX("Reading header...");
-            usart0_read((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+            a = b;
+            b = t;
+        }
 
-            DBGPRINTLN_CTX("Header [M %04X] [C %02X] [S %02X]", xHeader.usMagic, xHeader.ubCommand, xHeader.ubPayloadSize);
+        ulFrames = ulFrames / a * ulPeriods;
 
-            if(xHeader.usMagic != USART_HEADER_MAGIC)
+        if(ulFrames > TIMER_PWM_BURST_FRAMES)
+            break;
+    }
+
+    return ulFrames;
+}
+uint8_t burst_rebuild(pwm_burst_t *pBurst)
+{
+    uint32_t ulFrames = burst_calc_frames(pBurst);
+
+    ldma_ch_disable(pBurst->ubDMAChannel);
+    ldma_ch_peri_req_disable(pBurst->ubDMAChannel);
+    ldma_ch_req_clear(pBurst->ubDMAChannel);
+
+    pBurst->ubFrameCount = 0;
+    pBurst->ubActiveTable = 0;
+    pBurst->ubDirty = 0;
+    pBurst->ubSwapState = BURST_SWAP_IDLE;
+
+    if(ulFrames <= 1 || ulFrames > TIMER_PWM_BURST_FRAMES)
+    {
+        uint8_t ubSuccess = ulFrames <= 1;
+
+        // Plain PWM on all channels of this timer, including the ones whose pattern did not fit
+        for(uint8_t i = pBurst->ubFirstChannel; i < pBurst->ubFirstChannel + pBurst->ubChannelCount; i++)
+        {
+            if(!ubSuccess)
             {
-                DBGPRINTLN_CTX("Invalid magic!");
+                pubBurstOnPeriods[i] = 0;
+                pubBurstOffPeriods[i] = 0;
+            }
+
+            update_channel(i, 0);
+        }
+
+        return ubSuccess;
+    }
+
+    for(uint8_t i = pBurst->ubFirstChannel; i < pBurst->ubFirstChannel + pBurst->ubChannelCount; i++)
+        pusBurstCompare[i] = get_channel_compare(i);
+
+    pBurst->ubFrameCount = ulFrames;
+
+    burst_render(pBurst, 0); // The channel is stopped, nothing to race with
+
+    // One descriptor per PWM period, each one writes all CCVB registers of the timer on overflow
+    for(uint8_t i = 0; i < ulFrames; i++)
+    {
+        pBurst->pDescriptors[i].CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_DSTINC_FOUR | LDMA_CH_CTRL_SIZE_WORD | LDMA_CH_CTRL_SRCINC_ONE | LDMA_CH_CTRL_IGNORESREQ | LDMA_CH_CTRL_REQMODE_BLOCK | pBurst->ulDMABlockSize | ((((uint32_t)pBurst->ubChannelCount - 1) << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+        pBurst->pDescriptors[i].SRC = &pBurst->pulFrames[i * pBurst->ubChannelCount];
+        pBurst->pDescriptors[i].DST = &pBurst->pTimer->CC[0].CCVB; // CC blocks are 4 words apart
+        pBurst->pDescriptors[i].LINK = (uint32_t)&pBurst->pDescriptors[(i + 1) % ulFrames] | LDMA_CH_LINK_LINK;
+    }
+
+    ldma_ch_config(pBurst->ubDMAChannel, pBurst->ulDMASource, LDMA_CH_CFG_SRCINCSIGN_POSITIVE, LDMA_CH_CFG_DSTINCSIGN_POSITIVE, LDMA_CH_CFG_ARBSLOTS_DEFAULT, 0);
+    ldma_ch_load(pBurst->ubDMAChannel, pBurst->pDescriptors);
+    ldma_ch_peri_req_enable(pBurst->ubDMAChannel);
+    ldma_ch_enable(pBurst->ubDMAChannel);
+
+    return 1;
+}
+void spinup_set_channel_dc(uint8_t ubChannel, float fDuty)
+{
+    if(ubChannel > 6)
+        return;
+
+    if(fDuty < 0 || fDuty > 1)
+        return;
+
+    // Slowing a fan down never causes inrush, only speed increases are queued
+    if(fDuty <= get_channel_dc(ubChannel))
+    {
+        ubSpinUpPending &= ~BIT(ubChannel);
+
+        set_channel_dc(ubChannel, fDuty);
+
+        return;
+    }
+
+    pfSpinUpDuty[ubChannel] = fDuty;
+    pusSpinUpEffVoltage[ubChannel] = 0;
+    ubSpinUpPending |= BIT(ubChannel);
+}
+void spinup_set_channel_eff_voltage(uint8_t ubChannel, uint16_t usVoltage)
+{
+    if(ubChannel > 6)
+        return;
+
+    uint16_t usVEXT = usVEXTVoltage ? usVEXTVoltage : adc_get_vext();
+
+    // Same rule as for duty cycles, judged by the duty cycle the voltage works out to right now
+    if(!usVoltage || !usVEXT || (float)usVoltage / usVEXT <= get_channel_dc(ubChannel))
+    {
+        ubSpinUpPending &= ~BIT(ubChannel);
+
+        set_channel_eff_voltage(ubChannel, usVoltage);
+
+        return;
+    }
+
+    pusSpinUpEffVoltage[ubChannel] = usVoltage;
+    ubSpinUpPending |= BIT(ubChannel);
+}
+void spinup_task()
+{
+    static uint8_t ubState = SPINUP_STATE_IDLE;
+    static uint8_t ubChannel = 0;
+    static uint64_t ullStateTick = 0;
+    static uint64_t ullLastPollTick = 0;
+    static float fVEXTBaseline = 0.f;
+
+    switch(ubState)
+    {
+        case SPINUP_STATE_IDLE:
+        {
+            if(!ubSpinUpPending)
+                return;
+
+            ubChannel = 0;
+
+            while(!(ubSpinUpPending & BIT(ubChannel)))
+                ubChannel++;
+
+            ubSpinUpPending &= ~BIT(ubChannel);
+
+            if(usSpinUpDroopThreshold)
+                fVEXTBaseline = adc_get_vext();
+
+            if(pusSpinUpEffVoltage[ubChannel])
+                set_channel_eff_voltage(ubChannel, pusSpinUpEffVoltage[ubChannel]);
+            else
+                set_channel_dc(ubChannel, pfSpinUpDuty[ubChannel]);
+
+            ullStateTick = now_ms();
+            ubState = SPINUP_STATE_DELAY;
+
+            sleep_deadline(ullStateTick + pusSpinUpDelay[ubChannel]);
+        }
+        break;
+        case SPINUP_STATE_DELAY:
+        {
+            if(now_ms() - ullStateTick < pusSpinUpDelay[ubChannel])
+            {
+                sleep_deadline(ullStateTick + pusSpinUpDelay[ubChannel]);
+
+                return;
+            }
+
+            ullStateTick = now_ms();
+            ubState = usSpinUpDroopThreshold ? SPINUP_STATE_DROOP : SPINUP_STATE_IDLE;
+
+            sleep_deadline(0); // The droop check or the next channel goes right away
+        }
+        break;
+        case SPINUP_STATE_DROOP:
+        {
+            if(!period_elapsed(&ullLastPollTick, SPINUP_DROOP_POLL_MS))
+                return;
+
+            if(adc_get_vext() + usSpinUpDroopThreshold >= fVEXTBaseline)
+            {
+                ubState = SPINUP_STATE_IDLE;
+
+                sleep_deadline(0);
+            }
+            else if(now_ms() - ullStateTick > usSpinUpDroopTimeout)
+            {
+                DBGPRINTLN_CTX("VEXT did not recover after starting channel %hhu, continuing", ubChannel);
+
+                ubState = SPINUP_STATE_IDLE;
+
+                sleep_deadline(0);
+            }
+        }
+        break;
+    }
+}
+uint8_t get_temperature(uint8_t ubSource, float *pfTemperature)
+{
+    switch(ubSource)
+    {
+        case USART_TEMP_EMU:
+        {
+            *pfTemperature = emu_get_temperature();
+        }
+        break;
+        case USART_TEMP_ADC:
+        {
+            *pfTemperature = adc_get_temperature();
+        }
+        break;
+        default:
+        {
+            if(ubSource < USART_TEMP_EXT_BASE || ubSource >= USART_TEMP_COUNT)
+                return 0;
+
+            uint8_t ubSensor = ubSource - USART_TEMP_EXT_BASE;
+
+            if(ubSensor >= ubSensorCount || !(ubSensorValid & BIT(ubSensor)))
+                return 0;
+
+            *pfTemperature = pfSensorTemperature[ubSensor];
+        }
+        break;
+    }
+
+    return 1;
+}
+void fan_curve_task()
+{
+    static uint64_t ullLastTick = 0;
+
+    if(!period_elapsed(&ullLastTick, FAN_CURVE_PERIOD_MS))
+        return;
+
+    float pfTemperature[USART_TEMP_COUNT];
+    uint8_t pubTemperatureState[USART_TEMP_COUNT] = {0}; // 0 - Not read, 1 - Valid, 2 - Failed
+
+    for(uint8_t i = 0; i < 7; i++)
+    {
+        fan_curve_t *pCurve = &pxFanCurve[i];
+        uint8_t ubSource = pubFanCurveSource[i];
+
+        if(!pCurve->ubPointCount)
+            continue;
+
+        // Each source is read at most once per pass, even if several curves use it
+        if(!pubTemperatureState[ubSource])
+            pubTemperatureState[ubSource] = get_temperature(ubSource, &pfTemperature[ubSource]) ? 1 : 2;
+
+        uint16_t usDuty;
+
+        if(pubTemperatureState[ubSource] == 1)
+        {
+            float fTemperature = pfTemperature[ubSource];
+
+            if(fTemperature > 127.f)
+                fTemperature = 127.f;
+
+            if(fTemperature < -128.f)
+                fTemperature = -128.f;
+
+            usDuty = fan_curve_eval(pCurve, (int16_t)(fTemperature * 256.f));
+        }
+        else
+        {
+            usDuty = pCurve->usMaxDuty; // Fail safe, run at the maximum allowed speed without a reading
+        }
+
+        pusFanCurveDuty[i] = usDuty;
+
+        spinup_set_channel_dc(i, usDuty / 65535.f);
+    }
+}
+void stop_channel_control(uint8_t ubChannel)
+{
+    if(ubChannel > 6)
+        return;
+
+    pxFanCurve[ubChannel].ubPointCount = 0;
+    ubPIDActive &= ~BIT(ubChannel);
+
+    if(!ubPIDActive)
+        rtcc_set_tick(0, NULL);
+}
+void pid_tick_isr()
+{
+    usPIDTicks++;
+}
+void pid_task()
+{
+    uint16_t usTicks;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        usTicks = usPIDTicks;
+        usPIDTicks = 0;
+    }
+
+    if(!usTicks || !ubPIDActive)
+        return;
+
+    float pfTemperature[USART_TEMP_COUNT];
+    uint8_t pubTemperatureState[USART_TEMP_COUNT] = {0}; // 0 - Not read, 1 - Valid, 2 - Failed
+
+    for(uint8_t i = 0; i < 7; i++)
+    {
+        if(!(ubPIDActive & BIT(i)))
+            continue;
+
+        if(pusPIDCountdown[i] > usTicks)
+        {
+            pusPIDCountdown[i] -= usTicks;
+
+            continue;
+        }
+
+        pusPIDCountdown[i] = pusPIDPeriod[i]; // Ticks missed while the main loop was busy are not made up, the gains are per sample
+
+        uint8_t ubSource = pubPIDSource[i];
+
+        if(!pubTemperatureState[ubSource])
+            pubTemperatureState[ubSource] = get_temperature(ubSource, &pfTemperature[ubSource]) ? 1 : 2;
+
+        if(pubTemperatureState[ubSource] == 1)
+        {
+            float fTemperature = pfTemperature[ubSource];
+
+            if(fTemperature > 127.f)
+                fTemperature = 127.f;
+
+            if(fTemperature < -128.f)
+                fTemperature = -128.f;
+
+            psPIDTemperature[i] = (int16_t)(fTemperature * 256.f);
+            pusPIDDuty[i] = pid_step(&pxPID[i], psPIDTemperature[i]);
+        }
+        else
+        {
+            pusPIDDuty[i] = pxPID[i].usMaxOutput; // Fail safe, run at the maximum allowed speed without a reading
+        }
+
+        spinup_set_channel_dc(i, pusPIDDuty[i] / 65535.f); // Like the fan curves, so a start from 0% waits for its turn
+    }
+}
+uint8_t one_wire_cache_load()
+{
+    const one_wire_rom_cache_t *pCache = (const one_wire_rom_cache_t *)ONE_WIRE_ROM_CACHE_ADDR;
+
+    if(pCache->ulMagic != ONE_WIRE_ROM_CACHE_MAGIC)
+        return 0;
+
+    if(!pCache->ubCount || pCache->ubCount > ONE_WIRE_MAX_SENSORS)
+        return 0;
+
+    if(calc_crc32((uint8_t *)pCache, sizeof(one_wire_rom_cache_t) - sizeof(uint32_t)) != pCache->ulCRC)
+        return 0;
+
+    // Match-ROM each cached sensor, a CRC valid scratchpad proves it is still on the bus
+    for(uint8_t i = 0; i < pCache->ubCount; i++)
+    {
+        uint8_t ubScratchpad[9];
+
+        if(!ds18b20_read_scratchpad(pCache->ubROM[i], 0, ubScratchpad))
+        {
+            DBGPRINTLN_CTX("  Cached 1-Wire device %02X%02X%02X%02X%02X%02X%02X%02X missing", pCache->ubROM[i][7], pCache->ubROM[i][6], pCache->ubROM[i][5], pCache->ubROM[i][4], pCache->ubROM[i][3], pCache->ubROM[i][2], pCache->ubROM[i][1], pCache->ubROM[i][0]);
+
+            return 0;
+        }
+    }
+
+    for(uint8_t i = 0; i < pCache->ubCount; i++)
+        for(uint8_t j = 0; j < 8; j++)
+            pubSensorROM[i][j] = pCache->ubROM[i][j];
+
+    ubSensorCount = pCache->ubCount;
+    ubSensorValid = 0x00;
+
+    one_wire_probe();
+
+    return 1;
+}
+void one_wire_cache_store()
+{
+    const one_wire_rom_cache_t *pCache = (const one_wire_rom_cache_t *)ONE_WIRE_ROM_CACHE_ADDR;
+    one_wire_rom_cache_t xCache = {0};
+
+    xCache.ulMagic = ONE_WIRE_ROM_CACHE_MAGIC;
+    xCache.ubCount = ubSensorCount;
+
+    for(uint8_t i = 0; i < ubSensorCount; i++)
+        for(uint8_t j = 0; j < 8; j++)
+            xCache.ubROM[i][j] = pubSensorROM[i][j];
+
+    xCache.ulCRC = calc_crc32((uint8_t *)&xCache, sizeof(one_wire_rom_cache_t) - sizeof(uint32_t));
+
+    uint8_t ubChanged = 0;
+
+    for(uint32_t i = 0; i < sizeof(one_wire_rom_cache_t); i++)
+        ubChanged |= ((const uint8_t *)pCache)[i] != ((uint8_t *)&xCache)[i];
+
+    if(!ubChanged) // Spare the page an erase cycle
+        return;
+
+    DBGPRINTLN_CTX("Updating 1-Wire ROM cache...");
+
+    msc_flash_page_erase(ONE_WIRE_ROM_CACHE_ADDR);
+    msc_flash_page_write(ONE_WIRE_ROM_CACHE_ADDR, (uint8_t *)&xCache, sizeof(one_wire_rom_cache_t));
+}
+void one_wire_probe()
+{
+    ubSensorOverdrive = 0x00;
+    ubSensorConverting = 0x00;
+
+    for(uint8_t i = 0; i < ubSensorCount; i++)
+        if(!ds18b20_read_resolution(pubSensorROM[i], 0, &pubSensorResolution[i]))
+            pubSensorResolution[i] = DS18B20_MAX_RESOLUTION;
+
+    if(!ds18b20_read_power_supply(NULL, &ubSensorParasite))
+        ubSensorParasite = 1; // Assume the worst, broadcast rounds work either way
+
+    DBGPRINTLN_CTX("1-Wire bus is %s powered", ubSensorParasite ? "parasite" : "externally");
+}
+void one_wire_update(uint8_t (*pubROM)[8], uint8_t ubCount)
+{
+    uint8_t ubSensors = 0;
+    uint8_t ubChanged = 0;
+
+    for(uint8_t i = 0; i < ubCount; i++)
+    {
+        DBGPRINTLN_CTX("  1-Wire device %02X%02X%02X%02X%02X%02X%02X%02X", pubROM[i][7], pubROM[i][6], pubROM[i][5], pubROM[i][4], pubROM[i][3], pubROM[i][2], pubROM[i][1], pubROM[i][0]);
+
+        if(pubROM[i][0] != DS18B20_FAMILY_CODE)
+            continue;
+
+        for(uint8_t j = 0; j < 8; j++)
+        {
+            ubChanged |= ubSensors >= ubSensorCount || pubSensorROM[ubSensors][j] != pubROM[i][j];
+
+            pubSensorROM[ubSensors][j] = pubROM[i][j];
+        }
+
+        ubSensors++;
+    }
+
+    if(ubChanged || ubSensors != ubSensorCount) // Keep the last readings when the bus did not change
+    {
+        ubSensorCount = ubSensors;
+        ubSensorValid = 0x00;
+
+        one_wire_probe();
+    }
+
+    one_wire_cache_store();
+}
+void one_wire_scan()
+{
+    uint8_t ubROM[ONE_WIRE_MAX_SENSORS][8];
+    uint8_t ubCount = ds2484_one_wire_search(ubROM, ONE_WIRE_MAX_SENSORS);
+
+    one_wire_update(ubROM, ubCount);
+}
+void rail_alarm_isr(uint8_t ubInputs)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // The ADC0 and LDMA vectors and adc_task all call this
+    {
+        ubRailAlarmLatched |= ubInputs;
+        ubRailAlarmPending |= ubInputs;
+    }
+
+    if(!(ubInputs & ubRailAlarmForce))
+        return;
+
+    // Cut the outputs right here, rail_alarm_task makes it stick once the main loop gets to it
+    ldma_ch_disable(TIMER0_DMA_CHANNEL);
+    ldma_ch_disable(TIMER1_DMA_CHANNEL);
+
+    for(uint8_t i = 0; i < 7; i++)
+    {
+        pwm_burst_t *pBurst = &pxBurst[i > 2 ? 1 : 0];
+        uint8_t ubCC = i - pBurst->ubFirstChannel;
+        uint16_t usCompare = ((uint32_t)usRailAlarmSafeDuty * get_steps()) >> 16;
+
+        pBurst->pTimer->CC[ubCC].CCV = usCompare;
+        pBurst->pTimer->CC[ubCC].CCVB = usCompare;
+    }
+}
+uint8_t set_rail_alarm(uint8_t ubInput, uint8_t ubEnable, float fLow, float fHigh, uint8_t ubForceSafeDuty, float fSafeDuty)
+{
+    if(ubInput != ADC_INPUT_5V0 && ubInput != ADC_INPUT_VEXT)
+        return 0;
+
+    if(!ubEnable)
+    {
+        adc_clear_window(ubInput);
+
+        ubRailAlarmEnabled &= ~BIT(ubInput);
+        ubRailAlarmForce &= ~BIT(ubInput);
+
+        return 1;
+    }
+
+    if(fSafeDuty < 0 || fSafeDuty > 1)
+        return 0;
+
+    // Safe duty cycle first, the window may trip right away
+    if(ubForceSafeDuty)
+    {
+        usRailAlarmSafeDuty = fSafeDuty * 65535; // Shared by both rails
+        ubRailAlarmForce |= BIT(ubInput);
+    }
+    else
+    {
+        ubRailAlarmForce &= ~BIT(ubInput);
+    }
+
+    if(!adc_set_window(ubInput, fLow, fHigh))
+        return 0;
+
+    ubRailAlarmEnabled |= BIT(ubInput);
+
+    return 1;
+}
+void rail_alarm_task()
+{
+    uint8_t ubPending;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ubPending = ubRailAlarmPending;
+        ubRailAlarmPending = 0x00;
+    }
+
+    if(!ubPending)
+        return;
+
+    DBGPRINTLN_CTX("Rail alarm on inputs 0x%02X (5V0 %.2f mV, VEXT %.2f mV)", ubPending, adc_get_5v0(), adc_get_vext());
+
+    if(ubPending & ubRailAlarmForce)
+    {
+        float fSafeDuty = usRailAlarmSafeDuty / 65535.f;
+
+        ubSpinUpPending = 0x00;
+        ubTachKick = 0x00;
+
+        for(uint8_t i = 0; i < 7; i++)
+        {
+            stop_channel_control(i);
+
+            pubBurstOnPeriods[i] = 0;
+            pubBurstOffPeriods[i] = 0;
+            pusChannelEffVoltage[i] = 0;
+            pfChannelDuty[i] = fSafeDuty;
+        }
+
+        // Back to plain PWM, this also reloads every channel with the safe duty cycle
+        burst_rebuild(&pxBurst[0]);
+        burst_rebuild(&pxBurst[1]);
+    }
+
+    usart_cmd_header_t xHeader;
+    usart_cmd_rail_alarm_t xPayload;
+
+    xHeader.usMagic = USART_HEADER_MAGIC;
+    xHeader.ubCommand = USART_CMD_RAIL_ALARM;
+    xHeader.ubPayloadSize = sizeof(usart_cmd_rail_alarm_t);
+
+    xPayload.ubInputs = ubPending;
+    xPayload.f5V0 = adc_get_5v0();
+    xPayload.fVEXT = adc_get_vext();
+
+    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_rail_alarm_t));
+}
+uint8_t set_sample_period(uint16_t usPeriod)
+{
+    if(!usPeriod)
+    {
+        adc_set_trigger(0);
+        cryotimer_disable();
+
+        return 1;
+    }
+
+    if(usPeriod & (usPeriod - 1))
+        return 0;
+
+    uint8_t ubPeriodSel = 0;
+
+    while(BIT(ubPeriodSel) < usPeriod)
+        ubPeriodSel++;
+
+    // ULFRCO ticks at 1 kHz and keeps running in every energy mode, PRS hands the period pulses to the ADC sequence gate
+    cryotimer_init(CRYOTIMER_CTRL_OSCSEL_ULFRCO, CRYOTIMER_CTRL_PRESC_DIV1, ubPeriodSel);
+    adc_set_trigger(PRS_CH_CTRL_SOURCESEL_CRYOTIMER | PRS_CH_CTRL_SIGSEL_CRYOTIMERPERIOD);
+
+    return 1;
+}
+uint16_t get_sample_period()
+{
+    if(!adc_get_trigger())
+        return 0;
+
+    return cryotimer_get_period() * 1000 / ULFRCO_OSC_FREQ;
+}
+void rpm_task()
+{
+    static uint8_t ubChannel = 0;
+    static uint8_t ubCapturing = 0;
+    static uint32_t ulSampleRate = 0;
+    static uint64_t ullStartTick = 0;
+    static uint64_t ullLastTick = 0;
+
+    if(ubCapturing && ubRPMCaptureAborted)
+    {
+        ubCapturing = 0; // Same channel again on the next period
+
+        return;
+    }
+
+    if(ubCapturing)
+    {
+        if(adc_capture_busy())
+        {
+            if(now_ms() - ullStartTick <= RPM_CAPTURE_TIMEOUT_MS)
+            {
+                sleep_deadline(ullStartTick + RPM_CAPTURE_TIMEOUT_MS + 1);
+
+                return;
+            }
+
+            adc_capture_abort(); // The output stopped switching
+
+            pusChannelRPM[ubChannel] = 0;
+        }
+        else
+        {
+            pusChannelRPM[ubChannel] = rpm_estimate(pusRPMSamples, RPM_CAPTURE_SAMPLES, ulSampleRate, pubRPMPulsesPerRev[ubChannel]);
+        }
+
+        ubCapturing = 0;
+        ubChannel = (ubChannel + 1) % 7;
+
+        return;
+    }
+
+    if(!ubRPMEnabled)
+        return;
+
+    if(!period_elapsed(&ullLastTick, RPM_PERIOD_MS))
+        return;
+
+    while(!(ubRPMEnabled & BIT(ubChannel)))
+        ubChannel = (ubChannel + 1) % 7;
+
+    // There is no per channel sense node, the commutation ripple of the fan is picked up on VEXT
+    // Sampling right at the compare clear catches the rail while it still carries the current of this channel
+    // Other channels switching at the same time blur the result, the estimate is best with one fan on the timer
+    uint16_t usCompare = get_channel_compare(ubChannel);
+    float fFreq = get_freq();
+
+    if(!usCompare || usCompare >= get_steps() || pubBurstOffPeriods[ubChannel] || fFreq > ADC_CAPTURE_MAX_TRIGGER_HZ)
+    {
+        pusChannelRPM[ubChannel] = 0;
+        ubChannel = (ubChannel + 1) % 7;
+
+        return;
+    }
+
+    uint32_t ulDecimation = fFreq / RPM_SAMPLE_RATE_HZ;
+
+    if(ulDecimation < 1)
+        ulDecimation = 1;
+
+    if(ulDecimation > ADC_CAPTURE_MAX_DECIMATION)
+        ulDecimation = ADC_CAPTURE_MAX_DECIMATION;
+
+    ulSampleRate = fFreq / ulDecimation;
+
+    // The VEXT rail window keeps comparing every captured conversion, only the 5V0 one waits for the sequence to resume
+    ubRPMCaptureAborted = 0;
+
+    if(!adc_capture_start(ADC_INPUT_VEXT, pulRPMTrigger[ubChannel], PRS_CH_CTRL_EDSEL_NEGEDGE, ulDecimation, pusRPMSamples, RPM_CAPTURE_SAMPLES, 0))
+        return;
+
+    ubCapturing = 1;
+    ullStartTick = now_ms();
+}
+void tach_task()
+{
+    static uint64_t ullLastTick = 0;
+
+    if(!period_elapsed(&ullLastTick, TACH_PERIOD_MS))
+        return;
+
+    for(uint8_t i = 0; i < TACH_COUNT; i++)
+    {
+        uint8_t ubChannel = pubTachChannel[i];
+
+        if(ubChannel == TACH_NO_CHANNEL)
+            continue;
+
+        if(ubTachKick & BIT(ubChannel))
+        {
+            if(now_ms() - pullTachKickTick[i] < TACH_KICK_MS)
+                continue;
+
+            ubTachKick &= ~BIT(ubChannel);
+
+            update_channel(ubChannel, 1); // Back to whatever the channel was set to meanwhile
+
+            pullTachOnTick[i] = now_ms(); // Give it the full timeout to prove itself again
+
+            continue;
+        }
+
+        if(!get_channel_compare(ubChannel))
+        {
+            pubTachKickCount[i] = 0;
+            pullTachOnTick[i] = now_ms();
+
+            continue;
+        }
+
+        if(tach_get_rpm(i))
+        {
+            pubTachKickCount[i] = 0;
+
+            continue;
+        }
+
+        if(now_ms() - pullTachOnTick[i] < pusTachStallTimeout[i])
+            continue;
+
+        if(tach_get_idle_time(i) < pusTachStallTimeout[i])
+            continue;
+
+        if(!pubTachKickCount[i])
+        {
+            DBGPRINTLN_CTX("Fan on tach %hhu (channel %hhu) stalled!", i, ubChannel);
+
+            ubTachFault |= BIT(i);
+
+            usart_cmd_header_t xHeader;
+            usart_cmd_tach_fault_t xPayload;
+
+            xHeader.usMagic = USART_HEADER_MAGIC;
+            xHeader.ubCommand = USART_CMD_TACH_FAULT;
+            xHeader.ubPayloadSize = sizeof(usart_cmd_tach_fault_t);
+
+            xPayload.ubTach = i;
+            xPayload.ubChannel = ubChannel;
+
+            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_tach_fault_t));
+        }
+
+        if(pubTachKickCount[i] >= TACH_MAX_KICKS)
+            continue;
+
+        pubTachKickCount[i]++;
+        pullTachKickTick[i] = now_ms();
+        ubTachKick |= BIT(ubChannel);
+
+        update_channel(ubChannel, 1);
+    }
+}
+uint8_t accounting_load()
+{
+    const accounting_checkpoint_t *pNewest = NULL;
+
+    for(uint16_t i = 0; i < ACCOUNTING_FLASH_PAGES * ACCOUNTING_SLOTS_PER_PAGE; i++)
+    {
+        const accounting_checkpoint_t *pCheckpoint = (const accounting_checkpoint_t *)(ACCOUNTING_FLASH_ADDR + (i / ACCOUNTING_SLOTS_PER_PAGE) * FLASH_PAGE_SIZE) + i % ACCOUNTING_SLOTS_PER_PAGE;
+
+        if(pCheckpoint->ulMagic != ACCOUNTING_MAGIC)
+            continue;
+
+        if(pCheckpoint->ulCRC != calc_crc32((uint8_t *)pCheckpoint, sizeof(accounting_checkpoint_t) - sizeof(uint32_t)))
+            continue;
+
+        if(pNewest && pCheckpoint->ulSequence < pNewest->ulSequence)
+            continue;
+
+        pNewest = pCheckpoint;
+        usAccountingSlot = i + 1;
+    }
+
+    if(!pNewest)
+        return 0;
+
+    for(uint8_t i = 0; i < 7; i++)
+    {
+        pullAccountingOnTime[i] = pNewest->ullOnTime[i];
+        pullAccountingDutyTime[i] = pNewest->ullDutyTime[i];
+        pullAccountingEnergy[i] = pNewest->ullEnergy[i];
+    }
+
+    ulAccountingSequence = pNewest->ulSequence;
+
+    return 1;
+}
+void accounting_store()
+{
+    accounting_checkpoint_t xCheckpoint = {0};
+
+    xCheckpoint.ulMagic = ACCOUNTING_MAGIC;
+    xCheckpoint.ulSequence = ++ulAccountingSequence;
+
+    for(uint8_t i = 0; i < 7; i++)
+    {
+        xCheckpoint.ullOnTime[i] = pullAccountingOnTime[i];
+        xCheckpoint.ullDutyTime[i] = pullAccountingDutyTime[i];
+        xCheckpoint.ullEnergy[i] = pullAccountingEnergy[i];
+    }
+
+    xCheckpoint.ulCRC = calc_crc32((uint8_t *)&xCheckpoint, sizeof(accounting_checkpoint_t) - sizeof(uint32_t));
+
+    if(usAccountingSlot >= ACCOUNTING_FLASH_PAGES * ACCOUNTING_SLOTS_PER_PAGE)
+        usAccountingSlot = 0;
+
+    uint32_t ulAddress = ACCOUNTING_FLASH_ADDR + (usAccountingSlot / ACCOUNTING_SLOTS_PER_PAGE) * FLASH_PAGE_SIZE + (usAccountingSlot % ACCOUNTING_SLOTS_PER_PAGE) * sizeof(accounting_checkpoint_t);
+    uint8_t ubErased = 1;
+
+    for(uint32_t i = 0; i < sizeof(accounting_checkpoint_t); i += 4)
+        ubErased &= *(const uint32_t *)(ulAddress + i) == 0xFFFFFFFF;
+
+    // A torn write leaves a dirty slot behind, skip to the start of the next page in that case
+    if(!ubErased && (usAccountingSlot % ACCOUNTING_SLOTS_PER_PAGE))
+    {
+        usAccountingSlot = ((usAccountingSlot / ACCOUNTING_SLOTS_PER_PAGE + 1) % ACCOUNTING_FLASH_PAGES) * ACCOUNTING_SLOTS_PER_PAGE;
+        ulAddress = ACCOUNTING_FLASH_ADDR + (usAccountingSlot / ACCOUNTING_SLOTS_PER_PAGE) * FLASH_PAGE_SIZE;
+        ubErased = 0;
+    }
+
+    // Only the page not holding the newest checkpoint is ever erased, a reset in between loses at most one checkpoint
+    if(!ubErased)
+        msc_flash_page_erase(ulAddress);
+
+    msc_flash_page_write(ulAddress, (uint8_t *)&xCheckpoint, sizeof(accounting_checkpoint_t));
+
+    usAccountingSlot++;
+    ubAccountingDirty = 0;
+}
+void accounting_task()
+{
+    static uint64_t ullLastCheckpointTick = 0;
+
+    uint32_t ulElapsed = now_ms() - ullAccountingTick;
+
+    if(ulElapsed < ACCOUNTING_TICK_MS)
+        return;
+
+    ullAccountingTick += ulElapsed; // Ticks missed while the loop was blocked or asleep are accounted in one go
+
+    uint32_t ulVEXT = adc_get_vext(); // mV
+    uint32_t ulVEXTSquared = ulVEXT * ulVEXT;
+
+    for(uint8_t i = 0; i < 7; i++)
+    {
+        uint16_t usCompare = get_channel_compare(i);
+
+        if(!usCompare)
+            continue;
+
+        uint32_t ulDuty = ((uint32_t)usCompare << 16) / get_steps(); // Q16
+
+        if(pubBurstOffPeriods[i]) // Only the on periods of a burst pattern drive the channel
+            ulDuty = ulDuty * pubBurstOnPeriods[i] / (pubBurstOnPeriods[i] + pubBurstOffPeriods[i]);
+
+        // Duty (Q16) * mV^2 >> 16 is at most VEXT^2 so it fits 32 bits, dividing by 1000 takes mV^2 ms to V^2 us
+        uint32_t ulEnergy = (uint32_t)(((uint64_t)ulDuty * ulVEXTSquared) >> 16) / 1000;
+
+        pullAccountingOnTime[i] += ulElapsed;
+        pullAccountingDutyTime[i] += (uint64_t)ulDuty * ulElapsed;
+        pullAccountingEnergy[i] += (uint64_t)ulEnergy * ulElapsed;
+
+        ubAccountingDirty = 1;
+    }
+
+    if(!ubAccountingDirty)
+        return;
+
+    if(now_ms() - ullLastCheckpointTick < ACCOUNTING_CHECKPOINT_MS)
+    {
+        sleep_deadline(ullLastCheckpointTick + ACCOUNTING_CHECKPOINT_MS);
+
+        return;
+    }
+
+    ullLastCheckpointTick = now_ms();
+
+    accounting_store();
+}
+uint8_t self_test_measure(uint32_t ulPRSSource, uint32_t ulPRSEdge, float *pfVoltage)
+{
+    if(!adc_capture_start(ADC_INPUT_VEXT, ulPRSSource, ulPRSEdge, 1, pusSelfTestSamples, SELF_TEST_SAMPLES, 1))
+        return 0;
+
+    // One sample per PWM period, plus one for a period change still waiting for the next overflow
+    uint32_t ulTimeout = SELF_TEST_TIMEOUT_MS + (uint32_t)((SELF_TEST_SAMPLES + 1) * 1000.f / get_freq() + 0.5f);
+    uint64_t ullStartTick = now_ms();
+
+    while(adc_capture_busy())
+    {
+        if(now_ms() - ullStartTick > ulTimeout)
+        {
+            adc_capture_abort();
+
+            return 0;
+        }
+    }
+
+    uint32_t ulSum = 0;
+
+    for(uint8_t i = SELF_TEST_SAMPLES / 2; i < SELF_TEST_SAMPLES; i++)
+        ulSum += pusSelfTestSamples[i];
+
+    *pfVoltage = adc_code_to_value(ADC_INPUT_VEXT, ulSum / (SELF_TEST_SAMPLES - SELF_TEST_SAMPLES / 2));
+
+    return 1;
+}
+void self_test_run()
+{
+    uint16_t usResult = 0x0000;
+    uint64_t ullStartTick = now_ms();
+
+    // Let a running speed capture finish, the ADC is needed exclusively
+    while(adc_capture_busy() && now_ms() - ullStartTick <= RPM_CAPTURE_TIMEOUT_MS);
+
+    if(adc_capture_busy())
+        ubRPMCaptureAborted = 1;
+
+    adc_capture_abort();
+
+    float fFreq = get_freq();
+
+    // Running channels keep their duty cycle, only the frequency changes for the few ms of the test
+    if(fFreq < SELF_TEST_MIN_FREQ_HZ)
+        set_freq(TIMER_PWM_DEF_FREQ_HZ);
+
+    for(uint8_t i = 0; i < 7; i++)
+    {
+        pwm_burst_t *pBurst = &pxBurst[i > 2 ? 1 : 0];
+        uint8_t ubCC = i - pBurst->ubFirstChannel;
+        uint8_t ubState = SELF_TEST_UNTESTED;
+        float fBaseline;
+        float fLoaded;
+
+        psSelfTestDroop[i] = 0;
+
+        // Only idle channels are pulsed, a burst pattern on the same timer would overwrite the test compare value
+        if(get_freq() > ADC_CAPTURE_MAX_TRIGGER_HZ || get_channel_compare(i) || pBurst->ubFrameCount)
+        {
+            usResult |= ubState << (i * 2);
+
+            continue;
+        }
+
+        // Unloaded VEXT, sampled on the timer overflow since the idle channel has no edges of its own
+        if(self_test_measure(i > 2 ? PRS_CH_CTRL_SOURCESEL_TIMER1 | PRS_CH_CTRL_SIGSEL_TIMER1OF : PRS_CH_CTRL_SOURCESEL_TIMER0 | PRS_CH_CTRL_SIGSEL_TIMER0OF, PRS_CH_CTRL_EDSEL_OFF, &fBaseline))
+        {
+            uint16_t usCompare = SELF_TEST_DUTY * get_steps();
+
+            pBurst->pTimer->CC[ubCC].CCV = usCompare;
+            pBurst->pTimer->CC[ubCC].CCVB = usCompare;
+
+            // Loaded VEXT, sampled on the compare clear at the end of each on phase when the current peaks
+            uint8_t ubMeasured = self_test_measure(pulRPMTrigger[i], PRS_CH_CTRL_EDSEL_NEGEDGE, &fLoaded);
+
+            update_channel(i, 1); // Back to idle
+
+            if(ubMeasured)
+            {
+                float fDroop = fBaseline - fLoaded;
+
+                psSelfTestDroop[i] = fDroop;
+
+                if(fDroop < SELF_TEST_NO_LOAD_MV)
+                    ubState = SELF_TEST_NO_LOAD;
+                else if(fDroop > SELF_TEST_SHORT_MV)
+                    ubState = SELF_TEST_SHORT;
+                else
+                    ubState = SELF_TEST_NORMAL;
+            }
+        }
+
+        usResult |= ubState << (i * 2);
+    }
+
+    if(fFreq < SELF_TEST_MIN_FREQ_HZ)
+        set_freq(fFreq);
+
+    usSelfTestResult = usResult;
+
+    DBGPRINTLN_CTX("Self-test result 0x%04X in %lu ms", usSelfTestResult, (uint32_t)(now_ms() - ullStartTick));
+}
+void perf_reset()
+{
+    ulPerfLoopLast = DWT->CYCCNT;
+    ulPerfIdleCycles = 0;
+    ullPerfLoopSum = 0;
+    usPerfLoopCount = 0;
+    ulPerfLoopAvg = 0;
+    ulPerfLoopMax = 0;
+    ulPerfCmdMax = 0;
+
+    msc_cache_counters_reset();
+}
+void perf_loop_tick()
+{
+    uint32_t ulNow = DWT->CYCCNT;
+    uint32_t ulCycles = ulNow - ulPerfLoopLast - ulPerfIdleCycles; // Wraps cleanly, iterations are far below the CYCCNT range
+
+    ulPerfLoopLast = ulNow;
+    ulPerfIdleCycles = 0;
+
+    if(ulCycles > ulPerfLoopMax)
+        ulPerfLoopMax = ulCycles;
+
+    ullPerfLoopSum += ulCycles;
+
+    if(++usPerfLoopCount < BIT(PERF_LOOP_WINDOW_SHIFT))
+        return;
+
+    ulPerfLoopAvg = ullPerfLoopSum >> PERF_LOOP_WINDOW_SHIFT;
+    ullPerfLoopSum = 0;
+    usPerfLoopCount = 0;
+}
+void history_task()
+{
+    static uint64_t ullLastTick = 0;
+
+    if(now_ms() - ullLastTick < HISTORY_TIER0_PERIOD * 1000)
+    {
+        sleep_deadline(ullLastTick + HISTORY_TIER0_PERIOD * 1000);
+
+        return;
+    }
+
+    // Periods missed while the loop was blocked are not made up for, they show up as a gap
+    while(now_ms() - ullLastTick >= HISTORY_TIER0_PERIOD * 1000)
+    {
+        ullLastTick += HISTORY_TIER0_PERIOD * 1000;
+        ulHistoryTime += HISTORY_TIER0_PERIOD;
+    }
+
+    sleep_deadline(ullLastTick + HISTORY_TIER0_PERIOD * 1000);
+
+    int16_t psSample[HISTORY_FIELDS];
+
+    for(uint8_t i = 0; i < 7; i++)
+        psSample[i] = get_channel_dc(i) * 32767.f; // Signed like everything else, so the tiers can average it
+
+    psSample[7] = adc_get_vext();
+    psSample[8] = adc_get_5v0();
+    psSample[9] = adc_get_temperature() * 256.f;
+
+    for(uint8_t i = 0; i < ONE_WIRE_MAX_SENSORS; i++)
+        psSample[HISTORY_EXT_TEMP_FIELD + i] = (i < ubSensorCount && (ubSensorValid & BIT(i))) ? (int16_t)(pfSensorTemperature[i] * 256.f) : HISTORY_INVALID;
+
+    history_push(ulHistoryTime, psSample);
+}
+void usart_cmd_error(usart_cmd_header_t *pHeader)
+{
+    pHeader->ubCommand = USART_CMD_ERROR;
+    pHeader->ubPayloadSize = 0;
+    usart0_write((uint8_t *)pHeader, sizeof(usart_cmd_header_t));
+}
+uint8_t usart_cmd_read_payload(usart_cmd_header_t *pHeader, void *pPayload, uint8_t ubSize)
+{
+    if(pHeader->ubPayloadSize != ubSize)
+    {
+        DBGPRINTLN_CTX("Invalid payload size!");
+
+        usart_cmd_error(pHeader);
+
+        return 0;
+    }
+
+    if(!ubSize)
+        return 1;
+
+    if(usart0_available() < ubSize)
+    {
+        DBGPRINTLN_CTX("Not enough data, waiting...");
+
+        uint64_t ullStartTick = now_ms();
+
+        while(usart0_available() < ubSize && now_ms() - ullStartTick <= 500);
+
+        if(usart0_available() < ubSize)
+        {
+            DBGPRINTLN_CTX("Timed out waiting for payload!");
+
+            usart_cmd_error(pHeader);
+
+            return 0;
+        }
+    }
+
+    DBGPRINTLN_CTX("Reading payload...");
+    usart0_read((uint8_t *)pPayload, ubSize);
+
+    return 1;
+}
+void one_wire_start()
+{
+    if(!ds2484_seq_start(&xOneWireSeq))
+        xOneWireSeq.ubStatus = DS2484_SEQ_STATUS_FAIL; // Collected on the next pass like any other failure
+}
+void one_wire_task()
+{
+    static uint8_t ubState = ONE_WIRE_STATE_IDLE;
+    static uint8_t ubSensor = 0;
+    static uint8_t ubOp = ONE_WIRE_OP_NONE;
+    static uint64_t ullRoundTick = 0;
+    static uint64_t ullConvertTick = 0;
+    static uint64_t ullSearchTick = 0;
+    static uint8_t ubRoundResolution = DS18B20_MAX_RESOLUTION;
+
+    // Sequences run from the I2C interrupt, the main loop only starts them and collects the results
+    if(ubOp != ONE_WIRE_OP_NONE)
+    {
+        i2c0_check_timeout();
+
+        if(xOneWireSeq.ubStatus == DS2484_SEQ_STATUS_BUSY)
+            return;
+
+        uint8_t ubDone = xOneWireSeq.ubStatus == DS2484_SEQ_STATUS_DONE;
+
+        switch(ubOp)
+        {
+            case ONE_WIRE_OP_CONVERT:
+            {
+                if(!ubDone)
+                    ubSensorValid &= ~BIT(ubSensor); // Retried after the conversion time like a successful one
+
+                pullSensorConvertTick[ubSensor] = now_ms();
+            }
+            break;
+            case ONE_WIRE_OP_CONVERT_ALL:
+            {
+                if(!ubDone)
+                {
+                    DBGPRINTLN_CTX("1-Wire conversion failed!");
+
+                    ubSensorValid = 0x00;
+                    ubState = ONE_WIRE_STATE_IDLE;
+                }
+
+                ullConvertTick = now_ms();
+            }
+            break;
+            case ONE_WIRE_OP_READ:
+            {
+                if(ubSensor < ubSensorCount && ds18b20_seq_get_temperature(&xOneWireSeq, &pfSensorTemperature[ubSensor]))
+                    ubSensorValid |= BIT(ubSensor);
+                else
+                    ubSensorValid &= ~BIT(ubSensor);
+
+                uint8_t ubRoundDone = ubSensor >= ubSensorCount - 1;
+
+                if(ubState == ONE_WIRE_STATE_READ && ++ubSensor >= ubSensorCount)
+                    ubState = ONE_WIRE_STATE_IDLE;
+
+                // Sensors restored from the cache already reported once, now look for ones added to the bus
+                if(ubSensorSearchPending && ubRoundDone)
+                {
+                    ubSensorSearchPending = 0;
+                    ubSensorSearchActive = 1;
+                    ubSearchCount = 0;
+                    bSearchDiscrepancy = -1;
+
+                    memset(pubSearchPath, 0, sizeof(pubSearchPath));
+                }
+            }
+            break;
+            case ONE_WIRE_OP_SEARCH:
+            {
+                int8_t bDiscrepancy = -1;
+                uint8_t ubPassDone = ds2484_seq_get_search(&xOneWireSeq, pubSearchPath, &bDiscrepancy);
+
+                if(ubPassDone && calc_crc8_maxim(pubSearchPath, 7) == pubSearchPath[7])
+                    memcpy(pubSearchROM[ubSearchCount++], pubSearchPath, 8);
+
+                if(ubPassDone && bDiscrepancy >= 0 && ubSearchCount < ONE_WIRE_MAX_SENSORS)
+                {
+                    bSearchDiscrepancy = bDiscrepancy;
+
+                    break;
+                }
+
+                // Last device found, or the bus failed, same outcome as a blocking search
+                ubSensorSearchActive = 0;
+
+                one_wire_update(pubSearchROM, ubSearchCount);
+            }
+            break;
+        }
+
+        ubOp = ONE_WIRE_OP_NONE;
+
+        sleep_deadline(0); // The interrupt that finished the sequence already woke the core, the next step goes right away
+
+        return;
+    }
+
+    if(!ubSensorCount)
+        return;
+
+    if(ubSensorSearchActive)
+        sleep_deadline(ullSearchTick + ONE_WIRE_SEARCH_PASS_MS);
+
+    // Parasite powered sensors need a quiet bus while converting, so passes only go between rounds
+    if(ubSensorSearchActive && now_ms() - ullSearchTick >= ONE_WIRE_SEARCH_PASS_MS && (!ubSensorParasite || ubState == ONE_WIRE_STATE_IDLE))
+    {
+        ullSearchTick = now_ms();
+
+        ds2484_seq_init(&xOneWireSeq);
+        ds2484_seq_add_search(&xOneWireSeq, pubSearchPath, bSearchDiscrepancy);
+        one_wire_start();
+
+        ubOp = ONE_WIRE_OP_SEARCH;
+
+        return;
+    }
+
+    if(!ubSensorParasite)
+    {
+        // Externally powered sensors convert on their own, each one as often as its resolution allows
+        ubSensor = (ubSensor + 1) % ubSensorCount;
+
+        uint8_t ubOverdrive = !!(ubSensorOverdrive & BIT(ubSensor));
+
+        if(!(ubSensorConverting & BIT(ubSensor)))
+        {
+            ds18b20_seq_convert(&xOneWireSeq, pubSensorROM[ubSensor], ubOverdrive, 0);
+            one_wire_start();
+
+            ubOp = ONE_WIRE_OP_CONVERT;
+            ubSensorConverting |= BIT(ubSensor);
+            pullSensorConvertTick[ubSensor] = now_ms();
+
+            return;
+        }
+
+        if(now_ms() - pullSensorConvertTick[ubSensor] < DS18B20_CONVERSION_TIME(pubSensorResolution[ubSensor]))
+        {
+            // Wake for whichever sensor finishes first, the passes in between step over to it
+            for(uint8_t i = 0; i < ubSensorCount; i++)
+                if(ubSensorConverting & BIT(i))
+                    sleep_deadline(pullSensorConvertTick[i] + DS18B20_CONVERSION_TIME(pubSensorResolution[i]));
+
+            return;
+        }
+
+        ubSensorConverting &= ~BIT(ubSensor);
+
+        ds18b20_seq_read_scratchpad(&xOneWireSeq, pubSensorROM[ubSensor], ubOverdrive);
+        one_wire_start();
+
+        ubOp = ONE_WIRE_OP_READ;
+
+        return;
+    }
+
+    switch(ubState)
+    {
+        case ONE_WIRE_STATE_IDLE:
+        {
+            if(now_ms() - ullRoundTick < (ONE_WIRE_PERIOD_MS >> (DS18B20_MAX_RESOLUTION - ubRoundResolution)))
+            {
+                sleep_deadline(ullRoundTick + (ONE_WIRE_PERIOD_MS >> (DS18B20_MAX_RESOLUTION - ubRoundResolution)));
+
+                return;
+            }
+
+            ullRoundTick = now_ms();
+
+            // One broadcast conversion for the whole bus, N sensors cost a single conversion time
+            ds18b20_seq_convert(&xOneWireSeq, NULL, 0, 1);
+            one_wire_start();
+
+            ubOp = ONE_WIRE_OP_CONVERT_ALL;
+
+            // The round lasts as long as the slowest sensor
+            ubRoundResolution = DS18B20_MIN_RESOLUTION;
+
+            for(uint8_t i = 0; i < ubSensorCount; i++)
+                if(pubSensorResolution[i] > ubRoundResolution)
+                    ubRoundResolution = pubSensorResolution[i];
+
+            ubState = ONE_WIRE_STATE_CONVERT;
+        }
+        break;
+        case ONE_WIRE_STATE_CONVERT:
+        {
+            if(now_ms() - ullConvertTick < DS18B20_CONVERSION_TIME(ubRoundResolution))
+            {
+                sleep_deadline(ullConvertTick + DS18B20_CONVERSION_TIME(ubRoundResolution));
+
+                return;
+            }
+
+            ubSensor = 0;
+            ubState = ONE_WIRE_STATE_READ;
+
+            sleep_deadline(0);
+        }
+        break;
+        case ONE_WIRE_STATE_READ:
+        {
+            // One sensor per pass, the main loop keeps servicing commands while the DS2484 works
+            ds18b20_seq_read_scratchpad(&xOneWireSeq, pubSensorROM[ubSensor], !!(ubSensorOverdrive & BIT(ubSensor)));
+            one_wire_start();
+
+            ubOp = ONE_WIRE_OP_READ;
+        }
+        break;
+    }
+}
+
+int init()
+{
+    rmu_init(RMU_CTRL_PINRMODE_FULL, RMU_CTRL_SYSRMODE_EXTENDED, RMU_CTRL_LOCKUPRMODE_EXTENDED, RMU_CTRL_WDOGRMODE_EXTENDED); // Init RMU and set reset modes
+
+    emu_init(1); // Init EMU, ignore DCDC and switch digital power immediatly to DVDD
+
+    cmu_init(); // Init Clocks
+
+    dbg_init(); // Init Debug module
+    dbg_swo_config(BIT(0) | BIT(1), 200000); // Init SWO channels 0 and 1 at 200 kHz
+
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; // Cycle counter for the perf figures, sleeping keeps it in step with the RTCC
+
+    msc_init(); // Init Flash, RAM and caches
+
+    rtcc_init(); // Init RTCC, the system time base
+
+    wdog_init((8 <<_WDOG_CTRL_PERSEL_SHIFT) | (3 << _WDOG_CTRL_WARNSEL_SHIFT)); // Init the watchdog timer, 2049 ms timeout, 75% warning
+    wdog_set_warning_isr(wdog_warning_isr);
+
+    gpio_init(); // Init GPIOs
+    ldma_init(); // Init LDMA
+    ldma_ch_set_isr(TIMER0_DMA_CHANNEL, burst0_dma_isr);
+    ldma_ch_set_isr(TIMER1_DMA_CHANNEL, burst1_dma_isr);
+    prs_init(); // Init PRS
+    crc_init(); // Init CRC calculation unit
+    adc_init(); // Init ADCs
+    adc_set_window_isr(rail_alarm_isr);
+    set_sample_period(ADC_SAMPLE_DEF_PERIOD_MS);
+    tach_init(); // Init fan tach inputs
+
+    float fAVDDHighThresh, fAVDDLowThresh;
+    float fDVDDHighThresh, fDVDDLowThresh;
+    float fIOVDDHighThresh, fIOVDDLowThresh;
+
+    emu_vmon_avdd_config(1, 3.1f, &fAVDDLowThresh, 3.22f, &fAVDDHighThresh); // Enable AVDD monitor
+    emu_vmon_dvdd_config(1, 3.1f, &fDVDDLowThresh); // Enable DVDD monitor
+    emu_vmon_iovdd_config(1, 3.15f, &fIOVDDLowThresh); // Enable IOVDD monitor
+
+    fDVDDHighThresh = fDVDDLowThresh + 0.026f; // Hysteresis from datasheet
+    fIOVDDHighThresh = fIOVDDLowThresh + 0.026f; // Hysteresis from datasheet
+
+    usart0_init(115200, USART_FRAME_STOPBITS_ONE | USART_FRAME_PARITY_NONE | USART_FRAME_DATABITS_EIGHT, 17, 19, -1, -1);
+    i2c0_init(I2C_NORMAL, 31, 1);
+
+    char szDeviceName[32];
+
+    get_device_name(szDeviceName, 32);
+
+    DBGPRINTLN_CTX("USB Fan Controller v%lu (%s %s)!", BUILD_VERSION, __DATE__, __TIME__);
+    DBGPRINTLN_CTX("Device: %s", szDeviceName);
+    DBGPRINTLN_CTX("Device Revision: 0x%04X", get_device_revision());
+    DBGPRINTLN_CTX("Calibration temperature: %hhu C", (DEVINFO->CAL & _DEVINFO_CAL_TEMP_MASK) >> _DEVINFO_CAL_TEMP_SHIFT);
+    DBGPRINTLN_CTX("Flash Size: %hu kB", FLASH_SIZE >> 10);
+    DBGPRINTLN_CTX("RAM Size: %hu kB", SRAM_SIZE >> 10);
+    DBGPRINTLN_CTX("Free RAM: %lu B", get_free_ram());
+    DBGPRINTLN_CTX("Unique ID: %08X-%08X", DEVINFO->UNIQUEH, DEVINFO->UNIQUEL);
+
+    DBGPRINTLN_CTX("RMU - Reset cause: %hhu", rmu_get_reset_reason());
+    DBGPRINTLN_CTX("RMU - Reset state: %hhu", rmu_get_reset_state());
+
+    rmu_clear_reset_reason();
+    rmu_set_reset_state(0x00);
+
+    DBGPRINTLN_CTX("CMU - HFXO Oscillator: %.3f MHz", (float)HFXO_OSC_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - HFRCO Oscillator: %.3f MHz", (float)HFRCO_OSC_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - AUXHFRCO Oscillator: %.3f MHz", (float)AUXHFRCO_OSC_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - LFXO Oscillator: %.3f kHz", (float)LFXO_OSC_FREQ / 1000);
+    DBGPRINTLN_CTX("CMU - LFRCO Oscillator: %.3f kHz", (float)LFRCO_OSC_FREQ / 1000);
+    DBGPRINTLN_CTX("CMU - ULFRCO Oscillator: %.3f kHz", (float)ULFRCO_OSC_FREQ / 1000);
+    DBGPRINTLN_CTX("CMU - HFSRC Clock: %.3f MHz", (float)HFSRC_CLOCK_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - HF Clock: %.3f MHz", (float)HF_CLOCK_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - HFCORE Clock: %.3f MHz", (float)HFCORE_CLOCK_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - HFEXP Clock: %.3f MHz", (float)HFEXP_CLOCK_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - HFPER Clock: %.3f MHz", (float)HFPER_CLOCK_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - HFLE Clock: %.3f MHz", (float)HFLE_CLOCK_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - ADC0 Clock: %.3f MHz", (float)ADC0_CLOCK_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - DBG Clock: %.3f MHz", (float)DBG_CLOCK_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - AUX Clock: %.3f MHz", (float)AUX_CLOCK_FREQ / 1000000);
+    DBGPRINTLN_CTX("CMU - LFA Clock: %.3f kHz", (float)LFA_CLOCK_FREQ / 1000);
+    DBGPRINTLN_CTX("CMU - LETIMER0 Clock: %.3f kHz", (float)LETIMER0_CLOCK_FREQ / 1000);
+    DBGPRINTLN_CTX("CMU - LFB Clock: %.3f kHz", (float)LFB_CLOCK_FREQ / 1000);
+    DBGPRINTLN_CTX("CMU - LEUART0 Clock: %.3f kHz", (float)LEUART0_CLOCK_FREQ / 1000);
+    DBGPRINTLN_CTX("CMU - LFE Clock: %.3f kHz", (float)LFE_CLOCK_FREQ / 1000);
+    DBGPRINTLN_CTX("CMU - RTCC Clock: %.3f kHz", (float)RTCC_CLOCK_FREQ / 1000);
+
+    DBGPRINTLN_CTX("EMU - AVDD Fall Threshold: %.2f mV!", fAVDDLowThresh * 1000);
+    DBGPRINTLN_CTX("EMU - AVDD Rise Threshold: %.2f mV!", fAVDDHighThresh * 1000);
+    DBGPRINTLN_CTX("EMU - AVDD Voltage: %.2f mV", adc_get_avdd());
+    DBGPRINTLN_CTX("EMU - AVDD Status: %s", g_ubAVDDLow ? "LOW" : "OK");
+    DBGPRINTLN_CTX("EMU - DVDD Fall Threshold: %.2f mV!", fDVDDLowThresh * 1000);
+    DBGPRINTLN_CTX("EMU - DVDD Rise Threshold: %.2f mV!", fDVDDHighThresh * 1000);
+    DBGPRINTLN_CTX("EMU - DVDD Voltage: %.2f mV", adc_get_dvdd());
+    DBGPRINTLN_CTX("EMU - DVDD Status: %s", g_ubDVDDLow ? "LOW" : "OK");
+    DBGPRINTLN_CTX("EMU - IOVDD Fall Threshold: %.2f mV!", fIOVDDLowThresh * 1000);
+    DBGPRINTLN_CTX("EMU - IOVDD Rise Threshold: %.2f mV!", fIOVDDHighThresh * 1000);
+    DBGPRINTLN_CTX("EMU - IOVDD Voltage: %.2f mV", adc_get_iovdd());
+    DBGPRINTLN_CTX("EMU - IOVDD Status: %s", g_ubIOVDDLow ? "LOW" : "OK");
+    DBGPRINTLN_CTX("EMU - Core Voltage: %.2f mV", adc_get_corevdd());
+    DBGPRINTLN_CTX("EMU - 5V0 Voltage: %.2f mV", adc_get_5v0());
+    DBGPRINTLN_CTX("EMU - VEXT Voltage: %.2f mV", adc_get_vext());
+
+    DBGPRINTLN_CTX("Scanning I2C bus 0...");
+
+    for(uint8_t a = 0x08; a < 0x78; a++)
+    {
+        if(i2c0_write(a, 0, 0, I2C_STOP))
+            DBGPRINTLN_CTX("  Address 0x%02X ACKed!", a);
+    }
+
+    if(accounting_load())
+        DBGPRINTLN_CTX("Restored accounting checkpoint %lu", ulAccountingSequence);
+
+    config_init();
+    history_init();
+
+    if(ds2484_init())
+    {
+        if(one_wire_cache_load())
+        {
+            DBGPRINTLN_CTX("Restored 1-Wire sensors from the ROM cache");
+
+            ubSensorSearchPending = 1;
+        }
+        else
+        {
+            DBGPRINTLN_CTX("Scanning 1-Wire bus...");
+
+            one_wire_scan();
+        }
+
+        DBGPRINTLN_CTX("Found %hhu DS18B20 sensor(s)", ubSensorCount);
+    }
+    else
+    {
+        DBGPRINTLN_CTX("DS2484 not found!");
+    }
+
+    return 0;
+}
+int main()
+{
+    init_timers();
+    self_test_run();
+    restore_settings();
+    perf_reset();
+
+    ullAccountingTick = now_ms();
+
+    while(1)
+    {
+        sleep();
+        perf_loop_tick();
+
+        wdog_feed();
+
+        adc_task();
+        spinup_task();
+        vext_comp_task();
+        burst_task();
+        fan_curve_task();
+        pid_task();
+        one_wire_task();
+        rail_alarm_task();
+        rpm_task();
+        tach_task();
+        accounting_task();
+        history_task();
+        config_task();
+        i2c0_check_timeout();
+
+        static uint64_t ullLastUSARTChange = 0;
+        static uint32_t ulLastUSARTAvailable = 0;
+
+        if(usart0_available() != ulLastUSARTAvailable)
+        {
+            ulLastUSARTAvailable = usart0_available();
+            ullLastUSARTChange = now_ms();
+        }
+
+        if(ulLastUSARTAvailable != 0)
+            sleep_deadline(ullLastUSARTChange + 2001);
+
+        if(ulLastUSARTAvailable != 0 && now_ms() - ullLastUSARTChange > 2000)
+        {
+            DBGPRINTLN_CTX("Clearing USART buffer...");
+
+            usart0_flush();
+        }
+
+        if(usart0_available() >= sizeof(usart_cmd_header_t))
+        {
+            uint32_t ulCmdStart = DWT->CYCCNT;
+            usart_cmd_header_t xHeader;
+
+            DBGPRINTLN_CTX("Reading header...");
+            usart0_read((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+
+            DBGPRINTLN_CTX("Header [M %04X] [C %02X] [S %02X]", xHeader.usMagic, xHeader.ubCommand, xHeader.ubPayloadSize);
+
+            if(xHeader.usMagic != USART_HEADER_MAGIC)
+            {
+                DBGPRINTLN_CTX("Invalid magic!");
+
+                continue;
+            }
+
+            switch(xHeader.ubCommand)
+            {
+                case USART_CMD_SET_DC:
+                {
+                    usart_cmd_set_dc_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_dc_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_DC [C %hhu] [D %.6f]", xPayload.ubChannel, xPayload.fDutyCycle);
+
+                    if(xPayload.ubChannel > 6)
+                    {
+                        DBGPRINTLN_CTX("Invalid channel!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    if(xPayload.fDutyCycle < 0.0f || xPayload.fDutyCycle > 1.0f)
+                    {
+                        DBGPRINTLN_CTX("Invalid duty cycle!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    stop_channel_control(xPayload.ubChannel); // Manual control overrides the fan curve and PID loop
+
+                    spinup_set_channel_dc(xPayload.ubChannel, xPayload.fDutyCycle);
+
+                    config_set_float(CONFIG_KEY_DUTY(xPayload.ubChannel), xPayload.fDutyCycle); // Written to flash in batches by config_task
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_DC:
+                {
+                    usart_cmd_get_dc_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_dc_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_DC [C %hhu]", xPayload.ubChannel);
+
+                    if(xPayload.ubChannel > 6)
+                    {
+                        DBGPRINTLN_CTX("Invalid channel!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    xPayload.fDutyCycle = get_channel_dc(xPayload.ubChannel);
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_dc_t));
+                }
+                break;
+                case USART_CMD_GET_VOLTAGE:
+                {
+                    usart_cmd_get_voltage_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_voltage_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_VOLTAGE [C %hhu]", xPayload.ubChannel);
+
+                    switch(xPayload.ubChannel)
+                    {
+                        case USART_VOLTAGE_AVDD:
+                        {
+                            xPayload.fVoltage = adc_get_avdd();
+
+                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
+                        }
+                        break;
+                        case USART_VOLTAGE_DVDD:
+                        {
+                            xPayload.fVoltage = adc_get_dvdd();
+
+                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
+                        }
+                        break;
+                        case USART_VOLTAGE_IOVDD:
+                        {
+                            xPayload.fVoltage = adc_get_iovdd();
+
+                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
+                        }
+                        break;
+                        case USART_VOLTAGE_CORE:
+                        {
+                            xPayload.fVoltage = adc_get_corevdd();
+
+                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
+                        }
+                        break;
+                        case USART_VOLTAGE_5V0:
+                        {
+                            xPayload.fVoltage = adc_get_5v0();
+
+                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
+                        }
+                        break;
+                        case USART_VOLTAGE_VEXT:
+                        {
+                            xPayload.fVoltage = adc_get_vext();
+
+                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
+                        }
+                        break;
+                        default:
+                        {
+                            DBGPRINTLN_CTX("Invalid voltage channel!");
+
+                            usart_cmd_error(&xHeader);
+                        }
+                        break;
+                    }
+                }
+                break;
+                case USART_CMD_GET_TEMP:
+                {
+                    usart_cmd_get_temp_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_temp_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_TEMP [C %hhu]", xPayload.ubChannel);
+
+                    float fTemperature;
+
+                    if(!get_temperature(xPayload.ubChannel, &fTemperature))
+                    {
+                        DBGPRINTLN_CTX("Invalid temperature channel!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    xPayload.fTemperature = fTemperature;
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_temp_t));
+                }
+                break;
+                case USART_CMD_SET_FREQ:
+                {
+                    usart_cmd_set_freq_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_freq_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_FREQ [F %.6f]", xPayload.fFreq);
+
+                    if(xPayload.fFreq < TIMER_PWM_MIN_FREQ_HZ || xPayload.fFreq > TIMER_PWM_MAX_FREQ_HZ)
+                    {
+                        DBGPRINTLN_CTX("Invalid frequency!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    set_freq(xPayload.fFreq);
+
+                    config_set_float(CONFIG_KEY_PWM_FREQ, xPayload.fFreq);
+
+                    usart_cmd_get_pwm_info_t xInfo;
+
+                    xInfo.fFreq = get_freq();
+                    xInfo.usPrescaler = get_prescaler();
+                    xInfo.usSteps = get_steps();
+
+                    DBGPRINTLN_CTX("PWM set to %.3f Hz [P %hu] [S %hu]", xInfo.fFreq, xInfo.usPrescaler, xInfo.usSteps);
+
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_pwm_info_t);
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xInfo, sizeof(usart_cmd_get_pwm_info_t));
+                }
+                break;
+                case USART_CMD_GET_FREQ:
+                {
+                    usart_cmd_get_freq_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_freq_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_FREQ");
+
+                    xPayload.fFreq = get_freq();
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_freq_t));
+                }
+                break;
+                case USART_CMD_GET_PWM_INFO:
+                {
+                    if(!usart_cmd_read_payload(&xHeader, NULL, 0))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_PWM_INFO");
+
+                    usart_cmd_get_pwm_info_t xPayload;
+
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_pwm_info_t);
+
+                    xPayload.fFreq = get_freq();
+                    xPayload.usPrescaler = get_prescaler();
+                    xPayload.usSteps = get_steps();
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_pwm_info_t));
+                }
+                break;
+                case USART_CMD_SET_BURST:
+                {
+                    usart_cmd_set_burst_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_burst_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_BURST [C %hhu] [ON %hhu] [OFF %hhu]", xPayload.ubChannel, xPayload.ubOnPeriods, xPayload.ubOffPeriods);
+
+                    if(!set_channel_burst(xPayload.ubChannel, xPayload.ubOnPeriods, xPayload.ubOffPeriods))
+                    {
+                        DBGPRINTLN_CTX("Invalid burst pattern!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_BURST:
+                {
+                    usart_cmd_get_burst_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_burst_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_BURST [C %hhu]", xPayload.ubChannel);
+
+                    if(xPayload.ubChannel > 6)
+                    {
+                        DBGPRINTLN_CTX("Invalid channel!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    get_channel_burst(xPayload.ubChannel, &xPayload.ubOnPeriods, &xPayload.ubOffPeriods);
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_burst_t));
+                }
+                break;
+                case USART_CMD_SET_DC_ALL:
+                {
+                    usart_cmd_set_dc_all_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_dc_all_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_DC_ALL");
+
+                    uint8_t ubValid = 1;
+
+                    for(uint8_t i = 0; i < 7; i++)
+                    {
+                        if(xPayload.fDutyCycle[i] < 0.0f || xPayload.fDutyCycle[i] > 1.0f)
+                            ubValid = 0;
+                    }
+
+                    if(!ubValid)
+                    {
+                        DBGPRINTLN_CTX("Invalid duty cycle!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    for(uint8_t i = 0; i < 7; i++)
+                    {
+                        stop_channel_control(i); // Manual control overrides the fan curve and PID loop
+
+                        spinup_set_channel_dc(i, xPayload.fDutyCycle[i]);
+
+                        config_set_float(CONFIG_KEY_DUTY(i), xPayload.fDutyCycle[i]);
+                    }
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_SET_SPINUP:
+                {
+                    usart_cmd_set_spinup_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_spinup_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_SPINUP [T %hu] [TO %hu]", xPayload.usDroopThreshold, xPayload.usDroopTimeout);
+
+                    for(uint8_t i = 0; i < 7; i++)
+                        pusSpinUpDelay[i] = xPayload.usDelay[i];
+
+                    usSpinUpDroopThreshold = xPayload.usDroopThreshold;
+                    usSpinUpDroopTimeout = xPayload.usDroopTimeout;
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_SPINUP:
+                {
+                    if(!usart_cmd_read_payload(&xHeader, NULL, 0))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_SPINUP");
+
+                    usart_cmd_get_spinup_t xPayload;
+
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_spinup_t);
+
+                    for(uint8_t i = 0; i < 7; i++)
+                        xPayload.usDelay[i] = pusSpinUpDelay[i];
+
+                    xPayload.usDroopThreshold = usSpinUpDroopThreshold;
+                    xPayload.usDroopTimeout = usSpinUpDroopTimeout;
+                    xPayload.ubPending = ubSpinUpPending;
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_spinup_t));
+                }
+                break;
+                case USART_CMD_SET_EFF_VOLTAGE:
+                {
+                    usart_cmd_set_eff_voltage_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_eff_voltage_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_EFF_VOLTAGE [C %hhu] [V %hu]", xPayload.ubChannel, xPayload.usVoltage);
+
+                    if(xPayload.ubChannel > 6)
+                    {
+                        DBGPRINTLN_CTX("Invalid channel!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    if(xPayload.usVoltage > ADC_VEXT_DIV * 2500)
+                    {
+                        DBGPRINTLN_CTX("Invalid voltage!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    stop_channel_control(xPayload.ubChannel);
+
+                    spinup_set_channel_eff_voltage(xPayload.ubChannel, xPayload.usVoltage); // Replaces any queued duty cycle, a start from 0 waits for its turn like SET_DC
+
+                    // Only fixed duty cycles are persisted, a stale one must not come back after a reset
+                    if(xPayload.usVoltage)
+                        config_clear(CONFIG_KEY_DUTY(xPayload.ubChannel));
+                    else
+                        config_set_float(CONFIG_KEY_DUTY(xPayload.ubChannel), get_channel_dc(xPayload.ubChannel));
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_EFF_VOLTAGE:
+                {
+                    usart_cmd_get_eff_voltage_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_eff_voltage_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_EFF_VOLTAGE [C %hhu]", xPayload.ubChannel);
+
+                    if(xPayload.ubChannel > 6)
+                    {
+                        DBGPRINTLN_CTX("Invalid channel!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_eff_voltage_t);
+
+                    xPayload.usVoltage = get_channel_eff_voltage(xPayload.ubChannel);
+                    xPayload.usVEXT = usVEXTVoltage;
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_eff_voltage_t));
+                }
+                break;
+                case USART_CMD_SET_FAN_CURVE:
+                {
+                    usart_cmd_set_fan_curve_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_fan_curve_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_FAN_CURVE [C %hhu] [S %hhu] [N %hhu]", xPayload.ubChannel, xPayload.ubSource, xPayload.ubPointCount);
+
+                    if(xPayload.ubChannel > 6)
+                    {
+                        DBGPRINTLN_CTX("Invalid channel!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    if(xPayload.ubSource >= USART_TEMP_COUNT)
+                    {
+                        DBGPRINTLN_CTX("Invalid temperature source!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    stop_channel_control(xPayload.ubChannel);
+
+                    if(!fan_curve_set(&pxFanCurve[xPayload.ubChannel], xPayload.xPoint, xPayload.ubPointCount, xPayload.usHysteresis, xPayload.usMinDuty, xPayload.usMaxDuty))
+                    {
+                        DBGPRINTLN_CTX("Invalid fan curve!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    pubFanCurveSource[xPayload.ubChannel] = xPayload.ubSource;
+
+                    if(xPayload.ubPointCount)
+                    {
+                        pusChannelEffVoltage[xPayload.ubChannel] = 0; // The curve drives the duty cycle directly
+
+                        config_clear(CONFIG_KEY_DUTY(xPayload.ubChannel)); // Curves are not persisted, the channel boots stopped instead of at a stale duty cycle
+                    }
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_FAN_CURVE:
+                {
+                    usart_cmd_get_fan_curve_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_fan_curve_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_FAN_CURVE [C %hhu]", xPayload.ubChannel);
+
+                    if(xPayload.ubChannel > 6)
+                    {
+                        DBGPRINTLN_CTX("Invalid channel!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    fan_curve_t *pCurve = &pxFanCurve[xPayload.ubChannel];
+
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_fan_curve_t);
+
+                    xPayload.ubSource = pubFanCurveSource[xPayload.ubChannel];
+                    xPayload.ubPointCount = pCurve->ubPointCount;
+                    xPayload.usHysteresis = pCurve->usHysteresis;
+                    xPayload.usMinDuty = pCurve->usMinDuty;
+                    xPayload.usMaxDuty = pCurve->usMaxDuty;
+
+                    for(uint8_t i = 0; i < FAN_CURVE_MAX_POINTS; i++)
+                        xPayload.xPoint[i] = pCurve->xPoint[i];
+
+                    xPayload.sTemperature = pCurve->sHeldTemperature;
+                    xPayload.usDuty = pusFanCurveDuty[xPayload.ubChannel];
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_fan_curve_t));
+                }
+                break;
+                case USART_CMD_SET_PID:
+                {
+                    usart_cmd_set_pid_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_pid_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_PID [C %hhu] [E %hhu] [S %hhu] [SP %hd]", xPayload.ubChannel, xPayload.ubEnable, xPayload.ubSource, xPayload.sSetpoint);
+
+                    if(xPayload.ubChannel > 6)
+                    {
+                        DBGPRINTLN_CTX("Invalid channel!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    if(xPayload.ubSource >= USART_TEMP_COUNT)
+                    {
+                        DBGPRINTLN_CTX("Invalid temperature source!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    uint16_t usPeriod = ((uint32_t)xPayload.usPeriod * PID_TICK_HZ + 500) / 1000;
+
+                    if(!usPeriod)
+                    {
+                        DBGPRINTLN_CTX("Invalid PID period!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    uint8_t ubWasActive = !!(ubPIDActive & BIT(xPayload.ubChannel));
+
+                    stop_channel_control(xPayload.ubChannel);
+
+                    if(!pid_config(&pxPID[xPayload.ubChannel], xPayload.sSetpoint, xPayload.lKp, xPayload.lKi, xPayload.lKd, xPayload.ubDerivativeFilter, xPayload.usMinDuty, xPayload.usMaxDuty))
+                    {
+                        DBGPRINTLN_CTX("Invalid PID parameters!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    pubPIDSource[xPayload.ubChannel] = xPayload.ubSource;
+                    pusPIDPeriod[xPayload.ubChannel] = usPeriod;
+                    pusPIDCountdown[xPayload.ubChannel] = 0;
+
+                    if(xPayload.ubEnable)
+                    {
+                        if(!ubWasActive)
+                            pid_reset(&pxPID[xPayload.ubChannel]); // Bumpless retuning of a running loop, fresh start otherwise
+
+                        if(!ubPIDActive)
+                            rtcc_set_tick(PID_TICK_PERIOD, pid_tick_isr);
+
+                        ubPIDActive |= BIT(xPayload.ubChannel);
+
+                        config_clear(CONFIG_KEY_DUTY(xPayload.ubChannel)); // PID loops are not persisted either
+                    }
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_PID:
+                {
+                    usart_cmd_get_pid_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_pid_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_PID [C %hhu]", xPayload.ubChannel);
+
+                    if(xPayload.ubChannel > 6)
+                    {
+                        DBGPRINTLN_CTX("Invalid channel!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    pid_controller_t *pPID = &pxPID[xPayload.ubChannel];
+
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_pid_t);
+
+                    xPayload.ubEnable = !!(ubPIDActive & BIT(xPayload.ubChannel));
+                    xPayload.ubSource = pubPIDSource[xPayload.ubChannel];
+                    xPayload.sSetpoint = pPID->sSetpoint;
+                    xPayload.lKp = pPID->lKp;
+                    xPayload.lKi = pPID->lKi;
+                    xPayload.lKd = pPID->lKd;
+                    xPayload.ubDerivativeFilter = pPID->ubDerivativeFilter;
+                    xPayload.usMinDuty = pPID->usMinOutput;
+                    xPayload.usMaxDuty = pPID->usMaxOutput;
+                    xPayload.usPeriod = (uint32_t)pusPIDPeriod[xPayload.ubChannel] * 1000 / PID_TICK_HZ;
+                    xPayload.sTemperature = psPIDTemperature[xPayload.ubChannel];
+                    xPayload.usDuty = pusPIDDuty[xPayload.ubChannel];
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_pid_t));
+                }
+                break;
+                case USART_CMD_GET_SENSORS:
+                {
+                    if(!usart_cmd_read_payload(&xHeader, NULL, 0))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_SENSORS");
+
+                    usart_cmd_get_sensors_t xPayload;
+
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_sensors_t);
+
+                    xPayload.ubCount = ubSensorCount;
+
+                    for(uint8_t i = 0; i < ONE_WIRE_MAX_SENSORS; i++)
+                        for(uint8_t j = 0; j < 8; j++)
+                            xPayload.ubROM[i][j] = i < ubSensorCount ? pubSensorROM[i][j] : 0x00;
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_sensors_t));
+                }
+                break;
+                case USART_CMD_SET_SENSOR_CONFIG:
+                {
+                    usart_cmd_set_sensor_config_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_sensor_config_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_SENSOR_CONFIG [S %hhu R %hhu O %hhu]", xPayload.ubSensor, xPayload.ubResolution, xPayload.ubOverdrive);
+
+                    if(xPayload.ubSensor >= ubSensorCount)
+                    {
+                        DBGPRINTLN_CTX("Invalid sensor!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    if(xPayload.ubResolution < DS18B20_MIN_RESOLUTION || xPayload.ubResolution > DS18B20_MAX_RESOLUTION)
+                    {
+                        DBGPRINTLN_CTX("Invalid resolution!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    uint8_t ubScratchpad[9];
+
+                    // DS18B20s do not implement overdrive, only sensors that answer at that speed are switched over
+                    if(xPayload.ubOverdrive && !ds18b20_read_scratchpad(pubSensorROM[xPayload.ubSensor], 1, ubScratchpad))
+                    {
+                        DBGPRINTLN_CTX("Sensor does not support overdrive!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    if(xPayload.ubResolution != pubSensorResolution[xPayload.ubSensor] && !ds18b20_set_resolution(pubSensorROM[xPayload.ubSensor], !!xPayload.ubOverdrive, xPayload.ubResolution))
+                    {
+                        DBGPRINTLN_CTX("Failed to set resolution!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    pubSensorResolution[xPayload.ubSensor] = xPayload.ubResolution;
+
+                    if(xPayload.ubOverdrive)
+                        ubSensorOverdrive |= BIT(xPayload.ubSensor);
+                    else
+                        ubSensorOverdrive &= ~BIT(xPayload.ubSensor);
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_SENSOR_CONFIG:
+                {
+                    usart_cmd_get_sensor_config_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_sensor_config_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_SENSOR_CONFIG [S %hhu]", xPayload.ubSensor);
+
+                    if(xPayload.ubSensor >= ubSensorCount)
+                    {
+                        DBGPRINTLN_CTX("Invalid sensor!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_sensor_config_t);
+
+                    xPayload.ubResolution = pubSensorResolution[xPayload.ubSensor];
+                    xPayload.ubOverdrive = !!(ubSensorOverdrive & BIT(xPayload.ubSensor));
+                    xPayload.ubParasite = ubSensorParasite;
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_sensor_config_t));
+                }
+                break;
+                case USART_CMD_SET_FILTER:
+                {
+                    usart_cmd_set_filter_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_filter_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_FILTER [I %hhu T %hhu P %hhu]", xPayload.ubInput, xPayload.ubType, xPayload.ubParam);
+
+                    if(!adc_set_filter(xPayload.ubInput, xPayload.ubType, xPayload.ubParam))
+                    {
+                        DBGPRINTLN_CTX("Invalid filter!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_STATS:
+                {
+                    usart_cmd_get_stats_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_stats_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_GET_STATS [I %hhu C %hhu]", xPayload.ubInput, xPayload.ubClear);
+
+                    adc_stats_t xStats;
+
+                    if(!adc_get_stats(xPayload.ubInput, &xStats, xPayload.ubClear))
+                    {
+                        DBGPRINTLN_CTX("Invalid input or no samples!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_stats_t);
+
+                    adc_get_filter(xPayload.ubInput, &xPayload.ubFilterType, &xPayload.ubFilterParam);
+
+                    xPayload.fMin = xStats.fMin;
+                    xPayload.fMax = xStats.fMax;
+                    xPayload.fMean = xStats.fMean;
+                    xPayload.fPeak = xStats.fPeak;
+                    xPayload.ulCount = xStats.ulCount;
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_stats_t));
+                }
+                break;
+                case USART_CMD_SET_RAIL_ALARM:
+                {
+                    usart_cmd_set_rail_alarm_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_rail_alarm_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_RAIL_ALARM [I %hhu E %hhu L %.2f H %.2f F %hhu D %.6f]", xPayload.ubInput, xPayload.ubEnable, xPayload.fLow, xPayload.fHigh, xPayload.ubForceSafeDuty, xPayload.fSafeDuty);
+
+                    if(!set_rail_alarm(xPayload.ubInput, xPayload.ubEnable, xPayload.fLow, xPayload.fHigh, xPayload.ubForceSafeDuty, xPayload.fSafeDuty))
+                    {
+                        DBGPRINTLN_CTX("Invalid rail alarm!");
+
+                        usart_cmd_error(&xHeader);
+
+                        break;
+                    }
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_RAIL_ALARM:
+                {
+                    usart_cmd_get_rail_alarm_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_rail_alarm_t)))
+                        break;
 
-                continue;
-            }
+                    DBGPRINTLN_CTX("USART_CMD_GET_RAIL_ALARM [I %hhu C %hhu]", xPayload.ubInput, xPayload.ubClear);
 
-            switch(xHeader.ubCommand)
-            {
-                case USART_CMD_SET_DC:
-                {
-                    if(xHeader.ubPayloadSize != sizeof(usart_cmd_set_dc_t))
+                    if(xPayload.ubInput != ADC_INPUT_5V0 && xPayload.ubInput != ADC_INPUT_VEXT)
                     {
-                        DBGPRINTLN_CTX("Invalid payload size!");
+                        DBGPRINTLN_CTX("Invalid input!");
 
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                        usart_cmd_error(&xHeader);
 
                         break;
                     }
 
-                    if(usart0_available() < xHeader.ubPayloadSize)
-                    {
-                        DBGPRINTLN_CTX("Not enough data, waiting...");
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_rail_alarm_t);
 
-                        uint64_t ullStartTick = g_ullSystemTick;
+                    float fLow, fHigh;
 
-                        while(usart0_available() < xHeader.ubPayloadSize && g_ullSystemTick - ullStartTick <= 500);
+                    xPayload.ubEnabled = !!(ubRailAlarmEnabled & BIT(xPayload.ubInput));
+                    xPayload.ubArmed = adc_get_window(xPayload.ubInput, &fLow, &fHigh);
+                    xPayload.fLow = fLow;
+                    xPayload.fHigh = fHigh;
+                    xPayload.ubLatched = ubRailAlarmLatched;
+                    xPayload.ubForceSafeDuty = !!(ubRailAlarmForce & BIT(xPayload.ubInput));
+                    xPayload.fSafeDuty = usRailAlarmSafeDuty / 65535.f;
 
-                        if(usart0_available() < xHeader.ubPayloadSize)
+                    if(xPayload.ubClear && (ubRailAlarmLatched & BIT(xPayload.ubInput)))
+                    {
+                        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
                         {
-                            DBGPRINTLN_CTX("Timed out waiting for payload!");
-
-                            xHeader.ubCommand = USART_CMD_ERROR;
-                            xHeader.ubPayloadSize = 0;
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-
-                            break;
+                            ubRailAlarmLatched &= ~BIT(xPayload.ubInput);
                         }
+
+                        if(ubRailAlarmEnabled & BIT(xPayload.ubInput))
+                            adc_set_window(xPayload.ubInput, fLow, fHigh); // Re-arm
                     }
 
-                    usart_cmd_set_dc_t xPayload;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_rail_alarm_t));
+                }
+                break;
+                case USART_CMD_SET_SAMPLE_PERIOD:
+                {
+                    usart_cmd_set_sample_period_t xPayload;
 
-                    DBGPRINTLN_CTX("Reading payload...");
-                    usart0_read((uint8_t *)&xPayload, xHeader.ubPayloadSize);
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_sample_period_t)))
+                        break;
 
-                    DBGPRINTLN_CTX("USART_CMD_SET_DC [C %hhu] [D %.6f]", xPayload.ubChannel, xPayload.fDutyCycle);
+                    DBGPRINTLN_CTX("USART_CMD_SET_SAMPLE_PERIOD [P %hu]", xPayload.usPeriod);
 
-                    if(xPayload.ubChannel > 6)
+                    if(xPayload.usPeriod > ADC_SAMPLE_MAX_PERIOD_MS || !set_sample_period(xPayload.usPeriod))
                     {
-                        DBGPRINTLN_CTX("Invalid channel!");
+                        DBGPRINTLN_CTX("Invalid sample period!");
 
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                        usart_cmd_error(&xHeader);
 
                         break;
                     }
 
-                    if(xPayload.fDutyCycle < 0.0f || xPayload.fDutyCycle > 1.0f)
-                    {
-                        DBGPRINTLN_CTX("Invalid duty cycle!");
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_SAMPLE_PERIOD:
+                {
+                    if(!usart_cmd_read_payload(&xHeader, NULL, 0))
+                        break;
 
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    DBGPRINTLN_CTX("USART_CMD_GET_SAMPLE_PERIOD");
 
-                        break;
-                    }
+                    usart_cmd_get_sample_period_t xPayload;
 
-                    set_channel_dc(xPayload.ubChannel, xPayload.fDutyCycle);
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_sample_period_t);
+
+                    xPayload.usPeriod = get_sample_period();
+                    xPayload.ulSequenceCount = adc_get_sequence_count();
 
-                    xHeader.ubPayloadSize = 0;
                     usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_sample_period_t));
                 }
                 break;
-                case USART_CMD_GET_DC:
+                case USART_CMD_SET_RPM_CONFIG:
                 {
-                    if(xHeader.ubPayloadSize != sizeof(usart_cmd_get_dc_t))
-                    {
-                        DBGPRINTLN_CTX("Invalid payload size!");
-
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart_cmd_set_rpm_config_t xPayload;
 
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_rpm_config_t)))
                         break;
-                    }
 
-                    if(usart0_available() < xHeader.ubPayloadSize)
-                    {
-                        DBGPRINTLN_CTX("Not enough data, waiting...");
+                    DBGPRINTLN_CTX("USART_CMD_SET_RPM_CONFIG [C %hhu E %hhu P %hhu]", xPayload.ubChannel, xPayload.ubEnable, xPayload.ubPulsesPerRev);
 
-                        uint64_t ullStartTick = g_ullSystemTick;
+                    if(xPayload.ubChannel > 6 || !xPayload.ubPulsesPerRev)
+                    {
+                        DBGPRINTLN_CTX("Invalid RPM configuration!");
 
-                        while(usart0_available() < xHeader.ubPayloadSize && g_ullSystemTick - ullStartTick <= 500);
+                        usart_cmd_error(&xHeader);
 
-                        if(usart0_available() < xHeader.ubPayloadSize)
-                        {
-                            DBGPRINTLN_CTX("Timed out waiting for payload!");
+                        break;
+                    }
 
-                            xHeader.ubCommand = USART_CMD_ERROR;
-                            xHeader.ubPayloadSize = 0;
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    pubRPMPulsesPerRev[xPayload.ubChannel] = xPayload.ubPulsesPerRev;
 
-                            break;
-                        }
+                    if(xPayload.ubEnable)
+                    {
+                        ubRPMEnabled |= BIT(xPayload.ubChannel);
+                    }
+                    else
+                    {
+                        ubRPMEnabled &= ~BIT(xPayload.ubChannel);
+                        pusChannelRPM[xPayload.ubChannel] = 0;
                     }
 
-                    usart_cmd_get_dc_t xPayload;
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_RPM:
+                {
+                    usart_cmd_get_rpm_t xPayload;
 
-                    DBGPRINTLN_CTX("Reading payload...");
-                    usart0_read((uint8_t *)&xPayload, xHeader.ubPayloadSize);
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_rpm_t)))
+                        break;
 
-                    DBGPRINTLN_CTX("USART_CMD_GET_DC [C %hhu]", xPayload.ubChannel);
+                    DBGPRINTLN_CTX("USART_CMD_GET_RPM [C %hhu]", xPayload.ubChannel);
 
                     if(xPayload.ubChannel > 6)
                     {
                         DBGPRINTLN_CTX("Invalid channel!");
 
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                        usart_cmd_error(&xHeader);
 
                         break;
                     }
 
-                    xPayload.fDutyCycle = get_channel_dc(xPayload.ubChannel);
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_rpm_t);
+
+                    xPayload.ubEnabled = !!(ubRPMEnabled & BIT(xPayload.ubChannel));
+                    xPayload.ubPulsesPerRev = pubRPMPulsesPerRev[xPayload.ubChannel];
+                    xPayload.usRPM = pusChannelRPM[xPayload.ubChannel];
 
                     usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_dc_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_rpm_t));
                 }
                 break;
-                case USART_CMD_GET_VOLTAGE:
+                case USART_CMD_SET_TACH_CONFIG:
                 {
-                    if(xHeader.ubPayloadSize != sizeof(usart_cmd_get_voltage_t))
+                    usart_cmd_set_tach_config_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_set_tach_config_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_SET_TACH_CONFIG [T %hhu C %hhu P %hhu A %hhu S %hu]", xPayload.ubTach, xPayload.ubChannel, xPayload.ubPulsesPerRev, xPayload.ubAverage, xPayload.usStallTimeout);
+
+                    if(xPayload.ubTach >= TACH_COUNT || (xPayload.ubChannel > 6 && xPayload.ubChannel != TACH_NO_CHANNEL) || !xPayload.usStallTimeout)
                     {
-                        DBGPRINTLN_CTX("Invalid payload size!");
+                        DBGPRINTLN_CTX("Invalid tach configuration!");
 
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                        usart_cmd_error(&xHeader);
 
                         break;
                     }
 
-                    if(usart0_available() < xHeader.ubPayloadSize)
+                    if(!tach_config(xPayload.ubTach, xPayload.ubPulsesPerRev, xPayload.ubAverage))
                     {
-                        DBGPRINTLN_CTX("Not enough data, waiting...");
-
-                        uint64_t ullStartTick = g_ullSystemTick;
+                        DBGPRINTLN_CTX("Invalid tach configuration!");
 
-                        while(usart0_available() < xHeader.ubPayloadSize && g_ullSystemTick - ullStartTick <= 500);
+                        usart_cmd_error(&xHeader);
 
-                        if(usart0_available() < xHeader.ubPayloadSize)
-                        {
-                            DBGPRINTLN_CTX("Timed out waiting for payload!");
+                        break;
+                    }
 
-                            xHeader.ubCommand = USART_CMD_ERROR;
-                            xHeader.ubPayloadSize = 0;
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    if(pubTachChannel[xPayload.ubTach] != TACH_NO_CHANNEL && (ubTachKick & BIT(pubTachChannel[xPayload.ubTach])))
+                    {
+                        ubTachKick &= ~BIT(pubTachChannel[xPayload.ubTach]);
 
-                            break;
-                        }
+                        update_channel(pubTachChannel[xPayload.ubTach], 1);
                     }
 
-                    usart_cmd_get_voltage_t xPayload;
+                    pubTachChannel[xPayload.ubTach] = xPayload.ubChannel;
+                    pusTachStallTimeout[xPayload.ubTach] = xPayload.usStallTimeout;
+                    pubTachKickCount[xPayload.ubTach] = 0;
+                    pullTachOnTick[xPayload.ubTach] = now_ms();
 
-                    DBGPRINTLN_CTX("Reading payload...");
-                    usart0_read((uint8_t *)&xPayload, xHeader.ubPayloadSize);
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_GET_TACH:
+                {
+                    usart_cmd_get_tach_t xPayload;
 
-                    DBGPRINTLN_CTX("USART_CMD_GET_VOLTAGE [C %hhu]", xPayload.ubChannel);
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_tach_t)))
+                        break;
 
-                    switch(xPayload.ubChannel)
+                    DBGPRINTLN_CTX("USART_CMD_GET_TACH [T %hhu C %hhu]", xPayload.ubTach, xPayload.ubClear);
+
+                    if(xPayload.ubTach >= TACH_COUNT)
                     {
-                        case USART_VOLTAGE_AVDD:
-                        {
-                            xPayload.fVoltage = adc_get_avdd();
+                        DBGPRINTLN_CTX("Invalid tach!");
 
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
-                        }
-                        break;
-                        case USART_VOLTAGE_DVDD:
-                        {
-                            xPayload.fVoltage = adc_get_dvdd();
+                        usart_cmd_error(&xHeader);
 
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
-                        }
                         break;
-                        case USART_VOLTAGE_IOVDD:
-                        {
-                            xPayload.fVoltage = adc_get_iovdd();
+                    }
 
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
-                        }
-                        break;
-                        case USART_VOLTAGE_CORE:
-                        {
-                            xPayload.fVoltage = adc_get_corevdd();
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_tach_t);
 
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
-                        }
-                        break;
-                        case USART_VOLTAGE_5V0:
-                        {
-                            xPayload.fVoltage = adc_get_5v0();
+                    tach_get_config(xPayload.ubTach, &xPayload.ubPulsesPerRev, &xPayload.ubAverage);
 
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
-                        }
-                        break;
-                        case USART_VOLTAGE_VEXT:
-                        {
-                            xPayload.fVoltage = adc_get_vext();
+                    xPayload.ubChannel = pubTachChannel[xPayload.ubTach];
+                    xPayload.usStallTimeout = pusTachStallTimeout[xPayload.ubTach];
+                    xPayload.usRPM = tach_get_rpm(xPayload.ubTach);
+                    xPayload.ulPulseCount = tach_get_pulse_count(xPayload.ubTach);
+                    xPayload.ubFault = !!(ubTachFault & BIT(xPayload.ubTach));
+                    xPayload.ubKicks = pubTachKickCount[xPayload.ubTach];
 
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_voltage_t));
-                        }
-                        break;
-                        default:
-                        {
-                            DBGPRINTLN_CTX("Invalid voltage channel!");
+                    if(xPayload.ubClear)
+                        ubTachFault &= ~BIT(xPayload.ubTach);
 
-                            xHeader.ubCommand = USART_CMD_ERROR;
-                            xHeader.ubPayloadSize = 0;
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                        }
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_tach_t));
+                }
+                break;
+                case USART_CMD_SELF_TEST:
+                {
+                    usart_cmd_self_test_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_self_test_t)))
                         break;
-                    }
+
+                    DBGPRINTLN_CTX("USART_CMD_SELF_TEST [R %hhu]", xPayload.ubRun);
+
+                    if(xPayload.ubRun)
+                        self_test_run();
+
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_self_test_t);
+
+                    xPayload.usResult = usSelfTestResult;
+
+                    for(uint8_t i = 0; i < 7; i++)
+                        xPayload.sDroop[i] = psSelfTestDroop[i];
+
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_self_test_t));
                 }
                 break;
-                case USART_CMD_GET_TEMP:
+                case USART_CMD_GET_ACCOUNTING:
                 {
-                    if(xHeader.ubPayloadSize != sizeof(usart_cmd_get_temp_t))
+                    usart_cmd_get_accounting_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_accounting_t)))
+                        break;
+
+                    if(xPayload.ubChannel > 6)
                     {
-                        DBGPRINTLN_CTX("Invalid payload size!");
+                        DBGPRINTLN_CTX("Invalid channel!");
 
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                        usart_cmd_error(&xHeader);
 
                         break;
                     }
 
-                    if(usart0_available() < xHeader.ubPayloadSize)
-                    {
-                        DBGPRINTLN_CTX("Not enough data, waiting...");
-
-                        uint64_t ullStartTick = g_ullSystemTick;
+                    DBGPRINTLN_CTX("USART_CMD_GET_ACCOUNTING [C %hhu R %hhu]", xPayload.ubChannel, xPayload.ubReset);
 
-                        while(usart0_available() < xHeader.ubPayloadSize && g_ullSystemTick - ullStartTick <= 500);
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_accounting_t);
 
-                        if(usart0_available() < xHeader.ubPayloadSize)
-                        {
-                            DBGPRINTLN_CTX("Timed out waiting for payload!");
+                    xPayload.ullOnTime = pullAccountingOnTime[xPayload.ubChannel];
+                    xPayload.ullDutyTime = pullAccountingDutyTime[xPayload.ubChannel];
+                    xPayload.ullEnergy = pullAccountingEnergy[xPayload.ubChannel];
 
-                            xHeader.ubCommand = USART_CMD_ERROR;
-                            xHeader.ubPayloadSize = 0;
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    if(xPayload.ubReset)
+                    {
+                        pullAccountingOnTime[xPayload.ubChannel] = 0;
+                        pullAccountingDutyTime[xPayload.ubChannel] = 0;
+                        pullAccountingEnergy[xPayload.ubChannel] = 0;
 
-                            break;
-                        }
+                        accounting_store(); // A reset must survive a power cycle
                     }
 
-                    usart_cmd_get_temp_t xPayload;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_accounting_t));
+                }
+                break;
+                case USART_CMD_UPDATE_BEGIN:
+                {
+                    usart_cmd_update_begin_t xPayload;
 
-                    DBGPRINTLN_CTX("Reading payload...");
-                    usart0_read((uint8_t *)&xPayload, xHeader.ubPayloadSize);
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_update_begin_t)))
+                        break;
 
-                    DBGPRINTLN_CTX("USART_CMD_GET_TEMP [C %hhu]", xPayload.ubChannel);
+                    DBGPRINTLN_CTX("USART_CMD_UPDATE_BEGIN [S %lu C 0x%08X]", xPayload.ulSize, xPayload.ulCRC);
 
-                    switch(xPayload.ubChannel)
+                    if(!update_begin(xPayload.ulSize, xPayload.ulCRC))
                     {
-                        case USART_TEMP_EMU:
-                        {
-                            xPayload.fTemperature = emu_get_temperature();
+                        DBGPRINTLN_CTX("Invalid image size!");
+
+                        usart_cmd_error(&xHeader);
 
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_temp_t));
-                        }
                         break;
-                        case USART_TEMP_ADC:
-                        {
-                            xPayload.fTemperature = adc_get_temperature();
+                    }
 
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                            usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_temp_t));
-                        }
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                }
+                break;
+                case USART_CMD_UPDATE_DATA:
+                {
+                    usart_cmd_update_data_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_update_data_t)))
                         break;
-                        default:
-                        {
-                            DBGPRINTLN_CTX("Invalid temperature channel!");
 
-                            xHeader.ubCommand = USART_CMD_ERROR;
-                            xHeader.ubPayloadSize = 0;
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                        }
+                    if(!update_write(xPayload.ulOffset, xPayload.ubData, UPDATE_CHUNK_SIZE))
+                    {
+                        DBGPRINTLN_CTX("Invalid update chunk [O %lu]!", xPayload.ulOffset);
+
+                        usart_cmd_error(&xHeader);
+
                         break;
                     }
+
+                    xHeader.ubPayloadSize = 0;
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
                 }
                 break;
-                case USART_CMD_SET_FREQ:
+                case USART_CMD_UPDATE_FINISH:
                 {
-                    if(xHeader.ubPayloadSize != sizeof(usart_cmd_set_freq_t))
+                    usart_cmd_update_finish_t xPayload;
+
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_update_finish_t)))
+                        break;
+
+                    DBGPRINTLN_CTX("USART_CMD_UPDATE_FINISH [A %hhu]", xPayload.ubApply);
+
+                    uint32_t ulCRC = 0;
+
+                    if(!update_finish(&ulCRC))
                     {
-                        DBGPRINTLN_CTX("Invalid payload size!");
+                        DBGPRINTLN_CTX("Image verification failed [C 0x%08X]!", ulCRC);
 
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                        update_abort();
+
+                        usart_cmd_error(&xHeader);
 
                         break;
                     }
 
-                    if(usart0_available() < xHeader.ubPayloadSize)
-                    {
-                        DBGPRINTLN_CTX("Not enough data, waiting...");
+                    xPayload.ulCRC = ulCRC;
 
-                        uint64_t ullStartTick = g_ullSystemTick;
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_update_finish_t);
+                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_update_finish_t));
 
-                        while(usart0_available() < xHeader.ubPayloadSize && g_ullSystemTick - ullStartTick <= 500);
+                    if(!xPayload.ubApply)
+                        break;
 
-                        if(usart0_available() < xHeader.ubPayloadSize)
-                        {
-                            DBGPRINTLN_CTX("Timed out waiting for payload!");
+                    DBGPRINTLN_CTX("Applying update...");
 
-                            xHeader.ubCommand = USART_CMD_ERROR;
-                            xHeader.ubPayloadSize = 0;
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    delay_ms(100);
 
-                            break;
-                        }
-                    }
+                    if(ubAccountingDirty)
+                        accounting_store();
 
-                    usart_cmd_set_freq_t xPayload;
+                    config_flush();
 
-                    DBGPRINTLN_CTX("Reading payload...");
-                    usart0_read((uint8_t *)&xPayload, xHeader.ubPayloadSize);
+                    update_apply();
+                }
+                break;
+                case USART_CMD_GET_PERF:
+                {
+                    usart_cmd_get_perf_t xPayload;
 
-                    DBGPRINTLN_CTX("USART_CMD_SET_FREQ [F %.6f]", xPayload.fFreq);
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_perf_t)))
+                        break;
 
-                    if(xPayload.fFreq < TIMER_PWM_MIN_FREQ_HZ || xPayload.fFreq > TIMER_PWM_MAX_FREQ_HZ)
-                    {
-                        DBGPRINTLN_CTX("Invalid frequency!");
+                    DBGPRINTLN_CTX("USART_CMD_GET_PERF [R %hhu]", xPayload.ubReset);
 
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_perf_t);
 
-                        break;
-                    }
+                    xPayload.ulLoopAvg = ulPerfLoopAvg;
+                    xPayload.ulLoopMax = ulPerfLoopMax;
+                    xPayload.ulCmdMax = ulPerfCmdMax;
 
-                    set_freq(xPayload.fFreq);
+                    uint64_t ullCacheHits, ullCacheMisses;
+
+                    msc_cache_counters_get(&ullCacheHits, &ullCacheMisses);
+
+                    xPayload.ullCacheHits = ullCacheHits; // Packed members can't be pointed to
+                    xPayload.ullCacheMisses = ullCacheMisses;
+
+                    if(xPayload.ubReset)
+                        perf_reset();
 
-                    xHeader.ubPayloadSize = 0;
                     usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_perf_t));
                 }
                 break;
-                case USART_CMD_GET_FREQ:
+                case USART_CMD_GET_HISTORY:
                 {
-                    if(xHeader.ubPayloadSize != sizeof(usart_cmd_get_freq_t))
-                    {
-                        DBGPRINTLN_CTX("Invalid payload size!");
-
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart_cmd_get_history_t xPayload;
 
+                    if(!usart_cmd_read_payload(&xHeader, &xPayload, sizeof(usart_cmd_get_history_t)))
                         break;
-                    }
 
-                    if(usart0_available() < xHeader.ubPayloadSize)
+                    if(xPayload.ubTier >= HISTORY_TIERS)
                     {
-                        DBGPRINTLN_CTX("Not enough data, waiting...");
-
-                        uint64_t ullStartTick = g_ullSystemTick;
+                        DBGPRINTLN_CTX("Invalid tier!");
 
-                        while(usart0_available() < xHeader.ubPayloadSize && g_ullSystemTick - ullStartTick <= 500);
+                        usart_cmd_error(&xHeader);
 
-                        if(usart0_available() < xHeader.ubPayloadSize)
-                        {
-                            DBGPRINTLN_CTX("Timed out waiting for payload!");
+                        break;
+                    }
 
-                            xHeader.ubCommand = USART_CMD_ERROR;
-                            xHeader.ubPayloadSize = 0;
-                            usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    DBGPRINTLN_CTX("USART_CMD_GET_HISTORY [T %hhu B %hhu]", xPayload.ubTier, xPayload.ubBlock);
 
-                            break;
-                        }
-                    }
+                    xHeader.ubPayloadSize = sizeof(usart_cmd_get_history_t);
 
-                    usart_cmd_get_freq_t xPayload;
+                    history_block_t xBlock; // Tier 0 is encoded into it from the slots, the payload is packed
 
-                    DBGPRINTLN_CTX("Reading payload...");
-                    usart0_read((uint8_t *)&xPayload, xHeader.ubPayloadSize);
+                    if(!history_get_block(xPayload.ubTier, xPayload.ubBlock, &xBlock))
+                        memset(&xBlock, 0, sizeof(history_block_t));
 
-                    DBGPRINTLN_CTX("USART_CMD_GET_FREQ");
+                    xPayload.ubBlockCount = history_get_block_count(xPayload.ubTier);
+                    xPayload.usPeriod = history_get_period(xPayload.ubTier);
+                    xPayload.ulNow = ulHistoryTime;
 
-                    xPayload.fFreq = get_freq();
+                    memcpy(&xPayload.xBlock, &xBlock, sizeof(history_block_t));
 
                     usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_freq_t));
+                    usart0_write((uint8_t *)&xPayload, sizeof(usart_cmd_get_history_t));
                 }
                 break;
                 case USART_CMD_GET_UID:
                 {
-                    if(xHeader.ubPayloadSize != 0)
-                    {
-                        DBGPRINTLN_CTX("Invalid payload size!");
-
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-
+                    if(!usart_cmd_read_payload(&xHeader, NULL, 0))
                         break;
-                    }
 
                     DBGPRINTLN_CTX("USART_CMD_GET_UID");
 
@@ -950,16 +4043,8 @@ int main()
                 break;
                 case USART_CMD_GET_SW_INFO:
                 {
-                    if(xHeader.ubPayloadSize != 0)
-                    {
-                        DBGPRINTLN_CTX("Invalid payload size!");
-
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-
+                    if(!usart_cmd_read_payload(&xHeader, NULL, 0))
                         break;
-                    }
 
                     DBGPRINTLN_CTX("USART_CMD_GET_SW_INFO");
 
@@ -977,16 +4062,8 @@ int main()
                 break;
                 case USART_CMD_RESET_BL:
                 {
-                    if(xHeader.ubPayloadSize != 0)
-                    {
-                        DBGPRINTLN_CTX("Invalid payload size!");
-
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-
+                    if(!usart_cmd_read_payload(&xHeader, NULL, 0))
                         break;
-                    }
 
                     DBGPRINTLN_CTX("USART_CMD_RESET_BL");
 
@@ -996,22 +4073,19 @@ int main()
 
                     delay_ms(100);
 
+                    if(ubAccountingDirty)
+                        accounting_store();
+
+                    config_flush();
+
                     rmu_set_reset_state(0x01);
                     reset();
                 }
                 break;
                 case USART_CMD_RESET_APP:
                 {
-                    if(xHeader.ubPayloadSize != 0)
-                    {
-                        DBGPRINTLN_CTX("Invalid payload size!");
-
-                        xHeader.ubCommand = USART_CMD_ERROR;
-                        xHeader.ubPayloadSize = 0;
-                        usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
-
+                    if(!usart_cmd_read_payload(&xHeader, NULL, 0))
                         break;
-                    }
 
                     DBGPRINTLN_CTX("USART_CMD_RESET_APP");
 
@@ -1021,6 +4095,11 @@ int main()
 
                     delay_ms(100);
 
+                    if(ubAccountingDirty)
+                        accounting_store();
+
+                    config_flush();
+
                     rmu_set_reset_state(0x00);
                     reset();
                 }
@@ -1029,11 +4108,14 @@ int main()
                 {
                     DBGPRINTLN_CTX("Invalid command!");
 
-                    xHeader.ubCommand = USART_CMD_ERROR;
-                    xHeader.ubPayloadSize = 0;
-                    usart0_write((uint8_t *)&xHeader, sizeof(usart_cmd_header_t));
+                    usart_cmd_error(&xHeader);
                 }
             }
+
+            uint32_t ulCmdCycles = DWT->CYCCNT - ulCmdStart;
+
+            if(ulCmdCycles > ulPerfCmdMax)
+                ulPerfCmdMax = ulCmdCycles;
         }
     }
 
@@ -1,8 +1,59 @@
 #include "msc.h"
 
+static ldma_descriptor_t __attribute__ ((aligned (4))) xMSCDMADescriptor;
+
+static volatile uint32_t ulCacheHitsOverflows = 0;
+static volatile uint32_t ulCacheMissesOverflows = 0;
+
 lock_bits_t *g_psLockBits = (lock_bits_t *)LOCKBITS_BASE;
 init_calib_t *g_psInitCalibrationTable = (init_calib_t *)(DEVINFO_BASE & ~(uint32_t)(FLASH_PAGE_SIZE - 1));
 
+void _msc_isr()
+{
+    uint32_t ulFlags = MSC->IFC;
+
+    if(ulFlags & MSC_IFC_CHOF)
+        ulCacheHitsOverflows++;
+
+    if(ulFlags & MSC_IFC_CMOF)
+        ulCacheMissesOverflows++;
+}
+
+static void msc_flash_burst_dma(uint8_t *pubData, uint32_t ulSize)
+{
+    ldma_ch_disable(MSC_DMA_CHANNEL);
+    ldma_ch_peri_req_disable(MSC_DMA_CHANNEL);
+    ldma_ch_req_clear(MSC_DMA_CHANNEL);
+
+    ldma_ch_config(MSC_DMA_CHANNEL, LDMA_CH_REQSEL_SOURCESEL_MSC | LDMA_CH_REQSEL_SIGSEL_MSCWDATA, LDMA_CH_CFG_SRCINCSIGN_POSITIVE, LDMA_CH_CFG_DSTINCSIGN_DEFAULT, LDMA_CH_CFG_ARBSLOTS_DEFAULT, 0);
+
+    // No DONEIFSEN, completion is polled so the LDMA ISR never sees this channel
+    xMSCDMADescriptor.CTRL = LDMA_CH_CTRL_DSTMODE_ABSOLUTE | LDMA_CH_CTRL_SRCMODE_ABSOLUTE | LDMA_CH_CTRL_DSTINC_NONE | LDMA_CH_CTRL_SIZE_WORD | LDMA_CH_CTRL_SRCINC_ONE | LDMA_CH_CTRL_REQMODE_BLOCK | LDMA_CH_CTRL_BLOCKSIZE_UNIT1 | ((((ulSize >> 2) - 1) << _LDMA_CH_CTRL_XFERCNT_SHIFT) & _LDMA_CH_CTRL_XFERCNT_MASK) | LDMA_CH_CTRL_STRUCTTYPE_TRANSFER;
+    xMSCDMADescriptor.SRC = pubData;
+    xMSCDMADescriptor.DST = &(MSC->WDATA);
+    xMSCDMADescriptor.LINK = 0x00000000;
+
+    ldma_ch_load(MSC_DMA_CHANNEL, &xMSCDMADescriptor);
+    ldma_ch_peri_req_enable(MSC_DMA_CHANNEL);
+    ldma_ch_enable(MSC_DMA_CHANNEL);
+
+    MSC->WRITECMD = MSC_WRITECMD_WRITETRIG; // WDATA requests start once the trigger is armed
+
+    while(!ldma_ch_get_done(MSC_DMA_CHANNEL));
+}
+static void msc_flash_burst_cpu(uint8_t *pubData, uint32_t ulSize)
+{
+    for(uint32_t i = 0; i < ulSize; i += 4)
+    {
+        while(!(MSC->STATUS & MSC_STATUS_WDATAREADY));
+
+        MSC->WDATA = (uint32_t)pubData[i] | ((uint32_t)pubData[i + 1] << 8) | ((uint32_t)pubData[i + 2] << 16) | ((uint32_t)pubData[i + 3] << 24); // Source may be unaligned
+
+        if(!i)
+            MSC->WRITECMD = MSC_WRITECMD_WRITETRIG; // Following words are written as soon as WDATA is refilled
+    }
+}
+
 void msc_init()
 {
     msc_flash_unlock();
@@ -12,6 +63,14 @@ void msc_init()
     MSC->CACHECMD = MSC_CACHECMD_INVCACHE;
 
     msc_flash_lock();
+
+    REG_DISCARD(&MSC->IFC); // Clear all flags
+    IRQ_CLEAR(MSC_IRQn); // Clear pending vector
+    IRQ_SET_PRIO(MSC_IRQn, 3, 1); // Set priority 3,1 (min)
+    IRQ_ENABLE(MSC_IRQn); // Enable vector
+    MSC->IEN |= MSC_IEN_CHOF | MSC_IEN_CMOF; // Extend the 20 bit cache counters in software
+
+    msc_cache_counters_reset();
 }
 void msc_config_waitstates(uint32_t ulFrequency)
 {
@@ -24,6 +83,44 @@ void msc_config_waitstates(uint32_t ulFrequency)
 
     msc_flash_lock();
 }
+void msc_cache_counters_reset()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        MSC->CACHECMD = MSC_CACHECMD_STOPPC;
+        MSC->CACHECMD = MSC_CACHECMD_STARTPC; // Also clears both counters
+
+        REG_DISCARD(&MSC->IFC); // Drop overflows from the previous run
+        IRQ_CLEAR(MSC_IRQn);
+
+        ulCacheHitsOverflows = 0;
+        ulCacheMissesOverflows = 0;
+    }
+}
+void msc_cache_counters_get(uint64_t *pullHits, uint64_t *pullMisses)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint32_t ulHits = MSC->CACHEHITS & _MSC_CACHEHITS_MASK;
+        uint32_t ulMisses = MSC->CACHEMISSES & _MSC_CACHEMISSES_MASK;
+        uint32_t ulFlags = MSC->IF;
+        uint64_t ullHitsOverflows = ulCacheHitsOverflows;
+        uint64_t ullMissesOverflows = ulCacheMissesOverflows;
+
+        // A pending overflow not serviced yet only counts if the value was read after the wrap
+        if((ulFlags & MSC_IF_CHOF) && ulHits < (_MSC_CACHEHITS_MASK >> 1))
+            ullHitsOverflows++;
+
+        if((ulFlags & MSC_IF_CMOF) && ulMisses < (_MSC_CACHEMISSES_MASK >> 1))
+            ullMissesOverflows++;
+
+        if(pullHits)
+            *pullHits = ullHitsOverflows * (_MSC_CACHEHITS_MASK + 1ULL) + ulHits;
+
+        if(pullMisses)
+            *pullMisses = ullMissesOverflows * (_MSC_CACHEMISSES_MASK + 1ULL) + ulMisses;
+    }
+}
 void msc_flash_lock()
 {
     MSC->LOCK = MSC_LOCK_LOCKKEY_LOCK;
@@ -75,36 +172,43 @@ void msc_flash_page_write(uint32_t ulAddress, uint8_t *pubData, uint32_t ulSize)
     if(ulSize & 3) // Only allow full word writes
         return;
 
-    ulAddress &= ~(uint32_t)(FLASH_PAGE_SIZE - 1);
+    if(ulAddress & 3) // Only allow aligned writes
+        return;
+
+    // The LDMA reads whole words, unaligned sources and writes before ldma_init() are fed by the CPU
+    uint8_t ubDMA = !((uint32_t)pubData & 3) && (CMU->HFBUSCLKEN0 & CMU_HFBUSCLKEN0_LDMA);
 
     while(MSC->STATUS & MSC_STATUS_BUSY);
 
     msc_flash_unlock();
 
-    MSC->ADDRB = ulAddress;
-    MSC->WRITECMD = MSC_WRITECMD_LADDRIM;
-
-    for(uint16_t i = 0; i < FLASH_PAGE_SIZE; i += 4)
+    while(ulSize)
     {
-        if(!ulSize)
+        // A burst can't cross a page boundary, the address is reloaded for each page
+        uint32_t ulCount = FLASH_PAGE_SIZE - (ulAddress & (FLASH_PAGE_SIZE - 1));
+
+        if(ulCount > ulSize)
+            ulCount = ulSize;
+
+        MSC->ADDRB = ulAddress;
+        MSC->WRITECMD = MSC_WRITECMD_LADDRIM;
+
+        if(MSC->STATUS & (MSC_STATUS_LOCKED | MSC_STATUS_INVADDR)) // WDATAREADY would never come back
             break;
 
-        MSC->WDATA = *(uint32_t *)pubData;
-        MSC->WRITECMD = MSC_WRITECMD_WRITEONCE;
+        if(ubDMA)
+            msc_flash_burst_dma(pubData, ulCount);
+        else
+            msc_flash_burst_cpu(pubData, ulCount);
 
         while(MSC->STATUS & MSC_STATUS_BUSY);
 
-        ulSize -= 4;
-        ulAddress += 4;
-        pubData += 4;
+        ulSize -= ulCount;
+        ulAddress += ulCount;
+        pubData += ulCount;
     }
 
     msc_flash_lock();
-
-    if(!ulSize)
-        return;
-
-    msc_flash_page_write(ulAddress, pubData, ulSize);
 }
 void msc_flash_word_write(uint32_t ulAddress, uint32_t ulData)
 {
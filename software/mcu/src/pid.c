@@ -0,0 +1,83 @@
+#include "pid.h"
+
+static int32_t pid_clamp(int64_t llValue, int32_t lMin, int32_t lMax)
+{
+    if(llValue < lMin)
+        return lMin;
+
+    if(llValue > lMax)
+        return lMax;
+
+    return llValue;
+}
+
+uint8_t pid_config(pid_controller_t *pPID, int16_t sSetpoint, int32_t lKp, int32_t lKi, int32_t lKd, uint8_t ubDerivativeFilter, uint16_t usMinOutput, uint16_t usMaxOutput)
+{
+    if(!pPID)
+        return 0;
+
+    if(usMinOutput > usMaxOutput)
+        return 0;
+
+    if(ubDerivativeFilter > 15)
+        return 0;
+
+    pPID->sSetpoint = sSetpoint;
+    pPID->lKp = lKp;
+    pPID->lKi = lKi;
+    pPID->lKd = lKd;
+    pPID->ubDerivativeFilter = ubDerivativeFilter;
+    pPID->usMinOutput = usMinOutput;
+    pPID->usMaxOutput = usMaxOutput;
+
+    // Keep the integral term across retuning so the output does not jump, only pull it back into the new limits
+    pPID->lIntegral = pid_clamp(pPID->lIntegral, (int32_t)usMinOutput << 8, (int32_t)usMaxOutput << 8);
+
+    return 1;
+}
+void pid_reset(pid_controller_t *pPID)
+{
+    if(!pPID)
+        return;
+
+    pPID->lIntegral = (int32_t)pPID->usMinOutput << 8;
+    pPID->lDerivative = 0;
+    pPID->ubPrimed = 0;
+}
+uint16_t pid_step(pid_controller_t *pPID, int16_t sMeasurement)
+{
+    if(!pPID)
+        return 0;
+
+    // Terms are accumulated as Q0.24 duty cycles, 8 more fractional bits than the output so small integral steps are not lost
+    int32_t lMin = (int32_t)pPID->usMinOutput << 8;
+    int32_t lMax = (int32_t)pPID->usMaxOutput << 8;
+    int32_t lError = (int32_t)sMeasurement - pPID->sSetpoint; // Q8.8
+
+    if(!pPID->ubPrimed)
+    {
+        pPID->sLastMeasurement = sMeasurement; // No derivative kick on the first sample
+        pPID->ubPrimed = 1;
+    }
+
+    // Q16.16 * Q8.8 = Q0.24, 64 bit intermediates so large gains cannot overflow
+    int64_t llProportional = (int64_t)pPID->lKp * lError;
+    int64_t llIntegralStep = (int64_t)pPID->lKi * lError;
+
+    // Derivative on the measurement instead of the error, setpoint changes do not kick the output
+    int64_t llDerivativeRaw = (int64_t)pPID->lKd * ((int32_t)sMeasurement - pPID->sLastMeasurement);
+    int32_t lDerivativeRaw = pid_clamp(llDerivativeRaw, INT32_MIN >> 1, INT32_MAX >> 1);
+
+    pPID->lDerivative += (lDerivativeRaw - pPID->lDerivative) >> pPID->ubDerivativeFilter;
+    pPID->sLastMeasurement = sMeasurement;
+
+    // Anti-windup: conditional integration, the integral only moves towards saturation while the output is not already saturated
+    int64_t llUnclamped = llProportional + pPID->lIntegral + pPID->lDerivative;
+
+    if(!((llUnclamped >= lMax && llIntegralStep > 0) || (llUnclamped <= lMin && llIntegralStep < 0)))
+        pPID->lIntegral = pid_clamp((int64_t)pPID->lIntegral + llIntegralStep, lMin, lMax);
+
+    int32_t lOutput = pid_clamp(llProportional + pPID->lIntegral + pPID->lDerivative, lMin, lMax);
+
+    return (uint32_t)lOutput >> 8;
+}
@@ -0,0 +1,44 @@
+#include "prs.h"
+
+void prs_init()
+{
+    cmu_hfbus_clock_gate(CMU_HFBUSCLKEN0_PRS, 1);
+
+    for(uint8_t ubChannel = 0; ubChannel < PRS_CHAN_COUNT; ubChannel++)
+        PRS->CH[ubChannel].CTRL = _PRS_CH_CTRL_RESETVALUE;
+}
+
+void prs_ch_config(uint8_t ubChannel, uint32_t ulSource, uint32_t ulEdge, uint8_t ubAsync)
+{
+    if(ubChannel >= PRS_CHAN_COUNT)
+        return;
+
+    // Asynchronous channels keep working without HFCLK, but the edge detector needs it
+    if(ubAsync)
+        ulEdge = PRS_CH_CTRL_EDSEL_OFF;
+
+    PRS->CH[ubChannel].CTRL = (ubAsync ? PRS_CH_CTRL_ASYNC : 0) | (ulEdge & _PRS_CH_CTRL_EDSEL_MASK) | (ulSource & (_PRS_CH_CTRL_SOURCESEL_MASK | _PRS_CH_CTRL_SIGSEL_MASK));
+}
+void prs_ch_disable(uint8_t ubChannel)
+{
+    if(ubChannel >= PRS_CHAN_COUNT)
+        return;
+
+    PRS->CH[ubChannel].CTRL = _PRS_CH_CTRL_RESETVALUE;
+}
+uint8_t prs_ch_get_level(uint8_t ubChannel)
+{
+    if(ubChannel >= PRS_CHAN_COUNT)
+        return 0;
+
+    return !!(PRS->PEEK & BIT(ubChannel));
+}
+
+void prs_sw_pulse(uint16_t usMask)
+{
+    PRS->SWPULSE = usMask;
+}
+void prs_sw_level(uint16_t usMask, uint16_t usLevel)
+{
+    PRS->SWLEVEL = (PRS->SWLEVEL & ~usMask) | (usLevel & usMask);
+}
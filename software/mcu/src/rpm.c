@@ -0,0 +1,117 @@
+#include "rpm.h"
+
+static int32_t rpm_ripple(const uint16_t *pusSamples, uint16_t i, uint32_t *pulWindow, int32_t *plBaseline)
+{
+    // Moving average against noise, then the slow baseline is taken out so supply drift does not hide the ripple
+    *pulWindow += pusSamples[i];
+
+    if(i >= RPM_SMOOTHING)
+        *pulWindow -= pusSamples[i - RPM_SMOOTHING];
+
+    int32_t lValue = (int32_t)(*pulWindow / RPM_SMOOTHING) << 8; // Q.8
+
+    if(i < RPM_SMOOTHING)
+        *plBaseline = lValue;
+    else
+        *plBaseline += (lValue - *plBaseline) >> RPM_BASELINE_SHIFT;
+
+    return lValue - *plBaseline;
+}
+
+uint16_t rpm_estimate(const uint16_t *pusSamples, uint16_t usCount, uint32_t ulSampleRate, uint8_t ubPulsesPerRev)
+{
+    if(!pusSamples || usCount < RPM_MIN_SAMPLES || !ulSampleRate || !ubPulsesPerRev)
+        return 0;
+
+    uint32_t ulWindow = 0;
+    int32_t lBaseline = 0;
+    int32_t lMin = INT32_MAX;
+    int32_t lMax = INT32_MIN;
+    int32_t lSum = 0; // Whole codes, cannot overflow for any capture length
+
+    // First pass finds the ripple amplitude and offset once the baseline has settled
+    for(uint16_t i = 0; i < usCount; i++)
+    {
+        int32_t lRipple = rpm_ripple(pusSamples, i, &ulWindow, &lBaseline);
+
+        if(i < RPM_SETTLE_SAMPLES)
+            continue;
+
+        if(lRipple < lMin)
+            lMin = lRipple;
+
+        if(lRipple > lMax)
+            lMax = lRipple;
+
+        lSum += lRipple >> 8;
+    }
+
+    if(lMax - lMin < (RPM_MIN_RIPPLE << 8))
+        return 0;
+
+    // Schmitt trigger a quarter of the peak to peak wide, centered on the mean ripple since the baseline lags behind a drifting supply
+    int32_t lCenter = (lSum / (int32_t)(usCount - RPM_SETTLE_SAMPLES)) << 8;
+    int32_t lHigh = lCenter + ((lMax - lMin) >> 3);
+    int32_t lLow = lCenter - ((lMax - lMin) >> 3);
+
+    int32_t lPrevious = 0;
+    uint8_t ubArmed = 0;
+    uint16_t usCrossings = 0;
+    uint32_t ulFirst = 0; // Q24.8 sample index
+    uint32_t ulLast = 0;
+
+    ulWindow = 0;
+    lBaseline = 0;
+
+    for(uint16_t i = 0; i < usCount; i++)
+    {
+        int32_t lRipple = rpm_ripple(pusSamples, i, &ulWindow, &lBaseline);
+
+        if(i < RPM_SETTLE_SAMPLES)
+        {
+            lPrevious = lRipple;
+
+            continue;
+        }
+
+        if(lRipple < lLow)
+        {
+            ubArmed = 1;
+        }
+        else if(ubArmed && lRipple > lHigh)
+        {
+            // Linear interpolation between the two samples straddling the upper threshold, scaled down so the Q.8 quotient fits 32 bits
+            uint32_t ulNumerator = lHigh - lPrevious;
+            uint32_t ulDenominator = lRipple - lPrevious;
+
+            while(ulDenominator > 0x7FFFFF)
+            {
+                ulNumerator >>= 1;
+                ulDenominator >>= 1;
+            }
+
+            uint32_t ulFraction = (ulNumerator << 8) / ulDenominator;
+            uint32_t ulCrossing = ((uint32_t)(i - 1) << 8) + ulFraction;
+
+            if(!usCrossings)
+                ulFirst = ulCrossing;
+
+            ulLast = ulCrossing;
+            usCrossings++;
+            ubArmed = 0;
+        }
+
+        lPrevious = lRipple;
+    }
+
+    if(usCrossings < RPM_MIN_CROSSINGS || ulLast <= ulFirst)
+        return 0;
+
+    // RPM = 60 * fs * periods / (pulses per rev * span in samples), in float since there is no 64 bit division helper
+    float fRPM = 60.f * ulSampleRate * (usCrossings - 1) * 256.f / ((float)ubPulsesPerRev * (ulLast - ulFirst));
+
+    if(fRPM > 65535.f)
+        return 0xFFFF;
+
+    return fRPM + 0.5f;
+}
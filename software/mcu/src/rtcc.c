@@ -1,5 +1,25 @@
 #include "rtcc.h"
 
+static rtcc_tick_isr_t pfTickISR = NULL;
+static uint32_t ulTickPeriod = 0;
+static volatile uint32_t ulOverflows = 0; // Upper half of the 64 bit tick count
+
+void _rtcc_isr()
+{
+    uint32_t ulFlags = RTCC->IFC;
+
+    if(ulFlags & RTCC_IFC_OF)
+        ulOverflows++;
+
+    if(ulFlags & RTCC_IFC_CC2)
+    {
+        RTCC->CC[2].CCV += ulTickPeriod; // Next match, wraps along with CNT
+
+        if(pfTickISR)
+            pfTickISR();
+    }
+}
+
 void rtcc_init()
 {
     cmu_hfbus_clock_gate(CMU_HFBUSCLKEN0_LE, 1);
@@ -8,30 +28,71 @@ void rtcc_init()
 
     cmu_update_clocks();
 
-    RTCC->CTRL = RTCC_CTRL_CNTMODE_NORMAL | RTCC_CTRL_OSCFDETEN | RTCC_CTRL_CNTTICK_CCV0MATCH | RTCC_CTRL_PRECCV0TOP | RTCC_CTRL_DEBUGRUN;
+    // CNT counts every RTCC clock and is the low half of the system time, so it is never written after this
+    RTCC->CTRL = RTCC_CTRL_CNTMODE_NORMAL | RTCC_CTRL_OSCFDETEN | RTCC_CTRL_CNTTICK_PRESC | RTCC_CTRL_CNTPRESC_DIV1 | RTCC_CTRL_DEBUGRUN;
     RTCC->PRECNT = 0;
     RTCC->CNT = 0;
 
-    RTCC->CC[0].CCV = (RTCC_CLOCK_FREQ / 1) - 1; // Prescaler for 1 Hz
+    ulOverflows = 0;
 
     RTCC->CC[1].CTRL = RTCC_CC_CTRL_COMPBASE_CNT | RTCC_CC_CTRL_MODE_OUTPUTCOMPARE;
 
+    RTCC->CC[2].CTRL = RTCC_CC_CTRL_COMPBASE_CNT | RTCC_CC_CTRL_MODE_OFF;
+
     RTCC->IFC = _RTCC_IFC_MASK;
-    RTCC->IEN |= RTCC_IEN_CC1;
+    IRQ_CLEAR(RTCC_IRQn); // Clear pending vector
+    IRQ_SET_PRIO(RTCC_IRQn, 2, 1); // Set priority 2,1
+    IRQ_ENABLE(RTCC_IRQn); // Enable vector
+    RTCC->IEN |= RTCC_IEN_OF | RTCC_IEN_CC1;
 
     RTCC->CTRL |= RTCC_CTRL_ENABLE;
 }
-uint32_t rtcc_get_time()
+uint64_t rtcc_get_ticks()
 {
-    return RTCC->CNT;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint32_t ulHigh = ulOverflows;
+        uint32_t ulLow = RTCC->CNT;
+
+        if((RTCC->IF & RTCC_IF_OF) && ulLow < 0x80000000) // CNT wrapped but the ISR has not run yet
+            ulHigh++;
+
+        return ((uint64_t)ulHigh << 32) | ulLow;
+    }
 }
-void rtcc_set_time(uint32_t ulTime)
+uint8_t rtcc_set_alarm(uint64_t ullTicks)
 {
-    RTCC->CNT = ulTime;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint64_t ullNow = rtcc_get_ticks();
+
+        if(ullTicks < ullNow + RTCC_ALARM_MIN_TICKS) // CNT could pass the compare value before it is written
+            return 0;
+
+        if(ullTicks - ullNow > 0xFFFFFFFF) // Only the low half is compared
+            return 0;
+
+        RTCC->CC[1].CCV = (uint32_t)ullTicks;
+
+        RTCC->IFC = RTCC_IFC_CC1;
+
+        return 1;
+    }
 }
-void rtcc_set_alarm(uint32_t ulAlarm)
+void rtcc_set_tick(uint32_t ulPeriod, rtcc_tick_isr_t pfISR)
 {
-    RTCC->CC[1].CCV = ulAlarm;
+    RTCC->IEN &= ~RTCC_IEN_CC2;
+    RTCC->CC[2].CTRL = RTCC_CC_CTRL_COMPBASE_CNT | RTCC_CC_CTRL_MODE_OFF;
+
+    pfTickISR = pfISR;
+    ulTickPeriod = ulPeriod;
+
+    if(!ulPeriod || !pfISR)
+        return;
+
+    RTCC->CC[2].CCV = RTCC->CNT + ulPeriod;
+    RTCC->CC[2].CTRL = RTCC_CC_CTRL_COMPBASE_CNT | RTCC_CC_CTRL_MODE_OUTPUTCOMPARE;
 
-    RTCC->IFC = RTCC_IFC_CC1;
+    RTCC->IFC = RTCC_IFC_CC2;
+    RTCC->IEN |= RTCC_IEN_CC2;
 }
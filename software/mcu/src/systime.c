@@ -0,0 +1,81 @@
+#include "systime.h"
+
+#define RTCC_TICK_MASK  (BIT(RTCC_TICK_SHIFT) - 1)
+
+static uint64_t ullSleepDeadline = 0; // ms, earliest deadline handed in since the last sleep_idle
+
+static uint64_t ms_to_ticks(uint32_t ulMs)
+{
+    return ((uint64_t)(ulMs / 1000) << RTCC_TICK_SHIFT) + ((((ulMs % 1000) << RTCC_TICK_SHIFT) + 999) / 1000); // Rounded up, never shorter than asked for
+}
+static uint32_t sleep_until(uint64_t ullTicks)
+{
+    if(!rtcc_set_alarm(ullTicks)) // Too close for an alarm, not worth sleeping
+        return 0;
+
+    uint64_t ullStart = rtcc_get_ticks();
+    uint32_t ulStart = DWT->CYCCNT;
+
+    SCB->SCR = (SCB->SCR & ~SCB_SCR_SLEEPDEEP_Msk) | SCB_SCR_SEVONPEND_Msk; // EM1, peripherals and the LDMA keep running
+
+    __DSB();
+    __WFE(); // Falls through once if an interrupt went pending since the last WFE, whatever it left for the main loop is not missed
+
+    // The core clock stops CYCCNT while asleep, the RTCC keeps counting, so it is caught up to within one RTCC tick
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint32_t ulAsleep = ((uint64_t)(uint32_t)(rtcc_get_ticks() - ullStart) * HFCORE_CLOCK_FREQ) >> RTCC_TICK_SHIFT;
+        uint32_t ulCounted = DWT->CYCCNT - ulStart;
+
+        if(ulAsleep <= ulCounted)
+            return 0;
+
+        DWT->CYCCNT += ulAsleep - ulCounted;
+
+        return ulAsleep - ulCounted;
+    }
+}
+
+uint64_t now_ms()
+{
+    uint64_t ullTicks = rtcc_get_ticks();
+
+    // Whole seconds and the fraction are scaled apart, so nothing overflows and no 64 bit division is needed
+    return (ullTicks >> RTCC_TICK_SHIFT) * 1000 + ((((uint32_t)ullTicks & RTCC_TICK_MASK) * 1000) >> RTCC_TICK_SHIFT);
+}
+uint64_t now_us()
+{
+    uint64_t ullTicks = rtcc_get_ticks();
+
+    return (ullTicks >> RTCC_TICK_SHIFT) * 1000000 + ((((uint32_t)ullTicks & RTCC_TICK_MASK) * 15625) >> (RTCC_TICK_SHIFT - 6)); // 10^6 / 2^15 = 15625 / 2^9
+}
+void delay_ms(uint32_t ulMs)
+{
+    uint64_t ullDeadline = rtcc_get_ticks() + ms_to_ticks(ulMs);
+
+    NONATOMIC_BLOCK(NONATOMIC_RESTORESTATE)
+    {
+        while(rtcc_get_ticks() < ullDeadline)
+            sleep_until(ullDeadline); // Any interrupt wakes the core too, the loop checks again, the last ticks are spun
+    }
+}
+void sleep_deadline(uint64_t ullMs)
+{
+    if(ullMs < ullSleepDeadline)
+        ullSleepDeadline = ullMs;
+}
+uint32_t sleep_idle(uint32_t ulMaxMs)
+{
+    uint64_t ullNow = now_ms();
+    uint64_t ullDeadline = ullSleepDeadline;
+
+    ullSleepDeadline = UINT64_MAX; // Handed in again by the next pass of the main loop
+
+    if(ullDeadline <= ullNow)
+        return 0;
+
+    if(ullDeadline - ullNow < ulMaxMs)
+        ulMaxMs = ullDeadline - ullNow;
+
+    return sleep_until(rtcc_get_ticks() + ms_to_ticks(ulMaxMs));
+}
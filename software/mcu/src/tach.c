@@ -0,0 +1,165 @@
+#include "tach.h"
+
+typedef struct
+{
+    uint8_t ubPulsesPerRev;
+    uint8_t ubAverage;
+    uint8_t ubIndex;
+    uint8_t ubFill;
+    uint8_t ubPrimed; // An edge was seen since the last reset, ulLastEdge is valid
+    uint32_t ulLastEdge; // RTCC ticks
+    uint32_t ulPeriodSum; // Running sum of the periods in the window, in RTCC ticks
+    uint32_t pulPeriod[TACH_MAX_AVERAGE];
+    volatile uint32_t ulPulseCount;
+    volatile uint64_t ullLastPulseTick;
+} tach_t;
+
+static tach_t pxTach[TACH_COUNT];
+static const uint8_t pubTachLine[TACH_COUNT] = {GPIO_EXTI_TACH0, GPIO_EXTI_TACH1, GPIO_EXTI_TACH2};
+
+static void tach_isr(uint8_t ubLine)
+{
+    uint32_t ulNow = (uint32_t)rtcc_get_ticks(); // Unlike CYCCNT the RTCC keeps counting while the core sleeps
+
+    for(uint8_t i = 0; i < TACH_COUNT; i++)
+    {
+        if(pubTachLine[i] != ubLine)
+            continue;
+
+        tach_t *pTach = &pxTach[i];
+        uint32_t ulPeriod = ulNow - pTach->ulLastEdge; // Wraps cleanly, periods are far below the 32 bit range
+
+        if(pTach->ubPrimed && ulPeriod < ((uint64_t)TACH_MIN_PERIOD_US << RTCC_TICK_SHIFT) / 1000000)
+            return;
+
+        // The first edge after a reset or a pause only restarts the measurement
+        if(pTach->ubPrimed && now_ms() - pTach->ullLastPulseTick < TACH_MAX_PERIOD_MS)
+        {
+            if(pTach->ubFill == pTach->ubAverage)
+                pTach->ulPeriodSum -= pTach->pulPeriod[pTach->ubIndex];
+            else
+                pTach->ubFill++;
+
+            pTach->pulPeriod[pTach->ubIndex] = ulPeriod;
+            pTach->ulPeriodSum += ulPeriod;
+            pTach->ubIndex = (pTach->ubIndex + 1) % pTach->ubAverage;
+        }
+
+        else
+        {
+            pTach->ubIndex = 0;
+            pTach->ubFill = 0;
+            pTach->ulPeriodSum = 0;
+        }
+
+        pTach->ubPrimed = 1;
+        pTach->ulLastEdge = ulNow;
+        pTach->ullLastPulseTick = now_ms();
+        pTach->ulPulseCount++;
+
+        return;
+    }
+}
+
+void tach_init()
+{
+    // Edges are timestamped with the RTCC, the sum of consecutive periods is only off by one tick however many are averaged
+    for(uint8_t i = 0; i < TACH_COUNT; i++)
+    {
+        tach_config(i, TACH_DEF_PULSES_PER_REV, TACH_DEF_AVERAGE);
+
+        gpio_set_exti_isr(pubTachLine[i], tach_isr);
+    }
+}
+uint8_t tach_config(uint8_t ubTach, uint8_t ubPulsesPerRev, uint8_t ubAverage)
+{
+    if(ubTach >= TACH_COUNT)
+        return 0;
+
+    if(!ubPulsesPerRev || !ubAverage || ubAverage > TACH_MAX_AVERAGE)
+        return 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pxTach[ubTach].ubPulsesPerRev = ubPulsesPerRev;
+        pxTach[ubTach].ubAverage = ubAverage;
+    }
+
+    tach_reset(ubTach);
+
+    return 1;
+}
+void tach_get_config(uint8_t ubTach, uint8_t *pubPulsesPerRev, uint8_t *pubAverage)
+{
+    if(ubTach >= TACH_COUNT)
+        return;
+
+    if(pubPulsesPerRev)
+        *pubPulsesPerRev = pxTach[ubTach].ubPulsesPerRev;
+
+    if(pubAverage)
+        *pubAverage = pxTach[ubTach].ubAverage;
+}
+uint16_t tach_get_rpm(uint8_t ubTach)
+{
+    if(ubTach >= TACH_COUNT)
+        return 0;
+
+    uint32_t ulPeriodSum;
+    uint8_t ubFill;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ulPeriodSum = pxTach[ubTach].ulPeriodSum;
+        ubFill = pxTach[ubTach].ubFill;
+    }
+
+    if(!ubFill || !ulPeriodSum)
+        return 0;
+
+    if(tach_get_idle_time(ubTach) >= TACH_MAX_PERIOD_MS)
+        return 0;
+
+    // RPM = 60 * f_RTCC * pulses / (pulses per rev * sum of periods), both sides fit 32 bits with periods below TACH_MAX_PERIOD_MS
+    uint32_t ulRPM = 60 * BIT(RTCC_TICK_SHIFT) * ubFill / (pxTach[ubTach].ubPulsesPerRev * ulPeriodSum);
+
+    if(ulRPM > 0xFFFF)
+        return 0xFFFF;
+
+    return ulRPM;
+}
+uint32_t tach_get_pulse_count(uint8_t ubTach)
+{
+    if(ubTach >= TACH_COUNT)
+        return 0;
+
+    return pxTach[ubTach].ulPulseCount;
+}
+uint32_t tach_get_idle_time(uint8_t ubTach)
+{
+    if(ubTach >= TACH_COUNT)
+        return 0;
+
+    uint64_t ullLastPulseTick;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ullLastPulseTick = pxTach[ubTach].ullLastPulseTick;
+    }
+
+    return now_ms() - ullLastPulseTick;
+}
+void tach_reset(uint8_t ubTach)
+{
+    if(ubTach >= TACH_COUNT)
+        return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pxTach[ubTach].ubIndex = 0;
+        pxTach[ubTach].ubFill = 0;
+        pxTach[ubTach].ulPeriodSum = 0;
+        pxTach[ubTach].ubPrimed = 0;
+        pxTach[ubTach].ullLastPulseTick = now_ms();
+    }
+}
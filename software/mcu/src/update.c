@@ -0,0 +1,200 @@
+#include "update.h"
+
+typedef struct
+{
+    uint32_t ulMagic;
+    uint32_t ulSize; // Bytes to copy from the staging slot
+    uint32_t ulDone; // Left erased until the copy is complete
+} update_marker_t;
+
+static uint8_t ubUpdateActive = 0;
+static uint8_t ubUpdateReady = 0; // Image is complete and verified
+static uint32_t ulUpdateSize = 0;
+static uint32_t ulUpdateCRC = 0;
+static uint32_t ulUpdateReceived = 0;
+
+extern void _estack(); // Not really a function, just to be compatible with array later
+
+void _boot_reset_isr() BOOT_CODE __attribute__((noreturn));
+void _boot_fault_isr() BOOT_CODE;
+static void update_boot_flash_cmd(uint32_t ulAddress, uint32_t ulCommand, uint32_t ulData) BOOT_CODE;
+static void update_boot_copy(volatile update_marker_t *pMarker) BOOT_CODE;
+
+// Lives in the bootloader area, which an update never erases, so the copy can always be started again
+__attribute__ ((section(".irom1.isr_vector"))) void (* const g_pfnBootVectors[])() = {
+    _estack,
+    _boot_reset_isr,
+    _boot_fault_isr, // NMI
+    _boot_fault_isr, // HardFault
+    _boot_fault_isr, // MemManage
+    _boot_fault_isr, // BusFault
+    _boot_fault_isr // UsageFault
+};
+
+// Nothing below may call into irom0, it is half erased while the copy runs
+void _boot_reset_isr()
+{
+    volatile update_marker_t *pMarker = (volatile update_marker_t *)UPDATE_MARKER_ADDR;
+
+    SCB->VTOR = (uint32_t)g_pfnBootVectors;
+
+    if(pMarker->ulMagic == UPDATE_MARKER_MAGIC && pMarker->ulDone == 0xFFFFFFFF && pMarker->ulSize <= UPDATE_SLOT_SIZE)
+        update_boot_copy(pMarker);
+
+    while(!IS_VALID_APP(UPDATE_APP_ADDR));
+
+    SCB->VTOR = UPDATE_APP_ADDR;
+
+    __set_MSP(*(volatile uint32_t *)UPDATE_APP_ADDR);
+
+    ((void (*)())*(volatile uint32_t *)(UPDATE_APP_ADDR + 4))();
+
+    while(1);
+}
+void _boot_fault_isr()
+{
+    while(1);
+}
+static void update_boot_flash_cmd(uint32_t ulAddress, uint32_t ulCommand, uint32_t ulData)
+{
+    MSC->ADDRB = ulAddress;
+    MSC->WRITECMD = MSC_WRITECMD_LADDRIM;
+
+    if(ulCommand == MSC_WRITECMD_WRITEONCE)
+        MSC->WDATA = ulData;
+
+    MSC->WRITECMD = ulCommand;
+
+    while(MSC->STATUS & MSC_STATUS_BUSY);
+}
+static void update_boot_copy(volatile update_marker_t *pMarker)
+{
+    // Always starts over from the first page, the staging slot is not touched again until the marker is cleared
+    uint32_t ulSize = pMarker->ulSize;
+
+    MSC->LOCK = MSC_LOCK_LOCKKEY_UNLOCK;
+    MSC->WRITECTRL |= MSC_WRITECTRL_WREN;
+
+    for(uint32_t ulOffset = 0; ulOffset < ulSize; ulOffset += 4)
+    {
+        if(!(ulOffset & (FLASH_PAGE_SIZE - 1)))
+        {
+            WDOG0->CMD = WDOG_CMD_CLEAR;
+
+            update_boot_flash_cmd(UPDATE_APP_ADDR + ulOffset, MSC_WRITECMD_ERASEPAGE, 0);
+        }
+
+        update_boot_flash_cmd(UPDATE_APP_ADDR + ulOffset, MSC_WRITECMD_WRITEONCE, *(volatile uint32_t *)(UPDATE_STAGING_ADDR + ulOffset));
+    }
+
+    update_boot_flash_cmd((uint32_t)&pMarker->ulDone, MSC_WRITECMD_WRITEONCE, 0x00000000);
+
+    MSC->WRITECTRL &= ~MSC_WRITECTRL_WREN;
+    MSC->LOCK = MSC_LOCK_LOCKKEY_LOCK;
+}
+
+uint8_t update_begin(uint32_t ulSize, uint32_t ulCRC)
+{
+    update_abort();
+
+    if(!ulSize || ulSize > UPDATE_SLOT_SIZE)
+        return 0;
+
+    if(ulSize & 3) // Only full words can be programmed
+        return 0;
+
+    // A copy that never ran (no boot stub) must not pick up the staging slot once it is half rewritten
+    if(*(volatile uint32_t *)UPDATE_MARKER_ADDR != 0xFFFFFFFF)
+        msc_flash_page_erase(UPDATE_MARKER_ADDR);
+
+    ulUpdateSize = ulSize;
+    ulUpdateCRC = ulCRC;
+    ulUpdateReceived = 0;
+    ubUpdateActive = 1;
+
+    return 1;
+}
+uint8_t update_write(uint32_t ulOffset, const uint8_t *pubData, uint32_t ulSize)
+{
+    if(!ubUpdateActive)
+        return 0;
+
+    if(ulOffset != ulUpdateReceived) // Chunks have to arrive in order
+        return 0;
+
+    if(ulOffset >= ulUpdateSize)
+        return 0;
+
+    if(ulSize > ulUpdateSize - ulOffset) // Padding past the end of the image is dropped
+        ulSize = ulUpdateSize - ulOffset;
+
+    if(ulSize & 3) // Only full words can be programmed
+        return 0;
+
+    // Each page is erased when the first chunk for it arrives, the host waits for the reply so nothing is in flight while the core stalls
+    for(uint32_t ulPage = (ulOffset + FLASH_PAGE_SIZE - 1) & ~(uint32_t)(FLASH_PAGE_SIZE - 1); ulPage < ulOffset + ulSize; ulPage += FLASH_PAGE_SIZE)
+    {
+        msc_flash_page_erase(UPDATE_STAGING_ADDR + ulPage);
+
+        wdog_feed();
+    }
+
+    msc_flash_page_write(UPDATE_STAGING_ADDR + ulOffset, (uint8_t *)pubData, ulSize);
+
+    ulUpdateReceived += ulSize;
+
+    return 1;
+}
+uint8_t update_finish(uint32_t *pulCRC)
+{
+    if(!ubUpdateActive)
+        return 0;
+
+    if(ulUpdateReceived != ulUpdateSize)
+        return 0;
+
+    // Check what actually ended up in flash, not what was received
+    uint32_t ulCRC = calc_crc32((uint8_t *)UPDATE_STAGING_ADDR, ulUpdateSize);
+
+    if(pulCRC)
+        *pulCRC = ulCRC;
+
+    if(ulCRC != ulUpdateCRC)
+        return 0;
+
+    if(!IS_VALID_APP(UPDATE_STAGING_ADDR)) // Initial stack pointer has to be in RAM
+        return 0;
+
+    if(*(uint32_t *)(UPDATE_STAGING_ADDR + 4) - UPDATE_APP_ADDR >= ulUpdateSize) // Reset vector has to be inside the image
+        return 0;
+
+    ubUpdateActive = 0;
+    ubUpdateReady = 1;
+
+    return 1;
+}
+void update_abort()
+{
+    ubUpdateActive = 0;
+    ubUpdateReady = 0;
+}
+uint8_t update_is_active()
+{
+    return ubUpdateActive;
+}
+void update_apply()
+{
+    if(!ubUpdateReady)
+        return;
+
+    update_marker_t xMarker = {UPDATE_MARKER_MAGIC, ulUpdateSize, 0xFFFFFFFF};
+
+    msc_flash_page_erase(UPDATE_MARKER_ADDR);
+    msc_flash_page_write(UPDATE_MARKER_ADDR, (uint8_t *)&xMarker, offsetof(update_marker_t, ulDone)); // ulDone stays erased, the boot stub clears it once the copy is complete
+
+    __disable_irq();
+
+    SCB->AIRCR = 0x05FA0000 | _VAL2FLD(SCB_AIRCR_SYSRESETREQ, 1);
+
+    while(1);
+}
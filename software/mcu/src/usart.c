@@ -51,7 +51,7 @@ static volatile uint8_t *pubUSART0FIFO = NULL;
 static volatile uint16_t usUSART0FIFOWritePos, usUSART0FIFOReadPos;
 static ldma_descriptor_t __attribute__ ((aligned (4))) pUSART0DMADescriptor[2];
 
-void _usart0_rx_isr()
+void RAM_CODE _usart0_rx_isr()
 {
     uint32_t ulFlags = USART0->IFC;
 
@@ -91,7 +91,7 @@ void _usart0_rx_isr()
         ldma_ch_peri_req_enable(USART0_DMA_CHANNEL);
     }
 }
-static void usart0_dma_isr(uint8_t ubError)
+static void RAM_CODE usart0_dma_isr(uint8_t ubError)
 {
     if(ubError)
     {
@@ -0,0 +1,28 @@
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+
+static int iTestFailures = 0;
+
+#define TEST_CHECK(cond, ...) \
+    do \
+    { \
+        if(!(cond)) \
+        { \
+            printf("%s:%d: FAIL: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            iTestFailures++; \
+        } \
+    } while(0)
+#define TEST_RUN(fn) \
+    do \
+    { \
+        int iBefore = iTestFailures; \
+        fn(); \
+        printf("  %s %s\n", iTestFailures == iBefore ? "ok  " : "FAIL", #fn); \
+    } while(0)
+#define TEST_RESULT() (iTestFailures ? 1 : 0)
+
+#endif  // __TEST_H__
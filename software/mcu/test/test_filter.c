@@ -0,0 +1,150 @@
+#include <math.h>
+#include "filter.h"
+#include "test.h"
+
+#define STEP_LOW            1000 // Codes
+#define STEP_HIGH           3000 // Codes
+#define SETTLE_SAMPLES      4096 // Enough for the slowest IIR to settle to the last code
+
+static filter_t xFilter;
+
+static void test_invalid_config()
+{
+    TEST_CHECK(!filter_config(NULL, FILTER_TYPE_IIR, 4), "NULL filter accepted");
+    TEST_CHECK(!filter_config(&xFilter, FILTER_TYPE_IIR, 0), "IIR shift 0 accepted");
+    TEST_CHECK(!filter_config(&xFilter, FILTER_TYPE_IIR, FILTER_IIR_MAX_SHIFT + 1), "IIR shift %d accepted", FILTER_IIR_MAX_SHIFT + 1);
+    TEST_CHECK(!filter_config(&xFilter, FILTER_TYPE_MOVING_AVERAGE, 1), "moving average window 1 accepted");
+    TEST_CHECK(!filter_config(&xFilter, FILTER_TYPE_MOVING_AVERAGE, FILTER_MA_MAX_WINDOW + 1), "moving average window %d accepted", FILTER_MA_MAX_WINDOW + 1);
+    TEST_CHECK(!filter_config(&xFilter, FILTER_TYPE_MOVING_AVERAGE + 1, 4), "unknown type accepted");
+}
+static void test_none()
+{
+    TEST_CHECK(filter_config(&xFilter, FILTER_TYPE_NONE, 0), "config failed");
+
+    for(uint32_t i = 0; i < 65536; i += 257)
+        TEST_CHECK(filter_update(&xFilter, i) == i, "sample %u not passed through", i);
+}
+static void test_iir_step()
+{
+    for(uint8_t ubShift = 1; ubShift <= FILTER_IIR_MAX_SHIFT; ubShift++)
+    {
+        TEST_CHECK(filter_config(&xFilter, FILTER_TYPE_IIR, ubShift), "config failed for shift %hhu", ubShift);
+
+        uint16_t usOut = filter_update(&xFilter, STEP_LOW);
+
+        TEST_CHECK(usOut == STEP_LOW, "shift %hhu: first sample gave %hu instead of priming to %d", ubShift, usOut, STEP_LOW);
+
+        // y[n] = x - (x - y0) * (1 - 2^-k)^n, the Q8 state loses less than a code to truncation
+        double dPole = 1.0 - 1.0 / (1 << ubShift);
+
+        for(int n = 1; n <= 64; n++)
+        {
+            double dExpected = STEP_HIGH - (STEP_HIGH - STEP_LOW) * pow(dPole, n);
+
+            usOut = filter_update(&xFilter, STEP_HIGH);
+
+            TEST_CHECK(fabs(usOut - dExpected) <= 1.0, "shift %hhu: sample %d gave %hu, expected %.1f", ubShift, n, usOut, dExpected);
+        }
+    }
+}
+static void test_iir_gain()
+{
+    static const uint16_t pusLevel[] = {0, 1, 1000, 32768, 65535};
+
+    for(uint8_t ubShift = 1; ubShift <= FILTER_IIR_MAX_SHIFT; ubShift++)
+    {
+        for(uint8_t i = 0; i < sizeof(pusLevel) / sizeof(pusLevel[0]); i++)
+        {
+            // Settle from the far end of the range so both directions of the truncation are covered
+            uint16_t usStart = pusLevel[i] < 32768 ? 65535 : 0;
+            uint16_t usOut = 0;
+
+            filter_config(&xFilter, FILTER_TYPE_IIR, ubShift);
+            filter_update(&xFilter, usStart);
+
+            for(int n = 0; n < SETTLE_SAMPLES; n++)
+                usOut = filter_update(&xFilter, pusLevel[i]);
+
+            TEST_CHECK(fabs((double)usOut - pusLevel[i]) <= 1.0, "shift %hhu: settled at %hu for a constant %hu", ubShift, usOut, pusLevel[i]);
+        }
+    }
+}
+static void test_moving_average_step()
+{
+    for(uint8_t ubWindow = 2; ubWindow <= FILTER_MA_MAX_WINDOW; ubWindow++)
+    {
+        TEST_CHECK(filter_config(&xFilter, FILTER_TYPE_MOVING_AVERAGE, ubWindow), "config failed for window %hhu", ubWindow);
+
+        for(uint8_t n = 0; n < ubWindow; n++)
+            filter_update(&xFilter, STEP_LOW);
+
+        // A linear ramp over exactly one window, then flat
+        for(uint8_t n = 1; n <= 2 * ubWindow; n++)
+        {
+            uint8_t ubNew = n < ubWindow ? n : ubWindow;
+            double dExpected = (double)(STEP_LOW * (ubWindow - ubNew) + STEP_HIGH * ubNew) / ubWindow;
+            uint16_t usOut = filter_update(&xFilter, STEP_HIGH);
+
+            TEST_CHECK(fabs(usOut - dExpected) <= 0.5, "window %hhu: sample %hhu gave %hu, expected %.1f", ubWindow, n, usOut, dExpected);
+        }
+    }
+}
+static void test_moving_average_gain()
+{
+    static const uint16_t pusLevel[] = {0, 1, 1000, 32768, 65535};
+
+    for(uint8_t ubWindow = 2; ubWindow <= FILTER_MA_MAX_WINDOW; ubWindow++)
+    {
+        for(uint8_t i = 0; i < sizeof(pusLevel) / sizeof(pusLevel[0]); i++)
+        {
+            filter_config(&xFilter, FILTER_TYPE_MOVING_AVERAGE, ubWindow);
+
+            // Exact from the first sample on, the average is over the samples seen so far while the window fills
+            for(uint8_t n = 0; n < 2 * ubWindow; n++)
+            {
+                uint16_t usOut = filter_update(&xFilter, pusLevel[i]);
+
+                TEST_CHECK(usOut == pusLevel[i], "window %hhu: sample %hhu gave %hu for a constant %hu", ubWindow, n, usOut, pusLevel[i]);
+            }
+        }
+    }
+}
+static void test_stats()
+{
+    filter_stats_t xStats;
+
+    filter_stats_reset(&xStats, 1);
+
+    filter_stats_update(&xStats, 200);
+    filter_stats_update(&xStats, 100);
+    filter_stats_update(&xStats, 300);
+
+    TEST_CHECK(xStats.usMin == 100 && xStats.usMax == 300, "window min %hu, max %hu", xStats.usMin, xStats.usMax);
+    TEST_CHECK(xStats.ulCount == 3 && xStats.ullSum == 600, "count %u, sum %llu", xStats.ulCount, (unsigned long long)xStats.ullSum);
+
+    // A new window keeps the peaks unless they are cleared too
+    filter_stats_reset(&xStats, 0);
+    filter_stats_update(&xStats, 200);
+
+    TEST_CHECK(xStats.usMin == 200 && xStats.usMax == 200, "new window min %hu, max %hu", xStats.usMin, xStats.usMax);
+    TEST_CHECK(xStats.usPeak == 300 && xStats.usPeakMin == 100, "peaks %hu and %hu not held", xStats.usPeak, xStats.usPeakMin);
+
+    filter_stats_reset(&xStats, 1);
+
+    TEST_CHECK(xStats.usPeak == 0 && xStats.usPeakMin == 0xFFFF, "peaks %hu and %hu not cleared", xStats.usPeak, xStats.usPeakMin);
+}
+
+int main()
+{
+    printf("filter\n");
+
+    TEST_RUN(test_invalid_config);
+    TEST_RUN(test_none);
+    TEST_RUN(test_iir_step);
+    TEST_RUN(test_iir_gain);
+    TEST_RUN(test_moving_average_step);
+    TEST_RUN(test_moving_average_gain);
+    TEST_RUN(test_stats);
+
+    return TEST_RESULT();
+}
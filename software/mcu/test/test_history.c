@@ -0,0 +1,186 @@
+#include "history.h"
+#include "test.h"
+
+#define TEST_START_TIME     1000u // s
+#define TEST_MAX_SAMPLES    (HISTORY_TIER0_SAMPLES + 16)
+
+typedef struct
+{
+    uint32_t ulTime;
+    int16_t psFields[HISTORY_FIELDS];
+} test_sample_t;
+
+static test_sample_t pxDecoded[TEST_MAX_SAMPLES];
+
+static uint32_t test_read_varint(const history_block_t *pBlock, uint16_t *pusPos)
+{
+    uint32_t ulValue = 0;
+
+    for(uint8_t ubShift = 0; *pusPos < pBlock->usSize; ubShift += 7)
+    {
+        uint8_t ubByte = pBlock->ubData[(*pusPos)++];
+
+        ulValue |= (uint32_t)(ubByte & 0x7F) << ubShift;
+
+        if(!(ubByte & 0x80))
+            break;
+    }
+
+    return ulValue;
+}
+// Same decoding as the host tool, samples are appended to pxDecoded
+static uint16_t test_decode_tier0()
+{
+    uint16_t usCount = 0;
+    uint8_t ubBlocks = history_get_block_count(0);
+
+    for(uint8_t b = 0; b < ubBlocks; b++)
+    {
+        history_block_t xBlock;
+
+        TEST_CHECK(history_get_block(0, b, &xBlock), "block %hhu of %hhu missing", b, ubBlocks);
+
+        int16_t psFields[HISTORY_FIELDS];
+        uint16_t usPos = 0;
+
+        memcpy(psFields, xBlock.psKey, sizeof(psFields));
+
+        for(uint16_t n = 0; n < xBlock.usCount && usCount < TEST_MAX_SAMPLES; n++)
+        {
+            if(n)
+            {
+                uint32_t ulChanged = test_read_varint(&xBlock, &usPos);
+
+                for(uint8_t i = 0; i < HISTORY_FIELDS; i++)
+                {
+                    if(!(ulChanged & (1UL << i)))
+                        continue;
+
+                    uint16_t usZigzag = test_read_varint(&xBlock, &usPos);
+
+                    psFields[i] = (uint16_t)psFields[i] + (uint16_t)((usZigzag >> 1) ^ -(usZigzag & 1));
+                }
+            }
+
+            pxDecoded[usCount].ulTime = xBlock.ulTime + n * HISTORY_TIER0_PERIOD;
+            memcpy(pxDecoded[usCount].psFields, psFields, sizeof(psFields));
+
+            usCount++;
+        }
+
+        TEST_CHECK(usPos == xBlock.usSize, "block %hhu: %hu of %hu bytes decoded", b, usPos, xBlock.usSize);
+    }
+
+    history_block_t xPast;
+
+    TEST_CHECK(!history_get_block(0, ubBlocks, &xPast), "block past the last one returned");
+
+    return usCount;
+}
+// Every field jumps by close to the full range each second, the worst case for the delta encoding
+static void test_sample_noisy(uint32_t ulTime, int16_t *psSample)
+{
+    for(uint8_t i = 0; i < HISTORY_FIELDS; i++)
+        psSample[i] = (int16_t)((ulTime * 40503u + i * 9973u) ^ (ulTime & 1 ? 0x7FFF : 0x0000));
+
+    for(uint8_t i = 0; i < HISTORY_FIELDS; i++)
+        if(psSample[i] == HISTORY_INVALID)
+            psSample[i]++;
+}
+
+static void test_worst_case_span()
+{
+    int16_t psSample[HISTORY_FIELDS];
+
+    history_init();
+
+    for(uint32_t t = 0; t < 2 * HISTORY_TIER0_SAMPLES; t++)
+    {
+        test_sample_noisy(TEST_START_TIME + t, psSample);
+        history_push(TEST_START_TIME + t, psSample);
+    }
+
+    uint16_t usCount = test_decode_tier0();
+    uint32_t ulNewest = TEST_START_TIME + 2 * HISTORY_TIER0_SAMPLES - 1;
+
+    TEST_CHECK(usCount == HISTORY_TIER0_SAMPLES, "%hu samples kept instead of %d", usCount, HISTORY_TIER0_SAMPLES);
+
+    for(uint16_t n = 0; n < usCount; n++)
+    {
+        uint32_t ulTime = ulNewest - (usCount - 1 - n) * HISTORY_TIER0_PERIOD;
+
+        test_sample_noisy(ulTime, psSample);
+
+        TEST_CHECK(pxDecoded[n].ulTime == ulTime, "sample %hu at %u s instead of %u s", n, pxDecoded[n].ulTime, ulTime);
+        TEST_CHECK(!memcmp(pxDecoded[n].psFields, psSample, sizeof(psSample)), "sample %hu at %u s decoded wrong", n, ulTime);
+    }
+}
+static void test_gap()
+{
+    int16_t psSample[HISTORY_FIELDS];
+
+    history_init();
+
+    for(uint32_t t = 0; t < 10; t++)
+    {
+        test_sample_noisy(TEST_START_TIME + t, psSample);
+        history_push(TEST_START_TIME + t, psSample);
+    }
+
+    // Loop blocked for 5 periods
+    test_sample_noisy(TEST_START_TIME + 15, psSample);
+    history_push(TEST_START_TIME + 15, psSample);
+
+    uint16_t usCount = test_decode_tier0();
+
+    TEST_CHECK(usCount == 16, "%hu samples instead of 16", usCount);
+
+    for(uint16_t n = 0; n < usCount; n++)
+    {
+        TEST_CHECK(pxDecoded[n].ulTime == TEST_START_TIME + n, "sample %hu at %u s", n, pxDecoded[n].ulTime);
+
+        for(uint8_t i = 0; i < HISTORY_FIELDS; i++)
+        {
+            if(n < 10 || n == 15)
+                continue;
+
+            TEST_CHECK(pxDecoded[n].psFields[i] == HISTORY_INVALID, "skipped period %hu field %hhu has value %hd", n, i, pxDecoded[n].psFields[i]);
+        }
+    }
+
+    test_sample_noisy(TEST_START_TIME + 15, psSample);
+
+    TEST_CHECK(!memcmp(pxDecoded[15].psFields, psSample, sizeof(psSample)), "sample after the gap decoded wrong");
+}
+static void test_tier1_average()
+{
+    int16_t psSample[HISTORY_FIELDS];
+
+    history_init();
+
+    for(uint32_t t = 0; t < HISTORY_TIER1_DECIMATION; t++)
+    {
+        for(uint8_t i = 0; i < HISTORY_FIELDS; i++)
+            psSample[i] = i == 0 ? (int16_t)(t & 1 ? 200 : 100) : HISTORY_INVALID;
+
+        history_push(TEST_START_TIME + t, psSample);
+    }
+
+    history_block_t xBlock;
+
+    TEST_CHECK(history_get_block_count(1) == 1, "%hhu tier 1 blocks", history_get_block_count(1));
+    TEST_CHECK(history_get_block(1, 0, &xBlock), "tier 1 block missing");
+    TEST_CHECK(xBlock.ulTime == TEST_START_TIME && xBlock.usCount == 1, "tier 1 block at %u s with %hu samples", xBlock.ulTime, xBlock.usCount);
+    TEST_CHECK(xBlock.psKey[0] == 150 && xBlock.psKey[1] == HISTORY_INVALID, "tier 1 averaged to %hd and %hd", xBlock.psKey[0], xBlock.psKey[1]);
+}
+
+int main()
+{
+    printf("history\n");
+
+    TEST_RUN(test_worst_case_span);
+    TEST_RUN(test_gap);
+    TEST_RUN(test_tier1_average);
+
+    return TEST_RESULT();
+}
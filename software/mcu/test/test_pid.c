@@ -0,0 +1,193 @@
+#include <math.h>
+#include "pid.h"
+#include "test.h"
+
+// First order thermal plant, a heat source cooled by a fan, dT/dt = (T_ambient + R * P * (1 - k * duty) - T) / tau
+#define PLANT_AMBIENT       25.0 // C
+#define PLANT_RISE          40.0 // C, above ambient with the fan stopped
+#define PLANT_COOLING       0.8 // Fraction of the rise removed at full duty
+#define PLANT_TAU           30.0 // s
+#define PLANT_SUBSTEPS      16 // Integration steps per controller sample
+
+#define SAMPLE_PERIOD       1.0 // s
+#define SETPOINT            45.0 // C
+
+typedef struct
+{
+    double dTemperature;
+    double dLoad; // Scales the rise, disturbance input
+} plant_t;
+
+static void plant_step(plant_t *pPlant, uint16_t usDuty, double dPeriod)
+{
+    double dDuty = usDuty / 65535.0;
+    double dTarget = PLANT_AMBIENT + PLANT_RISE * pPlant->dLoad * (1.0 - PLANT_COOLING * dDuty);
+
+    for(int i = 0; i < PLANT_SUBSTEPS; i++)
+        pPlant->dTemperature += (dTarget - pPlant->dTemperature) * (dPeriod / PLANT_SUBSTEPS) / PLANT_TAU;
+}
+static int16_t plant_measure(const plant_t *pPlant)
+{
+    return (int16_t)lround(pPlant->dTemperature * 256.0); // Q8.8, like the sensors
+}
+static int32_t q16(double dValue)
+{
+    return (int32_t)lround(dValue * 65536.0);
+}
+static void setup(pid_controller_t *pPID, plant_t *pPlant)
+{
+    *pPID = (pid_controller_t){0};
+
+    // 0.1 duty per C, integral time of 20 samples, derivative time of 2 samples
+    pid_config(pPID, (int16_t)(SETPOINT * 256), q16(0.1), q16(0.1 / 20), q16(0.1 * 2), 2, 0, 65535);
+    pid_reset(pPID);
+
+    pPlant->dTemperature = PLANT_AMBIENT + PLANT_RISE; // Hot soaked, fan stopped
+    pPlant->dLoad = 1.0;
+}
+
+static void test_config_limits()
+{
+    pid_controller_t xPID = {0};
+
+    TEST_CHECK(!pid_config(&xPID, 0, 0, 0, 0, 0, 2, 1), "min above max accepted");
+    TEST_CHECK(!pid_config(&xPID, 0, 0, 0, 0, 16, 0, 1), "derivative filter 16 accepted");
+    TEST_CHECK(pid_config(&xPID, 0, 0, 0, 0, 15, 1, 1), "valid config rejected");
+    TEST_CHECK(!pid_config(NULL, 0, 0, 0, 0, 0, 0, 1), "NULL controller accepted");
+}
+static void test_settling()
+{
+    pid_controller_t xPID;
+    plant_t xPlant;
+    double dMinimum = 1000.0;
+    int iSettled = -1;
+
+    setup(&xPID, &xPlant);
+
+    for(int i = 0; i < 600; i++)
+    {
+        plant_step(&xPlant, pid_step(&xPID, plant_measure(&xPlant)), SAMPLE_PERIOD);
+
+        if(xPlant.dTemperature < dMinimum)
+            dMinimum = xPlant.dTemperature;
+
+        if(fabs(xPlant.dTemperature - SETPOINT) > 0.25)
+            iSettled = -1;
+        else if(iSettled < 0)
+            iSettled = i;
+    }
+
+    // Reverse acting, the overshoot is below the setpoint
+    TEST_CHECK(iSettled >= 0 && iSettled < 300, "not settled within 300 s (settled at %d)", iSettled);
+    TEST_CHECK(SETPOINT - dMinimum < 1.0, "overshoot %.2f C", SETPOINT - dMinimum);
+
+    // Steady state, the integral alone holds the duty cycle that balances the plant
+    double dExpected = (1.0 - (SETPOINT - PLANT_AMBIENT) / PLANT_RISE) / PLANT_COOLING;
+    uint16_t usDuty = pid_step(&xPID, plant_measure(&xPlant));
+
+    TEST_CHECK(fabs(usDuty / 65535.0 - dExpected) < 0.01, "steady state duty %.3f, expected %.3f", usDuty / 65535.0, dExpected);
+}
+static void test_output_limits()
+{
+    pid_controller_t xPID;
+    plant_t xPlant;
+
+    setup(&xPID, &xPlant);
+    pid_config(&xPID, xPID.sSetpoint, xPID.lKp, xPID.lKi, xPID.lKd, xPID.ubDerivativeFilter, 0x4000, 0xC000);
+
+    for(int i = 0; i < 600; i++)
+    {
+        uint16_t usDuty = pid_step(&xPID, plant_measure(&xPlant));
+
+        TEST_CHECK(usDuty >= 0x4000 && usDuty <= 0xC000, "duty 0x%04X out of limits at %d s", usDuty, i);
+
+        plant_step(&xPlant, usDuty, SAMPLE_PERIOD);
+    }
+}
+static void test_anti_windup()
+{
+    pid_controller_t xPID;
+    plant_t xPlant;
+
+    setup(&xPID, &xPlant);
+
+    for(int i = 0; i < 300; i++)
+        plant_step(&xPlant, pid_step(&xPID, plant_measure(&xPlant)), SAMPLE_PERIOD);
+
+    // Load step the fan cannot hold, full duty only gets down to 25 + 120 * 0.2 = 49 C
+    xPlant.dLoad = 3.0;
+
+    int32_t lIntegralMax = 0;
+
+    for(int i = 0; i < 600; i++)
+    {
+        plant_step(&xPlant, pid_step(&xPID, plant_measure(&xPlant)), SAMPLE_PERIOD);
+
+        if(xPID.lIntegral > lIntegralMax)
+            lIntegralMax = xPID.lIntegral;
+    }
+
+    TEST_CHECK(lIntegralMax <= (int32_t)0xFFFF << 8, "integral wound up past the output limit (0x%08X)", lIntegralMax);
+
+    TEST_CHECK(pid_step(&xPID, plant_measure(&xPlant)) == 0xFFFF, "not saturated under the load step");
+
+    // Load back to normal, a wound up integral would hold full duty long after the temperature crossed the setpoint
+    xPlant.dLoad = 1.0;
+
+    double dMinimum = 1000.0;
+    int iCrossed = -1;
+    int iReleased = -1;
+
+    for(int i = 0; i < 600; i++)
+    {
+        uint16_t usDuty = pid_step(&xPID, plant_measure(&xPlant));
+
+        if(iCrossed < 0 && xPlant.dTemperature < SETPOINT)
+            iCrossed = i;
+
+        if(iReleased < 0 && usDuty < 0xFFFF)
+            iReleased = i;
+
+        if(xPlant.dTemperature < dMinimum)
+            dMinimum = xPlant.dTemperature;
+
+        plant_step(&xPlant, usDuty, SAMPLE_PERIOD);
+    }
+
+    TEST_CHECK(iCrossed >= 0 && iReleased >= 0 && iReleased <= iCrossed, "output held saturated past the setpoint crossing (released %d s, crossed %d s)", iReleased, iCrossed);
+    TEST_CHECK(SETPOINT - dMinimum < 2.0, "undershoot after the load step %.2f C", SETPOINT - dMinimum);
+    TEST_CHECK(fabs(xPlant.dTemperature - SETPOINT) < 0.25, "not settled after the load step (%.2f C)", xPlant.dTemperature);
+}
+static void test_setpoint_step()
+{
+    pid_controller_t xPID;
+    plant_t xPlant;
+
+    setup(&xPID, &xPlant);
+
+    for(int i = 0; i < 300; i++)
+        plant_step(&xPlant, pid_step(&xPID, plant_measure(&xPlant)), SAMPLE_PERIOD);
+
+    uint16_t usBefore = pid_step(&xPID, plant_measure(&xPlant));
+
+    // Derivative on the measurement, a setpoint change only moves the output by the proportional and one integral step
+    xPID.sSetpoint -= 2 * 256;
+
+    uint16_t usAfter = pid_step(&xPID, plant_measure(&xPlant));
+    double dStep = (usAfter - usBefore) / 65535.0;
+
+    TEST_CHECK(fabs(dStep - (0.1 + 0.1 / 20) * 2) < 0.002, "setpoint step moved the output by %.3f, expected 0.210", dStep);
+}
+
+int main()
+{
+    printf("pid\n");
+
+    TEST_RUN(test_config_limits);
+    TEST_RUN(test_settling);
+    TEST_RUN(test_output_limits);
+    TEST_RUN(test_anti_windup);
+    TEST_RUN(test_setpoint_step);
+
+    return TEST_RESULT();
+}
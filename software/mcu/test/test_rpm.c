@@ -0,0 +1,139 @@
+#include <math.h>
+#include "rpm.h"
+#include "test.h"
+
+// Synthetic VEXT captures of a running 2-pin fan, each commutation pulls a current spike through the supply impedance
+#define TRACE_RATE          4000 // Hz, as decimated by rpm_task
+#define TRACE_SAMPLES       512
+#define TRACE_LEVEL         28600 // Codes, VEXT around 12 V behind the 1:11 divider
+#define TRACE_RIPPLE        120 // Codes, about 50 mV of droop per commutation
+#define TRACE_NOISE         16 // Codes, peak to peak, one 12 bit LSB
+
+static uint16_t pusTrace[TRACE_SAMPLES];
+static uint32_t ulNoiseState = 1;
+
+static int noise()
+{
+    ulNoiseState = ulNoiseState * 1664525 + 1013904223;
+
+    return (int)(ulNoiseState >> 16) % (TRACE_NOISE + 1) - TRACE_NOISE / 2;
+}
+static void trace_generate(double dFrequency, double dPhase, double dDrift)
+{
+    for(int i = 0; i < TRACE_SAMPLES; i++)
+    {
+        double dPosition = fmod(i * dFrequency / TRACE_RATE + dPhase, 1.0);
+        double dDroop = TRACE_RIPPLE * exp(-dPosition * 6.0); // Sharp spike at the commutation, decaying with the winding current
+
+        pusTrace[i] = (uint16_t)lround(TRACE_LEVEL - dDroop + dDrift * i / TRACE_SAMPLES + noise());
+    }
+}
+#define TRACE_TOLERANCE     0.05 // A few ripple periods per capture, each crossing is placed to a fraction of a sample
+
+static double rpm_error(uint16_t usRPM, double dFrequency, uint8_t ubPulsesPerRev)
+{
+    double dExpected = dFrequency * 60.0 / ubPulsesPerRev;
+
+    return fabs(usRPM - dExpected) / dExpected;
+}
+
+static void test_invalid_input()
+{
+    trace_generate(100.0, 0.0, 0.0);
+
+    TEST_CHECK(!rpm_estimate(NULL, TRACE_SAMPLES, TRACE_RATE, 4), "NULL samples accepted");
+    TEST_CHECK(!rpm_estimate(pusTrace, RPM_MIN_SAMPLES - 1, TRACE_RATE, 4), "short capture accepted");
+    TEST_CHECK(!rpm_estimate(pusTrace, TRACE_SAMPLES, 0, 4), "zero sample rate accepted");
+    TEST_CHECK(!rpm_estimate(pusTrace, TRACE_SAMPLES, TRACE_RATE, 0), "zero pulses per revolution accepted");
+}
+static void test_flat()
+{
+    // A stopped fan, only noise and a slow supply sag
+    for(int i = 0; i < TRACE_SAMPLES; i++)
+        pusTrace[i] = TRACE_LEVEL - i / 16 + noise();
+
+    TEST_CHECK(!rpm_estimate(pusTrace, TRACE_SAMPLES, TRACE_RATE, 4), "flat capture gave %hu RPM", rpm_estimate(pusTrace, TRACE_SAMPLES, TRACE_RATE, 4));
+}
+static void test_accuracy()
+{
+    static const double pdFrequency[] = {30.0, 50.0, 80.0, 133.3, 200.0, 350.0, 500.0}; // 450 to 7500 RPM with 4 commutations per revolution
+    static const uint8_t pubPulsesPerRev[] = {2, 4, 6};
+
+    for(unsigned f = 0; f < sizeof(pdFrequency) / sizeof(pdFrequency[0]); f++)
+    {
+        for(unsigned p = 0; p < sizeof(pubPulsesPerRev) / sizeof(pubPulsesPerRev[0]); p++)
+        {
+            double dWorst = 0.0;
+
+            for(int k = 0; k < 16; k++)
+            {
+                trace_generate(pdFrequency[f], k / 16.0, 0.0);
+
+                double dError = rpm_error(rpm_estimate(pusTrace, TRACE_SAMPLES, TRACE_RATE, pubPulsesPerRev[p]), pdFrequency[f], pubPulsesPerRev[p]);
+
+                if(dError > dWorst)
+                    dWorst = dError;
+            }
+
+            TEST_CHECK(dWorst < TRACE_TOLERANCE, "%.1f Hz, %hhu pulses per revolution, worst error %.1f%%", pdFrequency[f], pubPulsesPerRev[p], dWorst * 100.0);
+        }
+    }
+}
+static void test_drift()
+{
+    // VEXT sagging by more than the ripple over the capture, e.g. another channel spinning up
+    for(int k = 0; k < 16; k++)
+    {
+        trace_generate(80.0, k / 16.0, -4.0 * TRACE_RIPPLE);
+
+        uint16_t usRPM = rpm_estimate(pusTrace, TRACE_SAMPLES, TRACE_RATE, 4);
+
+        TEST_CHECK(rpm_error(usRPM, 80.0, 4) < TRACE_TOLERANCE, "drifting capture at phase %d/16 gave %hu RPM, expected 1200", k, usRPM);
+    }
+}
+static void test_low_speed()
+{
+    // Documented limit, RPM_MIN_CROSSINGS ripple periods and one to arm the trigger have to fit after the settle samples
+    double dLimit = (double)(RPM_MIN_CROSSINGS + 1) * TRACE_RATE / (TRACE_SAMPLES - RPM_SETTLE_SAMPLES);
+
+    for(int k = 0; k < 16; k++)
+    {
+        trace_generate(dLimit * 1.02, k / 16.0, 0.0);
+
+        uint16_t usRPM = rpm_estimate(pusTrace, TRACE_SAMPLES, TRACE_RATE, 4);
+
+        TEST_CHECK(rpm_error(usRPM, dLimit * 1.02, 4) < TRACE_TOLERANCE, "%.1f Hz at phase %d/16 gave %hu RPM", dLimit * 1.02, k, usRPM);
+    }
+
+    // Below it, e.g. 20 Hz, at most two crossings fit and there is no reading rather than a wrong one
+    for(int k = 0; k < 16; k++)
+    {
+        trace_generate(20.0, k / 16.0, 0.0);
+
+        uint16_t usRPM = rpm_estimate(pusTrace, TRACE_SAMPLES, TRACE_RATE, 4);
+
+        TEST_CHECK(!usRPM || rpm_error(usRPM, 20.0, 4) < TRACE_TOLERANCE, "20 Hz at phase %d/16 gave a wrong %hu RPM", k, usRPM);
+    }
+}
+static void test_saturation()
+{
+    // A 50 kHz ripple measured as 750000 RPM, clamped
+    for(int i = 0; i < TRACE_SAMPLES; i++)
+        pusTrace[i] = TRACE_LEVEL + (i & 4 ? TRACE_RIPPLE : 0);
+
+    TEST_CHECK(rpm_estimate(pusTrace, TRACE_SAMPLES, 400000, 1) == 0xFFFF, "not clamped to 65535 RPM");
+}
+
+int main()
+{
+    printf("rpm\n");
+
+    TEST_RUN(test_invalid_input);
+    TEST_RUN(test_flat);
+    TEST_RUN(test_accuracy);
+    TEST_RUN(test_drift);
+    TEST_RUN(test_low_speed);
+    TEST_RUN(test_saturation);
+
+    return TEST_RESULT();
+}